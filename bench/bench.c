@@ -0,0 +1,123 @@
+/*
+    bench.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+static const char *bench_filter = nullptr;
+static size_t bench_batches = BENCH_BATCHES;
+
+uint64_t bench_now( void ){
+    struct timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+void bench_init( int argc, char **argv ){
+    for( int i = 1; i < argc; ++i ){
+        if( strcmp( argv[i], "--quick" ) == 0 ){
+            bench_batches = 3;
+        }
+        else if( argv[i][0] != '-' ){
+            bench_filter = argv[i];
+        }
+    }
+    #ifndef __OPTIMIZE__
+    printf( "Warning: built without optimizations; configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers\n" );
+    #endif
+    printf( "%-40s %12s %12s %12s\n", "benchmark", "best ns/op", "median ns/op", "MB/s" );
+}
+
+bool bench_enabled( const char *name ){
+    return !bench_filter || strstr( name, bench_filter ) != nullptr;
+}
+
+static const char *bench_backends[] = {
+    [RTMP_BACKEND_AUTO] = "auto",
+    [RTMP_BACKEND_EPOLL] = "epoll",
+    [RTMP_BACKEND_IO_URING] = "io_uring",
+    [RTMP_BACKEND_POLL] = "poll",
+    [RTMP_BACKEND_SELECT] = "select"
+};
+
+const char * bench_backend_name( rtmp_backend_t backend ){
+    if( (size_t)backend >= sizeof( bench_backends ) / sizeof( bench_backends[0] ) ){
+        return "unknown";
+    }
+    return bench_backends[backend];
+}
+
+bool bench_backend_parse( const char *name, rtmp_backend_t *backend ){
+    for( size_t i = 0; i < sizeof( bench_backends ) / sizeof( bench_backends[0] ); ++i ){
+        if( strcmp( name, bench_backends[i] ) == 0 ){
+            *backend = (rtmp_backend_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int bench_compare( const void *a, const void *b ){
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+void bench_run( const char *name, bench_proc proc, void *user, size_t bytes ){
+    if( !bench_enabled( name ) ){
+        return;
+    }
+    //Grow the batch until it takes long enough to time reliably; this doubles as a warmup
+    size_t iterations = 1;
+    while( true ){
+        uint64_t start = bench_now();
+        proc( user, iterations );
+        uint64_t elapsed = bench_now() - start;
+        if( elapsed >= BENCH_BATCH_NS / 4 || iterations >= ( (size_t)1 << 40 ) ){
+            if( elapsed > 0 ){
+                iterations = iterations * (double)BENCH_BATCH_NS / elapsed + 1;
+            }
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double results[BENCH_BATCHES];
+    for( size_t i = 0; i < bench_batches; ++i ){
+        uint64_t start = bench_now();
+        proc( user, iterations );
+        results[i] = (double)( bench_now() - start ) / iterations;
+    }
+    qsort( results, bench_batches, sizeof( double ), bench_compare );
+    double best = results[0];
+    double median = results[bench_batches / 2];
+    if( bytes ){
+        printf( "%-40s %12.1f %12.1f %12.1f\n", name, best, median, bytes * 1000.0 / best );
+    }
+    else{
+        printf( "%-40s %12.1f %12.1f %12s\n", name, best, median, "-" );
+    }
+    fflush( stdout );
+}
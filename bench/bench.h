@@ -0,0 +1,64 @@
+/*
+    bench.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RTMP_H_BENCH_H
+#define RTMP_H_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/rtmp/rtmp_constants.h>
+
+//How long a single timed batch should take, and how many batches are timed
+#define BENCH_BATCH_NS 10000000
+#define BENCH_BATCHES 15
+
+//Runs the operation under test iterations times
+typedef void (*bench_proc)( void *user, size_t iterations );
+
+//Parses the common options: an optional name filter, and --quick for fewer batches.
+//Prints a warning if the benchmarks were built without optimizations.
+void bench_init( int argc, char **argv );
+
+//Times proc and prints the fastest and median time per operation.
+//If bytes is not zero, the throughput for that many bytes per operation is printed too.
+//Benchmarks whose names don't contain the filter passed to bench_init are skipped.
+void bench_run( const char *name, bench_proc proc, void *user, size_t bytes );
+
+//Returns true if a benchmark by this name would run
+bool bench_enabled( const char *name );
+
+//Monotonic time in nanoseconds
+uint64_t bench_now( void );
+
+//Names the backends the way --backend options take them
+const char * bench_backend_name( rtmp_backend_t backend );
+
+//Parses a backend name. Returns false if it isn't one.
+bool bench_backend_parse( const char *name, rtmp_backend_t *backend );
+
+//Keeps the compiler from discarding a computed value
+#define BENCH_KEEP(value) __asm__ volatile( "" : : "g"(value) : "memory" )
+
+#endif
@@ -0,0 +1,174 @@
+/*
+    bench_loopback.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+//Pumps synthetic audio and video from a client stream to a server stream entirely in memory,
+//so the handshake, chunking and message assembly are measured without any sockets involved.
+//Usage: bench_loopback [megabytes] [chunk size] [video frame size] [audio frame size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/rtmp/rtmp_stream.h>
+#include "bench.h"
+
+typedef struct{
+    size_t messages;
+    size_t bytes;
+} loopback_count_t;
+
+//Moves whatever src has ready to send into dst's input, then lets dst process it
+static bool loopback_move( rtmp_chunk_conn_t src, rtmp_chunk_conn_t dst ){
+    bool moved = false;
+    rtmp_chunk_conn_service( src );
+    while( true ){
+        const void *out;
+        void *in;
+        size_t out_len, in_len;
+        rtmp_chunk_conn_get_out_buff( src, &out, &out_len );
+        if( out_len == 0 ){
+            break;
+        }
+        rtmp_chunk_conn_get_in_buff( dst, &in, &in_len );
+        if( in_len == 0 ){
+            break;
+        }
+        if( in_len > out_len ){
+            in_len = out_len;
+        }
+        memcpy( in, out, in_len );
+        rtmp_chunk_conn_commit_in_buff( dst, in_len );
+        rtmp_chunk_conn_commit_out_buff( src, in_len );
+        rtmp_chunk_conn_service( dst );
+        moved = true;
+    }
+    return moved;
+}
+
+static void loopback_pump( rtmp_chunk_conn_t client, rtmp_chunk_conn_t server ){
+    bool moved = true;
+    while( moved ){
+        moved = loopback_move( client, server );
+        moved = loopback_move( server, client ) || moved;
+    }
+}
+
+static rtmp_cb_status_t loopback_on_media( rtmp_stream_args_t args, const byte *data, size_t length, size_t remaining, void *user ){
+    loopback_count_t *count = user;
+    count->bytes += length;
+    if( remaining == 0 ){
+        ++count->messages;
+    }
+    return RTMP_CB_CONTINUE;
+}
+
+int main( int argc, char **argv ){
+    size_t megabytes = argc > 1 ? strtoul( argv[1], nullptr, 10 ) : 256;
+    size_t chunk_size = argc > 2 ? strtoul( argv[2], nullptr, 10 ) : 4096;
+    size_t video_size = argc > 3 ? strtoul( argv[3], nullptr, 10 ) : 8192;
+    size_t audio_size = argc > 4 ? strtoul( argv[4], nullptr, 10 ) : 256;
+    if( video_size == 0 || audio_size == 0 ){
+        printf( "Frame sizes must not be zero\n" );
+        return 1;
+    }
+
+    #ifndef __OPTIMIZE__
+    printf( "Warning: built without optimizations; configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers\n" );
+    #endif
+
+    byte *video = malloc( video_size );
+    byte *audio = malloc( audio_size );
+    memset( video, 0x17, video_size );
+    memset( audio, 0xAF, audio_size );
+
+    rtmp_stream_t client = rtmp_stream_create( true );
+    rtmp_stream_t server = rtmp_stream_create( false );
+    rtmp_chunk_conn_t client_conn = rtmp_stream_get_conn( client );
+    rtmp_chunk_conn_t server_conn = rtmp_stream_get_conn( server );
+    loopback_count_t received = { 0, 0 };
+    rtmp_stream_reg_msg( server, RTMP_MSG_VIDEO, loopback_on_media, &received );
+    rtmp_stream_reg_msg( server, RTMP_MSG_AUDIO, loopback_on_media, &received );
+
+    uint64_t start = bench_now();
+    loopback_pump( client_conn, server_conn );
+    uint64_t shake_time = bench_now() - start;
+    if( !rtmp_chunk_conn_connected( client_conn ) || !rtmp_chunk_conn_connected( server_conn ) ){
+        printf( "Handshake did not complete\n" );
+        return 1;
+    }
+    rtmp_chunk_conn_set_chunk_size( client_conn, chunk_size );
+    loopback_pump( client_conn, server_conn );
+    rtmp_stats_t setup_stats;
+    rtmp_stream_get_stats( server, &setup_stats );
+
+    //Alternate video and audio frames, filling the output buffer before each pump like a real sender would
+    size_t total = megabytes * 1024 * 1024;
+    size_t sent_bytes = 0, sent_messages = 0;
+    rtmp_time_t timestamp = 0;
+    start = bench_now();
+    while( sent_bytes < total ){
+        while( sent_bytes < total ){
+            bool is_video = sent_messages % 2 == 0;
+            rtmp_err_t err = is_video ?
+                rtmp_stream_send_video( client, timestamp, video, video_size, nullptr ) :
+                rtmp_stream_send_audio( client, timestamp, audio, audio_size, nullptr );
+            if( err >= RTMP_ERR_ERROR ){
+                break;
+            }
+            sent_bytes += is_video ? video_size : audio_size;
+            ++sent_messages;
+            timestamp += 20;
+        }
+        loopback_pump( client_conn, server_conn );
+    }
+    uint64_t elapsed = bench_now() - start;
+
+    rtmp_stats_t client_stats, server_stats;
+    rtmp_stream_get_stats( client, &client_stats );
+    rtmp_stream_get_stats( server, &server_stats );
+
+    double seconds = elapsed / 1e9;
+    printf( "handshake:         %.1f us\n", shake_time / 1e3 );
+    printf( "chunk size:        %zu\n", chunk_size );
+    printf( "frames:            %zu B video, %zu B audio\n", video_size, audio_size );
+    printf( "payload:           %zu of %zu bytes in %zu of %zu messages\n", received.bytes, sent_bytes, received.messages, sent_messages );
+    printf( "wire:              %llu bytes in %llu chunks\n",
+        (unsigned long long)server_stats.bytes_in, (unsigned long long)server_stats.chunks_in );
+    printf( "header bytes/msg:  %.2f\n",
+        (double)( server_stats.bytes_in - setup_stats.bytes_in - received.bytes ) / ( received.messages ? received.messages : 1 ) );
+    printf( "elapsed:           %.3f s\n", seconds );
+    printf( "payload MB/s:      %.1f\n", received.bytes / seconds / ( 1024 * 1024 ) );
+    printf( "messages/s:        %.0f\n", received.messages / seconds );
+    printf( "chunks/s:          %.0f\n", client_stats.chunks_out / seconds );
+
+    bool complete = received.bytes == sent_bytes && received.messages == sent_messages;
+    if( !complete ){
+        printf( "Not every message arrived\n" );
+    }
+
+    rtmp_stream_destroy( client );
+    rtmp_stream_destroy( server );
+    free( video );
+    free( audio );
+    return complete ? 0 : 1;
+}
@@ -0,0 +1,463 @@
+/*
+    bench_micro.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+//Microbenchmarks for the building blocks of the chunk and command paths.
+//Usage: bench_micro [--quick] [name filter]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/rtmp/rtmp_chunk_flow.h>
+#include <openrtmp/rtmp/rtmp_chunk_cache.h>
+#include <openrtmp/util/ringbuffer.h>
+#include <openrtmp/util/algorithm.h>
+#include <openrtmp/util/handletable.h>
+#include <openrtmp/amf/amf_object.h>
+#include <openrtmp/amf/amf.h>
+#include "bench.h"
+
+#define HDR_BATCH 256
+#define CACHE_IDS 64
+#define SEARCH_COUNT 1024
+#define HANDLE_COUNT 50000
+#define DISPATCH_CALLS 1000
+#define DISPATCH_HANDLERS 32
+
+static byte payload[65536];
+
+
+//Ringbuffers
+
+typedef struct{
+    ringbuffer_t ring;
+    size_t size;
+} ring_bench_t;
+
+static void bench_ring_copy( void *user, size_t iterations ){
+    ring_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        ringbuffer_copy_write( b->ring, payload, b->size );
+        ringbuffer_copy_read( b->ring, payload, b->size );
+    }
+}
+
+static void bench_ring_commit( void *user, size_t iterations ){
+    ring_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        unsigned long size;
+        void *dst = ringbuffer_get_write_buf( b->ring, &size );
+        BENCH_KEEP( dst );
+        ringbuffer_commit_write( b->ring, b->size < size ? b->size : size );
+        const void *src = ringbuffer_get_read_buf( b->ring, &size );
+        BENCH_KEEP( src );
+        ringbuffer_commit_read( b->ring, size );
+    }
+}
+
+static void run_ring( void ){
+    ring_bench_t b;
+    b.ring = ringbuffer_create( 1 << 20 );
+    b.size = 128;
+    bench_run( "ringbuffer_copy 128B", bench_ring_copy, &b, b.size );
+    b.size = 4096;
+    bench_run( "ringbuffer_copy 4KB", bench_ring_copy, &b, b.size );
+    b.size = 65536;
+    bench_run( "ringbuffer_copy 64KB", bench_ring_copy, &b, b.size );
+    b.size = 4096;
+    bench_run( "ringbuffer_commit 4KB", bench_ring_commit, &b, 0 );
+    ringbuffer_destroy( b.ring );
+}
+
+
+//Chunk headers
+
+typedef struct{
+    ringbuffer_t ring;
+    rtmp_chunk_stream_cache_t cache;
+    rtmp_chunk_stream_message_t msg[4];
+    byte *encoded;
+    size_t encoded_len;
+} hdr_bench_t;
+
+//Four interleaved chunk streams, like audio, video, data and commands on a busy connection.
+//Every fourth message changes length, so there is a mix of every header format.
+static void hdr_setup( hdr_bench_t *b ){
+    b->ring = ringbuffer_create( 1 << 20 );
+    b->cache = rtmp_cache_create();
+    for( size_t i = 0; i < 4; ++i ){
+        b->msg[i].chunk_stream_id = 4 + i;
+        b->msg[i].message_stream_id = 1;
+        b->msg[i].message_length = 100 + i * 1000;
+        b->msg[i].message_type = i == 0 ? RTMP_MSG_AUDIO : RTMP_MSG_VIDEO;
+        b->msg[i].timestamp = 0;
+    }
+}
+
+static void hdr_next( rtmp_chunk_stream_message_t *msg, size_t i ){
+    msg->timestamp += 23;
+    if( i % 4 == 0 ){
+        msg->message_length += 1;
+    }
+}
+
+static void bench_hdr_emit( void *user, size_t iterations ){
+    hdr_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        rtmp_chunk_stream_message_t *msg = &b->msg[i % 4];
+        hdr_next( msg, i );
+        rtmp_chunk_emit_hdr( b->ring, msg, b->cache );
+        if( ringbuffer_count( b->ring ) > ( 1 << 19 ) ){
+            ringbuffer_clear( b->ring );
+        }
+    }
+}
+
+static void bench_hdr_read( void *user, size_t iterations ){
+    hdr_bench_t *b = user;
+    for( size_t i = 0; i < iterations; i += HDR_BATCH ){
+        //The batch always starts with full headers, so the read cache never goes stale
+        ringbuffer_copy_write( b->ring, b->encoded, b->encoded_len );
+        for( size_t k = 0; k < HDR_BATCH; ++k ){
+            rtmp_chunk_stream_message_t *msg;
+            rtmp_chunk_read_hdr( b->ring, &msg, b->cache );
+            BENCH_KEEP( msg );
+        }
+    }
+}
+
+static void run_hdr( void ){
+    hdr_bench_t b;
+    hdr_setup( &b );
+    bench_run( "rtmp_chunk_emit_hdr", bench_hdr_emit, &b, 0 );
+    ringbuffer_destroy( b.ring );
+    rtmp_cache_destroy( b.cache );
+
+    //Record a batch of headers to replay
+    hdr_setup( &b );
+    for( size_t i = 0; i < HDR_BATCH; ++i ){
+        rtmp_chunk_stream_message_t *msg = &b.msg[i % 4];
+        hdr_next( msg, i );
+        rtmp_chunk_emit_hdr( b.ring, msg, b.cache );
+    }
+    b.encoded_len = ringbuffer_count( b.ring );
+    b.encoded = malloc( b.encoded_len );
+    ringbuffer_copy_read( b.ring, b.encoded, b.encoded_len );
+    rtmp_cache_reset( b.cache );
+    //The time per header includes copying it back into the ringbuffer
+    bench_run( "rtmp_chunk_read_hdr", bench_hdr_read, &b, 0 );
+    free( b.encoded );
+    ringbuffer_destroy( b.ring );
+    rtmp_cache_destroy( b.cache );
+}
+
+
+//AMF
+
+typedef struct{
+    amf_t object;
+    byte encoded[4096];
+    size_t encoded_len;
+    char version;
+    bool arena;
+} amf_bench_t;
+
+//A typical connect command
+static amf_t amf_build( char version ){
+    amf_t amf = amf_create( version );
+    amf_push_simple( amf, AMF(
+        AMF_STR( "connect" ),
+        AMF_DBL( 1.0 ),
+        AMF_OBJ(
+            AMF_STR( "app", "live" ),
+            AMF_STR( "flashVer", "FMLE/3.0 (compatible; FMSc/1.0)" ),
+            AMF_STR( "swfUrl", "rtmp://localhost/live" ),
+            AMF_STR( "tcUrl", "rtmp://localhost/live" ),
+            AMF_BOOL( "fpad", 0 ),
+            AMF_DBL( "capabilities", 239.0 ),
+            AMF_DBL( "audioCodecs", 3575.0 ),
+            AMF_DBL( "videoCodecs", 252.0 ),
+            AMF_DBL( "videoFunction", 1.0 ),
+            AMF_STR( "pageUrl", "http://localhost/player.html" ),
+            AMF_DBL( "objectEncoding", (double)version )
+        )
+    ));
+    return amf;
+}
+
+static void bench_amf_write( void *user, size_t iterations ){
+    amf_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        amf_write( b->object, b->encoded, sizeof( b->encoded ), nullptr );
+    }
+}
+
+static void bench_amf_read( void *user, size_t iterations ){
+    amf_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        amf_t amf = b->arena ? amf_create_arena( b->version, b->encoded_len, false ) : amf_create( b->version );
+        amf_read( amf, b->encoded, b->encoded_len, nullptr );
+        amf_destroy( amf );
+    }
+}
+
+static void run_amf( void ){
+    amf_bench_t b;
+    const char *names[2][3] = {
+        { "amf_write AMF0", "amf_read AMF0", "amf_read AMF0 arena" },
+        { "amf_write AMF3", "amf_read AMF3", "amf_read AMF3 arena" }
+    };
+    for( size_t v = 0; v < 2; ++v ){
+        b.version = v == 0 ? 0 : 3;
+        b.object = amf_build( b.version );
+        b.encoded_len = amf_write( b.object, b.encoded, sizeof( b.encoded ), nullptr );
+        bench_run( names[v][0], bench_amf_write, &b, b.encoded_len );
+        b.arena = false;
+        bench_run( names[v][1], bench_amf_read, &b, b.encoded_len );
+        b.arena = true;
+        bench_run( names[v][2], bench_amf_read, &b, b.encoded_len );
+        amf_destroy( b.object );
+    }
+}
+
+
+//Chunk stream cache
+
+typedef struct{
+    rtmp_chunk_stream_cache_t cache;
+    size_t ids[CACHE_IDS];
+} cache_bench_t;
+
+static void bench_cache_get( void *user, size_t iterations ){
+    cache_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        BENCH_KEEP( rtmp_cache_get( b->cache, b->ids[i % CACHE_IDS] ) );
+    }
+}
+
+static void run_cache( void ){
+    cache_bench_t b;
+    b.cache = rtmp_cache_create();
+    //A few low IDs like a publisher uses, and the rest spread out like a server with many play streams
+    for( size_t i = 0; i < CACHE_IDS; ++i ){
+        b.ids[i] = i < 8 ? 2 + i : 2 + i * 37;
+        rtmp_cache_get( b.cache, b.ids[i] );
+    }
+    bench_run( "rtmp_cache_get", bench_cache_get, &b, 0 );
+    rtmp_cache_destroy( b.cache );
+}
+
+
+//Binary search
+
+typedef struct{
+    size_t haystack[SEARCH_COUNT];
+    size_t needles[SEARCH_COUNT];
+} search_bench_t;
+
+static bool size_less( const void * restrict a, const void * restrict b ){
+    return *(const size_t*)a < *(const size_t*)b;
+}
+
+static void bench_search_bin( void *user, size_t iterations ){
+    search_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        BENCH_KEEP( alg_search_bin( &b->needles[i % SEARCH_COUNT], b->haystack, sizeof( size_t ), SEARCH_COUNT, size_less ) );
+    }
+}
+
+static void run_search( void ){
+    search_bench_t *b = malloc( sizeof( search_bench_t ) );
+    srand( 1 );
+    for( size_t i = 0; i < SEARCH_COUNT; ++i ){
+        b->haystack[i] = i * 3;
+        b->needles[i] = rand() % ( SEARCH_COUNT * 3 );
+    }
+    bench_run( "alg_search_bin 1024", bench_search_bin, b, 0 );
+    free( b );
+}
+
+
+//Handle table
+
+typedef struct{
+    handle_table_t table;
+    handle_t handles[HANDLE_COUNT];
+    size_t victims[1024];
+} handle_bench_t;
+
+//Connection churn on a busy manager: one connection goes away and another takes its place
+static void bench_handle_churn( void *user, size_t iterations ){
+    handle_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        size_t victim = b->victims[i % 1024];
+        handle_table_remove( b->table, b->handles[victim] );
+        b->handles[victim] = handle_table_add( b->table, &b->handles[victim] );
+    }
+}
+
+static void bench_handle_get( void *user, size_t iterations ){
+    handle_bench_t *b = user;
+    for( size_t i = 0; i < iterations; ++i ){
+        BENCH_KEEP( handle_table_get( b->table, b->handles[b->victims[i % 1024]] ) );
+    }
+}
+
+static void run_handle( void ){
+    handle_bench_t *b = malloc( sizeof( handle_bench_t ) );
+    b->table = handle_table_create();
+    srand( 1 );
+    for( size_t i = 0; i < HANDLE_COUNT; ++i ){
+        b->handles[i] = handle_table_add( b->table, &b->handles[i] );
+    }
+    for( size_t i = 0; i < 1024; ++i ){
+        b->victims[i] = rand() % HANDLE_COUNT;
+    }
+    bench_run( "handle_table churn 50k", bench_handle_churn, b, 0 );
+    bench_run( "handle_table_get 50k", bench_handle_get, b, 0 );
+    handle_table_destroy( b->table );
+    free( b );
+}
+
+
+//Command dispatch
+
+typedef struct{
+    rtmp_stream_t stream;
+    rtmp_chunk_stream_message_t msg;
+    byte result[256], error[256], command[256];
+    size_t result_len, error_len, command_len;
+    //The oldest of the calls kept pending
+    uint32_t oldest;
+} dispatch_bench_t;
+
+static rtmp_cb_status_t dispatch_on_amf( rtmp_stream_args_t args, amf_t object, void *user ){
+    BENCH_KEEP( object );
+    return RTMP_CB_CONTINUE;
+}
+
+//Answers to calls issue a new one in their place, so there are always DISPATCH_CALLS pending
+static rtmp_cb_status_t dispatch_on_result( rtmp_stream_args_t args, amf_t object, void *user ){
+    dispatch_bench_t *b = user;
+    rtmp_stream_call( b->stream, "getStreamLength", dispatch_on_result, b, AMF( AMF_NULL(), AMF_STR( "live" ) ) );
+    return RTMP_CB_CONTINUE;
+}
+
+//Throws away what the calls sent, so the output never fills up
+static void dispatch_flush( dispatch_bench_t *b ){
+    rtmp_chunk_conn_t conn = rtmp_stream_get_conn( b->stream );
+    const void *out;
+    size_t len;
+    while( rtmp_chunk_conn_get_out_buff( conn, &out, &len ) == RTMP_ERR_NONE && len > 0 ){
+        rtmp_chunk_conn_commit_out_buff( conn, len );
+    }
+}
+
+static size_t dispatch_encode( byte *dest, size_t size, const char *name ){
+    amf_t amf = amf_create( 0 );
+    amf_push_simple( amf, AMF(
+        AMF_STR( name ),
+        AMF_DBL( 0.0 ),
+        AMF_NULL(),
+        AMF_OBJ(
+            AMF_STR( "level", "status" ),
+            AMF_STR( "code", "NetStream.Play.Start" ),
+            AMF_DBL( "duration", 0.0 )
+        )
+    ));
+    size_t len = amf_write( amf, dest, size, nullptr );
+    amf_destroy( amf );
+    return len;
+}
+
+//Feeds answers to the oldest pending call, with the transaction ID written in after the name
+static void dispatch_answer( dispatch_bench_t *b, byte *encoded, size_t len, size_t name_len, size_t iterations ){
+    for( size_t i = 0; i < iterations; ++i ){
+        amf0_write_number( encoded + 3 + name_len, len - 3 - name_len, b->oldest++ );
+        b->msg.message_length = len;
+        rtmp_stream_chunk_proc( rtmp_stream_get_conn( b->stream ), encoded, len, 0, &b->msg, b->stream );
+        if( ( i & 63 ) == 63 ){
+            dispatch_flush( b );
+        }
+    }
+    dispatch_flush( b );
+}
+
+static void bench_dispatch_result( void *user, size_t iterations ){
+    dispatch_bench_t *b = user;
+    dispatch_answer( b, b->result, b->result_len, 7, iterations );
+}
+
+static void bench_dispatch_error( void *user, size_t iterations ){
+    dispatch_bench_t *b = user;
+    dispatch_answer( b, b->error, b->error_len, 6, iterations );
+}
+
+static void bench_dispatch_command( void *user, size_t iterations ){
+    dispatch_bench_t *b = user;
+    b->msg.message_length = b->command_len;
+    for( size_t i = 0; i < iterations; ++i ){
+        rtmp_stream_chunk_proc( rtmp_stream_get_conn( b->stream ), b->command, b->command_len, 0, &b->msg, b->stream );
+    }
+}
+
+static void run_dispatch( void ){
+    dispatch_bench_t *b = malloc( sizeof( dispatch_bench_t ) );
+    b->stream = rtmp_stream_create( false );
+    memset( &b->msg, 0, sizeof( b->msg ) );
+    b->msg.chunk_stream_id = 3;
+    b->msg.message_type = RTMP_MSG_AMF0_CMD;
+    //Named handlers like a server registers, and one of them gets the commands
+    char name[32];
+    for( size_t i = 0; i < DISPATCH_HANDLERS; ++i ){
+        snprintf( name, sizeof( name ), "command%zu", i );
+        rtmp_stream_reg_amf( b->stream, RTMP_MSG_AMF0_CMD, name, dispatch_on_amf, b );
+    }
+    b->result_len = dispatch_encode( b->result, sizeof( b->result ), "_result" );
+    b->error_len = dispatch_encode( b->error, sizeof( b->error ), "_error" );
+    b->command_len = dispatch_encode( b->command, sizeof( b->command ), "command17" );
+    b->oldest = 1;
+    for( size_t i = 0; i < DISPATCH_CALLS; ++i ){
+        rtmp_stream_call( b->stream, "getStreamLength", dispatch_on_result, b, AMF( AMF_NULL(), AMF_STR( "live" ) ) );
+        dispatch_flush( b );
+    }
+    bench_run( "dispatch _result 1000 pending", bench_dispatch_result, b, 0 );
+    bench_run( "dispatch _error 1000 pending", bench_dispatch_error, b, 0 );
+    bench_run( "dispatch command 32 handlers", bench_dispatch_command, b, 0 );
+    rtmp_stream_destroy( b->stream );
+    free( b );
+}
+
+
+int main( int argc, char **argv ){
+    bench_init( argc, argv );
+    memset( payload, 0x5A, sizeof( payload ) );
+    run_ring();
+    run_hdr();
+    run_amf();
+    run_cache();
+    run_search();
+    run_handle();
+    run_dispatch();
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+    bench_wakeup.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+//Compares the backends a manager can use. For each one, a manager watches some number of idle connections while
+//another thread posts it tasks, one at a time. Reports how long each task took to start running, and how much CPU
+//time the manager's thread spent per wakeup.
+//Usage: bench_wakeup [--quick] [backend]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <openrtmp/rtmp.h>
+#include "bench.h"
+
+#define WAKEUP_ROUNDS 2000
+#define WAKEUP_ROUNDS_QUICK 300
+//Idle connections watched during each run. Each one takes two descriptors in this process, and select()
+//can't watch any numbered FD_SETSIZE or higher.
+#define WAKEUP_IDLE_MAX 400
+#define WAKEUP_PORT 19450
+//Time between tasks, so that the manager is back to waiting when the next one is posted
+#define WAKEUP_GAP_US 100
+
+static const size_t wakeup_idle[] = { 0, 50, WAKEUP_IDLE_MAX };
+static const rtmp_backend_t wakeup_backends[] = { RTMP_BACKEND_EPOLL, RTMP_BACKEND_POLL, RTMP_BACKEND_SELECT, RTMP_BACKEND_IO_URING };
+
+typedef struct{
+    rtmp_t mgr;
+    size_t accepted;
+    bool stop;
+    uint64_t posted;
+    uint64_t started;
+    size_t done;
+} wakeup_ctx_t;
+
+static rtmp_cb_status_t wakeup_on_connect( rtmp_server_t server, void *user ){
+    wakeup_ctx_t *ctx = user;
+    __atomic_add_fetch( &ctx->accepted, 1, __ATOMIC_RELEASE );
+    return RTMP_CB_CONTINUE;
+}
+
+static void wakeup_on_task( rtmp_t mgr, void *user ){
+    wakeup_ctx_t *ctx = user;
+    ctx->started = bench_now();
+    __atomic_add_fetch( &ctx->done, 1, __ATOMIC_RELEASE );
+}
+
+static void wakeup_on_stop( rtmp_t mgr, void *user ){
+    wakeup_ctx_t *ctx = user;
+    __atomic_store_n( &ctx->stop, true, __ATOMIC_RELEASE );
+}
+
+static void * wakeup_service( void *user ){
+    wakeup_ctx_t *ctx = user;
+    while( !__atomic_load_n( &ctx->stop, __ATOMIC_ACQUIRE ) ){
+        rtmp_service( ctx->mgr, 1000 );
+    }
+    return nullptr;
+}
+
+static int wakeup_compare( const void *a, const void *b ){
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double wakeup_cpu( pthread_t thread ){
+    clockid_t clock;
+    struct timespec t;
+    if( pthread_getcpuclockid( thread, &clock ) != 0 || clock_gettime( clock, &t ) != 0 ){
+        return 0;
+    }
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+//Returns false if the backend isn't supported
+static bool wakeup_run( rtmp_backend_t backend, size_t idle, size_t rounds, unsigned short port ){
+    wakeup_ctx_t ctx;
+    memset( &ctx, 0, sizeof( ctx ) );
+    ctx.mgr = rtmp_create();
+    if( !ctx.mgr || rtmp_set_backend( ctx.mgr, backend ) >= RTMP_ERR_ERROR ){
+        if( ctx.mgr ){
+            rtmp_destroy( ctx.mgr );
+        }
+        return false;
+    }
+    if( rtmp_listen( ctx.mgr, "127.0.0.1", port, wakeup_on_connect, &ctx ) >= RTMP_ERR_ERROR ){
+        printf( "%-10s %8zu couldn't listen on port %u\n", bench_backend_name( backend ), idle, port );
+        rtmp_destroy( ctx.mgr );
+        return true;
+    }
+    pthread_t thread;
+    pthread_create( &thread, nullptr, wakeup_service, &ctx );
+
+    int *socks = malloc( ( idle + 1 ) * sizeof( int ) );
+    union{
+        struct sockaddr_in sin;
+        struct sockaddr s;
+    } addr;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sin.sin_family = AF_INET;
+    addr.sin.sin_port = htons( port );
+    addr.sin.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    size_t opened = 0;
+    for( ; opened < idle; ++opened ){
+        socks[opened] = socket( AF_INET, SOCK_STREAM, 0 );
+        if( socks[opened] < 0 || connect( socks[opened], &addr.s, sizeof( addr ) ) < 0 ){
+            if( socks[opened] >= 0 ){
+                close( socks[opened] );
+            }
+            printf( "Only %zu of %zu idle connections could be opened\n", opened, idle );
+            break;
+        }
+    }
+    //Let the manager accept them all and settle, so that nothing but the tasks wakes it up.
+    //A backend which refuses some of them is reported with the number it did take.
+    for( size_t waited = 0; waited < 2000 && __atomic_load_n( &ctx.accepted, __ATOMIC_ACQUIRE ) < opened; ++waited ){
+        usleep( 1000 );
+    }
+    usleep( 50000 );
+
+    uint64_t *latency = malloc( rounds * sizeof( uint64_t ) );
+    double cpu_start = wakeup_cpu( thread );
+    for( size_t i = 0; i < rounds; ++i ){
+        usleep( WAKEUP_GAP_US );
+        uint64_t posted = bench_now();
+        rtmp_post( ctx.mgr, wakeup_on_task, &ctx );
+        while( __atomic_load_n( &ctx.done, __ATOMIC_ACQUIRE ) <= i ){
+        }
+        latency[i] = ctx.started - posted;
+    }
+    double cpu = ( wakeup_cpu( thread ) - cpu_start ) / rounds;
+
+    rtmp_post( ctx.mgr, wakeup_on_stop, &ctx );
+    pthread_join( thread, nullptr );
+    for( size_t i = 0; i < opened; ++i ){
+        close( socks[i] );
+    }
+    rtmp_destroy( ctx.mgr );
+
+    qsort( latency, rounds, sizeof( uint64_t ), wakeup_compare );
+    printf( "%-10s %8zu %12.1f %12.1f %12.1f %14.1f\n", bench_backend_name( backend ), __atomic_load_n( &ctx.accepted, __ATOMIC_ACQUIRE ),
+        latency[rounds / 2] / 1e3, latency[rounds * 99 / 100] / 1e3, latency[rounds - 1] / 1e3, cpu / 1e3 );
+    fflush( stdout );
+    free( latency );
+    free( socks );
+    return true;
+}
+
+int main( int argc, char **argv ){
+    size_t rounds = WAKEUP_ROUNDS;
+    rtmp_backend_t only = RTMP_BACKEND_AUTO;
+    for( int i = 1; i < argc; ++i ){
+        if( strcmp( argv[i], "--quick" ) == 0 ){
+            rounds = WAKEUP_ROUNDS_QUICK;
+        }
+        else if( !bench_backend_parse( argv[i], &only ) ){
+            printf( "Usage: %s [--quick] [epoll|poll|select|io_uring]\n", argv[0] );
+            return 1;
+        }
+    }
+    #ifndef __OPTIMIZE__
+    printf( "Warning: built without optimizations; configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers\n" );
+    #endif
+    printf( "%-10s %8s %12s %12s %12s %14s\n", "backend", "idle", "p50 us", "p99 us", "max us", "cpu us/wakeup" );
+
+    unsigned short port = WAKEUP_PORT;
+    for( size_t b = 0; b < sizeof( wakeup_backends ) / sizeof( wakeup_backends[0] ); ++b ){
+        if( only != RTMP_BACKEND_AUTO && only != wakeup_backends[b] ){
+            continue;
+        }
+        for( size_t i = 0; i < sizeof( wakeup_idle ) / sizeof( wakeup_idle[0] ); ++i ){
+            //Each run listens on a port of its own, so none has to wait for the last one's connections to time out
+            if( !wakeup_run( wakeup_backends[b], wakeup_idle[i], rounds, port++ ) ){
+                printf( "%-10s %8s\n", bench_backend_name( wakeup_backends[b] ), "unsupported" );
+                break;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,824 @@
+/*
+    rtmp_loadgen.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+//A load generator built on the library's own client. It opens many publishers and players against a server,
+//streams synthetic FLV-style audio and video through them, and reports handshake latency, throughput,
+//dropped connections and the server's memory use as it goes. Run with --help for the options.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <openrtmp/rtmp.h>
+#include <openrtmp/rtmp/rtmp_client.h>
+#include <openrtmp/rtmp/rtmp_pool.h>
+#include <openrtmp/amf/amf_object.h>
+#include <openrtmp/util/parseurl.h>
+#include "bench.h"
+
+//Every video message starts with a 5 byte FLV video tag header, and every audio message with a 2 byte
+//AAC header. The time each frame was sent follows, so players can measure delivery latency.
+#define LOADGEN_VIDEO_HEADER 5
+#define LOADGEN_AUDIO_HEADER 2
+#define LOADGEN_STAMP_SIZE sizeof( uint64_t )
+//AAC frames hold 1024 samples at 44.1kHz
+#define LOADGEN_AUDIO_FPS 43
+//Keyframes are this many times bigger than the frames in between
+#define LOADGEN_KEYFRAME_SCALE 5
+
+typedef enum{
+    LOADGEN_IDLE,
+    LOADGEN_CONNECTING,
+    LOADGEN_SETUP,
+    LOADGEN_STREAMING,
+    LOADGEN_FAILED,
+    LOADGEN_CLOSED
+} loadgen_state_t;
+
+typedef struct loadgen_options{
+    const char *url;
+    char app[128];
+    uint16_t port;
+    size_t publishers;
+    size_t players;
+    size_t streams;
+    size_t threads;
+    double video_kbps;
+    double audio_kbps;
+    double fps;
+    double gop;
+    size_t chunk_size;
+    double duration;
+    double rate;
+    double interval;
+    pid_t server_pid;
+    size_t serve;
+    bool level_triggered;
+    rtmp_backend_t backend;
+} loadgen_options_t;
+
+typedef struct loadgen_worker loadgen_worker_t;
+
+typedef struct loadgen_conn{
+    loadgen_worker_t *worker;
+    rtmp_client_t client;
+    loadgen_state_t state;
+    bool publisher;
+    char name[32];
+    size_t stream_id;
+    uint64_t connect_start;
+    uint64_t stream_start;
+    uint64_t video_frame;
+    uint64_t audio_frame;
+    //Set while a player is in the middle of a fragmented message
+    bool partial;
+} loadgen_conn_t;
+
+struct loadgen_worker{
+    pthread_t thread;
+    rtmp_t mgr;
+    const loadgen_options_t *opts;
+    loadgen_conn_t *conns;
+    size_t count;
+    size_t started;
+    byte *video;
+    size_t key_size;
+    size_t inter_size;
+    byte *audio;
+    size_t audio_size;
+
+    //Written by the worker, read by the reporting thread
+    rtmp_histogram_t handshake;
+    rtmp_histogram_t ready;
+    rtmp_histogram_t latency;
+    size_t streaming;
+    size_t failed;
+    size_t dropped;
+    size_t stalled;
+    size_t media_bytes;
+};
+
+static volatile sig_atomic_t loadgen_stop = false;
+
+static void loadgen_on_signal( int sig ){
+    loadgen_stop = true;
+}
+
+static void loadgen_add( size_t *counter, ssize_t value ){
+    __atomic_store_n( counter, __atomic_load_n( counter, __ATOMIC_RELAXED ) + value, __ATOMIC_RELAXED );
+}
+
+static size_t loadgen_get( size_t *counter ){
+    return __atomic_load_n( counter, __ATOMIC_RELAXED );
+}
+
+
+//Connection setup
+
+static void loadgen_fail( loadgen_conn_t *conn ){
+    if( conn->state == LOADGEN_STREAMING ){
+        loadgen_add( &conn->worker->streaming, -1 );
+        loadgen_add( &conn->worker->dropped, 1 );
+    }
+    else if( conn->state != LOADGEN_FAILED && conn->state != LOADGEN_CLOSED ){
+        loadgen_add( &conn->worker->failed, 1 );
+    }
+    conn->state = LOADGEN_FAILED;
+}
+
+static bool loadgen_is_result( amf_t object, const char *expected ){
+    if( amf_get_count( object ) == 0 || !amf_value_is( amf_get_item( object, 0 ), AMF_TYPE_STRING ) ){
+        return false;
+    }
+    return strcmp( amf_value_get_string( amf_get_item( object, 0 ), nullptr ), expected ) == 0;
+}
+
+//Fetches the code of an onStatus command, or nullptr if it isn't one
+static const char * loadgen_status_code( amf_t object, bool *error ){
+    if( amf_get_count( object ) < 4 || !loadgen_is_result( object, "onStatus" ) ){
+        return nullptr;
+    }
+    amf_value_t info = amf_get_item( object, 3 );
+    amf_value_t code = amf_obj_get_value( info, "code" );
+    amf_value_t level = amf_obj_get_value( info, "level" );
+    if( !code || !amf_value_is( code, AMF_TYPE_STRING ) ){
+        return nullptr;
+    }
+    *error = level && amf_value_is( level, AMF_TYPE_STRING ) && strcmp( amf_value_get_string( level, nullptr ), "error" ) == 0;
+    return amf_value_get_string( code, nullptr );
+}
+
+static void loadgen_begin_streaming( loadgen_conn_t *conn ){
+    uint64_t now = bench_now();
+    conn->state = LOADGEN_STREAMING;
+    conn->stream_start = now;
+    conn->video_frame = 0;
+    conn->audio_frame = 0;
+    rtmp_histogram_record( &conn->worker->ready, now - conn->connect_start );
+    loadgen_add( &conn->worker->streaming, 1 );
+}
+
+static rtmp_cb_status_t loadgen_on_status( rtmp_stream_args_t args, amf_t object, void *user ){
+    loadgen_conn_t *conn = user;
+    bool error = false;
+    const char *code = loadgen_status_code( object, &error );
+    if( !code ){
+        return RTMP_CB_CONTINUE;
+    }
+    if( error ){
+        loadgen_fail( conn );
+        return RTMP_CB_ERROR;
+    }
+    if( conn->state != LOADGEN_SETUP ){
+        return RTMP_CB_CONTINUE;
+    }
+    if( conn->publisher && strcmp( code, RTMP_NETSTREAM_START ) == 0 ){
+        const loadgen_options_t *opts = conn->worker->opts;
+        rtmp_client_setdataframe( conn->client, conn->stream_id, "onMetaData",
+            0, 0, 1280, 720,
+            "avc1", opts->video_kbps, opts->fps,
+            "mp4a", opts->audio_kbps, 44100, 16, 2,
+            "rtmp_loadgen" );
+        //AVC and AAC sequence headers, which the server keeps for players that join later
+        static const byte avc_config[] = { 0x17, 0x00, 0x00, 0x00, 0x00, 0x01, 0x64, 0x00, 0x1F, 0xFF, 0xE1, 0x00, 0x00, 0x01, 0x00, 0x00 };
+        static const byte aac_config[] = { 0xAF, 0x00, 0x12, 0x10 };
+        rtmp_stream_t stream = rtmp_client_stream( conn->client );
+        rtmp_stream_send_video2( stream, 0, conn->stream_id, 0, avc_config, sizeof( avc_config ), nullptr );
+        rtmp_stream_send_audio2( stream, 0, conn->stream_id, 0, aac_config, sizeof( aac_config ), nullptr );
+        loadgen_begin_streaming( conn );
+    }
+    else if( !conn->publisher && strcmp( code, RTMP_NETSTREAM_PLAY_START ) == 0 ){
+        loadgen_begin_streaming( conn );
+    }
+    return RTMP_CB_CONTINUE;
+}
+
+static rtmp_cb_status_t loadgen_on_media( rtmp_stream_args_t args, const byte *data, size_t length, size_t remaining, void *user ){
+    loadgen_conn_t *conn = user;
+    loadgen_worker_t *worker = conn->worker;
+    loadgen_add( &worker->media_bytes, length );
+    //Only the start of a message carries the time it was sent; sequence headers don't carry one at all
+    size_t header = args->message == RTMP_MSG_VIDEO ? LOADGEN_VIDEO_HEADER : LOADGEN_AUDIO_HEADER;
+    if( !conn->partial && length >= header + LOADGEN_STAMP_SIZE && data[1] == 0x01 ){
+        uint64_t sent;
+        memcpy( &sent, data + header, sizeof( sent ) );
+        //Frames replayed from the server's GOP cache were sent before we joined, and would only measure the cache
+        if( sent >= conn->stream_start ){
+            rtmp_histogram_record( &worker->latency, bench_now() - sent );
+        }
+    }
+    conn->partial = remaining > 0;
+    return RTMP_CB_CONTINUE;
+}
+
+static rtmp_cb_status_t loadgen_on_createstream( rtmp_stream_args_t args, amf_t object, void *user ){
+    loadgen_conn_t *conn = user;
+    if( !loadgen_is_result( object, "_result" ) || amf_get_count( object ) < 4 ){
+        loadgen_fail( conn );
+        return RTMP_CB_ERROR;
+    }
+    conn->stream_id = amf_value_get_integer( amf_get_item( object, 3 ) );
+    rtmp_stream_t stream = rtmp_client_stream( conn->client );
+    rtmp_err_t err = rtmp_stream_reg_amf( stream, RTMP_MSG_AMF0_CMD, "onStatus", loadgen_on_status, conn );
+    if( conn->publisher ){
+        err = err ? err : rtmp_client_publish( conn->client, conn->stream_id, conn->name, "live", nullptr, nullptr );
+    }
+    else{
+        rtmp_stream_set_msg_stream( stream, conn->stream_id );
+        err = err ? err : rtmp_stream_reg_msg( stream, RTMP_MSG_VIDEO, loadgen_on_media, conn );
+        err = err ? err : rtmp_stream_reg_msg( stream, RTMP_MSG_AUDIO, loadgen_on_media, conn );
+        err = err ? err : rtmp_client_play( conn->client, conn->name, -1, -1, false );
+    }
+    if( err >= RTMP_ERR_ERROR ){
+        loadgen_fail( conn );
+        return RTMP_CB_ERROR;
+    }
+    return RTMP_CB_CONTINUE;
+}
+
+static rtmp_cb_status_t loadgen_on_connect_result( rtmp_stream_args_t args, amf_t object, void *user ){
+    loadgen_conn_t *conn = user;
+    if( !loadgen_is_result( object, "_result" ) ){
+        loadgen_fail( conn );
+        return RTMP_CB_ERROR;
+    }
+    rtmp_err_t err = RTMP_ERR_NONE;
+    if( conn->publisher ){
+        //The same sequence an encoder sends
+        err = err ? err : rtmp_client_releasestream( conn->client, conn->name, nullptr, nullptr );
+        err = err ? err : rtmp_client_fcpublish( conn->client, conn->name, nullptr, nullptr );
+    }
+    err = err ? err : rtmp_client_createstream( conn->client, loadgen_on_createstream, conn );
+    if( err >= RTMP_ERR_ERROR ){
+        loadgen_fail( conn );
+        return RTMP_CB_ERROR;
+    }
+    return RTMP_CB_CONTINUE;
+}
+
+static rtmp_cb_status_t loadgen_on_event( rtmp_stream_t stream, rtmp_event_t event, void *user ){
+    loadgen_conn_t *conn = user;
+    const loadgen_options_t *opts = conn->worker->opts;
+    if( event == RTMP_EVENT_CONNECT_SUCCESS ){
+        rtmp_histogram_record( &conn->worker->handshake, bench_now() - conn->connect_start );
+        conn->state = LOADGEN_SETUP;
+        rtmp_err_t err = rtmp_client_connect( conn->client, opts->app, nullptr, nullptr,
+            RTMP_SUPPORT_SND_AAC, RTMP_SUPPORT_VID_H264, loadgen_on_connect_result, conn );
+        //Connecting asks for the default chunk size, so override it afterwards
+        err = err ? err : rtmp_chunk_conn_set_chunk_size( rtmp_stream_get_conn( stream ), opts->chunk_size );
+        if( err >= RTMP_ERR_ERROR ){
+            loadgen_fail( conn );
+            return RTMP_CB_ERROR;
+        }
+    }
+    else if( event == RTMP_EVENT_CONNECT_FAIL ){
+        loadgen_fail( conn );
+    }
+    else if( event == RTMP_EVENT_CLOSED ){
+        loadgen_fail( conn );
+        conn->state = LOADGEN_CLOSED;
+    }
+    return RTMP_CB_CONTINUE;
+}
+
+static void loadgen_start( loadgen_worker_t *worker, loadgen_conn_t *conn ){
+    conn->client = rtmp_client_create( worker->opts->url, conn->name );
+    if( !conn->client ){
+        loadgen_add( &worker->failed, 1 );
+        conn->state = LOADGEN_FAILED;
+        return;
+    }
+    rtmp_stream_t stream = rtmp_client_stream( conn->client );
+    rtmp_stream_reg_event( stream, RTMP_EVENT_CONNECT_SUCCESS, loadgen_on_event, conn );
+    rtmp_stream_reg_event( stream, RTMP_EVENT_CONNECT_FAIL, loadgen_on_event, conn );
+    rtmp_stream_reg_event( stream, RTMP_EVENT_CLOSED, loadgen_on_event, conn );
+    conn->state = LOADGEN_CONNECTING;
+    conn->connect_start = bench_now();
+    if( rtmp_connect( worker->mgr, conn->client ) >= RTMP_ERR_ERROR ){
+        //rtmp_connect has already destroyed the client
+        conn->client = nullptr;
+        loadgen_fail( conn );
+    }
+}
+
+
+//Media
+
+static void loadgen_stamp( byte *dst, uint64_t now ){
+    memcpy( dst, &now, sizeof( now ) );
+}
+
+//Sends every frame which is due, keeping to the schedule set by the stream's start time
+static void loadgen_publish( loadgen_worker_t *worker, loadgen_conn_t *conn, uint64_t now ){
+    const loadgen_options_t *opts = worker->opts;
+    rtmp_stream_t stream = rtmp_client_stream( conn->client );
+    uint64_t elapsed = now - conn->stream_start;
+    size_t gop_frames = opts->gop * opts->fps;
+
+    while( opts->video_kbps > 0 && conn->video_frame * 1e9 / opts->fps <= elapsed ){
+        bool key = gop_frames == 0 || conn->video_frame % gop_frames == 0;
+        size_t size = key ? worker->key_size : worker->inter_size;
+        //The buffer is shared; only the first bytes differ between frames
+        worker->video[0] = key ? 0x17 : 0x27;
+        loadgen_stamp( worker->video + LOADGEN_VIDEO_HEADER, now );
+        rtmp_time_t timestamp = conn->video_frame * 1000 / opts->fps;
+        if( rtmp_stream_send_video2( stream, 0, conn->stream_id, timestamp, worker->video, size, nullptr ) >= RTMP_ERR_ERROR ){
+            //The connection can't keep up; try again next time around
+            loadgen_add( &worker->stalled, 1 );
+            break;
+        }
+        loadgen_add( &worker->media_bytes, size );
+        ++conn->video_frame;
+    }
+    while( opts->audio_kbps > 0 && conn->audio_frame * 1e9 / LOADGEN_AUDIO_FPS <= elapsed ){
+        loadgen_stamp( worker->audio + LOADGEN_AUDIO_HEADER, now );
+        rtmp_time_t timestamp = conn->audio_frame * 1000 / LOADGEN_AUDIO_FPS;
+        if( rtmp_stream_send_audio2( stream, 0, conn->stream_id, timestamp, worker->audio, worker->audio_size, nullptr ) >= RTMP_ERR_ERROR ){
+            loadgen_add( &worker->stalled, 1 );
+            break;
+        }
+        loadgen_add( &worker->media_bytes, worker->audio_size );
+        ++conn->audio_frame;
+    }
+}
+
+static void loadgen_frames_init( loadgen_worker_t *worker ){
+    const loadgen_options_t *opts = worker->opts;
+    size_t minimum = LOADGEN_VIDEO_HEADER + LOADGEN_STAMP_SIZE;
+    //Spread the bitrate over a GOP of one keyframe followed by smaller frames
+    double gop_frames = opts->gop * opts->fps;
+    double units = gop_frames < 1 ? 1 : gop_frames - 1 + LOADGEN_KEYFRAME_SCALE;
+    double bytes_per_gop = opts->video_kbps * 1000 / 8 * ( gop_frames < 1 ? 1 / opts->fps : opts->gop );
+    worker->inter_size = bytes_per_gop / units;
+    worker->key_size = gop_frames < 1 ? worker->inter_size : worker->inter_size * LOADGEN_KEYFRAME_SCALE;
+    if( worker->inter_size < minimum ){
+        worker->inter_size = minimum;
+    }
+    if( worker->key_size < minimum ){
+        worker->key_size = minimum;
+    }
+    worker->audio_size = opts->audio_kbps * 1000 / 8 / LOADGEN_AUDIO_FPS;
+    if( worker->audio_size < LOADGEN_AUDIO_HEADER + LOADGEN_STAMP_SIZE ){
+        worker->audio_size = LOADGEN_AUDIO_HEADER + LOADGEN_STAMP_SIZE;
+    }
+
+    //Filler which doesn't compress to nothing, in case anything in the path tries
+    worker->video = malloc( worker->key_size );
+    worker->audio = malloc( worker->audio_size );
+    for( size_t i = 0; i < worker->key_size; ++i ){
+        worker->video[i] = i * 131 + ( i >> 8 );
+    }
+    for( size_t i = 0; i < worker->audio_size; ++i ){
+        worker->audio[i] = i * 37;
+    }
+    //Keyframe or inter frame, then an AVC NALU packet with no composition time offset
+    worker->video[1] = 0x01;
+    worker->video[2] = worker->video[3] = worker->video[4] = 0;
+    //AAC, 44kHz, 16 bit stereo, raw frame
+    worker->audio[0] = 0xAF;
+    worker->audio[1] = 0x01;
+}
+
+
+//Workers
+
+static void * loadgen_worker_proc( void *user ){
+    loadgen_worker_t *worker = user;
+    const loadgen_options_t *opts = worker->opts;
+    uint64_t start = bench_now();
+    uint64_t end = start + opts->duration * 1e9;
+    double rate = opts->rate / opts->threads;
+
+    while( !loadgen_stop && bench_now() < end ){
+        uint64_t now = bench_now();
+        //Ramp up at the requested rate rather than opening everything at once
+        while( worker->started < worker->count && worker->started < ( now - start ) * rate / 1e9 + 1 ){
+            loadgen_start( worker, &worker->conns[worker->started++] );
+        }
+        rtmp_service( worker->mgr, 1 );
+        now = bench_now();
+        for( size_t i = 0; i < worker->started; ++i ){
+            loadgen_conn_t *conn = &worker->conns[i];
+            if( conn->publisher && conn->state == LOADGEN_STREAMING ){
+                loadgen_publish( worker, conn, now );
+            }
+        }
+    }
+
+    for( size_t i = 0; i < worker->started; ++i ){
+        loadgen_conn_t *conn = &worker->conns[i];
+        if( !conn->client ){
+            continue;
+        }
+        //Closed connections have already been forgotten by the manager
+        if( conn->state != LOADGEN_CLOSED ){
+            rtmp_disconnect( worker->mgr, conn->client );
+        }
+        rtmp_client_destroy( conn->client );
+        conn->client = nullptr;
+    }
+    return nullptr;
+}
+
+
+//Reporting
+
+//Returns the resident set size of a process in bytes, or 0 if it can't be read
+static size_t loadgen_rss( pid_t pid ){
+    char path[64];
+    snprintf( path, sizeof( path ), "/proc/%d/status", (int)pid );
+    FILE *f = fopen( path, "r" );
+    if( !f ){
+        return 0;
+    }
+    char line[256];
+    size_t kb = 0;
+    while( fgets( line, sizeof( line ), f ) ){
+        if( sscanf( line, "VmRSS: %zu kB", &kb ) == 1 ){
+            break;
+        }
+    }
+    fclose( f );
+    return kb * 1024;
+}
+
+typedef struct loadgen_totals{
+    size_t streaming;
+    size_t failed;
+    size_t dropped;
+    size_t stalled;
+    size_t media_bytes;
+    rtmp_histogram_t handshake;
+    rtmp_histogram_t ready;
+    rtmp_histogram_t latency;
+} loadgen_totals_t;
+
+static void loadgen_collect( loadgen_worker_t *workers, size_t count, loadgen_totals_t *totals ){
+    memset( totals, 0, sizeof( *totals ) );
+    for( size_t i = 0; i < count; ++i ){
+        totals->streaming += loadgen_get( &workers[i].streaming );
+        totals->failed += loadgen_get( &workers[i].failed );
+        totals->dropped += loadgen_get( &workers[i].dropped );
+        totals->stalled += loadgen_get( &workers[i].stalled );
+        totals->media_bytes += loadgen_get( &workers[i].media_bytes );
+        rtmp_histogram_merge( &totals->handshake, &workers[i].handshake );
+        rtmp_histogram_merge( &totals->ready, &workers[i].ready );
+        rtmp_histogram_merge( &totals->latency, &workers[i].latency );
+    }
+}
+
+static double loadgen_ms( const rtmp_histogram_t *hist, double percentile ){
+    return rtmp_histogram_percentile( hist, percentile ) / 1e6;
+}
+
+static void loadgen_report_header( void ){
+    printf( "%7s %6s %6s %6s %6s %10s %10s %9s %9s %9s %9s %9s\n",
+        "time", "conns", "live", "failed", "drops", "out MB/s", "in MB/s",
+        "hs p50", "hs p99", "lat p50", "lat p99", "srv RSS" );
+}
+
+static void loadgen_report( const loadgen_options_t *opts, double elapsed, const loadgen_totals_t *totals,
+    const rtmp_stats_t *stats, const rtmp_stats_t *last, double seconds ){
+    size_t rss = opts->server_pid ? loadgen_rss( opts->server_pid ) : 0;
+    char rss_text[32] = "-";
+    if( rss ){
+        snprintf( rss_text, sizeof( rss_text ), "%.1fMB", rss / 1048576.0 );
+    }
+    printf( "%6.1fs %6llu %6zu %6zu %6zu %10.2f %10.2f %7.2fms %7.2fms %7.2fms %7.2fms %9s\n",
+        elapsed, (unsigned long long)stats->connections, totals->streaming, totals->failed, totals->dropped,
+        ( stats->bytes_out - last->bytes_out ) / seconds / 1048576,
+        ( stats->bytes_in - last->bytes_in ) / seconds / 1048576,
+        loadgen_ms( &totals->handshake, 50 ), loadgen_ms( &totals->handshake, 99 ),
+        loadgen_ms( &totals->latency, 50 ), loadgen_ms( &totals->latency, 99 ),
+        rss_text );
+    fflush( stdout );
+}
+
+static void loadgen_summary( const loadgen_totals_t *totals, const rtmp_stats_t *stats, double elapsed ){
+    const double p[] = { 50, 90, 99, 99.9, 100 };
+    const struct{
+        const char *name;
+        const rtmp_histogram_t *hist;
+    } rows[] = {
+        { "handshake", &totals->handshake },
+        { "ready", &totals->ready },
+        { "delivery", &totals->latency }
+    };
+    printf( "\n%-10s %10s %10s %10s %10s %10s %10s\n", "latency", "count", "p50", "p90", "p99", "p99.9", "max" );
+    for( size_t i = 0; i < sizeof( rows ) / sizeof( rows[0] ); ++i ){
+        printf( "%-10s %10llu", rows[i].name, (unsigned long long)rows[i].hist->count );
+        for( size_t k = 0; k < sizeof( p ) / sizeof( p[0] ); ++k ){
+            printf( " %8.2fms", loadgen_ms( rows[i].hist, p[k] ) );
+        }
+        printf( "\n" );
+    }
+    printf( "\nsent:      %.1f MB (%.2f MB/s)\n", stats->bytes_out / 1048576.0, stats->bytes_out / elapsed / 1048576 );
+    printf( "received:  %.1f MB (%.2f MB/s)\n", stats->bytes_in / 1048576.0, stats->bytes_in / elapsed / 1048576 );
+    printf( "media:     %.1f MB sent and received\n", totals->media_bytes / 1048576.0 );
+    printf( "streaming: %zu at the end\n", totals->streaming );
+    printf( "failed:    %zu never started streaming\n", totals->failed );
+    printf( "dropped:   %zu closed while streaming\n", totals->dropped );
+    printf( "stalled:   %zu sends deferred because the connection was backed up\n", totals->stalled );
+    printf( "syscalls:  %llu (%.1f per MB sent and received)\n", (unsigned long long)stats->syscalls,
+        stats->syscalls / ( ( stats->bytes_in + stats->bytes_out ) / 1048576.0 ) );
+}
+
+
+//Embedded server
+
+//Runs a server in a child process, so that its memory use can be measured on its own
+static pid_t loadgen_serve( const loadgen_options_t *opts ){
+    pid_t pid = fork();
+    if( pid != 0 ){
+        return pid < 0 ? 0 : pid;
+    }
+    signal( SIGINT, SIG_IGN );
+    signal( SIGTERM, loadgen_on_signal );
+    rtmp_pool_t pool = rtmp_pool_create( opts->serve );
+    for( size_t i = 0; i < rtmp_pool_size( pool ); ++i ){
+        rtmp_set_edge_triggered( rtmp_pool_worker( pool, i ), !opts->level_triggered );
+        if( rtmp_set_backend( rtmp_pool_worker( pool, i ), opts->backend ) >= RTMP_ERR_ERROR ){
+            printf( "The server's backend isn't supported\n" );
+            _exit( 1 );
+        }
+    }
+    rtmp_app_list_t list = rtmp_app_list_create();
+    rtmp_app_list_register( list, opts->app );
+    rtmp_pool_set_app_list( pool, list );
+    if( rtmp_pool_listen( pool, RTMP_ADDR_ANY, opts->port, nullptr, nullptr ) >= RTMP_ERR_ERROR ||
+        rtmp_pool_start( pool ) >= RTMP_ERR_ERROR ){
+        printf( "The server failed to start\n" );
+        _exit( 1 );
+    }
+    while( !loadgen_stop ){
+        pause();
+    }
+    rtmp_pool_stop( pool );
+    rtmp_stats_t stats;
+    rtmp_get_stats( nullptr, &stats, nullptr );
+    printf( "server:    %llu syscalls (%.1f per MB sent and received) with %s\n", (unsigned long long)stats.syscalls,
+        stats.syscalls / ( ( stats.bytes_in + stats.bytes_out ) / 1048576.0 ),
+        bench_backend_name( rtmp_get_backend( rtmp_pool_worker( pool, 0 ) ) ) );
+    fflush( stdout );
+    rtmp_pool_destroy( pool );
+    rtmp_app_list_destroy( list );
+    _exit( 0 );
+}
+
+
+//Options
+
+static void loadgen_usage( const char *name ){
+    printf(
+        "Usage: %s [options] [url]\n"
+        "  url                      The server and app to connect to (default rtmp://127.0.0.1:1935/live)\n"
+        "  -p, --publishers N       Number of publishers (default 1)\n"
+        "  -c, --players N          Number of players (default 0)\n"
+        "  -s, --streams N          Number of stream names; publishers and players are spread across them\n"
+        "                           (default: one per publisher)\n"
+        "  -t, --threads N          Client threads, each with its own manager (default 1)\n"
+        "  -v, --video-kbps N       Video bitrate per publisher (default 1000)\n"
+        "  -a, --audio-kbps N       Audio bitrate per publisher (default 128)\n"
+        "  -f, --fps N              Video frame rate (default 30)\n"
+        "  -g, --gop SECONDS        Time between keyframes (default 2)\n"
+        "  -k, --chunk-size N       Outgoing chunk size (default %d)\n"
+        "  -d, --duration SECONDS   How long to run for (default 30)\n"
+        "  -r, --rate N             New connections per second (default 200)\n"
+        "  -i, --interval SECONDS   Time between reports (default 1)\n"
+        "  -P, --server-pid PID     Report the memory use of this server process\n"
+        "  -S, --serve N            Start a server with N worker threads in a child process, and report its memory use\n"
+        "  -L, --level-triggered    Register connections with epoll as level-triggered, here and in the server started by -S\n"
+        "  -B, --backend NAME       Use auto, epoll, io_uring, poll or select for I/O, here and in the server started by -S (default auto)\n",
+        name, RTMP_DESIRED_CHUNK_SIZE );
+}
+
+static bool loadgen_parse( int argc, char **argv, loadgen_options_t *opts ){
+    static const struct option long_options[] = {
+        { "publishers", required_argument, nullptr, 'p' },
+        { "players", required_argument, nullptr, 'c' },
+        { "streams", required_argument, nullptr, 's' },
+        { "threads", required_argument, nullptr, 't' },
+        { "video-kbps", required_argument, nullptr, 'v' },
+        { "audio-kbps", required_argument, nullptr, 'a' },
+        { "fps", required_argument, nullptr, 'f' },
+        { "gop", required_argument, nullptr, 'g' },
+        { "chunk-size", required_argument, nullptr, 'k' },
+        { "duration", required_argument, nullptr, 'd' },
+        { "rate", required_argument, nullptr, 'r' },
+        { "interval", required_argument, nullptr, 'i' },
+        { "server-pid", required_argument, nullptr, 'P' },
+        { "serve", required_argument, nullptr, 'S' },
+        { "level-triggered", no_argument, nullptr, 'L' },
+        { "backend", required_argument, nullptr, 'B' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    memset( opts, 0, sizeof( *opts ) );
+    opts->url = "rtmp://127.0.0.1:1935/live";
+    opts->publishers = 1;
+    opts->threads = 1;
+    opts->video_kbps = 1000;
+    opts->audio_kbps = 128;
+    opts->fps = 30;
+    opts->gop = 2;
+    opts->chunk_size = RTMP_DESIRED_CHUNK_SIZE;
+    opts->duration = 30;
+    opts->rate = 200;
+    opts->interval = 1;
+
+    int c;
+    while( ( c = getopt_long( argc, argv, "p:c:s:t:v:a:f:g:k:d:r:i:P:S:LB:h", long_options, nullptr ) ) != -1 ){
+        switch( c ){
+            case 'p': opts->publishers = strtoul( optarg, nullptr, 10 ); break;
+            case 'c': opts->players = strtoul( optarg, nullptr, 10 ); break;
+            case 's': opts->streams = strtoul( optarg, nullptr, 10 ); break;
+            case 't': opts->threads = strtoul( optarg, nullptr, 10 ); break;
+            case 'v': opts->video_kbps = strtod( optarg, nullptr ); break;
+            case 'a': opts->audio_kbps = strtod( optarg, nullptr ); break;
+            case 'f': opts->fps = strtod( optarg, nullptr ); break;
+            case 'g': opts->gop = strtod( optarg, nullptr ); break;
+            case 'k': opts->chunk_size = strtoul( optarg, nullptr, 10 ); break;
+            case 'd': opts->duration = strtod( optarg, nullptr ); break;
+            case 'r': opts->rate = strtod( optarg, nullptr ); break;
+            case 'i': opts->interval = strtod( optarg, nullptr ); break;
+            case 'P': opts->server_pid = strtol( optarg, nullptr, 10 ); break;
+            case 'S': opts->serve = strtoul( optarg, nullptr, 10 ); break;
+            case 'L': opts->level_triggered = true; break;
+            case 'B':
+                if( !bench_backend_parse( optarg, &opts->backend ) ){
+                    printf( "Unknown backend %s\n", optarg );
+                    return false;
+                }
+                break;
+            default:
+                loadgen_usage( argv[0] );
+                return false;
+        }
+    }
+    if( optind < argc ){
+        opts->url = argv[optind];
+    }
+    if( opts->streams == 0 ){
+        opts->streams = opts->publishers ? opts->publishers : 1;
+    }
+    if( opts->threads == 0 || opts->fps <= 0 || opts->rate <= 0 || opts->interval <= 0 ){
+        printf( "The thread count, frame rate, connection rate and report interval must be positive\n" );
+        return false;
+    }
+
+    parseurl_t url = parseurl_create();
+    parseurl_set( url, PARSEURL_PORT, "1935" );
+    if( !parseurl_set( url, PARSEURL_URL_FORGIVING, opts->url ) ){
+        printf( "Couldn't parse %s\n", opts->url );
+        parseurl_destroy( url );
+        return false;
+    }
+    const char *path = parseurl_get( url, PARSEURL_PATH, "/" );
+    while( *path == '/' ){
+        ++path;
+    }
+    snprintf( opts->app, sizeof( opts->app ), "%.*s", (int)strcspn( path, "/" ), path );
+    opts->port = atoi( parseurl_get( url, PARSEURL_PORT, "1935" ) );
+    parseurl_destroy( url );
+    return true;
+}
+
+
+int main( int argc, char **argv ){
+    loadgen_options_t opts;
+    if( !loadgen_parse( argc, argv, &opts ) ){
+        return 1;
+    }
+
+    //Every connection needs a descriptor, on both ends when the server runs here too
+    struct rlimit limit;
+    if( getrlimit( RLIMIT_NOFILE, &limit ) == 0 ){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &limit );
+    }
+    //Closed connections are counted instead; logging each of thousands would drown out the report
+    rtmp_log_set_level( RTMP_LOG_ERROR );
+    if( opts.serve ){
+        opts.server_pid = loadgen_serve( &opts );
+        if( !opts.server_pid ){
+            printf( "Couldn't start the server\n" );
+            return 1;
+        }
+        //Give it a moment to start listening
+        usleep( 200000 );
+    }
+    signal( SIGINT, loadgen_on_signal );
+    signal( SIGTERM, loadgen_on_signal );
+    signal( SIGPIPE, SIG_IGN );
+
+    //Connections are dealt out in order and publishers come first, so each worker ramps up its
+    //publishers before its players, and every stream exists before anyone asks to play it
+    size_t total = opts.publishers + opts.players;
+    size_t per_worker = ( total + opts.threads - 1 ) / opts.threads;
+    loadgen_worker_t *workers = calloc( opts.threads, sizeof( loadgen_worker_t ) );
+    for( size_t w = 0; w < opts.threads; ++w ){
+        workers[w].opts = &opts;
+        workers[w].mgr = rtmp_create();
+        rtmp_set_edge_triggered( workers[w].mgr, !opts.level_triggered );
+        if( rtmp_set_backend( workers[w].mgr, opts.backend ) >= RTMP_ERR_ERROR ){
+            printf( "The backend isn't supported\n" );
+            return 1;
+        }
+        workers[w].conns = calloc( per_worker ? per_worker : 1, sizeof( loadgen_conn_t ) );
+        loadgen_frames_init( &workers[w] );
+    }
+    for( size_t i = 0; i < total; ++i ){
+        loadgen_worker_t *worker = &workers[i % opts.threads];
+        loadgen_conn_t *conn = &worker->conns[worker->count++];
+        conn->worker = worker;
+        conn->publisher = i < opts.publishers;
+        snprintf( conn->name, sizeof( conn->name ), "loadgen%zu", ( conn->publisher ? i : i - opts.publishers ) % opts.streams );
+    }
+
+    printf( "%zu publishers and %zu players on %zu streams at %s, app \"%s\"\n",
+        opts.publishers, opts.players, opts.streams, opts.url, opts.app );
+    printf( "%.0f kbps video at %.0f fps, %.0f kbps audio, chunk size %zu, %zu threads using %s\n\n",
+        opts.video_kbps, opts.fps, opts.audio_kbps, opts.chunk_size, opts.threads,
+        bench_backend_name( rtmp_get_backend( workers[0].mgr ) ) );
+
+    uint64_t start = bench_now();
+    for( size_t w = 0; w < opts.threads; ++w ){
+        if( !workers[w].mgr || pthread_create( &workers[w].thread, nullptr, loadgen_worker_proc, &workers[w] ) != 0 ){
+            printf( "Couldn't start the client threads\n" );
+            return 1;
+        }
+    }
+
+    loadgen_report_header();
+    rtmp_stats_t last, stats;
+    loadgen_totals_t totals;
+    rtmp_get_stats( nullptr, &last, nullptr );
+    uint64_t last_time = start;
+    uint64_t end = start + opts.duration * 1e9;
+    while( !loadgen_stop && bench_now() < end ){
+        uint64_t wake = last_time + opts.interval * 1e9;
+        uint64_t now = bench_now();
+        if( wake > end ){
+            wake = end;
+        }
+        if( wake > now ){
+            usleep( ( wake - now ) / 1000 );
+        }
+        now = bench_now();
+        rtmp_get_stats( nullptr, &stats, nullptr );
+        loadgen_collect( workers, opts.threads, &totals );
+        loadgen_report( &opts, ( now - start ) / 1e9, &totals, &stats, &last, ( now - last_time ) / 1e9 );
+        last = stats;
+        last_time = now;
+    }
+    loadgen_stop = true;
+
+    //Take the final numbers before the workers hang up, or the managers will be gone
+    rtmp_get_stats( nullptr, &stats, nullptr );
+    loadgen_collect( workers, opts.threads, &totals );
+    double elapsed = ( bench_now() - start ) / 1e9;
+    for( size_t w = 0; w < opts.threads; ++w ){
+        pthread_join( workers[w].thread, nullptr );
+        rtmp_destroy( workers[w].mgr );
+        free( workers[w].conns );
+        free( workers[w].video );
+        free( workers[w].audio );
+    }
+    free( workers );
+
+    loadgen_summary( &totals, &stats, elapsed );
+
+    if( opts.serve ){
+        //The server reports its own system calls as it exits
+        fflush( stdout );
+        kill( opts.server_pid, SIGTERM );
+        waitpid( opts.server_pid, nullptr, 0 );
+    }
+    return 0;
+}
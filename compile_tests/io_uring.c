@@ -0,0 +1,16 @@
+/* CMake Test File
+   Description : io_uring with provided buffer rings
+   Defines : RTMP_HAS_IO_URING
+ */
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+int main(){
+    //Whether the running kernel supports these is checked when each manager is created
+    struct io_uring_buf_reg reg = { 0 };
+    struct io_uring_getevents_arg arg = { 0 };
+    (void)reg;
+    (void)arg;
+    return __NR_io_uring_setup > 0 && IORING_RECV_MULTISHOT && IORING_ACCEPT_MULTISHOT && IORING_REGISTER_PBUF_RING;
+}
@@ -0,0 +1,24 @@
+/* CMake Test File
+   Description : memfd mirrored mappings
+   Defines : RTMP_HAS_MEMFD
+ */
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <unistd.h>
+
+int main(){
+    long page = sysconf( _SC_PAGESIZE );
+    int fd = memfd_create( "test", MFD_CLOEXEC );
+    if( fd < 0 || ftruncate( fd, page ) < 0 ){
+        return 0;
+    }
+    char *base = mmap( 0, page * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( base == MAP_FAILED ||
+        mmap( base, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) == MAP_FAILED ||
+        mmap( base + page, page, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) == MAP_FAILED ){
+        return 0;
+    }
+    base[0] = 42;
+    return base[page] == 42;
+}
@@ -80,52 +80,49 @@ amf_err_t amf0_get_typed_object( const byte* data, size_t len );
 
 void amf0_print( const byte* data, size_t len, rtmp_printer_t printer );
 
-/*
-amf_err_t amf3_write_undefined( byte *data, size_t len );
-amf_err_t amf3_write_null( byte *data, size_t len );
-amf_err_t amf3_write_false( byte *data, size_t len );
-amf_err_t amf3_write_true( byte *data, size_t len );
-amf_err_t amf3_write_int( byte *data, size_t len, int value );
-amf_err_t amf3_write_double( byte *data, size_t len, double value );
-amf_err_t amf3_write_string( byte *data, size_t len, byte *str, size_t str_len );
-amf_err_t amf3_write_xmldocument( byte *data, size_t len, byte *str, size_t str_len);
-amf_err_t amf3_write_date( byte *data, size_t len, double timestamp );
-amf_err_t amf3_write_array_begin( byte *data, size_t len, size_t dense_len );
-amf_err_t amf3_write_array_mid( byte *data, size_t len, size_t assoc_len );
-amf_err_t amf3_write_array_key( byte *data, size_t len, byte *str, size_t str_len );
-amf_err_t amf3_write_object( byte *data, size_t len, );
-amf_err_t amf3_write_xml( byte *data, size_t len, );
-amf_err_t amf3_write_array_byte( byte *data, size_t len, );
-amf_err_t amf3_write_vec_int( byte *data, size_t len, );
-amf_err_t amf3_write_vec_uint( byte *data, size_t len, );
-amf_err_t amf3_write_vec_double( byte *data, size_t len, );
-amf_err_t amf3_write_vec_object( byte *data, size_t len, );
-amf_err_t amf3_write_dict( byte *data, size_t len, );
-amf_err_t amf3_write_reference( byte *data, size_t len, amf3_type_t type, size_t index );
-
-
-amf_err_t amf3_get_undefined( byte *data, size_t len );
-amf_err_t amf3_get_null( byte *data, size_t len );
-amf_err_t amf3_get_false( byte *data, size_t len );
-amf_err_t amf3_get_true( byte *data, size_t len );
-amf_err_t amf3_get_int( byte *data, size_t len, int *value );
-amf_err_t amf3_get_double( byte *data, size_t len, double *value );
-amf_err_t amf3_get_string_length( byte *data, size_t len, size_t *length );
-amf_err_t amf3_get_string( byte *data, size_t len, byte *str, size_t str_len, size_t *continuation );
-amf_err_t amf3_get_xmldocument_length( byte *data, size_t len, size_t *length );
-amf_err_t amf3_get_xmldocument( byte *data, size_t len, byte *str, size_t str_len, size_t *continuation );
-amf_err_t amf3_get_date( byte *data, size_t len, double *timestamp );
-amf_err_t amf3_get_array( byte *data, size_t len, );
-amf_err_t amf3_get_object( byte *data, size_t len, );
-amf_err_t amf3_get_xml( byte *data, size_t len, );
-amf_err_t amf3_get_array_byte( byte *data, size_t len, );
-amf_err_t amf3_get_vec_int( byte *data, size_t len, );
-amf_err_t amf3_get_vec_uint( byte *data, size_t len, );
-amf_err_t amf3_get_vec_double( byte *data, size_t len, );
-amf_err_t amf3_get_vec_object( byte *data, size_t len, );
-amf_err_t amf3_get_dict( byte *data, size_t len, );
-//If AMF_ERR_NOT_A_REFERENCE is returned, then obviously the value is not a reference.
-amf_err_t amf3_get_reference( byte *data, size_t len, amf3_type_t *type, size_t *index );*/
+amf_err_t amf3_write_u29( byte* data, size_t len, uint32_t value );
+amf_err_t amf3_write_marker( byte* data, size_t len, amf3_type_t type );
+amf_err_t amf3_write_undefined( byte* data, size_t len );
+amf_err_t amf3_write_null( byte* data, size_t len );
+amf_err_t amf3_write_boolean( byte* data, size_t len, int value );
+amf_err_t amf3_write_integer( byte* data, size_t len, int32_t value );
+amf_err_t amf3_write_double( byte* data, size_t len, double value );
+amf_err_t amf3_write_ref( byte* data, size_t len, uint32_t index );
+amf_err_t amf3_write_bytes( byte* data, size_t len, const void *value, size_t value_len );
+amf_err_t amf3_write_date_value( byte* data, size_t len, double timestamp );
+
+
+amf3_type_t amf3_next_type( const byte* data, size_t len );
+amf_err_t amf3_get_u29( const byte* data, size_t len, uint32_t *value );
+amf_err_t amf3_get_u29_ref( const byte* data, size_t len, uint32_t *value, bool *reference );
+amf_err_t amf3_get_integer( const byte* data, size_t len, int32_t *value );
+amf_err_t amf3_get_double( const byte* data, size_t len, double *value );
+amf_err_t amf3_get_date_value( const byte* data, size_t len, double *timestamp );
+
+
+//A slice of serialized AMF0 holding exactly one value
+typedef struct amf0_view{
+    const byte *data;
+    size_t length;
+} amf0_view_t;
+
+//The offsets of the top level values in a serialized AMF0 message, for reading values without decoding the whole message
+typedef struct amf0_index{
+    const byte *data;
+    size_t length;
+    size_t count;
+    size_t offsets[AMF0_INDEX_MAX + 1];
+} amf0_index_t;
+
+amf_err_t amf0_skip( const byte* data, size_t len );
+amf_err_t amf0_index_create( amf0_index_t *index, const byte* data, size_t len );
+amf_err_t amf0_index_get( const amf0_index_t *index, size_t item, amf0_view_t *value );
+amf_err_t amf0_index_query( const amf0_index_t *index, amf0_view_t *value, size_t item, ... );
+amf_err_t amf0_view_get_member( const amf0_view_t *object, const void *key, size_t key_len, amf0_view_t *value );
+amf0_type_t amf0_view_type( const amf0_view_t *value );
+amf_err_t amf0_view_get_string( const amf0_view_t *value, const char **str, size_t *length );
+amf_err_t amf0_view_get_number( const amf0_view_t *value, double *number );
+amf_err_t amf0_view_get_boolean( const amf0_view_t *value, int *boolean );
 
 #ifdef __cplusplus
 }
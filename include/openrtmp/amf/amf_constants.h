@@ -49,6 +49,13 @@ extern "C" {
 #include <openrtmp/rtmp/rtmp_types.h>
 
 #define AMF_MAX_KEY 1000
+#define AMF3_MAX_DEPTH 64
+#define AMF0_MAX_DEPTH 64
+//Number of top level values tracked by an amf0_index_t
+#define AMF0_INDEX_MAX 16
+//Initial arena size for amf_create_arena, as a fixed part plus a multiple of the source length
+#define AMF_ARENA_BASE 1024
+#define AMF_ARENA_SCALE 8
 
 /*! \addtogroup amf_ref AMF
     @{ */
@@ -67,7 +74,8 @@ typedef enum AMF_ERR {
     AMF_ERR_INCOMPLETE,         //!< The data stream ended unexpectedly.
     AMF_ERR_NEED_NAME,          //!< An attempt to write a member without first writing a member name was made.
     AMF_ERR_OOM,                //!< An attempt to allocate dynamic memory failed.
-    AMF_ERR_BAD_ALLOC           //!< Unused.
+    AMF_ERR_BAD_ALLOC,          //!< Unused.
+    AMF_ERR_NOT_FOUND           //!< A requested item or member does not exist.
 } amf_err_t;
 
 #define AMF_SIZE(n) ((amf_err_t)(n))
@@ -118,7 +126,8 @@ typedef enum AMF3_TYPE {
     AMF3_TYPE_VECTOR_UINT,      //Page 12, §3.15
     AMF3_TYPE_VECTOR_DOUBLE,    //Page 12, §3.15
     AMF3_TYPE_VECTOR_OBJECT,    //Page 12, §3.15
-    AMF3_TYPE_DICTIONARY        //Page 13, §3.16
+    AMF3_TYPE_DICTIONARY,       //Page 13, §3.16
+    AMF3_TYPE_NONE              //Not a part of the spec, for internal use
 } amf3_type_t;
 
 //AMF Object Type Markers
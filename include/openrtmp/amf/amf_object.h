@@ -52,7 +52,7 @@ typedef union amf_value * amf_value_t;
 /*! \struct     amf_t
     \brief      Represents a generic AMF abstraction.
     \remarks    \parblock
-                It currently only implements AMF0 internally.
+                Values are read from and written to AMF0, switching to AMF3 through AVM+ markers where needed.
 
                 When pushing values to an AMF object, there is a notion of push slots or push position. This is merely
                 the logical name for the area where the next pushed value will reside. This is always the deepest
@@ -116,17 +116,34 @@ typedef struct amf_object * amf_t;
 */
 
 /*! \brief      Creates an AMF object abstraction for manipulating and reading AMF data.
-    \param      type    The version of AMF that this object should represent. Currently, only AMF0 is supported.
+    \param      type    The version of AMF that this object should represent, either 0 or 3.
     \return     On success, the return value is a valid `amf_t` pointer.
     \return     On failure, `nullptr` is returned.
-    \remarks    As of now, only AMF version 0 is supported, and the API mostly reflects this.
-                When AMF3 support is added, the API is almost certainly going to change to be less coupled with the
-                underlying value representations.
+    \remarks    Both versions hold the same values. An AMF3 object reads and writes the leading encoding selector
+                used by RTMP AMF3 messages, and sends complex values through AVM+ markers. AVM+ values are understood
+                when reading either version.
     \memberof   amf_t
     \sa         amf_reference
  */
 amf_t amf_create( char type );
 
+/*! \brief      Creates an AMF object whose contents all live in a single arena allocation.
+    \param      type        The version of AMF that this object should represent, either 0 or 3.
+    \param      source_len  The length of the data which will be read into the object, used to size the arena.
+    \param      borrow      If true, strings, XML documents, byte arrays and member names read into the object point
+                            into the source buffer instead of being copied.
+    \return     On success, the return value is a valid `amf_t` pointer.
+    \return     On failure, `nullptr` is returned.
+    \remarks    The object behaves like one made by `amf_create()`, but values, member lists and strings are carved out of
+                one block sized from \a source_len, and `amf_destroy()` releases them with a single free. If the block runs
+                out, further blocks are chained on. Nothing is released before the object is destroyed.
+    \remarks    When \a borrow is set, the buffer passed to `amf_read()` must outlive the object, and strings obtained from
+                it are not NUL terminated; always use the returned lengths.
+    \memberof   amf_t
+    \sa         amf_create
+ */
+amf_t amf_create_arena( char type, size_t source_len, bool borrow );
+
 /*! \brief      Increments the reference count on an AMF object.
     \param      other     An AMF object to take a reference from.
     \return     Returns \a other
@@ -368,6 +385,20 @@ amf_err_t amf_push_long_string( amf_t amf, const void *str );
  */
 amf_err_t amf_push_xml( amf_t amf, const void *xml );
 
+/*! \brief      Pushes a byte array into the current push location.
+    \param      amf     The AMF object into which the value will be pushed.
+    \param      data    The bytes to push. \n
+                        This value may be allocated with a previous call to `amf_push_string_alloc()`. If it was, this function
+                        will consume the buffer. Otherwise, a copy of \a length bytes will be made internally.
+    \param      length  The number of bytes in \a data.
+    \return     An AMF error code.
+    \remarks    Byte arrays only exist in AMF3. When written as part of an AMF0 message, they are wrapped in an AVM+ marker.
+    \remarks    For more information about push locations, see `amf_t`.
+    \memberof   amf_t
+    \sa         amf_push_string_alloc
+ */
+amf_err_t amf_push_byte_array( amf_t amf, const void *data, size_t length );
+
 
 
 
@@ -593,6 +624,14 @@ double amf_value_get_date( amf_value_t target, int16_t *timezone );
  */
 const char* amf_value_get_xml( amf_value_t target, size_t *length );
 
+/*! \brief      Extracts a byte array from an AMF value.
+    \param      target  An AMF value.
+    \param[out] length  (Optional) Receives the number of bytes in the returned buffer.
+    \return     A buffer holding the contents of \a target.
+    \memberof   amf_value_t
+ */
+const byte* amf_value_get_byte_array( amf_value_t target, size_t *length );
+
 
 //Get member from object by key.
 /*! \brief      Fetches a member from an object by key.
@@ -62,6 +62,9 @@ typedef enum {
 #include <openrtmp/rtmp/rtmp_client.h>
 #include <openrtmp/rtmp/rtmp_server.h>
 #include <openrtmp/rtmp/rtmp_app.h>
+#include <openrtmp/util/slab.h>
+#include <openrtmp/rtmp/rtmp_log.h>
+#include <openrtmp/rtmp/rtmp_stats.h>
 
 
 char * rtmp_params_get_s( rtmp_params_t params, rtmp_param_name_t name );
@@ -104,6 +107,103 @@ void rtmp_destroy( rtmp_t mgr );
 */
 void rtmp_set_app_list( rtmp_t mgr, rtmp_app_list_t list );
 
+/*! \brief      Limits the combined size of the I/O buffers of every connection owned by a manager.
+    \param      mgr     The manager whose connections should be limited.
+    \param      limit   The maximum number of bytes the buffers may occupy. A value of `0` disables the limit.
+    \noreturn
+    \remarks    Connections start with small buffers which grow as traffic demands, up to \ref RTMP_MAX_IO_BUFFER_SIZE each.
+                Once the budget is exhausted, buffers stop growing: reads from the network are paused until the input has been
+                processed, and sends fail with `RTMP_ERR_AGAIN` until the peer has drained the output.
+    \remarks    The default limit is \ref RTMP_DEFAULT_MEMORY_BUDGET.
+    \memberof   rtmp_t
+*/
+void rtmp_set_memory_budget( rtmp_t mgr, size_t limit );
+
+/*! \brief      Chooses how a manager waits for its connections to become ready.
+    \param      mgr     The manager to configure.
+    \param      enabled If true, connections are registered with epoll as edge-triggered. Otherwise they are level-triggered.
+                        Other backends are always level-triggered.
+    \noreturn
+    \remarks    \parblock
+                A level-triggered connection makes one `recv` or `send` per event, and changes its registration whenever
+                its buffers fill or empty. An edge-triggered connection is never re-registered: each event drains the
+                socket until it would block, or \ref RTMP_EPOLL_READ_MAX bytes have been read, and flushes the output
+                until it is empty or the kernel's buffer is full. This saves several system calls per chunk under load.
+                \endparblock
+    \remarks    Only connections established after this function is called are affected.
+                The default is \ref RTMP_EPOLL_EDGE_TRIGGERED.
+    \memberof   rtmp_t
+*/
+void rtmp_set_edge_triggered( rtmp_t mgr, bool enabled );
+
+/*! \brief      Sets how long a manager lets its connections go without hearing from the peer.
+    \param      mgr         The manager to configure.
+    \param      handshake   The milliseconds a new connection has to complete its handshake before it is closed.
+    \param      ping        The milliseconds a connection may receive nothing before a ping request is sent to the peer.
+    \param      idle        The milliseconds a connection may receive nothing before it is closed.
+    \noreturn
+    \remarks    A value of `0` disables the corresponding timeout. Pings are answered automatically, so a peer using
+                libOpenRTMP never goes idle while its connection works.
+    \remarks    Connections shrink their I/O buffers when they are checked, so with both ping and idle disabled, buffers
+                which grew for a burst of traffic are kept for as long as the connection lasts.
+    \remarks    The handshake timeout applies to connections established after this function is called. The others are
+                picked up by every connection the next time it is checked.
+    \remarks    The defaults are \ref RTMP_HANDSHAKE_TIMEOUT, \ref RTMP_PING_INTERVAL and \ref RTMP_IDLE_TIMEOUT.
+    \memberof   rtmp_t
+*/
+void rtmp_set_timeouts( rtmp_t mgr, rtmp_time_t handshake, rtmp_time_t ping, rtmp_time_t idle );
+
+/*! \brief      Chooses the mechanism a manager uses for network I/O.
+    \param      mgr     The manager to configure. It must not be listening, or have any connections yet.
+    \param      backend The backend to use. \ref RTMP_BACKEND_AUTO picks io_uring if it is supported, and epoll otherwise.
+    \return     This function returns a libOpenRTMP error code. If \a backend isn't supported, the manager keeps its current backend.
+    \remarks    Every backend in the build may be chosen at runtime, so they can be compared within the same program.
+                Which ones are built is decided by the `RTMP_POLLTECH_*` definitions in \ref rtmp_config.
+    \remarks    \parblock
+                With io_uring, the manager keeps a multishot accept and a multishot receive armed on every socket. The kernel
+                picks a buffer from a ring the manager provides for each receive, and the data is copied straight into the
+                connection's input. The output of each connection is sent with one asynchronous `sendmsg` at a time, and every
+                submission made during a service iteration goes to the kernel in the same system call as the wait for the next.
+                \endparblock
+    \remarks    Managers start with \ref RTMP_DEFAULT_BACKEND. io_uring needs Linux 6.0 or newer.
+    \memberof   rtmp_t
+*/
+rtmp_err_t rtmp_set_backend( rtmp_t mgr, rtmp_backend_t backend );
+
+/*! \brief      Gets the mechanism a manager uses for network I/O.
+    \param      mgr     The manager to query.
+    \return     The backend in use. This is never \ref RTMP_BACKEND_AUTO.
+    \memberof   rtmp_t
+*/
+rtmp_backend_t rtmp_get_backend( rtmp_t mgr );
+
+/*! \brief      Returns the number of bytes currently allocated for the I/O buffers of a manager's connections.
+    \param      mgr     The manager to query.
+    \return     The total capacity of the I/O buffers charged against the budget of \a mgr.
+    \memberof   rtmp_t
+*/
+size_t rtmp_get_memory_usage( rtmp_t mgr );
+
+/*! \brief      Reports on the pool a manager recycles its server connection objects through.
+    \param      mgr     The manager to query.
+    \param      stats   Receives the number of slabs allocated, connections live and cached for reuse, and allocation counters.
+    \noreturn
+    \remarks    Connection objects are allocated \ref RTMP_CONN_SLAB_SIZE at a time, and are kept for reuse once their connection closes.
+    \memberof   rtmp_t
+*/
+void rtmp_get_conn_stats( rtmp_t mgr, slab_stats_t *stats );
+
+/*! \brief      Reports the counters of a manager, or of every manager.
+    \param      mgr             The manager to query, or nullptr to add up every manager which exists or has existed.
+    \param      stats           Receives the counters for every connection while it was serviced by \a mgr.
+    \param      service_time    If not nullptr, receives a histogram of how long each call to \ref rtmp_service spent
+                                handling events, in nanoseconds. Time spent waiting for events isn't included.
+    \noreturn
+    \remarks    This may be called from any thread. The counters are read one at a time, so they may be slightly out of step with each other.
+    \memberof   rtmp_t
+*/
+void rtmp_get_stats( rtmp_t mgr, rtmp_stats_t *stats, rtmp_histogram_t *service_time );
+
 /*! \brief      Performs a service iteration over all connected streams.
     \param      mgr     The RTMP manager to service
     \param      timeout \parblock
@@ -115,6 +215,8 @@ void rtmp_set_app_list( rtmp_t mgr, rtmp_app_list_t list );
                         A timeout value of `-1` will block forever until there is network traffic to deal with.
                         \endparblock
     \return     This function returns a libOpenRTMP error code.
+    \remarks    The wait is cut short when a timer of the manager is due, such as a refresh event or a timeout, so
+                `-1` is enough to keep every connection serviced.
     \memberof   rtmp_t
 */
 rtmp_err_t rtmp_service( rtmp_t mgr, int timeout );
@@ -164,6 +266,58 @@ rtmp_err_t rtmp_close_stream( rtmp_t mgr, rtmp_stream_t stream );
 */
 rtmp_err_t rtmp_listen( rtmp_t mgr, const char * iface, short port, rtmp_connect_proc cb, void *user );
 
+/*! \brief      A procedure which is run on the thread servicing an RTMP manager.
+    \param      mgr     The manager whose thread is running the task.
+    \param      user    The pointer which was passed to \ref rtmp_post.
+    \noreturn
+    \memberof   rtmp_t
+*/
+typedef void (*rtmp_task_proc)(
+    rtmp_t mgr,
+    void *user
+);
+
+/*! \brief      Indicates that a stream has been handed from one manager to another.
+    \param      mgr     The manager which now owns \a stream, or the original manager if \a err is not `RTMP_ERR_NONE`.
+    \param      stream  The stream which was handed off.
+    \param      err     `RTMP_ERR_NONE` if the handoff succeeded, otherwise the reason it failed.
+    \param      user    The pointer which was passed to \ref rtmp_handoff.
+    \noreturn
+    \remarks    On success, this runs on the thread servicing the new manager, so \a stream may be used freely from within it.
+    \memberof   rtmp_t
+*/
+typedef void (*rtmp_handoff_proc)(
+    rtmp_t mgr,
+    rtmp_stream_t stream,
+    rtmp_err_t err,
+    void *user
+);
+
+/*! \brief      Queues a task to run on the thread which services an RTMP manager.
+    \param      mgr     The manager to run the task on.
+    \param      proc    The task to run.
+    \param      user    A pointer which will be passed into \a proc.
+    \return     This function returns a libOpenRTMP error code.
+    \remarks    This is the only manager function which may be called from any thread. The task runs during the next call to
+                \ref rtmp_service on \a mgr, which is woken up if it is currently blocking.
+    \memberof   rtmp_t
+*/
+rtmp_err_t rtmp_post( rtmp_t mgr, rtmp_task_proc proc, void *user );
+
+/*! \brief      Moves a stream, along with its connection, from one manager to another.
+    \param      from    The manager which currently owns \a stream.
+    \param      to      The manager which should take ownership of \a stream.
+    \param      stream  The stream to move.
+    \param      cb      An optional \ref rtmp_handoff_proc which is called once the move has completed.
+    \param      user    A pointer which will be passed into \a cb.
+    \return     This function returns a libOpenRTMP error code.
+    \remarks    This must be called from the thread servicing \a from, typically from within a stream callback. The stream is
+                detached once the current service iteration finishes, and attached to \a to on its own thread. \a from must not touch
+                \a stream after this call returns.
+    \memberof   rtmp_t
+*/
+rtmp_err_t rtmp_handoff( rtmp_t from, rtmp_t to, rtmp_stream_t stream, rtmp_handoff_proc cb, void *user );
+
 
 /*! \addtogroup rtmp_ref RTMP
     @{ */
@@ -54,6 +54,20 @@ typedef struct rtmp_app_list * rtmp_app_list_t;
 #include <openrtmp/rtmp/rtmp_types.h>
 #include <openrtmp/rtmp.h>
 
+/*! \brief      Statistics for a stream published through an app.
+    \remarks    The GOP cache holds the most recent keyframe and every frame since, so that new subscribers can start playing
+                right away instead of waiting for the next keyframe. The codec sequence headers are kept separately and are not
+                counted here.
+    \memberof   rtmp_app_t
+*/
+typedef struct rtmp_gop_stats{
+    size_t bytes_held;      //!< The number of payload bytes in the GOP cache.
+    size_t frames_held;     //!< The number of audio and video messages in the GOP cache.
+    size_t gops_cached;     //!< The number of GOPs which have been started in the cache.
+    size_t gops_dropped;    //!< The number of GOPs which were dropped for outgrowing the cache limit.
+    size_t subscribers;     //!< The number of connections playing the stream.
+} rtmp_gop_stats_t;
+
 /*! \brief      This callback is used by apps to indicate the receipt of an AMF-based RTMP message.
     \param      stream  The stream that this callback was fired from.
     \param      app     The app which this callback was registered with.
@@ -107,6 +121,22 @@ typedef rtmp_cb_status_t (*rtmp_app_on_pub_proc)(
     void *user
 );
 
+/*! \brief      This callback is used by apps to indicate the receipt of a \ref rpc_play remote procedure call.
+    \param      stream  The stream that this callback was fired from.
+    \param      app     The app which this callback was registered with.
+    \param      name    The name of the stream to play. Often called the stream key.
+    \param      user    A user-defined pointer which was registered with the app.
+    \return     See \ref callback_semantics
+    \remarks    If this callback continues, the stream is subscribed to whatever is published under \a name.
+    \memberof   rtmp_app_t
+*/
+typedef rtmp_cb_status_t (*rtmp_app_on_play_proc)(
+    rtmp_stream_t stream,
+    rtmp_app_t app,
+    const char * name,
+    void *user
+);
+
 /*! \brief      This callback is used by apps to indicate the receipt of audiovisual content.
     \param      stream      The stream that this callback was fired from.
     \param      app         The app which this callback was registered with.
@@ -224,6 +254,15 @@ void rtmp_app_set_fcpublish( rtmp_app_t app, rtmp_app_on_fcpub_proc proc, void *
 */
 void rtmp_app_set_publish( rtmp_app_t app, rtmp_app_on_pub_proc proc, void *user );
 
+/*! \brief      Sets the play callback.
+    \param      app     The app to register the callback with.
+    \param      proc    The callback procedure to register.
+    \param      user    An optional pointer to pass into the callback.
+    \noreturn
+    \memberof   rtmp_app_t
+*/
+void rtmp_app_set_play( rtmp_app_t app, rtmp_app_on_play_proc proc, void *user );
+
 /*! \brief      Sets the onMetadata callback.
     \param      app     The app to register the callback with.
     \param      proc    The callback procedure to register.
@@ -309,6 +348,17 @@ rtmp_cb_status_t rtmp_app_fcpublish( rtmp_stream_t stream, rtmp_app_t app, const
 */
 rtmp_cb_status_t rtmp_app_publish( rtmp_stream_t stream, rtmp_app_t app, const char * name, const char * type );
 
+/*! \brief      Fires the play callback on an app.
+    \param      stream  The RTMP stream to fire the play event on.
+    \param      app     The app to use for firing the callback.
+    \param      name    The name of the stream to play. Also referred to as the stream key.
+    \return     This function returns the result of the callback.
+    \return     If no callback was specified, the return value is `RTMP_CB_CONTINUE`.
+    \return     See \ref callback_semantics
+    \memberof   rtmp_app_t
+*/
+rtmp_cb_status_t rtmp_app_play( rtmp_stream_t stream, rtmp_app_t app, const char * name );
+
 /*! \brief      Fires the onMetadata callback on an app.
     \param      stream  The RTMP stream to fire the onMetadata event on.
     \param      app     The app to use for firing the callback.
@@ -366,6 +416,27 @@ rtmp_cb_status_t rtmp_app_video( rtmp_stream_t stream, rtmp_app_t app, size_t st
 */
 rtmp_cb_status_t rtmp_app_audio( rtmp_stream_t stream, rtmp_app_t app, size_t streamid, rtmp_time_t timestamp, const void * av_data, size_t av_length, bool final_part );
 
+/*! \brief      Sets the GOP cache limit for streams published through an app.
+    \param      app     The app to configure.
+    \param      size    The maximum number of bytes cached for each published stream. \n
+                        A value of 0 disables the cache, so new subscribers wait for the next keyframe.
+    \noreturn
+    \remarks    The default is \ref RTMP_DEFAULT_GOP_CACHE_SIZE. The new limit applies from the next frame onwards.
+    \memberof   rtmp_app_t
+*/
+void rtmp_app_set_gop_cache_size( rtmp_app_t app, size_t size );
+
+/*! \brief      Gets statistics for a stream published through an app.
+    \param      app     The app the stream belongs to.
+    \param      name    The name of the stream. Also referred to as the stream key.
+    \param      stats   Receives the statistics.
+    \return     If a stream called \a name is being published or played, the return value is true.
+    \return     Otherwise, the return value is false and \a stats is left untouched.
+    \remarks    This may be called from any thread. The values are updated as frames arrive, and are not a consistent snapshot.
+    \memberof   rtmp_app_t
+*/
+bool rtmp_app_get_gop_stats( rtmp_app_t app, const char *name, rtmp_gop_stats_t *stats );
+
 #ifdef __cplusplus
 }
 #endif
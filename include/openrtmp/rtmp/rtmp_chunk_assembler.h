@@ -36,6 +36,8 @@ typedef struct rtmp_chunk_assembler *rtmp_chunk_assembler_t;
 
 rtmp_chunk_assembler_t rtmp_chunk_assembler_create( size_t max_size, rtmp_chunk_proc chunk_cb, rtmp_event_proc event_cb, rtmp_log_proc log_cb, void *user );
 void rtmp_chunk_assembler_destroy( rtmp_chunk_assembler_t assembler );
+//Drops any partly assembled messages, but keeps the buffers they were assembled in
+void rtmp_chunk_assembler_reset( rtmp_chunk_assembler_t assembler );
 void rtmp_chunk_assembler_assign( rtmp_chunk_assembler_t assembler,  rtmp_chunk_conn_t connection );
 
 #ifdef __cplusplus
@@ -51,7 +51,8 @@ void rtmp_cache_reset( rtmp_chunk_stream_cache_t cache );
 
 //Get a cached message header by chunk stream ID
 rtmp_chunk_stream_message_internal_t * rtmp_cache_get( rtmp_chunk_stream_cache_t cache, size_t chunk_id );
-rtmp_chunk_stream_message_internal_t * rtmp_cache_find( rtmp_chunk_stream_cache_t cache, size_t stream_id, size_t msg_size, byte msg_type, rtmp_time_t timestamp );
+//Pick a chunk stream for a message that was sent without one. Messages of the same type on the same message stream share a chunk stream.
+rtmp_chunk_stream_message_internal_t * rtmp_cache_find( rtmp_chunk_stream_cache_t cache, size_t stream_id, byte msg_type );
 
 
 #ifdef __cplusplus
@@ -32,6 +32,7 @@ extern "C" {
 #include <openrtmp/rtmp/rtmp_types.h>
 #include <openrtmp/rtmp/rtmp_constants.h>
 #include <openrtmp/rtmp/rtmp_chunk_flow.h>
+#include <openrtmp/rtmp/rtmp_stats.h>
 
 typedef struct rtmp_chunk_conn *rtmp_chunk_conn_t;
 
@@ -52,6 +53,12 @@ typedef rtmp_cb_status_t (*rtmp_event_proc)(
     void * restrict user                //User-specified data
 );
 
+//Procedure prototype for releasing a payload which was sent by reference
+typedef void (*rtmp_release_proc)(
+    const byte *data,                   //The payload which is no longer referenced
+    void * restrict user                //User-specified data
+);
+
 //Procedure prototype for handling logging
 typedef void (*rtmp_log_proc)(
     rtmp_err_t err,                     //The error status
@@ -69,6 +76,10 @@ rtmp_chunk_conn_t rtmp_chunk_conn_create( bool client );
 //Destroy an RTMP object.
 rtmp_err_t rtmp_chunk_conn_close( rtmp_chunk_conn_t conn );
 
+//Puts a connection back in the state rtmp_chunk_conn_create leaves it in, keeping its buffers and caches for reuse.
+//The callbacks have to be registered again.
+rtmp_err_t rtmp_chunk_conn_reset( rtmp_chunk_conn_t conn, bool is_client );
+
 //This should be called every time the buffers are changed.
 rtmp_err_t rtmp_chunk_conn_service( rtmp_chunk_conn_t conn );
 
@@ -90,6 +101,11 @@ rtmp_err_t rtmp_chunk_conn_acknowledge( rtmp_chunk_conn_t conn );
 //Tells the peer how many bytes will be received prior to an ack being sent.
 rtmp_err_t rtmp_chunk_conn_set_window_ack_size( rtmp_chunk_conn_t conn, uint32_t size );
 
+//Returns the number of bytes sent or queued which the peer hasn't acknowledged yet, or just the queued bytes if the peer has never
+//acknowledged anything. Once it passes RTMP_MAX_IN_FLIGHT_WINDOWS times the window set with rtmp_chunk_conn_set_window_ack_size,
+//audio, video and data messages are refused with RTMP_ERR_AGAIN until the peer catches up.
+size_t rtmp_chunk_conn_in_flight( rtmp_chunk_conn_t conn );
+
 //Asks the peer to change their window size.
 rtmp_err_t rtmp_chunk_conn_set_peer_bwidth( rtmp_chunk_conn_t conn, uint32_t size, rtmp_limit_t limit_type );
 
@@ -99,6 +115,10 @@ rtmp_err_t rtmp_chunk_conn_get_in_buff( rtmp_chunk_conn_t conn, void **buffer, s
 //Fetches a buffer along with its size used to fetch data from the RTMP chunk connection.
 rtmp_err_t rtmp_chunk_conn_get_out_buff( rtmp_chunk_conn_t conn, const void **buffer, size_t *size );
 
+//Fills iov with up to max descriptors covering pending output, in order, and stores the number used in count.
+//Sending them with writev/sendmsg and committing the amount sent is equivalent to using rtmp_chunk_conn_get_out_buff.
+rtmp_err_t rtmp_chunk_conn_get_out_iov( rtmp_chunk_conn_t conn, rtmp_iovec_t *iov, size_t max, size_t *count );
+
 //Inform the connection about how many bytes were written to the buffer.
 rtmp_err_t rtmp_chunk_conn_commit_in_buff( rtmp_chunk_conn_t conn, size_t size );
 
@@ -107,6 +127,23 @@ rtmp_err_t rtmp_chunk_conn_commit_out_buff( rtmp_chunk_conn_t conn, size_t size
 
 rtmp_err_t rtmp_chunk_conn_pause( rtmp_chunk_conn_t conn, bool status );
 
+//Charges the I/O buffers of the connection against a shared budget. Pass nullptr to detach them.
+rtmp_err_t rtmp_chunk_conn_set_budget( rtmp_chunk_conn_t conn, ringbuffer_budget_t *budget );
+
+//Shrinks the I/O buffers back towards their initial size if they have drained.
+rtmp_err_t rtmp_chunk_conn_trim( rtmp_chunk_conn_t conn );
+
+//Keeps the output buffer from moving while an asynchronous send still refers to the descriptors from rtmp_chunk_conn_get_out_iov.
+//While pinned, the output can't grow, so sends may fail with RTMP_ERR_AGAIN sooner.
+rtmp_err_t rtmp_chunk_conn_pin_out_buff( rtmp_chunk_conn_t conn, bool pinned );
+
+//Reports the counters of this connection alone. Only call this from the thread servicing the connection.
+void rtmp_chunk_conn_get_stats( rtmp_chunk_conn_t conn, rtmp_stats_t *stats );
+
+//Adds everything this connection counts from now on into stats as well, which is how managers keep their totals.
+//Passing nullptr stops that. Only the thread servicing the connection may write to stats.
+rtmp_err_t rtmp_chunk_conn_set_stats( rtmp_chunk_conn_t conn, rtmp_stats_t *stats );
+
 
 rtmp_err_t rtmp_chunk_conn_call_event( rtmp_chunk_conn_t conn, rtmp_event_t event );
 
@@ -123,6 +160,37 @@ rtmp_chunk_conn_send_message(
     size_t *written
 );
 
+//Send a message without copying its payload. Only the chunk headers are written into the output buffer;
+//the payload is read straight from data when the connection is flushed. Once every byte of it has been sent,
+//or the connection is closed, release is called with data and user. If an error is returned, release is not called.
+rtmp_err_t
+rtmp_chunk_conn_send_message_ref(
+    rtmp_chunk_conn_t conn,
+    byte message_type,
+    uint32_t chunk_stream,
+    uint32_t message_stream,
+    uint32_t timestamp,
+    const byte *data,
+    size_t length,
+    rtmp_release_proc release,
+    void *user
+);
+
+//Queue bytes which were already split into chunks by rtmp_chunk_frame_message at this connection's chunk size.
+//The next message sent on chunk_stream will use a full header, since the peer's view of it has changed.
+//message_type is the type of the framed message, which decides whether it may be held back.
+//Ownership of data works the same way as in rtmp_chunk_conn_send_message_ref.
+rtmp_err_t
+rtmp_chunk_conn_send_framed_ref(
+    rtmp_chunk_conn_t conn,
+    uint32_t chunk_stream,
+    rtmp_message_type_t message_type,
+    const byte *data,
+    size_t length,
+    rtmp_release_proc release,
+    void *user
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -46,6 +46,9 @@ rtmp_err_t rtmp_chunk_read_shake_2( ringbuffer_t input, rtmp_time_t * restrict t
 //Used to emit a header. Contents of header will be read from message and stored in the cache for future writes.
 rtmp_err_t rtmp_chunk_emit_hdr( ringbuffer_t output, rtmp_chunk_stream_message_t *message, rtmp_chunk_stream_cache_t cache );
 
+//Used to emit the header of every chunk after the first in a message. This is always type 3, and leaves the cache alone.
+rtmp_err_t rtmp_chunk_emit_hdr_continue( ringbuffer_t output, rtmp_chunk_stream_message_t *message, rtmp_chunk_stream_cache_t cache );
+
 //Used to read a header. Message will be filled with a pointer to a message in the cache which contains all the information.
 rtmp_err_t rtmp_chunk_read_hdr( ringbuffer_t input, rtmp_chunk_stream_message_t **message, rtmp_chunk_stream_cache_t cache );
 
@@ -55,6 +58,14 @@ rtmp_err_t rtmp_chunk_emit_hdr_basic( ringbuffer_t output, byte format, size_t i
 //Used to read the initial few bytes of the chunk header, as the length and content is variable based on the id value.
 rtmp_err_t rtmp_chunk_read_hdr_basic( ringbuffer_t input, byte *format, size_t *id );
 
+//Returns how many bytes rtmp_chunk_frame_message needs to frame message at chunk_size, or 0 if the chunk stream ID is invalid.
+size_t rtmp_chunk_frame_size( const rtmp_chunk_stream_message_t *message, uint32_t chunk_size );
+
+//Splits data into chunks of chunk_size with a full header on the first chunk and minimal headers after it, writing them to output.
+//The result doesn't depend on any connection state, so it can be built once and sent to any number of connections
+//that use the same chunk size. output must hold rtmp_chunk_frame_size bytes. Returns the number of bytes written.
+size_t rtmp_chunk_frame_message( byte *output, const rtmp_chunk_stream_message_t *message, const byte *data, uint32_t chunk_size );
+
 //Print the contents of a chunk header. For debugging.
 void rtmp_print_message( rtmp_chunk_stream_message_t *msg );
 
@@ -284,7 +284,18 @@ rtmp_err_t rtmp_client_setdataframe_amf(
     amf_t object
 );
 
-
+/*! \brief      Issues a play remote procedure call.
+    \param      client      The RTMP client to issue the call with.
+    \param      stream_name The \ref rtmp_playpath "playpath" to play. If this is `nullptr`, the client's playpath is used.
+    \param      start       Where to start playing from, in seconds. `-2` plays the live stream, or a recording if there
+                            is no live stream. `-1` only plays the live stream.
+    \param      duration    How long to play for, in seconds. `-1` plays until the stream ends.
+    \param      reset       Whether to flush any previous playlist.
+    \return     Returns a \ref rtmp_err_t code.
+    \remarks    The call is sent on the message stream selected with \ref rtmp_stream_set_msg_stream, which should be one
+                created with \ref rtmp_client_createstream. The server answers with `onStatus` commands on that stream.
+    \memberof   rtmp_client_t
+*/
 rtmp_err_t rtmp_client_play( rtmp_client_t client,
     const char *stream_name,
     double start DEFAULT(-1),
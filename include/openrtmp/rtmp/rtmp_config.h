@@ -58,6 +58,12 @@
 //! The default strategy setting for changing window size.
 #define RTMP_DEFAULT_BANDWIDTH_TYPE         RTMP_LIMIT_HARD
 
+//! \brief How many of our acknowledgement windows of media may go unacknowledged before sends to a peer are refused.
+//!
+//! Peers only acknowledge once they have received a whole window, so this must be more than one.
+//! Only applies once the peer has sent at least one acknowledgement; peers which never do are limited by \ref RTMP_MAX_IO_BUFFER_SIZE alone.
+#define RTMP_MAX_IN_FLIGHT_WINDOWS          2
+
 
 //! The max chunk size this implementation will allow to be used. The peer may still use a larger chunk size than this.
 #define RTMP_MAX_CHUNK_SIZE                 10000
@@ -65,18 +71,68 @@
 //! The desired chunk size.
 #define RTMP_DESIRED_CHUNK_SIZE             4096
 
-//! \brief The default number of bytes allocated for input/output buffers.
+//! \brief The number of bytes initially allocated for input/output buffers.
 //!
-//! It may be desireable to be able to store a few seconds worth of data in these buffers.
+//! Buffers grow on demand up to \ref RTMP_MAX_IO_BUFFER_SIZE, and are shrunk back towards this size once they drain.
 //! At minimum, the buffer must be 1600 bytes to hold handshake messages.
-#define RTMP_DEFAULT_IO_BUFFER_SIZE         30000000
+#define RTMP_DEFAULT_IO_BUFFER_SIZE         4096
+
+//! \brief The maximum number of bytes a single input or output buffer may grow to.
+//!
+//! It may be desireable to be able to store a few seconds worth of data in these buffers.
+//! Once an output buffer reaches this size, further sends fail with `RTMP_ERR_AGAIN` until the peer catches up.
+#define RTMP_MAX_IO_BUFFER_SIZE             0x00800000
+
+//! \brief The default limit, in bytes, on the combined I/O buffers of every connection owned by an `rtmp_t`.
+//!
+//! Buffers stop growing once the limit is reached, which stops reads and fails sends until memory is released.
+//! A value of 0 disables the limit. See `rtmp_set_memory_budget()`.
+#define RTMP_DEFAULT_MEMORY_BUDGET          0x40000000
+
+//! \brief   How many connection objects an `rtmp_t` allocates at a time.
+//! \details Closed connections are recycled rather than freed, so a burst of reconnects is served from memory that is already held.
+#define RTMP_CONN_SLAB_SIZE                 32
+
+//! \brief   How many closed server connections an `rtmp_t` keeps whole for the next ones it accepts.
+//! \details A kept connection still holds its I/O buffers, chunk stream caches, assembler buffers and callback tables,
+//!          so accepting a connection in its place allocates nothing.
+#define RTMP_SPARE_SERVERS                  64
+
+//! \brief   Payloads smaller than this many bytes are copied into the output buffer even when sent by reference.
+//! \details Tracking a reference costs more than copying a small message, and small messages are usually control traffic anyway.
+#define RTMP_ZEROCOPY_THRESHOLD             512
+
+//! The maximum number of buffer descriptors handed to a single scatter/gather send.
+#define RTMP_MAX_IOV                        64
+
+//! \brief   Ringbuffers at least this large map their storage twice back to back, where the platform supports it.
+//! \details Every readable or writable region of such a buffer is contiguous, so nothing has to be split at the wrap point.
+//!          Each one costs two memory mappings and is rounded up to whole pages, so small buffers stay on the heap.
+//!          Set to 0 to disable mirroring.
+#define RTMP_RINGBUFFER_MIRROR_MIN          0x00008000
+
+//! \brief   The default limit, in bytes, on the GOP cache kept for each published stream.
+//! \details A GOP which outgrows the limit is dropped, and caching resumes at the next keyframe. See `rtmp_app_set_gop_cache_size()`.
+#define RTMP_DEFAULT_GOP_CACHE_SIZE         0x00400000
+
+//! The size of each block of memory a GOP cache stores frames in. Larger frames get a block of their own.
+#define RTMP_GOP_BLOCK_SIZE                 0x00010000
 
 #define RTMP_DEFAULT_PROXY_V_BUFFER_SIZE    0x05FFFFFF
 #define RTMP_DEFAULT_PROXY_A_BUFFER_SIZE    0x05FFFFFF
 
 //! \brief   The size of the static stream cache allocation.
 //! \details If a chunk stream ID exceeds this number, dense dynamic allocation will be used, which does have negative performance implications.
-#define RTMP_STREAM_STATIC_CACHE_SIZE 10
+#define RTMP_STREAM_STATIC_CACHE_SIZE 16
+
+//! \brief   The first chunk stream ID handed out to messages sent on chunk stream 0.
+//! \details IDs below this are left for callers which pick their chunk streams themselves.
+#define RTMP_STREAM_AUTO_FIRST 10
+
+//! \brief   The number of chunk streams handed out to messages sent on chunk stream 0.
+//! \details Each message stream and message type pair keeps its own chunk stream while there are enough to go around,
+//!          so that its headers compress well. When they run out, the least recently used one is reassigned.
+#define RTMP_STREAM_AUTO_COUNT 6
 
 //! The max number of stream cache entries.
 #define RTMP_STREAM_CACHE_MAX 100
@@ -98,14 +154,37 @@
 #define RTMP_SPEC_ENFORCE_HANDSHAKE_NONCES
 
 //! \brief   The logging level.
-//! \details Currently, there are 5 logging levels:
+//! \details This is the most verbose level which is compiled in; log statements above it compile to nothing.
+//!          The level actually logged at runtime is set with `rtmp_log_set_level()`. The levels are:
 //! * 0 - No logging
 //! * 1 - Log fatal errors only (Suggested for production)
 //! * 2 - Log most non-fatal errors (Suggested for debugging)
 //! * 3 - Log all errors
 //! * 4 - Log all status codes other than ERR_NONE
+//! * 5 - Log every message processed
+//! * 10 - Log everything
 #define RTMP_LOG_LEVEL 4
 
+//! \brief   The number of log records which may be waiting for delivery. Must be a power of two.
+//! \details Records produced while the queue is full are dropped and counted.
+#define RTMP_LOG_QUEUE_SIZE 1024
+
+//! The maximum length of a log message, including the terminator. Longer messages are truncated.
+#define RTMP_LOG_MESSAGE_MAX 192
+
+//! The maximum number of log sinks which may be registered with `rtmp_log_add_sink()`.
+#define RTMP_LOG_SINKS_MAX 8
+
+//! How long, in milliseconds, the log thread sleeps when there is nothing to deliver.
+#define RTMP_LOG_DRAIN_INTERVAL 10
+
+//! \brief   The number of buckets each power of two is split into by an `rtmp_histogram_t`, as a power of two.
+//! \details A precision of 3 splits each power of two into 8 buckets, so recorded values are accurate to within 12.5%.
+#define RTMP_HISTOGRAM_PRECISION 3
+//! \brief   The largest power of two an `rtmp_histogram_t` tells apart. Larger values all land in the last bucket.
+//! \details Latencies are recorded in nanoseconds, so 40 covers about 18 minutes.
+#define RTMP_HISTOGRAM_MAGNITUDE 40
+
 //The max size of a 'safe alloc'
 //! The maximum amount of memory allowed to be allocated by a stream. Currently unimplemented.
 #define RTMP_MAX_ALLOC 10000
@@ -130,17 +209,51 @@
 #define RTMP_MAX_ASM_SOFT_BUFFER 5
 
 
-//The technique used to poll connections.
-//#define RTMP_POLLTECH_SELECT
+//The techniques managers may use to poll connections. Any number of them may be built in; see \ref rtmp_set_backend.
 //#define RTMP_POLLTECH_WSAPOLL
-//#define RTMP_POLLTECH_POLL
 
-//! \brief   If defined, the networking implementation used will be epoll based.
-//! \details As of writing this, epoll is the only available networking implementation.
+//! \brief   If defined, managers may use epoll.
+//! \details This is what \ref RTMP_BACKEND_AUTO picks when io_uring isn't available, and the only backend with edge-triggered connections.
 #define RTMP_POLLTECH_EPOLL
 
-//! The maximum number of file descriptors returned by epoll.
-#define RTMP_EPOLL_MAX 100
+//! \brief   If defined, managers may use `poll()`.
+//! \details Every wait hands the whole set of sockets to the kernel, so its cost grows with the number of connections.
+#define RTMP_POLLTECH_POLL
+
+//! \brief   If defined, managers may use `select()`.
+//! \details Like `poll()`, every wait scans every socket. Only sockets numbered below `FD_SETSIZE` can be watched.
+#define RTMP_POLLTECH_SELECT
+
+//! The maximum number of ready sockets handled per wait, whichever backend is used.
+#define RTMP_POLL_MAX 100
+
+//! \brief   Whether managers register their connections with epoll as edge-triggered. See \ref rtmp_set_edge_triggered.
+#define RTMP_EPOLL_EDGE_TRIGGERED true
+
+//! \brief   The most bytes read from one edge-triggered connection each time it is drained.
+//! \details A connection with more to read than this is drained again on the next service iteration, so a fast peer can't starve the others.
+#define RTMP_EPOLL_READ_MAX 0x00100000
+
+//! \brief   If defined, managers may use io_uring. See \ref rtmp_set_backend.
+//! \details The build defines RTMP_HAS_IO_URING when the kernel headers describe everything the backend uses.
+//!          Whether the running kernel supports it is only known once a manager is created; epoll is used otherwise.
+#if defined RTMP_HAS_IO_URING
+#define RTMP_POLLTECH_IO_URING
+#endif
+
+//! \brief   The backend new managers use. See \ref rtmp_backend_t.
+#define RTMP_DEFAULT_BACKEND RTMP_BACKEND_AUTO
+
+//! The number of submission queue entries in each manager's io_uring. The completion queue is four times larger.
+#define RTMP_URING_ENTRIES 256
+
+//! \brief   The number of receive buffers each io_uring manager provides to the kernel. Must be a power of two.
+//! \details Received data is copied out of a buffer into the connection's input as soon as its completion is seen,
+//!          so these only have to cover the data that arrives between two service iterations.
+#define RTMP_URING_BUFFERS 256
+
+//! The size of each receive buffer provided to io_uring.
+#define RTMP_URING_BUFFER_SIZE 0x4000
 
 //! The maximum number of connections waiting to be accepted.
 #define RTMP_LISTEN_SIZE 1000
@@ -151,6 +264,16 @@
 //! How long, in milliseconds, the library will wait for a pending RPC to finish.
 #define RTMP_CALL_TIMEOUT 10000
 
+//! \brief   How long, in milliseconds, a connection may take to finish its handshake before it is closed.
+//! \details Managers start with this value; see \ref rtmp_set_timeouts.
+#define RTMP_HANDSHAKE_TIMEOUT 10000
+
+//! How long, in milliseconds, a manager waits for a connection to receive anything before it sends a ping request.
+#define RTMP_PING_INTERVAL 60000
+
+//! How long, in milliseconds, a connection may go without receiving anything before it is closed.
+#define RTMP_IDLE_TIMEOUT 90000
+
 /*! @} */
 /*! @} */
 #endif
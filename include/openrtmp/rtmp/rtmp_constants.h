@@ -57,13 +57,14 @@ extern "C" {
 /// \details    \refdoc{rtmp_spec,5.2.2,7}
 #define RTMP_VERSION                        3
 
-/// \brief      The ID of the aggregate chunk cache (used internally)
-#define RTMP_CACHE_AGGREGATE                0
-
 /// \brief      The maximum size of a message header.
 /// \details    \refdoc{rtmp_spec,5.3.1,12}
 #define RTMP_MESSAGE_HEADER_SIZE            (1 + 3 + 4 + 3)
 
+/// \brief      The maximum size of a chunk header, including the basic header and extended timestamp.
+/// \details    \refdoc{rtmp_spec,5.3.1,12}
+#define RTMP_MAX_CHUNK_HEADER_SIZE          (3 + 11 + 4)
+
 /// \brief      When specifying a stream event, this will indicate that the callback should fire for any event of the given class.
 #define RTMP_ANY                            0xFFFFFF
 
@@ -108,10 +109,20 @@ typedef enum {
     RTMP_EVENT_FAILED,          //!< The RTMP stream failed in some unexpected way.
     RTMP_EVENT_FILLED,          //!< The output buffer was filled with at least one byte.
     RTMP_EVENT_EMPTIED,         //!< The input buffer had at least one byte removed.
-    RTMP_EVENT_REFRESH,         //!< Called at regular intervals.
+    RTMP_EVENT_REFRESH,         //!< Called every \ref RTMP_REFRESH_TIME milliseconds on streams with a callback for it.
 } rtmp_event_t;
 
 
+/*! \brief      Contains names for the mechanisms a manager can use to wait for and perform network I/O. See \ref rtmp_set_backend.
+*/
+typedef enum {
+    RTMP_BACKEND_AUTO = 0,      //!< io_uring if the build and the running kernel support it, and epoll otherwise.
+    RTMP_BACKEND_EPOLL,         //!< epoll, edge- or level-triggered according to \ref rtmp_set_edge_triggered.
+    RTMP_BACKEND_IO_URING,      //!< io_uring, with multishot accept and receives into buffers provided to the kernel.
+    RTMP_BACKEND_POLL,          //!< `poll()`, level-triggered.
+    RTMP_BACKEND_SELECT         //!< `select()`, level-triggered. Sockets numbered `FD_SETSIZE` or higher are refused.
+} rtmp_backend_t;
+
 typedef enum {
     RTMP_IO_IN = 1,
     RTMP_IO_OUT = 2,
@@ -194,7 +205,7 @@ typedef enum {
     //RTMP Command Messages
     RTMP_MSG_AUDIO = 8,                 //!< An RTMP command message which indicates that the payload contains audio. \n \refdoc{rtmp_spec,7.1.4,26}
     RTMP_MSG_VIDEO = 9,                 //!< An RTMP command message which indicates that the payload contains video. \n \refdoc{rtmp_spec,7.1.5,26}
-    RTMP_MSG_AGGREGATE = 22,            //!< An RTMP command message which indicates that this is an aggregate RTMP message. Aggregate RTMP messages are currently not supported. \n \refdoc{rtmp_spec,7.1.6,26}
+    RTMP_MSG_AGGREGATE = 22,            //!< An RTMP command message which indicates that this is an aggregate RTMP message. Streams deliver the messages inside an aggregate to their callbacks one at a time, rather than the aggregate itself. \n \refdoc{rtmp_spec,7.1.6,26}
     RTMP_MSG_AMF3_DAT = 15,             //!< An RTMP command message which indicates that the payload of this message is AMF3 information. \n \refdoc{rtmp_spec,7.1.2,24}
     RTMP_MSG_AMF3_SO = 16,              //!< An RTMP command message which indicates that the payload is a serialized shared object in AMF3 format. \n \refdoc{rtmp_spec,7.1.3,24}
     RTMP_MSG_AMF3_CMD = 17,             //!< An RTMP command message which indicates that the payload is a RPC call in AMF3 format. \n \refdoc{rtmp_spec,7.1.1,24}
@@ -328,6 +339,21 @@ typedef enum {
     RTMP_ERR_ABORT                              //!< A fatal error indicating that the stream is aborting for some reason, usually as a result of a callback.
 } rtmp_err_t;
 
+/*! \brief      Severity levels used by the logging subsystem.
+    \remarks    The numeric values line up with \ref RTMP_LOG_LEVEL. A record is only produced if its level is no greater
+                than both \ref RTMP_LOG_LEVEL and the level set with \ref rtmp_log_set_level.
+    \sa         rtmp_log_set_level
+*/
+typedef enum {
+    RTMP_LOG_NONE = 0,                          //!< Disables logging when used as a threshold.
+    RTMP_LOG_FATAL,                             //!< Fatal errors, after which a stream is aborted.
+    RTMP_LOG_ERROR,                             //!< Non-fatal errors.
+    RTMP_LOG_WARNING,                           //!< Ignorable errors.
+    RTMP_LOG_NOTICE,                            //!< Status codes other than \ref RTMP_ERR_NONE, and connection events.
+    RTMP_LOG_DEBUG,                             //!< Per-message tracing.
+    RTMP_LOG_TRACE = 10                         //!< Everything, including successful status codes.
+} rtmp_log_level_t;
+
 
 /*! @} */
 /*! @} */
@@ -352,6 +378,10 @@ typedef enum {
 #define RTMP_NETCON_ACCEPT "NetConnection.Connect.Success"
 #define RTMP_NETCON_REJECT "NetConnection.Connect.Rejected"
 #define RTMP_NETSTREAM_START "NetStream.Publish.Start"
+#define RTMP_NETSTREAM_BADNAME "NetStream.Publish.BadName"
+#define RTMP_NETSTREAM_PLAY_RESET "NetStream.Play.Reset"
+#define RTMP_NETSTREAM_PLAY_START "NetStream.Play.Start"
+#define RTMP_NETSTREAM_PLAY_FAILED "NetStream.Play.Failed"
 #define RTMP_TEMP_BUFF_SIZE 600
 
 #ifdef __cplusplus
@@ -0,0 +1,141 @@
+/*
+    rtmp_log.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RTMP_H_LOG_H
+#define RTMP_H_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/rtmp/rtmp_constants.h>
+#include <openrtmp/rtmp/rtmp_chunk_conn.h>
+
+/*! \addtogroup rtmp_ref RTMP
+    @{ */
+/*! \addtogroup rtmp_log Logging
+    \remarks    \parblock
+                Log statements format their message into a record in a fixed size lock-free queue, and return without doing
+                any I/O. Records are delivered to the registered sinks later, either by a dedicated thread started with
+                \ref rtmp_log_start, or otherwise by \ref rtmp_service. If the queue is full, records are dropped rather than
+                making the caller wait.
+
+                Log statements above \ref RTMP_LOG_LEVEL compile to nothing. Statements above the level set with
+                \ref rtmp_log_set_level cost a single relaxed load.
+                \endparblock
+    @{ */
+
+//The current runtime threshold; use rtmp_log_set_level() to change it
+extern rtmp_log_level_t rtmp_log_threshold;
+
+/*! \brief      Checks whether records of a given level are currently being logged.
+    \param      level   The level to check.
+    \return     Returns true if a record at \a level would be queued.
+ */
+static inline bool rtmp_log_enabled( rtmp_log_level_t level ){
+    return level <= RTMP_LOG_LEVEL && level <= __atomic_load_n( &rtmp_log_threshold, __ATOMIC_RELAXED );
+}
+
+/*! \def        RTMP_LOG(level,err,...)
+    \brief      Queues a log record with a printf style message.
+    \param      level   The \ref rtmp_log_level_t of the record.
+    \param      err     The error code associated with the record, or \ref RTMP_ERR_NONE.
+    \param      ...     A format string and its arguments.
+    \remarks    The arguments are not evaluated unless the record is actually logged.
+ */
+#define RTMP_LOG(level,err,...) do{                                                 \
+    if( (level) <= RTMP_LOG_LEVEL && rtmp_log_enabled( (level) ) ){                 \
+        rtmp_log_write( (level), (err), __LINE__, __FILE__, __VA_ARGS__ );         \
+    }                                                                               \
+}while(0)
+
+/*! \brief      Sets the most verbose level which is logged at runtime.
+    \param      level   The new threshold. Levels above \ref RTMP_LOG_LEVEL are never logged regardless of this setting.
+    \noreturn
+    \remarks    The default threshold is \ref RTMP_LOG_WARNING. This may be called from any thread.
+ */
+void rtmp_log_set_level( rtmp_log_level_t level );
+
+/*! \brief      Gets the most verbose level which is logged at runtime.
+    \return     The current threshold.
+ */
+rtmp_log_level_t rtmp_log_get_level( void );
+
+/*! \brief      Registers a procedure which receives every log record.
+    \param      proc    The procedure to call. It receives the error code, source location and message of each record.
+    \param      user    A pointer which will be passed into \a proc.
+    \return     This function returns a libOpenRTMP error code.
+    \remarks    Until the first sink is registered, records are printed to stdout with \ref rtmp_log_print.
+                Sinks are called from whichever thread delivers the records, but never from two threads at once.
+                Sinks should be registered before logging starts, and can't be removed.
+ */
+rtmp_err_t rtmp_log_add_sink( rtmp_log_proc proc, void *user );
+
+/*! \brief      A log sink which prints records to stdout.
+    \remarks    This is the sink used when no other sink has been registered. It may be registered alongside other sinks.
+ */
+void rtmp_log_print( rtmp_err_t err, size_t line, const char* restrict file, const char* restrict message, void * restrict user );
+
+/*! \brief      Queues a log record.
+    \param      level   The level of the record.
+    \param      err     The error code associated with the record.
+    \param      line    The line which produced the record.
+    \param      file    The file which produced the record. This must be a string literal, or otherwise outlive the record.
+    \param      format  A printf style format string, followed by its arguments.
+    \noreturn
+    \remarks    This does not check the level; use \ref RTMP_LOG instead, which does.
+ */
+void rtmp_log_write( rtmp_log_level_t level, rtmp_err_t err, size_t line, const char *file, const char *format, ... )
+    __attribute__((format(printf, 5, 6)));
+
+/*! \brief      Delivers every queued record to the sinks.
+    \return     The number of records delivered.
+    \remarks    If another thread is already delivering records, this returns 0 immediately.
+ */
+size_t rtmp_log_drain( void );
+
+/*! \brief      Starts a thread which delivers log records in the background.
+    \return     This function returns a libOpenRTMP error code.
+    \remarks    Without this thread, records are delivered from \ref rtmp_service, or by calling \ref rtmp_log_drain.
+ */
+rtmp_err_t rtmp_log_start( void );
+
+/*! \brief      Stops the log thread, after delivering any remaining records.
+    \noreturn
+ */
+void rtmp_log_stop( void );
+
+/*! \brief      Gets the number of records which were dropped because the queue was full.
+    \return     The number of dropped records since the program started.
+ */
+size_t rtmp_log_dropped( void );
+
+/*! @} */
+/*! @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+/*
+    rtmp_pool.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RTMP_H_POOL_H
+#define RTMP_H_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*! \addtogroup rtmp_ref RTMP
+    @{ */
+
+/*! \struct     rtmp_pool_t
+    \brief      A pool of RTMP managers, each serviced by its own thread.
+    \remarks    \parblock
+                Every worker in the pool is an ordinary `rtmp_t` with its own poll loop and its own listening socket.
+                The sockets are bound with `SO_REUSEPORT`, so the kernel spreads incoming connections across the workers,
+                and a connection stays on the worker which accepted it unless it is moved with \ref rtmp_handoff.
+
+                Callbacks for a connection always run on the thread of the worker which owns it. Callbacks registered
+                with an app list which is shared between workers may therefore run concurrently.
+                \endparblock
+*/
+typedef struct rtmp_pool * rtmp_pool_t;
+
+/*! @} */
+
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/rtmp.h>
+
+
+/*! \brief      Creates a pool of RTMP managers.
+    \param      workers     The number of workers to create. If this is `0`, one worker is created for every online CPU.
+    \return     If the return value is \ref nullptr, then the function failed to create the pool.
+    \return     Otherwise, the return value is a pool whose workers have not yet been started.
+    \memberof   rtmp_pool_t
+*/
+rtmp_pool_t rtmp_pool_create( size_t workers );
+
+/*! \brief      Stops and destroys a pool, along with all of its workers.
+    \param      pool    The pool to destroy.
+    \noreturn
+    \memberof   rtmp_pool_t
+*/
+void rtmp_pool_destroy( rtmp_pool_t pool );
+
+/*! \brief      Returns the number of workers in a pool.
+    \param      pool    The pool to query.
+    \return     The number of workers in \a pool.
+    \memberof   rtmp_pool_t
+*/
+size_t rtmp_pool_size( rtmp_pool_t pool );
+
+/*! \brief      Returns one of the managers in a pool.
+    \param      pool    The pool to query.
+    \param      idx     The index of the worker, which must be less than `rtmp_pool_size()`.
+    \return     The manager serviced by the worker at \a idx.
+    \remarks    Once the pool has been started, the manager may only be used from its own thread, except through \ref rtmp_post.
+                The result is useful as the target of \ref rtmp_handoff.
+    \memberof   rtmp_pool_t
+*/
+rtmp_t rtmp_pool_worker( rtmp_pool_t pool, size_t idx );
+
+/*! \brief      Sets the app list used by every worker in a pool.
+    \param      pool    The pool to modify.
+    \param      list    The app list to associate with every worker.
+    \noreturn
+    \remarks    This should be called before \ref rtmp_pool_start.
+    \memberof   rtmp_pool_t
+*/
+void rtmp_pool_set_app_list( rtmp_pool_t pool, rtmp_app_list_t list );
+
+/*! \brief      Splits a memory budget evenly between the workers of a pool.
+    \param      pool    The pool to modify.
+    \param      limit   The combined limit for all workers. A value of `0` disables the limit.
+    \noreturn
+    \remarks    See \ref rtmp_set_memory_budget.
+    \memberof   rtmp_pool_t
+*/
+void rtmp_pool_set_memory_budget( rtmp_pool_t pool, size_t limit );
+
+/*! \brief      Starts listening on every worker in a pool.
+    \param      pool    The pool to listen with.
+    \param      iface   The network interface to listen on. See \ref rtmp_listen.
+    \param      port    The port to listen on.
+    \param      cb      An optional \ref rtmp_connect_proc, which is called on the thread of the worker that accepted the connection.
+    \param      user    A pointer which will be passed into \a cb.
+    \return     This function returns a libOpenRTMP error code.
+    \remarks    This should be called before \ref rtmp_pool_start.
+    \memberof   rtmp_pool_t
+*/
+rtmp_err_t rtmp_pool_listen( rtmp_pool_t pool, const char * iface, short port, rtmp_connect_proc cb, void *user );
+
+/*! \brief      Starts a thread for every worker in a pool.
+    \param      pool    The pool to start.
+    \return     This function returns a libOpenRTMP error code.
+    \remarks    Each thread calls \ref rtmp_service on its manager until \ref rtmp_pool_stop is called.
+    \memberof   rtmp_pool_t
+*/
+rtmp_err_t rtmp_pool_start( rtmp_pool_t pool );
+
+/*! \brief      Stops every worker thread in a pool and waits for them to exit.
+    \param      pool    The pool to stop.
+    \noreturn
+    \memberof   rtmp_pool_t
+*/
+void rtmp_pool_stop( rtmp_pool_t pool );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
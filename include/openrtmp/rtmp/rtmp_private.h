@@ -36,39 +36,68 @@ extern "C" {
 #include <openrtmp/rtmp/rtmp_server.h>
 #include <openrtmp/rtmp/rtmp_client.h>
 #include <openrtmp/util/vec.h>
-
-#if defined RTMP_POLLTECH_EPOLL
-#   include <sys/epoll.h>
-#elif defined RTMP_POLLTECH_SELECT
-#   include <sys/select.h>
-#elif defined RTMP_POLLTECH_POLL
-#   include <sys/poll.h>
-#elif defined RTMP_POLLTECH_WSAPOLL
-#   include <winsock2.h>
-#endif
+#include <openrtmp/util/slab.h>
+#include <openrtmp/util/timerwheel.h>
+#include <openrtmp/util/handletable.h>
+#include <openrtmp/rtmp.h>
+#include <pthread.h>
 
 
 typedef enum {
     RTMP_T_RTMP_T,
     RTMP_T_SERVER_T,
-    RTMP_T_CLIENT_T
+    RTMP_T_CLIENT_T,
+    RTMP_T_INBOX_T
 } rtmp_t_t;
 
 struct rtmp_chunk_stream_message_internal{
     rtmp_chunk_stream_message_t msg;
+    //The value of the last timestamp field: the absolute timestamp after a type 0 header, otherwise the delta
     rtmp_time_t time_delta;
     uint32_t processed;
     bool initialized;
+    //Whether the last timestamp field needed an extended timestamp, which type 3 headers then repeat
+    bool extended;
 };
 
+//The message stream and type last sent on an automatically assigned chunk stream
+typedef struct rtmp_chunk_stream_affinity{
+    uint32_t message_stream_id;
+    byte message_type;
+    bool used;
+    size_t last_use;
+} rtmp_chunk_stream_affinity_t;
+
 struct rtmp_chunk_stream_cache{
     rtmp_chunk_stream_message_internal_t static_cache[RTMP_STREAM_STATIC_CACHE_SIZE];
     rtmp_chunk_stream_message_internal_t *dynamic_cache;
     size_t dynamic_cache_size;
+    rtmp_chunk_stream_affinity_t affinity[RTMP_STREAM_AUTO_COUNT];
+    size_t affinity_clock;
 };
 
+//A payload sent by reference, shared between the chunks it was split into
+typedef struct rtmp_chunk_ref{
+    const byte *data;
+    size_t refs;
+    rtmp_release_proc release;
+    void *user;
+} rtmp_chunk_ref_t;
+
+//A queued chunk: bytes from the output ringbuffer (its header) followed by a slice of a referenced payload
+typedef struct rtmp_chunk_seg{
+    size_t ring_len;
+    const byte *data;
+    size_t len;
+    rtmp_chunk_ref_t *ref;
+} rtmp_chunk_seg_t;
+
 struct rtmp_chunk_conn {
     ringbuffer_t in, out;
+    VEC_DECLARE(rtmp_chunk_seg_t) out_segs;
+    size_t out_seg_head;
+    size_t out_assigned;
+    size_t out_ref_bytes;
     rtmp_chunk_stream_cache_t stream_cache_out;
     rtmp_chunk_stream_cache_t stream_cache_in;
 
@@ -83,6 +112,12 @@ struct rtmp_chunk_conn {
     rtmp_time_t self_time, peer_time, peer_shake_recv_time, self_shake_recv_time;
 
     rtmp_time_t lag;
+
+    //Counters for this connection, and for the manager servicing it if any
+    rtmp_stats_t stats;
+    rtmp_stats_t *shared_stats;
+    uint64_t shake_start, paused_since;
+
     byte control_message_buffer[RTMP_CONTROL_BUFFER_SIZE];
     int control_message_len;
 
@@ -96,7 +131,8 @@ struct rtmp_chunk_conn {
     uint32_t peer_chunk_size;
     uint32_t self_window_size;
     uint32_t peer_window_size;
-    uint32_t peer_acknowledged;
+    //Set once the peer has sent an acknowledgement, after which sends are held to our window
+    bool peer_acknowledged;
     rtmp_limit_t peer_bandwidth_type;
 };
 
@@ -115,7 +151,21 @@ struct rtmp_params{
 
 void rtmp_params_free( struct rtmp_params * params );
 
+//Delivers queued log records, unless the log thread is doing so already
+void rtmp_log_service( void );
+
+//Counters have a single writer, so they are updated without a locked instruction.
+//The relaxed atomics only keep readers on other threads from seeing torn values.
+#define RTMP_STAT_ADD(counter, amount) __atomic_store_n( &(counter), __atomic_load_n( &(counter), __ATOMIC_RELAXED ) + (amount), __ATOMIC_RELAXED )
+#define RTMP_STAT_GET(counter) __atomic_load_n( &(counter), __ATOMIC_RELAXED )
+
+//Makes a manager's counters part of the totals reported by rtmp_get_stats( nullptr, ... )
+rtmp_err_t rtmp_stats_register( rtmp_t mgr );
+//Folds a manager's counters into the totals before it is destroyed
+void rtmp_stats_unregister( rtmp_t mgr );
 
+
+//Slot in the pending call table; a seq_num of 0 marks an empty slot
 typedef struct rtmp_call_cb{
     uint32_t seq_num;
     rtmp_time_t issued;
@@ -125,11 +175,21 @@ typedef struct rtmp_call_cb{
 
 typedef struct rtmp_amf_cb{
     char* name;
+    size_t name_len;
     rtmp_message_type_t type;
     rtmp_stream_amf_proc callback;
     void *user;
+    //Index of the next callback registered with the same type and name
+    size_t next;
 } rtmp_amf_cb_t;
 
+//Slot in the AMF callback index, holding the first and last callback registered for a key
+typedef struct rtmp_amf_slot{
+    size_t head;
+    size_t tail;
+    uint32_t hash;
+} rtmp_amf_slot_t;
+
 typedef struct rtmp_msg_cb{
     rtmp_message_type_t type;
     rtmp_stream_msg_proc callback;
@@ -154,6 +214,21 @@ typedef struct rtmp_log_cb{
 } rtmp_log_cb_t;
 
 
+//Progress through an incoming aggregate message, which may arrive in more than one piece
+typedef struct rtmp_aggregate_in{
+    //The chunk stream carrying the aggregate, or 0 between aggregates
+    uint32_t chunk_stream_id;
+    byte header[RTMP_MESSAGE_HEADER_SIZE];
+    size_t header_len;
+    //Bytes left in the current sub-message, and in the back pointer which follows it
+    size_t body_left;
+    size_t trailer_left;
+    //Sub-message timestamps are taken relative to the first one
+    rtmp_time_t first;
+    bool started;
+    rtmp_chunk_stream_message_t sub;
+} rtmp_aggregate_in_t;
+
 struct rtmp_stream{
     rtmp_chunk_conn_t connection;
     rtmp_chunk_assembler_t assembler;
@@ -163,10 +238,27 @@ struct rtmp_stream{
     size_t scratch_len;
     uint32_t seq_num;
 
+    rtmp_aggregate_in_t aggregate_in;
+    //Messages queued for the next outgoing aggregate, already in FLV tag form
+    byte *aggregate_out;
+    size_t aggregate_len;
+    size_t aggregate_cap;
+    rtmp_time_t aggregate_time;
+    //Set while an aggregate has only been partly sent
+    bool aggregate_busy;
+
     rtmp_destroy_proc ondestroy;
     void * userdata;
 
+    //The manager currently servicing this stream, if any, and the stream's connection in its handle table
+    rtmp_t mgr;
+    handle_t handle;
+
     VEC_DECLARE(rtmp_amf_cb_t) amf_callback;
+    //Open addressing index over amf_callback, keyed by message type and name
+    rtmp_amf_slot_t *amf_index;
+    size_t amf_index_cap;
+    size_t amf_index_used;
 
     VEC_DECLARE(rtmp_msg_cb_t) msg_callback;
 
@@ -176,7 +268,14 @@ struct rtmp_stream{
 
     VEC_DECLARE(rtmp_log_cb_t) log_callback;
 
-    VEC_DECLARE(rtmp_call_cb_t) call_callback;
+    //Calls awaiting a result, open addressing by transaction ID
+    rtmp_call_cb_t *calls;
+    size_t calls_cap;
+    size_t calls_used;
+    //Every call issued before this ID has been answered or has expired
+    uint32_t calls_oldest;
+    //Expires the oldest pending call, on the timer wheel of mgr
+    timer_entry_t call_timer;
 };
 
 
@@ -187,35 +286,59 @@ typedef struct rtmp_mgr_svr{
         rtmp_server_t server;
         rtmp_client_t client;
     };
-    int flags;
     rtmp_t mgr;
+    //The connection's handle in the servers table of mgr
+    handle_t handle;
     bool closing;
+    //RTMP_POLL_* flags the connection is registered for
+    int flags;
+    //Edge-triggered connections remember what the last event said about the socket until a call would block,
+    //and are queued on their manager whenever there is work for them instead of changing their registration
+    bool edge;
+    bool readable, writable;
+    bool pending;
+    //The connection's io_uring state, or nullptr if its manager uses a readiness backend
+    struct rtmp_uring_conn *uring;
+    //Fires the refresh event while the stream has a callback for it, and closes, pings or trims the connection
+    //when the peer has gone quiet
+    timer_entry_t refresh, deadline;
+    //Set once the handshake is done
+    bool connected;
+    //The input byte count when the deadline timer last fired, and when it was last seen to change
+    size_t seen_in;
+    rtmp_time_t active_since;
 } *rtmp_mgr_svr_t;
 
+typedef struct rtmp_task{
+    rtmp_task_proc proc;
+    void *user;
+} rtmp_task_t;
+
+typedef struct rtmp_handoff{
+    rtmp_stream_t stream;
+    rtmp_t target;
+    rtmp_handoff_proc callback;
+    void *user;
+    rtmp_mgr_svr_t item;
+} rtmp_handoff_t;
+
+//Queue of tasks posted to a manager from other threads
+struct rtmp_mgr_inbox{
+    rtmp_t_t type;
+    int fd;
+    pthread_mutex_t lock;
+    VEC_DECLARE(rtmp_task_t) tasks;
+};
+
 struct rtmp_mgr {
     rtmp_t_t type;
-    VEC_DECLARE(rtmp_mgr_svr_t) servers;
-    rtmp_time_t last_refresh;
+    //Every connection, by handle
+    handle_table_t servers;
+    ringbuffer_budget_t io_budget;
 
-    union{
-        #if defined RTMP_POLLTECH_EPOLL
-        struct{
-            int epollfd;
-        } epoll_args;
-        #elif defined RTMP_POLLTECH_SELECT
-        struct{
-            fd_set rfds, wfds, efds;
-        } select_args;
-        #elif defined RTMP_POLLTECH_POLL
-        struct{
-
-        } poll_args;
-        #elif defined RTMP_POLLTECH_WSAPOLL
-        struct{
-
-        } wsapoll_args;
-        #endif
-    };
+    //The readiness backend, and its state for this manager
+    const struct rtmp_poller *poller;
+    void *poller_data;
     rtmp_err_t (*service_cb)( rtmp_t mgr );
 
     rtmp_sock_t listen_socket;
@@ -223,8 +346,131 @@ struct rtmp_mgr {
     void *callback_data;
 
     rtmp_app_list_t applist;
+
+    struct rtmp_mgr_inbox inbox;
+    VEC_DECLARE(rtmp_handoff_t*) handoffs;
+    bool servicing;
+    bool reuse_port;
+
+    //Edge-triggered connections waiting to be drained
+    VEC_DECLARE(rtmp_mgr_svr_t) pending;
+    bool edge_triggered;
+
+    //The manager's io_uring, or nullptr if it uses a readiness backend
+    struct rtmp_uring *uring;
+
+    //Connection deadlines and pending calls; the wait for events never outlasts the next of them
+    timer_wheel_t timers;
+    //In milliseconds, or 0 if disabled
+    rtmp_time_t handshake_timeout, ping_interval, idle_timeout;
+
+    //Connection objects are recycled through these instead of going back to malloc on every accept
+    slab_pool_t server_pool;
+    slab_pool_t item_pool;
+    //Closed servers which still hold their connection's memory, taken before the pool is used
+    VEC_DECLARE(rtmp_server_t) spare_servers;
+
+    //Only this manager's thread writes these, so other threads may read them at any time
+    rtmp_stats_t stats;
+    rtmp_histogram_t service_time;
 };
 
+//What a readiness backend waits for, and reports, on a socket
+#define RTMP_POLL_IN    0x01
+#define RTMP_POLL_OUT   0x02
+//Reported on errors and hangups whether or not it was asked for
+#define RTMP_POLL_ERR   0x04
+//Report readiness once per change instead of for as long as it lasts. Only honored by backends with edge set.
+#define RTMP_POLL_EDGE  0x08
+
+typedef struct rtmp_poll_event{
+    void *ptr;
+    int events;
+} rtmp_poll_event_t;
+
+//A mechanism a manager can wait for its sockets to become ready with. Each manager picks one at runtime.
+//The pointer passed to add is handed back with every event for that socket.
+typedef struct rtmp_poller{
+    rtmp_backend_t backend;
+    bool edge;
+    rtmp_err_t (*create)( rtmp_t mgr );
+    void (*destroy)( rtmp_t mgr );
+    rtmp_err_t (*add)( rtmp_t mgr, rtmp_sock_t sock, int flags, void *ptr );
+    rtmp_err_t (*modify)( rtmp_t mgr, rtmp_sock_t sock, int flags, void *ptr );
+    void (*remove)( rtmp_t mgr, rtmp_sock_t sock );
+    //Waits up to timeout milliseconds. Returns how many events were stored, or -1.
+    int (*wait)( rtmp_t mgr, rtmp_poll_event_t *events, size_t max, int timeout );
+} rtmp_poller_t;
+
+#ifdef RTMP_POLLTECH_EPOLL
+extern const rtmp_poller_t rtmp_poller_epoll;
+#endif
+#ifdef RTMP_POLLTECH_POLL
+extern const rtmp_poller_t rtmp_poller_poll;
+#endif
+#ifdef RTMP_POLLTECH_SELECT
+extern const rtmp_poller_t rtmp_poller_select;
+#endif
+
+//Shared by the manager and its backends
+rtmp_stream_t rtmp_mgr_item_stream( rtmp_mgr_svr_t item );
+//Creates a server connection for a socket that was just accepted, and passes it to the listen callback
+rtmp_err_t rtmp_mgr_accept( rtmp_t mgr, rtmp_sock_t sock );
+//Closes a connection and frees its item; always returns RTMP_ERR_CONNECTION_CLOSED
+rtmp_err_t rtmp_mgr_close( rtmp_t mgr, rtmp_mgr_svr_t item, const char *reason );
+//Queues a connection to be drained before the manager next waits
+void rtmp_mgr_queue( rtmp_t mgr, rtmp_mgr_svr_t item );
+//Starts firing the refresh event on a stream which has just been given a callback for it
+void rtmp_mgr_refresh( rtmp_t mgr, rtmp_stream_t stream );
+
+//Moves a stream's call timeouts onto a manager's timer wheel, or off of any wheel if mgr is nullptr
+void rtmp_stream_attach( rtmp_stream_t stream, rtmp_t mgr );
+//Puts a stream back in the state rtmp_stream_create_at leaves it in, like destroying it and creating it again at the
+//same location, except that the memory its connection and callbacks were using is kept for reuse
+void rtmp_stream_reset_at( rtmp_stream_t stream, bool client );
+//Whether any of the stream's event callbacks want the refresh event
+bool rtmp_stream_wants_refresh( rtmp_stream_t stream );
+//Passes a received message, or a piece of one, to a stream's callbacks. The stream's assembler calls this.
+rtmp_cb_status_t rtmp_stream_chunk_proc(
+    rtmp_chunk_conn_t conn,
+    const byte * restrict contents,
+    size_t available,
+    size_t remaining,
+    const rtmp_chunk_stream_message_t *msg,
+    void * restrict user
+);
+//Runs the tasks posted with rtmp_post
+rtmp_err_t rtmp_mgr_handle_inbox( rtmp_t mgr );
+
+#ifdef RTMP_POLLTECH_IO_URING
+//Sets up io_uring for a manager, or fails if the kernel lacks something it needs
+rtmp_err_t rtmp_uring_create( rtmp_t mgr );
+void rtmp_uring_destroy( rtmp_t mgr );
+//Starts accepting connections on the manager's listen socket
+rtmp_err_t rtmp_uring_listen( rtmp_t mgr );
+rtmp_err_t rtmp_uring_add( rtmp_t mgr, rtmp_mgr_svr_t item );
+//Stops a connection's I/O while its stream still exists. rtmp_uring_release then takes the place of slab_free,
+//and frees the item once no operation in flight refers to it.
+void rtmp_uring_remove( rtmp_t mgr, rtmp_mgr_svr_t item );
+void rtmp_uring_release( rtmp_t mgr, rtmp_mgr_svr_t item );
+//Prepares a connection to be handed off. Returns false until nothing in flight refers to it anymore,
+//after which the item no longer has any io_uring state.
+bool rtmp_uring_detach( rtmp_t mgr, rtmp_mgr_svr_t item );
+//Submits what was queued and waits up to timeout milliseconds for completions. Returns how many are ready, or -1.
+int rtmp_uring_wait( rtmp_t mgr, int timeout );
+rtmp_err_t rtmp_uring_dispatch( rtmp_t mgr );
+//Services a queued connection, starts a send if none is in flight, and arms the receive if there is room for input
+rtmp_err_t rtmp_uring_drain( rtmp_t mgr, rtmp_mgr_svr_t item, bool *more );
+#endif
+
+//Creates a pool of server connection objects, per_slab to a slab.
+slab_pool_t rtmp_server_pool_create( size_t per_slab );
+//Like rtmp_server_create, but takes its memory from pool. rtmp_server_destroy returns it there.
+rtmp_server_t rtmp_server_create_pooled( slab_pool_t pool );
+//Makes a closed server as good as new without freeing anything, so the next accepted connection can take it over
+//along with the buffers, caches and callback tables the last one grew
+void rtmp_server_recycle( rtmp_server_t server );
+
 #ifdef __cplusplus
 }
 #endif
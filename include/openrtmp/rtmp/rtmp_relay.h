@@ -0,0 +1,87 @@
+/*
+    rtmp_relay.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RTMP_H_RELAY_H
+#define RTMP_H_RELAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/rtmp/rtmp_app.h>
+#include <openrtmp/rtmp.h>
+
+//A published stream, shared between its publisher and any number of subscribers.
+//Media from the publisher is framed into chunks once per distinct subscriber chunk size and sent to every
+//subscriber by reference, so the per-viewer cost is a few bytes of bookkeeping rather than a copy.
+typedef struct rtmp_relay * rtmp_relay_t;
+
+//The relays belonging to one app, looked up by stream name. Safe to share between managers.
+typedef struct rtmp_relay_list * rtmp_relay_list_t;
+
+rtmp_relay_list_t rtmp_relay_list_create( void );
+void rtmp_relay_list_destroy( rtmp_relay_list_t list );
+
+//Sets the GOP cache limit for every relay in the list. See rtmp_app_set_gop_cache_size.
+void rtmp_relay_list_set_gop_limit( rtmp_relay_list_t list, size_t limit );
+
+//Copies the statistics of the relay called name. Returns false if there is no such relay.
+bool rtmp_relay_list_get_stats( rtmp_relay_list_t list, const char *name, rtmp_gop_stats_t *stats );
+
+//Fetches the relays belonging to an app
+rtmp_relay_list_t rtmp_app_relays( rtmp_app_t app );
+
+//Finds the relay called name, creating it if there isn't one, and adds a reference to it.
+//A new relay is bound to mgr; everyone who joins it must be moved to that manager first.
+//If publisher is set, the publisher slot is claimed as well, and nullptr is returned if it was already taken.
+rtmp_relay_t rtmp_relay_acquire( rtmp_relay_list_t list, const char *name, rtmp_t mgr, bool publisher );
+
+//Drops a reference from rtmp_relay_acquire, giving up the publisher slot if it was claimed with it.
+void rtmp_relay_release( rtmp_relay_t relay, bool publisher );
+
+//The manager which services every stream attached to the relay
+rtmp_t rtmp_relay_mgr( rtmp_relay_t relay );
+
+//The rest may only be called from the relay's manager.
+rtmp_err_t rtmp_relay_attach_publisher( rtmp_relay_t relay, rtmp_stream_t stream );
+void rtmp_relay_detach_publisher( rtmp_relay_t relay );
+
+//Adds a subscriber which receives everything on message stream msg_stream. It is sent the sequence headers and the
+//cached GOP right away if there is one, and otherwise starts at the next keyframe.
+rtmp_err_t rtmp_relay_attach( rtmp_relay_t relay, rtmp_stream_t stream, uint32_t msg_stream );
+void rtmp_relay_detach( rtmp_relay_t relay, rtmp_stream_t stream );
+size_t rtmp_relay_subscriber_count( rtmp_relay_t relay );
+
+//Feed an audio or video message from the publisher, possibly in fragments. remaining is the number of bytes still to come.
+//A call with no data and nothing remaining aborts the message being gathered.
+rtmp_err_t rtmp_relay_media( rtmp_relay_t relay, rtmp_message_type_t type, rtmp_time_t timestamp, const byte *data, size_t length, size_t remaining );
+
+//Replace the stream's metadata with an AMF0 onMetaData body, and pass it on to every subscriber
+rtmp_err_t rtmp_relay_metadata( rtmp_relay_t relay, const byte *data, size_t length );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+/*
+    rtmp_stats.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RTMP_H_STATS_H
+#define RTMP_H_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/rtmp/rtmp_constants.h>
+
+/*! \addtogroup rtmp_ref RTMP
+    @{ */
+/*! \addtogroup rtmp_stats Statistics
+    \remarks    \parblock
+                Every counter is written only by the thread which services the connection or manager it belongs to,
+                so keeping them up to date costs a plain add. Manager counters may be read from any thread; reading
+                them sums the counters of whichever managers are asked for.
+                \endparblock
+    @{ */
+
+//! \brief The number of entries in the per message type counters of an \ref rtmp_stats_t, indexed by \ref rtmp_message_type_t.
+#define RTMP_STATS_MSG_TYPES (RTMP_MSG_AGGREGATE + 1)
+
+//! \brief The number of buckets in an \ref rtmp_histogram_t.
+#define RTMP_HISTOGRAM_BUCKETS ((RTMP_HISTOGRAM_MAGNITUDE - RTMP_HISTOGRAM_PRECISION + 1) << RTMP_HISTOGRAM_PRECISION)
+
+/*! \brief      Counters for a connection, or for everything serviced by a manager.
+    \remarks    Messages whose type is outside of \ref rtmp_message_type_t are counted at index 0 of the per type counters.
+                All times are in nanoseconds.
+ */
+typedef struct rtmp_stats{
+    uint64_t connections;                           //!< The number of connections currently serviced.
+    uint64_t bytes_in;                              //!< The number of bytes received and processed.
+    uint64_t bytes_out;                             //!< The number of bytes queued for sending.
+    uint64_t queue_depth;                           //!< The number of bytes queued for sending which haven't been sent yet.
+    uint64_t chunks_in;                             //!< The number of chunks received.
+    uint64_t chunks_out;                            //!< The number of chunks queued for sending.
+    uint64_t messages_in[RTMP_STATS_MSG_TYPES];     //!< The number of complete messages received, by message type.
+    uint64_t messages_out[RTMP_STATS_MSG_TYPES];    //!< The number of messages queued for sending, by message type.
+    uint64_t handshakes;                            //!< The number of handshakes completed.
+    uint64_t handshake_time;                        //!< The total time spent between starting and completing those handshakes.
+    uint64_t callback_time;                         //!< The total time spent in chunk callbacks, which includes message handlers.
+    uint64_t paused_time;                           //!< The total time connections spent paused.
+    uint64_t syscalls;                              //!< The number of system calls made to wait for, send and receive data. Only managers count these.
+    uint64_t throttled;                             //!< The number of media messages refused because the peer hadn't acknowledged enough of what was already sent.
+} rtmp_stats_t;
+
+/*! \brief      A log-linear histogram, which records values with bounded relative error in a fixed amount of memory.
+    \remarks    Each power of two is split into 2^\ref RTMP_HISTOGRAM_PRECISION buckets.
+ */
+typedef struct rtmp_histogram{
+    uint64_t count;                                 //!< The number of values recorded.
+    uint64_t sum;                                   //!< The sum of the values recorded.
+    uint64_t max;                                   //!< The largest value recorded.
+    uint64_t buckets[RTMP_HISTOGRAM_BUCKETS];       //!< The number of values recorded in each bucket.
+} rtmp_histogram_t;
+
+/*! \brief      Records a value in a histogram.
+    \param      hist    The histogram.
+    \param      value   The value to record.
+    \noreturn
+    \remarks    Only one thread may record into a histogram, but any thread may read it while it does.
+ */
+void rtmp_histogram_record( rtmp_histogram_t *hist, uint64_t value );
+
+/*! \brief      Adds the contents of one histogram into another.
+    \param      dst     The histogram to add into.
+    \param      src     The histogram to add.
+    \noreturn
+ */
+void rtmp_histogram_merge( rtmp_histogram_t *dst, const rtmp_histogram_t *src );
+
+/*! \brief      Estimates a percentile of the values recorded in a histogram.
+    \param      hist        The histogram.
+    \param      percentile  The percentile to estimate, from 0 to 100.
+    \return     The largest value which falls in the same bucket as the requested percentile, or 0 if nothing was recorded.
+ */
+uint64_t rtmp_histogram_percentile( const rtmp_histogram_t *hist, double percentile );
+
+/*! \brief      Adds one set of counters into another.
+    \param      dst     The counters to add into.
+    \param      src     The counters to add.
+    \noreturn
+ */
+void rtmp_stats_merge( rtmp_stats_t *dst, const rtmp_stats_t *src );
+
+/*! @} */
+/*! @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -92,9 +92,12 @@ rtmp_err_t rtmp_stream_reg_event( rtmp_stream_t stream, rtmp_event_t type, rtmp_
 rtmp_err_t rtmp_stream_reg_log( rtmp_stream_t stream, rtmp_log_proc proc, void * restrict user );
 
 rtmp_chunk_conn_t rtmp_stream_get_conn( rtmp_stream_t stream );
+//Reports the counters of the stream's connection. Only call this from the thread servicing the stream.
+void rtmp_stream_get_stats( rtmp_stream_t stream, rtmp_stats_t *stats );
 
 
 
+//Sets the chunk stream used by the functions below. The default of 0 lets the connection pick one for each message stream and type.
 void rtmp_stream_set_chunk_stream(          rtmp_stream_t stream, size_t chunk_id );
 void rtmp_stream_set_msg_stream(            rtmp_stream_t stream, size_t msg_id );
 
@@ -104,6 +107,17 @@ rtmp_err_t rtmp_stream_send_cmd(            rtmp_stream_t stream, rtmp_time_t ti
 rtmp_err_t rtmp_stream_send_so(             rtmp_stream_t stream, rtmp_time_t timestamp, amf_t amf, size_t *written  );
 rtmp_err_t rtmp_stream_send_dat(            rtmp_stream_t stream, rtmp_time_t timestamp, amf_t amf, size_t *written  );
 
+//Like send_audio/send_video, but the payload is not copied; release is called once it has been sent.
+rtmp_err_t rtmp_stream_send_audio_ref(      rtmp_stream_t stream, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user );
+rtmp_err_t rtmp_stream_send_video_ref(      rtmp_stream_t stream, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user );
+
+//Batches small audio, video or data messages into a single aggregate message, so they share one chunk header.
+//queue_aggregate copies a message into the batch; send_aggregate sends the batch with the timestamp of its first message.
+//Nothing can be queued while a batch is only partly sent. aggregate_size is the number of bytes queued so far.
+rtmp_err_t rtmp_stream_queue_aggregate(     rtmp_stream_t stream, rtmp_message_type_t type, rtmp_time_t timestamp, const byte * restrict data, size_t len );
+rtmp_err_t rtmp_stream_send_aggregate(      rtmp_stream_t stream, size_t *written );
+size_t rtmp_stream_aggregate_size(          rtmp_stream_t stream );
+
 rtmp_err_t rtmp_stream_send_stream_begin(   rtmp_stream_t stream, uint32_t stream_id );
 rtmp_err_t rtmp_stream_send_stream_eof(     rtmp_stream_t stream, uint32_t stream_id );
 rtmp_err_t rtmp_stream_send_stream_dry(     rtmp_stream_t stream, uint32_t stream_id );
@@ -119,6 +133,9 @@ rtmp_err_t rtmp_stream_send_video2(         rtmp_stream_t stream, size_t chunk_i
 rtmp_err_t rtmp_stream_send_cmd2(           rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, amf_t amf, size_t *written  );
 rtmp_err_t rtmp_stream_send_so2(            rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, amf_t amf, size_t *written  );
 rtmp_err_t rtmp_stream_send_dat2(           rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, amf_t amf, size_t *written  );
+rtmp_err_t rtmp_stream_send_audio_ref2(     rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user );
+rtmp_err_t rtmp_stream_send_video_ref2(     rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user );
+rtmp_err_t rtmp_stream_send_aggregate2(     rtmp_stream_t stream, size_t chunk_id, size_t msg_id, size_t *written );
 
 rtmp_err_t rtmp_stream_call(                rtmp_stream_t stream, const char *name, rtmp_stream_amf_proc callback, void * userdata, ... );
 rtmp_err_t rtmp_stream_respond(             rtmp_stream_t stream, const char *name, double id, ... );
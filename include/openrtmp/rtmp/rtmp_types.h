@@ -67,13 +67,18 @@ typedef size_t rtmp_time_t;
     #include <winsock2.h>
     //! \brief A platform-agnostic way to refer to a socket.
     typedef SOCKET rtmp_sock_t;
+    //! \brief A platform-agnostic scatter/gather buffer descriptor.
+    typedef WSABUF rtmp_iovec_t;
 #else
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include <netinet/tcp.h>
     #include <netinet/in.h>
     #include <netdb.h>
     //! \brief A platform-agnostic way to refer to a socket.
     typedef int rtmp_sock_t;
+    //! \brief A platform-agnostic scatter/gather buffer descriptor.
+    typedef struct iovec rtmp_iovec_t;
 #endif
 
 /*! @} */
@@ -55,6 +55,14 @@ size_t alg_search_lin(
     less_than_proc less_than
 );
 
+//FNV-1a hash over a byte range. Chain calls by passing the previous result as the seed.
+#define ALG_HASH_SEED 2166136261u
+uint32_t alg_hash(
+    const void * restrict data,
+    size_t len,
+    uint32_t seed
+);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,63 @@
+/*
+    handletable.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RTMP_H_HANDLETABLE_H
+#define RTMP_H_HANDLETABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//A table of pointers addressed by generational handles. A handle holds a slot index and the generation the slot was
+//in when the handle was issued, so a handle to something which has been removed is recognized even once its slot is
+//reused. Adding, finding and removing are constant time, and the values are kept packed for iterating over them.
+typedef struct handle_table * handle_table_t;
+typedef uint64_t handle_t;
+
+//Never issued, so it can mark the absence of a handle
+#define HANDLE_NONE 0
+
+handle_table_t handle_table_create( void );
+void handle_table_destroy( handle_table_t table );
+
+//Returns HANDLE_NONE if no memory is available
+handle_t handle_table_add( handle_table_t table, void *value );
+//Returns nullptr if the handle's value has been removed
+void * handle_table_get( handle_table_t table, handle_t handle );
+//Moves the last value into the removed one's place. Returns false if the handle's value had already been removed.
+bool handle_table_remove( handle_table_t table, handle_t handle );
+
+//The values are at indices 0 through count - 1, in no particular order
+size_t handle_table_count( handle_table_t table );
+void * handle_table_at( handle_table_t table, size_t index );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
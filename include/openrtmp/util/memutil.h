@@ -31,6 +31,8 @@ extern "C" {
 
 #include <openrtmp/rtmp/rtmp_types.h>
 #include <openrtmp/rtmp/rtmp_constants.h>
+#include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 #include <type_traits>
@@ -40,41 +42,138 @@ extern "C" {
 #endif
 #define ALIAS(a,b,c) b c = (b)a;
 
+//The byte order helpers below sit on the per-chunk hot path, so they are inlined and
+//compile down to a load or store plus a single byte swap where the compiler allows it.
+#if defined __GNUC__ || defined __clang__
+#   define RTMP_BSWAP16(x) __builtin_bswap16(x)
+#   define RTMP_BSWAP32(x) __builtin_bswap32(x)
+#   define RTMP_BSWAP64(x) __builtin_bswap64(x)
+#else
+#   define RTMP_BSWAP16(x) ((uint16_t)( ((x) >> 8) | ((x) << 8) ))
+#   define RTMP_BSWAP32(x) ( ((x) >> 24) | (((x) >> 8) & 0xFF00) | (((x) << 8) & 0xFF0000) | ((x) << 24) )
+#   define RTMP_BSWAP64(x) ( ((uint64_t)RTMP_BSWAP32( (uint32_t)(x) ) << 32) | RTMP_BSWAP32( (uint32_t)((x) >> 32) ) )
+#endif
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#   define RTMP_NTOH16(x) RTMP_BSWAP16(x)
+#   define RTMP_NTOH32(x) RTMP_BSWAP32(x)
+#   define RTMP_NTOH64(x) RTMP_BSWAP64(x)
+#   define RTMP_LTOH32(x) (x)
+#elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#   define RTMP_NTOH16(x) (x)
+#   define RTMP_NTOH32(x) (x)
+#   define RTMP_NTOH64(x) (x)
+#   define RTMP_LTOH32(x) RTMP_BSWAP32(x)
+#else
+#   error "Intentionally unsupported"
+#endif
+
 //memcpy that will reverse byte order if the machine is little endian
-void ntoh_memcpy(void * restrict dst, const void * restrict src, size_t len);
+static inline void ntoh_memcpy(void * restrict dst, const void * restrict src, size_t len){
+    //Callers almost always pass a constant length, which folds this down to one of the fixed-width cases
+    if( len == 2 ){
+        uint16_t value;
+        memcpy( &value, src, 2 );
+        value = RTMP_NTOH16( value );
+        memcpy( dst, &value, 2 );
+    }
+    else if( len == 4 ){
+        uint32_t value;
+        memcpy( &value, src, 4 );
+        value = RTMP_NTOH32( value );
+        memcpy( dst, &value, 4 );
+    }
+    else if( len == 8 ){
+        uint64_t value;
+        memcpy( &value, src, 8 );
+        value = RTMP_NTOH64( value );
+        memcpy( dst, &value, 8 );
+    }
+    else{
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        byte *output = dst;
+        const byte *input = src;
+        while( len --> 0 ){
+            *(output++) = input[len];
+        }
+    #else
+        memcpy( dst, src, len );
+    #endif
+    }
+}
 
-//Read a short from a buffer based on endianess
-short ntoh_read_s(const void *src);
+//Read an unsigned short from a buffer based on endianess
+static inline uint16_t ntoh_read_us(const void *src){
+    uint16_t value;
+    memcpy( &value, src, sizeof( value ) );
+    return RTMP_NTOH16( value );
+}
 
-//Read an int from a buffer based on endianess
-int ntoh_read_d(const void *src);
+//Read an unsigned int from a buffer based on endianess
+static inline uint32_t ntoh_read_ud(const void *src){
+    uint32_t value;
+    memcpy( &value, src, sizeof( value ) );
+    return RTMP_NTOH32( value );
+}
 
 //Read a short from a buffer based on endianess
-uint16_t ntoh_read_us(const void *src);
+static inline short ntoh_read_s(const void *src){
+    return (short) ntoh_read_us( src );
+}
 
 //Read an int from a buffer based on endianess
-uint32_t ntoh_read_ud(const void *src);
+static inline int ntoh_read_d(const void *src){
+    return (int) ntoh_read_ud( src );
+}
 
-//Write a short to a buffer based on endianess
-void ntoh_write_s(void *dst, short value);
+//Write an unsigned short to a buffer based on endianess
+static inline void ntoh_write_us(void *dst, uint16_t value){
+    value = RTMP_NTOH16( value );
+    memcpy( dst, &value, sizeof( value ) );
+}
 
-//Write an int to a buffer based on endianess
-void ntoh_write_d(void *dst, int value);
+//Write an unsigned int to a buffer based on endianess
+static inline void ntoh_write_ud(void *dst, uint32_t value){
+    value = RTMP_NTOH32( value );
+    memcpy( dst, &value, sizeof( value ) );
+}
 
 //Write a short to a buffer based on endianess
-void ntoh_write_us(void *dst, uint16_t value);
+static inline void ntoh_write_s(void *dst, short value){
+    ntoh_write_us( dst, (uint16_t) value );
+}
 
 //Write an int to a buffer based on endianess
-void ntoh_write_ud(void *dst, uint32_t value);
+static inline void ntoh_write_d(void *dst, int value){
+    ntoh_write_ud( dst, (uint32_t) value );
+}
 
-void htol_write_ud(void *dst, uint32_t value);
-uint32_t ltoh_read_ud(void *src);
+//Write an int to a buffer in little endian order, as used by message stream IDs
+static inline void htol_write_ud(void *dst, uint32_t value){
+    value = RTMP_LTOH32( value );
+    memcpy( dst, &value, sizeof( value ) );
+}
 
+//Read a little endian int from a buffer
+static inline uint32_t ltoh_read_ud(const void *src){
+    uint32_t value;
+    memcpy( &value, src, sizeof( value ) );
+    return RTMP_LTOH32( value );
+}
 
 //Write a 3 byte int to a buffer based on endianess
-void ntoh_write_ud3(void *dst, uint32_t value);
+static inline void ntoh_write_ud3(void *dst, uint32_t value){
+    byte *dstb = dst;
+    dstb[0] = (value >> 16) & 255;
+    dstb[1] = (value >> 8) & 255;
+    dstb[2] = value & 255;
+}
+
 //Read a 3 byte int from a buffer based on endianess
-uint32_t ntoh_read_ud3(void *dst);
+static inline uint32_t ntoh_read_ud3(const void *src){
+    const byte *srcb = src;
+    return ((uint32_t)srcb[0] << 16) | ((uint32_t)srcb[1] << 8) | srcb[2];
+}
 
 //strlen which considers nullptr to be a zero-length string.
 size_t strlen_check( const char *str );
@@ -92,6 +191,8 @@ rtmp_err_t rtmp_nonce_alloc(void **nonce, size_t length);
 rtmp_err_t rtmp_nonce_del(void **nonce);
 
 rtmp_time_t rtmp_get_time();
+//A nanosecond timestamp for measuring short durations
+uint64_t rtmp_get_time_ns( void );
 
 typedef enum {
     si_yotta = 24,
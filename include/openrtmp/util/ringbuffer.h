@@ -24,6 +24,8 @@
 #ifndef RTMP_H_RINGBUFFER_H
 #define RTMP_H_RINGBUFFER_H
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +33,12 @@ extern "C" {
 
 typedef struct ringbuffer * ringbuffer_t;
 
+//Shared accounting for the capacity of a group of ringbuffers.
+typedef struct ringbuffer_budget{
+    unsigned long used;     //Total capacity currently allocated by the buffers in the group
+    unsigned long limit;    //Maximum total capacity the group may grow to. Zero means unlimited.
+} ringbuffer_budget_t;
+
 ringbuffer_t ringbuffer_create( unsigned long size);
 void ringbuffer_destroy( ringbuffer_t buffer );
 
@@ -46,6 +54,10 @@ void* ringbuffer_get_write_buf( ringbuffer_t buffer, unsigned long *size );
 //unread content held in the buffer.
 const void* ringbuffer_get_read_buf( ringbuffer_t buffer, unsigned long *size );
 
+//Like ringbuffer_get_read_buf, but starts skip bytes past the read position without consuming anything.
+//Returns nullptr with a size of 0 if skip reaches the end of the unread content.
+const void* ringbuffer_peek_read( ringbuffer_t buffer, unsigned long skip, unsigned long *size );
+
 //Commits a write to the buffer and returns how many bytes were actually committed.
 //Len specifies how many bytes were written by the caller.
 unsigned long ringbuffer_commit_write( ringbuffer_t buffer, unsigned long len );
@@ -63,12 +75,34 @@ void ringbuffer_shrink( ringbuffer_t buffer, unsigned long amount );
 //Changes the capacity of the buffer. This might trim data from the start of the buffer.
 void ringbuffer_resize( ringbuffer_t buffer, unsigned long amount );
 
+//Grows the buffer until at least amount bytes are free for writing, without exceeding
+//the limit of the buffer or the budget it draws from. Returns the free space afterwards,
+//which may be less than amount if either ceiling was reached.
+unsigned long ringbuffer_reserve( ringbuffer_t buffer, unsigned long amount );
+
+//Shrinks the capacity of the buffer towards floor while the content would still leave
+//the buffer at most half full. Frozen buffers are left alone.
+void ringbuffer_compact( ringbuffer_t buffer, unsigned long floor );
+
+//Keeps the content where it is while something outside the program, like an asynchronous send, still refers to it.
+//A pinned buffer never reallocates: resizing, compacting and reserving leave the capacity as it is.
+void ringbuffer_pin( ringbuffer_t buffer, bool pinned );
+
+//Sets the maximum capacity ringbuffer_reserve may grow the buffer to. Zero means unlimited.
+void ringbuffer_set_limit( ringbuffer_t buffer, unsigned long limit );
+
+//Charges the capacity of the buffer against budget. Pass nullptr to detach the buffer.
+void ringbuffer_set_budget( ringbuffer_t buffer, ringbuffer_budget_t *budget );
+
 //Returns the total capacity of the buffer.
 unsigned long ringbuffer_size( ringbuffer_t buffer );
 
 //Returns how many bytes are available for reading in the buffer.
 unsigned long ringbuffer_count( ringbuffer_t buffer );
 
+//Returns how many bytes may be written before the buffer is full.
+unsigned long ringbuffer_space( ringbuffer_t buffer );
+
 //Prepare the buffer for rolling back a series of read operations.
 void ringbuffer_freeze_read( ringbuffer_t buffer );
 
@@ -0,0 +1,64 @@
+/*
+    slab.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RTMP_H_SLAB_H
+#define RTMP_H_SLAB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stddef.h>
+
+//A pool of fixed-size objects, carved out of larger slabs and recycled when freed.
+//Objects may be freed from any thread, and the pool itself is only released once
+//it has been destroyed and every object it handed out has been returned.
+typedef struct slab_pool * slab_pool_t;
+
+typedef struct slab_stats{
+    size_t object_size; //Usable size of each object
+    size_t slabs;       //Number of slabs allocated from the system
+    size_t live;        //Objects currently handed out
+    size_t cached;      //Objects waiting on the free list to be reused
+    size_t peak;        //Highest value live has reached
+    size_t allocs;      //Total objects handed out
+    size_t reuses;      //How many of those were recycled rather than freshly carved
+} slab_stats_t;
+
+//Each slab holds per_slab objects of object_size bytes.
+slab_pool_t slab_pool_create( size_t object_size, size_t per_slab );
+void slab_pool_destroy( slab_pool_t pool );
+
+//Returns a zeroed object, or nullptr if no memory is available.
+void * slab_alloc( slab_pool_t pool );
+//Returns an object to the pool it came from.
+void slab_free( void * object );
+
+void slab_pool_stats( slab_pool_t pool, slab_stats_t *stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
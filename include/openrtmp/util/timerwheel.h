@@ -0,0 +1,83 @@
+/*
+    timerwheel.h
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef RTMP_H_TIMERWHEEL_H
+#define RTMP_H_TIMERWHEEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//A hierarchical timer wheel. Timers are embedded in the objects they belong to, so scheduling one never allocates,
+//and advancing the wheel only touches the timers which are due, and those moving down to a finer level on the way.
+//Times are in milliseconds, on whichever clock the caller advances the wheel with.
+//A wheel and its timers belong to a single thread.
+typedef struct timer_wheel * timer_wheel_t;
+typedef struct timer_entry timer_entry_t;
+
+//Called when a timer is due. The timer is no longer scheduled, so the callback is free to schedule it again.
+typedef void (*timer_proc)( timer_entry_t *timer, void *user );
+
+typedef struct timer_link{
+    struct timer_link *next, *prev;
+} timer_link_t;
+
+struct timer_entry{
+    timer_link_t link;
+    uint64_t deadline;
+    timer_proc proc;
+    void *user;
+    //Where the timer is filed in its wheel
+    uint8_t level, slot;
+};
+
+timer_wheel_t timer_wheel_create( uint64_t now );
+//Timers still scheduled are simply forgotten
+void timer_wheel_destroy( timer_wheel_t wheel );
+
+//Prepares a timer which isn't scheduled
+void timer_init( timer_entry_t *timer, timer_proc proc, void *user );
+bool timer_scheduled( const timer_entry_t *timer );
+
+//Schedules a timer, moving it if it was scheduled already. A deadline which has passed is due the next time the wheel
+//is advanced.
+void timer_wheel_schedule( timer_wheel_t wheel, timer_entry_t *timer, uint64_t deadline );
+void timer_wheel_cancel( timer_wheel_t wheel, timer_entry_t *timer );
+
+//Runs the callback of every timer due by now. Returns how many ran.
+size_t timer_wheel_advance( timer_wheel_t wheel, uint64_t now );
+//Returns the milliseconds until the wheel next has to be advanced, which may be early for timers far in the future.
+//Returns 0 if a timer is due already, or -1 if none are scheduled.
+int64_t timer_wheel_next( timer_wheel_t wheel, uint64_t now );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,265 @@
+/*
+    amf0_index.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include <openrtmp/util/memutil.h>
+#include <openrtmp/amf/amf.h>
+
+
+//Everything in here works directly on the serialized bytes and never allocates.
+
+static amf_err_t amf0_skip_internal( const byte* data, size_t data_len, size_t depth );
+
+//Returns the size of the header in front of the members of an associative value,
+//which is different for objects, ECMA arrays and typed objects.
+static amf_err_t amf0_member_header( const byte* data, size_t data_len ){
+    if( data_len < 1 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    switch( data[0] ){
+        case AMF0_TYPE_OBJECT:
+            return AMF_SIZE(1);
+        case AMF0_TYPE_ECMA_ARRAY:
+            if( data_len < 5 ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            return AMF_SIZE(5);
+        case AMF0_TYPE_TYPED_OBJECT:
+            if( data_len < 3 ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            if( data_len - 3 < ntoh_read_us( data + 1 ) ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            return AMF_SIZE(3 + ntoh_read_us( data + 1 ));
+        default:
+            return AMF_ERR_INVALID_DATA;
+    }
+}
+
+//Walks a member list up to and including the object end marker.
+//If key is set, stops at the first member with that name and reports its value instead.
+static amf_err_t amf0_walk_members( const byte* data, size_t data_len, size_t depth, const void *key, size_t key_len, amf0_view_t *value ){
+    size_t offset = 0;
+    while( true ){
+        if( data_len - offset < 2 ){
+            return AMF_ERR_INCOMPLETE;
+        }
+        size_t name_len = ntoh_read_us( data + offset );
+        offset += 2;
+        if( name_len == 0 && data_len - offset >= 1 && data[offset] == AMF0_TYPE_OBJECT_END ){
+            return key ? AMF_ERR_NOT_FOUND : AMF_SIZE(offset + 1);
+        }
+        if( data_len - offset < name_len ){
+            return AMF_ERR_INCOMPLETE;
+        }
+        const byte *name = data + offset;
+        offset += name_len;
+        amf_err_t ret = amf0_skip_internal( data + offset, data_len - offset, depth );
+        if( ret < 0 ){
+            return ret;
+        }
+        if( key && name_len == key_len && memcmp( name, key, key_len ) == 0 ){
+            value->data = data + offset;
+            value->length = ret;
+            return AMF_ERR_NONE;
+        }
+        offset += ret;
+    }
+}
+
+static amf_err_t amf0_skip_internal( const byte* data, size_t data_len, size_t depth ){
+    amf_err_t ret;
+    size_t length;
+    if( data_len < 1 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    switch( data[0] ){
+        case AMF0_TYPE_NUMBER:
+            length = 9;
+            break;
+        case AMF0_TYPE_BOOLEAN:
+            length = 2;
+            break;
+        case AMF0_TYPE_NULL:
+        case AMF0_TYPE_UNDEFINED:
+        case AMF0_TYPE_UNSUPPORTED:
+            length = 1;
+            break;
+        case AMF0_TYPE_REFERENCE:
+            length = 3;
+            break;
+        case AMF0_TYPE_DATE:
+            length = 11;
+            break;
+        case AMF0_TYPE_STRING:
+            if( data_len < 3 ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            length = 3 + ntoh_read_us( data + 1 );
+            break;
+        case AMF0_TYPE_LONG_STRING:
+        case AMF0_TYPE_XML_DOCUMENT:
+            if( data_len < 5 ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            length = ntoh_read_ud( data + 1 );
+            if( data_len - 5 < length ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            length += 5;
+            break;
+        case AMF0_TYPE_OBJECT:
+        case AMF0_TYPE_ECMA_ARRAY:
+        case AMF0_TYPE_TYPED_OBJECT:
+            if( depth >= AMF0_MAX_DEPTH ){
+                return AMF_ERR_INVALID_DATA;
+            }
+            ret = amf0_member_header( data, data_len );
+            if( ret < 0 ){
+                return ret;
+            }
+            length = ret;
+            ret = amf0_walk_members( data + length, data_len - length, depth + 1, nullptr, 0, nullptr );
+            if( ret < 0 ){
+                return ret;
+            }
+            length += ret;
+            break;
+        case AMF0_TYPE_STRICT_ARRAY:
+            if( depth >= AMF0_MAX_DEPTH ){
+                return AMF_ERR_INVALID_DATA;
+            }
+            if( data_len < 5 ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            length = 5;
+            for( uint32_t count = ntoh_read_ud( data + 1 ); count > 0; --count ){
+                ret = amf0_skip_internal( data + length, data_len - length, depth + 1 );
+                if( ret < 0 ){
+                    return ret;
+                }
+                length += ret;
+            }
+            break;
+        default:
+            //Movie clips, record sets, stray object ends and AVM+ values can't be skipped over
+            return AMF_ERR_INVALID_DATA;
+    }
+    if( data_len < length ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    return AMF_SIZE(length);
+}
+
+//Returns the serialized size of the value at the start of data, including any nested values.
+amf_err_t amf0_skip( const byte* data, size_t data_len ){
+    return amf0_skip_internal( data, data_len, 0 );
+}
+
+//Scans the offsets of the top level values.
+//Stops quietly after AMF0_INDEX_MAX values; the rest of the message is left unverified.
+amf_err_t amf0_index_create( amf0_index_t *index, const byte* data, size_t data_len ){
+    size_t offset = 0;
+    index->data = data;
+    index->length = data_len;
+    index->count = 0;
+    while( offset < data_len && index->count < AMF0_INDEX_MAX ){
+        amf_err_t ret = amf0_skip( data + offset, data_len - offset );
+        if( ret < 0 ){
+            return ret;
+        }
+        index->offsets[index->count++] = offset;
+        offset += ret;
+    }
+    index->offsets[index->count] = offset;
+    return AMF_SIZE(index->count);
+}
+
+amf_err_t amf0_index_get( const amf0_index_t *index, size_t item, amf0_view_t *value ){
+    if( item >= index->count ){
+        return AMF_ERR_NOT_FOUND;
+    }
+    value->data = index->data + index->offsets[item];
+    value->length = index->offsets[item + 1] - index->offsets[item];
+    return AMF_ERR_NONE;
+}
+
+amf_err_t amf0_view_get_member( const amf0_view_t *object, const void *key, size_t key_len, amf0_view_t *value ){
+    amf_err_t ret = amf0_member_header( object->data, object->length );
+    if( ret < 0 ){
+        return ret;
+    }
+    return amf0_walk_members( object->data + ret, object->length - ret, 0, key, key_len, value );
+}
+
+amf_err_t amf0_index_query( const amf0_index_t *index, amf0_view_t *value, size_t item, ... ){
+    va_list list;
+    const char *key;
+    amf0_view_t current;
+    amf_err_t ret = amf0_index_get( index, item, &current );
+
+    va_start( list, item );
+    while( ret >= 0 && ( key = va_arg( list, const char* ) ) != nullptr ){
+        ret = amf0_view_get_member( &current, key, strlen( key ), &current );
+    }
+    va_end( list );
+
+    if( ret >= 0 ){
+        *value = current;
+    }
+    return ret;
+}
+
+amf0_type_t amf0_view_type( const amf0_view_t *value ){
+    return amf0_next_type( value->data, value->length );
+}
+
+//Strings are not copied, so they are not NUL terminated.
+amf_err_t amf0_view_get_string( const amf0_view_t *value, const char **str, size_t *length ){
+    size_t header;
+    switch( amf0_view_type( value ) ){
+        case AMF0_TYPE_STRING:
+            header = 3;
+            break;
+        case AMF0_TYPE_LONG_STRING:
+        case AMF0_TYPE_XML_DOCUMENT:
+            header = 5;
+            break;
+        default:
+            return AMF_ERR_INVALID_DATA;
+    }
+    //Views come from amf0_skip, so the header and body are known to be present
+    *str = (const char*) value->data + header;
+    *length = value->length - header;
+    return AMF_ERR_NONE;
+}
+
+amf_err_t amf0_view_get_number( const amf0_view_t *value, double *number ){
+    return amf0_get_number( value->data, value->length, number );
+}
+
+amf_err_t amf0_view_get_boolean( const amf0_view_t *value, int *boolean ){
+    return amf0_get_boolean( value->data, value->length, boolean );
+}
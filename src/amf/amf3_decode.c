@@ -0,0 +1,121 @@
+/*
+    amf3_decode.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <openrtmp/util/memutil.h>
+#include <openrtmp/amf/amf.h>
+#include <openrtmp/util/ieee754_double.h>
+
+
+//Return the type of the next item in the message
+amf3_type_t amf3_next_type( const byte* data, size_t data_len ){
+    if( data_len < 1 ){
+        return AMF3_TYPE_NONE;
+    }
+    if( data[0] <= AMF3_TYPE_DICTIONARY ){
+        return data[0];
+    }
+    return AMF3_TYPE_NONE;
+}
+
+//Variable length unsigned 29 bit integer; the first three bytes carry 7 bits each,
+//and the fourth carries a full 8 bits.
+amf_err_t amf3_get_u29( const byte* data, size_t data_len, uint32_t *value ){
+    uint32_t result = 0;
+    for( size_t i = 0; i < 3; ++i ){
+        if( i >= data_len ){
+            return AMF_ERR_INCOMPLETE;
+        }
+        result = (result << 7) | (data[i] & 0x7F);
+        if( (data[i] & 0x80) == 0 ){
+            *value = result;
+            return AMF_SIZE(i + 1);
+        }
+    }
+    if( data_len < 4 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    *value = (result << 8) | data[3];
+    return AMF_SIZE(4);
+}
+
+//Reads the U29 header shared by strings and every type that goes in the object table.
+//The low bit is clear for references, in which case *value is the table index,
+//otherwise *value holds the remaining 28 bits (usually a length).
+amf_err_t amf3_get_u29_ref( const byte* data, size_t data_len, uint32_t *value, bool *reference ){
+    uint32_t temp;
+    amf_err_t ret = amf3_get_u29( data, data_len, &temp );
+    if( ret < 0 ){
+        return ret;
+    }
+    *reference = (temp & 1) == 0;
+    *value = temp >> 1;
+    return ret;
+}
+
+//Integers are stored as 29 bit two's complement values
+amf_err_t amf3_get_integer( const byte* data, size_t data_len, int32_t *value ){
+    uint32_t temp;
+    if( data_len < 1 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    if( data[0] != AMF3_TYPE_INTEGER ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    amf_err_t ret = amf3_get_u29( data + 1, data_len - 1, &temp );
+    if( ret < 0 ){
+        return ret;
+    }
+    if( temp & 0x10000000 ){
+        temp |= 0xE0000000;
+    }
+    *value = (int32_t) temp;
+    return AMF_SIZE(ret + 1);
+}
+
+//Returns an IEEE 754 float from the data
+amf_err_t amf3_get_double( const byte* data, size_t data_len, double *value ){
+    byte flipped[8];
+    if( data_len < 9 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    if( data[0] != AMF3_TYPE_DOUBLE ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    ntoh_memcpy( flipped, data + 1, 8 );
+    *value = read_double_ieee( flipped );
+    return AMF_SIZE(9);
+}
+
+//Dates are a U29D header followed by a double holding milliseconds since the epoch.
+//Only call this after the header has been found not to be a reference.
+amf_err_t amf3_get_date_value( const byte* data, size_t data_len, double *timestamp ){
+    byte flipped[8];
+    if( data_len < 8 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    ntoh_memcpy( flipped, data, 8 );
+    *timestamp = read_double_ieee( flipped );
+    return AMF_SIZE(8);
+}
@@ -0,0 +1,173 @@
+/*
+    amf3_encode.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <openrtmp/util/memutil.h>
+#include <openrtmp/amf/amf.h>
+#include <openrtmp/util/ieee754_double.h>
+
+
+//All of these follow the AMF0 convention: a null destination returns the encoded size.
+
+amf_err_t amf3_write_u29( byte* data, size_t data_len, uint32_t value ){
+    size_t len;
+    if( value < 0x80 ){
+        len = 1;
+    }
+    else if( value < 0x4000 ){
+        len = 2;
+    }
+    else if( value < 0x200000 ){
+        len = 3;
+    }
+    else if( value < 0x20000000 ){
+        len = 4;
+    }
+    else{
+        return AMF_ERR_INVALID_DATA;
+    }
+    if( data == nullptr ){
+        return AMF_SIZE(len);
+    }
+    if( data_len < len ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    switch( len ){
+        case 4:
+            data[0] = ((value >> 22) & 0x7F) | 0x80;
+            data[1] = ((value >> 15) & 0x7F) | 0x80;
+            data[2] = ((value >> 8) & 0x7F) | 0x80;
+            data[3] = value & 0xFF;
+            break;
+        case 3:
+            data[0] = ((value >> 14) & 0x7F) | 0x80;
+            data[1] = ((value >> 7) & 0x7F) | 0x80;
+            data[2] = value & 0x7F;
+            break;
+        case 2:
+            data[0] = ((value >> 7) & 0x7F) | 0x80;
+            data[1] = value & 0x7F;
+            break;
+        default:
+            data[0] = value;
+            break;
+    }
+    return AMF_SIZE(len);
+}
+
+//Writes a single marker byte for the types which have no payload
+amf_err_t amf3_write_marker( byte* data, size_t data_len, amf3_type_t type ){
+    if( data == nullptr ){
+        return AMF_SIZE(1);
+    }
+    if( data_len < 1 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    data[0] = type;
+    return AMF_SIZE(1);
+}
+
+amf_err_t amf3_write_undefined( byte* data, size_t data_len ){
+    return amf3_write_marker( data, data_len, AMF3_TYPE_UNDEFINED );
+}
+
+amf_err_t amf3_write_null( byte* data, size_t data_len ){
+    return amf3_write_marker( data, data_len, AMF3_TYPE_NULL );
+}
+
+amf_err_t amf3_write_boolean( byte* data, size_t data_len, int value ){
+    return amf3_write_marker( data, data_len, value ? AMF3_TYPE_TRUE : AMF3_TYPE_FALSE );
+}
+
+//Values outside of the 29 bit range have to be sent as doubles instead.
+amf_err_t amf3_write_integer( byte* data, size_t data_len, int32_t value ){
+    if( value < -0x10000000 || value > 0x0FFFFFFF ){
+        return amf3_write_double( data, data_len, value );
+    }
+    amf_err_t ret = amf3_write_u29( data ? data + 1 : nullptr, data_len ? data_len - 1 : 0, ((uint32_t)value) & 0x1FFFFFFF );
+    if( ret < 0 ){
+        return ret;
+    }
+    if( data ){
+        data[0] = AMF3_TYPE_INTEGER;
+    }
+    return AMF_SIZE(ret + 1);
+}
+
+amf_err_t amf3_write_double( byte* data, size_t data_len, double value ){
+    byte flipped[8];
+    if( data == nullptr ){
+        return AMF_SIZE(9);
+    }
+    if( data_len < 9 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    data[0] = AMF3_TYPE_DOUBLE;
+    write_double_ieee( flipped, value );
+    ntoh_memcpy( data + 1, flipped, 8 );
+    return AMF_SIZE(9);
+}
+
+//Writes the U29 reference header used by strings and the object table types
+amf_err_t amf3_write_ref( byte* data, size_t data_len, uint32_t index ){
+    if( index >= 0x10000000 ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    return amf3_write_u29( data, data_len, index << 1 );
+}
+
+//Writes an inline U29 length header followed by the raw bytes.
+//Used for string bodies, member names, XML and byte arrays; the caller writes any marker.
+amf_err_t amf3_write_bytes( byte* data, size_t data_len, const void *value, size_t value_len ){
+    if( value_len >= 0x10000000 ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    amf_err_t ret = amf3_write_u29( data, data_len, (value_len << 1) | 1 );
+    if( ret < 0 ){
+        return ret;
+    }
+    if( data == nullptr ){
+        return AMF_SIZE(ret + value_len);
+    }
+    if( data_len - ret < value_len ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    memcpy( data + ret, value, value_len );
+    return AMF_SIZE(ret + value_len);
+}
+
+amf_err_t amf3_write_date_value( byte* data, size_t data_len, double timestamp ){
+    byte flipped[8];
+    if( data == nullptr ){
+        return AMF_SIZE(9);
+    }
+    if( data_len < 9 ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    //Inline date; the remaining header bits are unused
+    data[0] = 0x01;
+    write_double_ieee( flipped, timestamp );
+    ntoh_memcpy( data + 1, flipped, 8 );
+    return AMF_SIZE(9);
+}
@@ -27,6 +27,7 @@
 #include <openrtmp/util/vec.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 
 
 typedef struct amf_v_dbl{
@@ -114,8 +115,60 @@ struct amf_v_member{
     union amf_value value;
 };
 
+//Reference tables used while an AMF3 value is read or written.
+//They only live as long as a single AVM+ value, so they get reset before each one.
+typedef struct amf3_slice{
+    const byte *data;
+    size_t length;
+} amf3_slice_t;
+
+typedef struct amf3_trait{
+    bool dynamic;
+    size_t sealed;
+    size_t names;
+} amf3_trait_t;
+
+typedef struct amf3_entry{
+    amf3_type_t type;
+    //Index into the amf_t reference table for objects and arrays
+    size_t ref;
+    //Payload of dates, XML and byte arrays, so that references can be copied
+    amf3_slice_t bytes;
+    double timestamp;
+    //The value which was written, when encoding
+    amf_value_t value;
+} amf3_entry_t;
+
+typedef struct amf3_tables{
+    amf_t amf;
+    VEC_DECLARE(amf3_slice_t) strings;
+    VEC_DECLARE(amf3_entry_t) objects;
+    VEC_DECLARE(amf3_trait_t) traits;
+    VEC_DECLARE(amf3_slice_t) names;
+    //Open addressed index of the string table for encoding; slots hold table index + 1
+    uint32_t *string_hash;
+    size_t string_hash_cap;
+    bool string_hash_used;
+    //Trait index of the anonymous dynamic trait when encoding, SIZE_MAX if not yet sent
+    size_t anon_trait;
+    size_t depth;
+} amf3_tables_t;
+
+//Arena blocks are chained newest first. The block an arena AMF object was created with holds the
+//object itself, so it is always the last one in the chain.
+typedef struct amf_arena_block amf_arena_block_t;
+struct amf_arena_block{
+    amf_arena_block_t *next;
+    size_t used;
+    size_t size;
+    //Keeps the data 16 byte aligned
+    size_t reserved;
+    byte data[];
+};
+
 struct amf_object{
     amf_type_t type;
+    char version;
     size_t references;
     size_t depth;
     VEC_DECLARE(union amf_value) items;
@@ -126,8 +179,91 @@ struct amf_object{
     size_t allocation_len;
 
     bool member_ready;
+
+    amf3_tables_t *amf3;
+
+    //When set, everything belonging to this object is allocated from the arena,
+    //and nothing is freed until the object is destroyed.
+    amf_arena_block_t *arena;
+    //Strings point into the source buffer instead of being copied
+    bool borrow;
 };
 
+#define AMF_ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+static void * amf_arena_alloc( amf_t amf, size_t size ){
+    amf_arena_block_t *block = amf->arena;
+    //Guards the rounding and the block header against wrapping on absurd sizes
+    if( size > SIZE_MAX / 2 ){
+        return nullptr;
+    }
+    size = AMF_ARENA_ALIGN( size );
+    if( block->size - block->used < size ){
+        size_t grow = block->size > size ? block->size : size;
+        block = malloc( sizeof( amf_arena_block_t ) + grow );
+        if( !block ){
+            return nullptr;
+        }
+        block->size = grow;
+        block->used = 0;
+        block->next = amf->arena;
+        amf->arena = block;
+    }
+    void *ret = block->data + block->used;
+    block->used += size;
+    return ret;
+}
+
+static void * amf_alloc( amf_t amf, size_t size ){
+    if( amf->arena ){
+        return amf_arena_alloc( amf, size );
+    }
+    return malloc( size );
+}
+
+static void amf_release( amf_t amf, void *ptr ){
+    if( !amf->arena ){
+        free( ptr );
+    }
+}
+
+//Arena vectors keep the VEC layout so that they can be read with the usual macros,
+//but they grow by moving into fresh arena space instead of being reallocated.
+static void * amf_arena_vec_create( amf_t amf, size_t elem_size ){
+    size_t *header = amf_arena_alloc( amf, sizeof( size_t ) * 2 + elem_size * 4 );
+    if( !header ){
+        return nullptr;
+    }
+    header[0] = 0;
+    header[1] = 4;
+    return header + 2;
+}
+
+static void * amf_arena_vec_push( amf_t amf, void **vec, size_t elem_size ){
+    size_t *header = VEC_PRIV_PTR( *vec );
+    if( header[0] >= header[1] ){
+        size_t reserve = header[1] * 2;
+        size_t *grown = amf_arena_alloc( amf, sizeof( size_t ) * 2 + elem_size * reserve );
+        if( !grown ){
+            return nullptr;
+        }
+        memcpy( grown + 2, *vec, elem_size * header[0] );
+        grown[0] = header[0];
+        grown[1] = reserve;
+        *vec = grown + 2;
+        header = grown;
+    }
+    return (byte*) *vec + elem_size * header[0]++;
+}
+
+#define AMF_VEC_INIT(amf, vec) ((amf)->arena ? (void)((vec) = amf_arena_vec_create( (amf), sizeof( *(vec) ) )) : (void)VEC_INIT(vec))
+#define AMF_VEC_PUSH(amf, vec) ((amf)->arena ? ({                           \
+    void *amf_vec_ = (vec);                                                     \
+    void *amf_ret_ = amf_arena_vec_push( (amf), &amf_vec_, sizeof( *(vec) ) );  \
+    (vec) = amf_vec_;                                                           \
+    amf_ret_;                                                                   \
+}) : (void*)VEC_PUSH(vec))
+
 void amf_free_value( amf_value_t val);
 
 static void amf_free_member( amf_v_member_t member ){
@@ -155,6 +291,7 @@ void amf_free_value( amf_value_t val){
 
         case AMF_TYPE_STRING:
         case AMF_TYPE_XML_DOCUMENT:
+        case AMF_TYPE_BYTE_ARRAY:
             free( val->string.data );
             break;
         case AMF_TYPE_OBJECT:
@@ -186,10 +323,35 @@ amf_t amf_create( char type ){
         free(ret);
         return nullptr;
     }
+    ret->version = type == 3 ? 3 : 0;
 
     return ret;
 }
 
+amf_t amf_create_arena( char type, size_t source_len, bool borrow ){
+    size_t size = AMF_ARENA_ALIGN( sizeof( struct amf_object ) ) + AMF_ARENA_BASE + source_len * AMF_ARENA_SCALE;
+    amf_arena_block_t *block = malloc( sizeof( amf_arena_block_t ) + size );
+    if( !block ){
+        return nullptr;
+    }
+    block->next = nullptr;
+    block->size = size;
+    block->used = AMF_ARENA_ALIGN( sizeof( struct amf_object ) );
+
+    amf_t ret = (amf_t) block->data;
+    memset( ret, 0, sizeof( *ret ) );
+    ret->arena = block;
+    ret->borrow = borrow;
+    ret->version = type == 3 ? 3 : 0;
+    AMF_VEC_INIT( ret, ret->items );
+    AMF_VEC_INIT( ret, ret->ref_table );
+    if( !ret->items || !ret->ref_table ){
+        free( block );
+        return nullptr;
+    }
+    return ret;
+}
+
 amf_t amf_reference( amf_t other ){
     other->references++;
     return other;
@@ -199,12 +361,28 @@ void amf_destroy( amf_t amf ){
     if( !amf ){
         return;
     }
-    if( amf->references == 0 ){
+    if( amf->references == 0 && amf->arena ){
+        amf_arena_block_t *block = amf->arena;
+        while( block ){
+            amf_arena_block_t *next = block->next;
+            free( block );
+            block = next;
+        }
+    }
+    else if( amf->references == 0 ){
         for( size_t i = 0; i < VEC_SIZE(amf->items); ++i ){
             amf_free_value( &amf->items[i] );
         }
         VEC_DESTROY( amf->items );
         VEC_DESTROY( amf->ref_table );
+        if( amf->amf3 ){
+            VEC_DESTROY( amf->amf3->strings );
+            VEC_DESTROY( amf->amf3->objects );
+            VEC_DESTROY( amf->amf3->traits );
+            VEC_DESTROY( amf->amf3->names );
+            free( amf->amf3->string_hash );
+            free( amf->amf3 );
+        }
         free( amf->allocation );
         free( amf );
     }
@@ -214,6 +392,680 @@ void amf_destroy( amf_t amf ){
 }
 
 
+//Returns the AMF3 reference tables of an AMF object, emptied for a new value.
+static amf3_tables_t * amf3_tables( amf_t amf ){
+    if( !amf->amf3 ){
+        amf3_tables_t *t = amf_alloc( amf, sizeof( amf3_tables_t ) );
+        if( !t ){
+            return nullptr;
+        }
+        memset( t, 0, sizeof( *t ) );
+        t->amf = amf;
+        AMF_VEC_INIT( amf, t->strings );
+        AMF_VEC_INIT( amf, t->objects );
+        AMF_VEC_INIT( amf, t->traits );
+        AMF_VEC_INIT( amf, t->names );
+        amf->amf3 = t;
+    }
+    VEC_SIZE( amf->amf3->strings ) = 0;
+    VEC_SIZE( amf->amf3->objects ) = 0;
+    VEC_SIZE( amf->amf3->traits ) = 0;
+    VEC_SIZE( amf->amf3->names ) = 0;
+    if( amf->amf3->string_hash_used ){
+        memset( amf->amf3->string_hash, 0, amf->amf3->string_hash_cap * sizeof( uint32_t ) );
+        amf->amf3->string_hash_used = false;
+    }
+    amf->amf3->anon_trait = SIZE_MAX;
+    amf->amf3->depth = 0;
+    return amf->amf3;
+}
+
+static size_t amf3_index_name( char *buffer, size_t idx ){
+    char temp[24];
+    size_t len = 0;
+    do{
+        temp[len++] = '0' + idx % 10;
+        idx /= 10;
+    } while( idx > 0 );
+    for( size_t i = 0; i < len; ++i ){
+        buffer[i] = temp[len - i - 1];
+    }
+    return len;
+}
+
+static bool amf3_is_index_name( const char *name, size_t length, size_t idx ){
+    char buffer[24];
+    size_t len = amf3_index_name( buffer, idx );
+    return len == length && memcmp( buffer, name, len ) == 0;
+}
+
+static amf_err_t amf_push_borrowed( amf_t amf, amf_type_t type, const void *data, size_t length );
+static amf_err_t amf_push_member_borrowed( amf_t amf, const void *name, size_t length );
+
+//Copies a slice of the source buffer into the AMF object using the push function for the given type.
+//Borrowing objects reference the slice in place instead.
+static amf_err_t amf3_push_slice( amf_t amf, amf_type_t type, amf3_slice_t slice ){
+    void *buffer;
+    if( amf->borrow ){
+        if( type == AMF_TYPE_NONE ){
+            return amf_push_member_borrowed( amf, slice.data, slice.length );
+        }
+        return amf_push_borrowed( amf, type, slice.data, slice.length );
+    }
+    amf_err_t ret = amf_push_string_alloc( amf, &buffer, slice.length );
+    if( ret < 0 ){
+        return ret;
+    }
+    memcpy( buffer, slice.data, slice.length );
+    switch( type ){
+        case AMF_TYPE_STRING:       return amf_push_string( amf, buffer );
+        case AMF_TYPE_XML_DOCUMENT: return amf_push_xml( amf, buffer );
+        case AMF_TYPE_BYTE_ARRAY:   return amf_push_byte_array( amf, buffer, slice.length );
+        default:                    return amf_push_member( amf, buffer );
+    }
+}
+
+amf_err_t amf_push_assoc_end( amf_t amf );
+static amf_err_t amf3_read_value( amf_t amf, amf3_tables_t *t, const byte *src, size_t size );
+
+//Reads a U29S string body, which is either a reference into the string table or an inline string.
+static amf_err_t amf3_read_string( amf3_tables_t *t, const byte *src, size_t size, amf3_slice_t *out ){
+    uint32_t header;
+    bool reference;
+    amf_err_t ret = amf3_get_u29_ref( src, size, &header, &reference );
+    if( ret < 0 ){
+        return ret;
+    }
+    if( reference ){
+        if( header >= VEC_SIZE(t->strings) ){
+            return AMF_ERR_INVALID_DATA;
+        }
+        *out = t->strings[header];
+        return ret;
+    }
+    if( size - ret < header ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    out->data = src + ret;
+    out->length = header;
+    //Empty strings are never sent by reference
+    if( header > 0 ){
+        amf3_slice_t *slot = AMF_VEC_PUSH( t->amf, t->strings );
+        if( !slot ){
+            return AMF_ERR_OOM;
+        }
+        *slot = *out;
+    }
+    return AMF_SIZE(ret + header);
+}
+
+//Resolves an object table reference to a complex value.
+static amf_err_t amf3_read_complex_ref( amf_t amf, amf3_tables_t *t, uint32_t idx ){
+    if( idx >= VEC_SIZE(t->objects) ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    switch( t->objects[idx].type ){
+        case AMF3_TYPE_OBJECT:
+        case AMF3_TYPE_ARRAY:
+            return amf_push_reference( amf, t->objects[idx].ref );
+        default:
+            return AMF_ERR_INVALID_DATA;
+    }
+}
+
+//Dates, XML and byte arrays live in the object table, but have no children.
+//References to them are resolved by copying the original payload.
+static amf_err_t amf3_read_blob( amf_t amf, amf3_tables_t *t, amf3_type_t type, const byte *src, size_t size ){
+    uint32_t header;
+    bool reference;
+    amf3_entry_t entry;
+    amf_err_t ret = amf3_get_u29_ref( src + 1, size - 1, &header, &reference );
+    if( ret < 0 ){
+        return ret;
+    }
+    size_t offset = ret + 1;
+    if( reference ){
+        if( header >= VEC_SIZE(t->objects) || t->objects[header].type != type ){
+            return AMF_ERR_INVALID_DATA;
+        }
+        entry = t->objects[header];
+    }
+    else{
+        entry.type = type;
+        entry.ref = 0;
+        entry.bytes.data = src + offset;
+        entry.bytes.length = 0;
+        entry.timestamp = 0;
+        entry.value = nullptr;
+        if( type == AMF3_TYPE_DATE ){
+            ret = amf3_get_date_value( src + offset, size - offset, &entry.timestamp );
+            if( ret < 0 ){
+                return ret;
+            }
+            offset += ret;
+        }
+        else{
+            if( size - offset < header ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            entry.bytes.length = header;
+            offset += header;
+        }
+        amf3_entry_t *slot = AMF_VEC_PUSH( t->amf, t->objects );
+        if( !slot ){
+            return AMF_ERR_OOM;
+        }
+        *slot = entry;
+    }
+    switch( type ){
+        case AMF3_TYPE_DATE:        ret = amf_push_date( amf, entry.timestamp, 0 );                     break;
+        case AMF3_TYPE_BYTE_ARRAY:  ret = amf3_push_slice( amf, AMF_TYPE_BYTE_ARRAY, entry.bytes );     break;
+        default:                    ret = amf3_push_slice( amf, AMF_TYPE_XML_DOCUMENT, entry.bytes );   break;
+    }
+    if( ret < 0 ){
+        return ret;
+    }
+    return AMF_SIZE(offset);
+}
+
+//Reads a member name followed by its value. A zero length name ends a dynamic member list,
+//in which case nothing is pushed and *done is set.
+static amf_err_t amf3_read_member( amf_t amf, amf3_tables_t *t, const byte *src, size_t size, bool *done ){
+    amf3_slice_t name;
+    amf_err_t ret = amf3_read_string( t, src, size, &name );
+    if( ret < 0 ){
+        return ret;
+    }
+    size_t offset = ret;
+    *done = name.length == 0;
+    if( *done ){
+        return AMF_SIZE(offset);
+    }
+    ret = amf3_push_slice( amf, AMF_TYPE_NONE, name );
+    if( ret < 0 ){
+        return ret;
+    }
+    ret = amf3_read_value( amf, t, src + offset, size - offset );
+    if( ret < 0 ){
+        return ret;
+    }
+    return AMF_SIZE(offset + ret);
+}
+
+static amf_err_t amf3_read_array( amf_t amf, amf3_tables_t *t, const byte *src, size_t size ){
+    uint32_t dense;
+    bool reference;
+    bool done = false;
+    char name[24];
+    void *buffer;
+    amf_err_t ret = amf3_get_u29_ref( src + 1, size - 1, &dense, &reference );
+    if( ret < 0 ){
+        return ret;
+    }
+    size_t offset = ret + 1;
+    if( reference ){
+        ret = amf3_read_complex_ref( amf, t, dense );
+        return ret < 0 ? ret : AMF_SIZE(offset);
+    }
+    if( t->depth >= AMF3_MAX_DEPTH ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    amf3_entry_t *slot = AMF_VEC_PUSH( t->amf, t->objects );
+    if( !slot ){
+        return AMF_ERR_OOM;
+    }
+    memset( slot, 0, sizeof( *slot ) );
+    slot->type = AMF3_TYPE_ARRAY;
+    slot->ref = VEC_SIZE(amf->ref_table);
+
+    ret = amf_push_ecma_start( amf, UINT32_MAX );
+    if( ret < 0 ){
+        return ret;
+    }
+    t->depth++;
+    while( !done ){
+        ret = amf3_read_member( amf, t, src + offset, size - offset, &done );
+        if( ret < 0 ){
+            return ret;
+        }
+        offset += ret;
+    }
+    ret = amf_push_assoc_end( amf );
+    for( uint32_t i = 0; i < dense && ret >= 0; ++i ){
+        size_t len = amf3_index_name( name, i );
+        ret = amf_push_string_alloc( amf, &buffer, len );
+        if( ret < 0 ){
+            break;
+        }
+        memcpy( buffer, name, len );
+        ret = amf_push_member( amf, buffer );
+        if( ret < 0 ){
+            break;
+        }
+        ret = amf3_read_value( amf, t, src + offset, size - offset );
+        offset += ret < 0 ? 0 : ret;
+    }
+    if( ret < 0 ){
+        return ret;
+    }
+    t->depth--;
+    ret = amf_push_object_end( amf );
+    return ret < 0 ? ret : AMF_SIZE(offset);
+}
+
+static amf_err_t amf3_read_object( amf_t amf, amf3_tables_t *t, const byte *src, size_t size ){
+    uint32_t header;
+    amf3_trait_t trait;
+    amf3_slice_t name;
+    bool done;
+    amf_err_t ret = amf3_get_u29( src + 1, size - 1, &header );
+    if( ret < 0 ){
+        return ret;
+    }
+    size_t offset = ret + 1;
+    if( (header & 1) == 0 ){
+        ret = amf3_read_complex_ref( amf, t, header >> 1 );
+        return ret < 0 ? ret : AMF_SIZE(offset);
+    }
+    if( (header & 3) == 1 ){
+        if( (header >> 2) >= VEC_SIZE(t->traits) ){
+            return AMF_ERR_INVALID_DATA;
+        }
+        trait = t->traits[header >> 2];
+    }
+    else if( (header & 7) == 7 ){
+        emit_err("[Unimplemented] Trying to read externalizable object from AMF3!");
+        return AMF_ERR_INVALID_DATA;
+    }
+    else{
+        trait.dynamic = (header & 8) != 0;
+        trait.sealed = header >> 4;
+        trait.names = VEC_SIZE(t->names);
+        //The class name is not kept; typed objects are read as anonymous objects.
+        ret = amf3_read_string( t, src + offset, size - offset, &name );
+        if( ret < 0 ){
+            return ret;
+        }
+        offset += ret;
+        for( size_t i = 0; i < trait.sealed; ++i ){
+            ret = amf3_read_string( t, src + offset, size - offset, &name );
+            if( ret < 0 ){
+                return ret;
+            }
+            offset += ret;
+            amf3_slice_t *slot = AMF_VEC_PUSH( t->amf, t->names );
+            if( !slot ){
+                return AMF_ERR_OOM;
+            }
+            *slot = name;
+        }
+        amf3_trait_t *slot = AMF_VEC_PUSH( t->amf, t->traits );
+        if( !slot ){
+            return AMF_ERR_OOM;
+        }
+        *slot = trait;
+    }
+    if( t->depth >= AMF3_MAX_DEPTH ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    amf3_entry_t *slot = AMF_VEC_PUSH( t->amf, t->objects );
+    if( !slot ){
+        return AMF_ERR_OOM;
+    }
+    memset( slot, 0, sizeof( *slot ) );
+    slot->type = AMF3_TYPE_OBJECT;
+    slot->ref = VEC_SIZE(amf->ref_table);
+
+    ret = amf_push_object_start( amf );
+    if( ret < 0 ){
+        return ret;
+    }
+    t->depth++;
+    for( size_t i = 0; i < trait.sealed; ++i ){
+        ret = amf3_push_slice( amf, AMF_TYPE_NONE, t->names[trait.names + i] );
+        if( ret < 0 ){
+            return ret;
+        }
+        ret = amf3_read_value( amf, t, src + offset, size - offset );
+        if( ret < 0 ){
+            return ret;
+        }
+        offset += ret;
+    }
+    done = !trait.dynamic;
+    while( !done ){
+        ret = amf3_read_member( amf, t, src + offset, size - offset, &done );
+        if( ret < 0 ){
+            return ret;
+        }
+        offset += ret;
+    }
+    t->depth--;
+    ret = amf_push_object_end( amf );
+    return ret < 0 ? ret : AMF_SIZE(offset);
+}
+
+static amf_err_t amf3_read_value( amf_t amf, amf3_tables_t *t, const byte *src, size_t size ){
+    amf3_slice_t slice;
+    amf_err_t ret = AMF_SIZE(1);
+    amf_err_t pushed;
+    int32_t temp_d;
+    double temp_f;
+    amf3_type_t type = amf3_next_type( src, size );
+    switch( type ){
+        case AMF3_TYPE_UNDEFINED:   pushed = amf_push_undefined( amf );     break;
+        case AMF3_TYPE_NULL:        pushed = amf_push_null( amf );          break;
+        case AMF3_TYPE_FALSE:       pushed = amf_push_boolean( amf, 0 );    break;
+        case AMF3_TYPE_TRUE:        pushed = amf_push_boolean( amf, 1 );    break;
+        case AMF3_TYPE_INTEGER:
+            ret = amf3_get_integer( src, size, &temp_d );
+            if( ret < 0 ){
+                return ret;
+            }
+            pushed = amf_push_integer( amf, temp_d );
+            break;
+        case AMF3_TYPE_DOUBLE:
+            ret = amf3_get_double( src, size, &temp_f );
+            if( ret < 0 ){
+                return ret;
+            }
+            pushed = amf_push_double( amf, temp_f );
+            break;
+        case AMF3_TYPE_STRING:
+            ret = amf3_read_string( t, src + 1, size - 1, &slice );
+            if( ret < 0 ){
+                return ret;
+            }
+            ret = AMF_SIZE(ret + 1);
+            pushed = amf3_push_slice( amf, AMF_TYPE_STRING, slice );
+            break;
+        case AMF3_TYPE_XML_DOCUMENT:
+        case AMF3_TYPE_XML:
+        case AMF3_TYPE_DATE:
+        case AMF3_TYPE_BYTE_ARRAY:
+            return amf3_read_blob( amf, t, type, src, size );
+        case AMF3_TYPE_ARRAY:
+            return amf3_read_array( amf, t, src, size );
+        case AMF3_TYPE_OBJECT:
+            return amf3_read_object( amf, t, src, size );
+        case AMF3_TYPE_NONE:
+            return size == 0 ? AMF_ERR_INCOMPLETE : AMF_ERR_INVALID_DATA;
+        default:
+            emit_err("[Unimplemented] Trying to read vector or dictionary from AMF3!");
+            return AMF_ERR_INVALID_DATA;
+    }
+    return pushed < 0 ? pushed : ret;
+}
+
+//Reads the AMF3 value following an AVM+ marker.
+static amf_err_t amf_read_avmplus( amf_t amf, const byte *src, size_t size ){
+    amf3_tables_t *t = amf3_tables( amf );
+    if( !t ){
+        return AMF_ERR_OOM;
+    }
+    size_t items = VEC_SIZE(amf->items);
+    size_t refs = VEC_SIZE(amf->ref_table);
+    size_t depth = amf->depth;
+    amf_err_t ret = amf3_read_value( amf, t, src, size );
+    if( ret < 0 && depth == 0 && VEC_SIZE(amf->items) > items ){
+        //Drop the partially read top level value so that reading may resume at its marker
+        if( !amf->arena ){
+            amf_free_value( &VEC_BACK(amf->items) );
+        }
+        VEC_POP( amf->items );
+        VEC_POP_N( amf->ref_table, VEC_SIZE(amf->ref_table) - refs );
+        amf->depth = 0;
+        amf->member_ready = false;
+    }
+    return ret;
+}
+
+#define DO(a) do{                       \
+    int wrote_internal = (a);           \
+    if( wrote_internal < 0 ){           \
+        return AMF_SIZE(wrote_internal);\
+    }                                   \
+    wrote += wrote_internal;            \
+    if( dest ){                         \
+        dest += wrote_internal;         \
+        size -= wrote_internal;         \
+    }                                   \
+}while(0)
+
+static amf_err_t amf3_write_value( amf3_tables_t *t, amf_value_t value, byte *dest, size_t size );
+
+//Only mixes the length and the outer 16 bytes; the table compares full strings on a hit anyway.
+static size_t amf3_string_hash( const byte *str, size_t len ){
+    uint64_t head = 0, tail = 0;
+    if( len >= 8 ){
+        memcpy( &head, str, 8 );
+        memcpy( &tail, str + len - 8, 8 );
+    }
+    else{
+        for( size_t i = 0; i < len; ++i ){
+            head = (head << 8) | str[i];
+        }
+    }
+    uint64_t hash = (head ^ (tail << 29 | tail >> 35) ^ len) * 0x9E3779B97F4A7C15ull;
+    return hash >> 32;
+}
+
+static bool amf3_string_hash_grow( amf3_tables_t *t ){
+    size_t cap = t->string_hash_cap ? t->string_hash_cap * 2 : 64;
+    uint32_t *hash = amf_alloc( t->amf, cap * sizeof( uint32_t ) );
+    if( !hash ){
+        return false;
+    }
+    memset( hash, 0, cap * sizeof( uint32_t ) );
+    for( size_t i = 0; i < VEC_SIZE(t->strings); ++i ){
+        size_t slot = amf3_string_hash( t->strings[i].data, t->strings[i].length ) & (cap - 1);
+        while( hash[slot] ){
+            slot = (slot + 1) & (cap - 1);
+        }
+        hash[slot] = i + 1;
+    }
+    amf_release( t->amf, t->string_hash );
+    t->string_hash = hash;
+    t->string_hash_cap = cap;
+    return true;
+}
+
+//Writes a U29S string body, using the string table when one is available.
+static amf_err_t amf3_write_string( amf3_tables_t *t, const char *str, size_t len, byte *dest, size_t size ){
+    if( t && len > 0 ){
+        if( (VEC_SIZE(t->strings) + 1) * 2 > t->string_hash_cap && !amf3_string_hash_grow( t ) ){
+            return AMF_ERR_OOM;
+        }
+        size_t mask = t->string_hash_cap - 1;
+        size_t slot = amf3_string_hash( (const byte*) str, len ) & mask;
+        while( t->string_hash[slot] ){
+            amf3_slice_t *known = &t->strings[t->string_hash[slot] - 1];
+            if( known->length == len && memcmp( known->data, str, len ) == 0 ){
+                return amf3_write_ref( dest, size, t->string_hash[slot] - 1 );
+            }
+            slot = (slot + 1) & mask;
+        }
+        amf3_slice_t *added = AMF_VEC_PUSH( t->amf, t->strings );
+        if( !added ){
+            return AMF_ERR_OOM;
+        }
+        added->data = (const byte*) str;
+        added->length = len;
+        t->string_hash[slot] = VEC_SIZE(t->strings);
+        t->string_hash_used = true;
+    }
+    return amf3_write_bytes( dest, size, str, len );
+}
+
+static amf_err_t amf3_write_track( amf3_tables_t *t, amf_value_t value, amf3_type_t type ){
+    if( t ){
+        if( t->depth >= AMF3_MAX_DEPTH ){
+            return AMF_ERR_INVALID_DATA;
+        }
+        amf3_entry_t *slot = AMF_VEC_PUSH( t->amf, t->objects );
+        if( !slot ){
+            return AMF_ERR_OOM;
+        }
+        memset( slot, 0, sizeof( *slot ) );
+        slot->type = type;
+        slot->value = value;
+    }
+    return AMF_ERR_NONE;
+}
+
+static amf_err_t amf3_write_value_obj( amf3_tables_t *t, amf_value_t val, byte *dest, size_t size ){
+    int wrote = 0;
+    DO( amf3_write_marker( dest, size, AMF3_TYPE_OBJECT ) );
+    DO( amf3_write_track( t, val, AMF3_TYPE_OBJECT ) );
+    //Everything is sent as an anonymous dynamic object, so only one trait is ever needed.
+    if( t && t->anon_trait != SIZE_MAX ){
+        DO( amf3_write_u29( dest, size, (t->anon_trait << 2) | 1 ) );
+    }
+    else{
+        DO( amf3_write_u29( dest, size, 0x0B ) );
+        DO( amf3_write_bytes( dest, size, "", 0 ) );
+        if( t ){
+            t->anon_trait = 0;
+        }
+    }
+    if( t ){
+        t->depth++;
+    }
+    for( size_t i = 0; i < VEC_SIZE(val->object.members); ++i ){
+        if( val->object.members[i].length == 0 ){
+            continue;
+        }
+        DO( amf3_write_string( t, val->object.members[i].name, val->object.members[i].length, dest, size ) );
+        DO( amf3_write_value( t, &val->object.members[i].value, dest, size ) );
+    }
+    if( t ){
+        t->depth--;
+    }
+    DO( amf3_write_bytes( dest, size, "", 0 ) );
+    return AMF_SIZE(wrote);
+}
+
+static amf_err_t amf3_write_value_arr( amf3_tables_t *t, amf_value_t val, byte *dest, size_t size ){
+    int wrote = 0;
+    size_t dense = VEC_SIZE(val->array.ordinal);
+    //Ordinal members only go in the dense portion if they are named 0 through n-1
+    for( size_t i = 0; i < dense; ++i ){
+        if( !amf3_is_index_name( val->array.ordinal[i].name, val->array.ordinal[i].length, i ) ){
+            dense = 0;
+            break;
+        }
+    }
+    if( dense >= 0x10000000 ){
+        return AMF_ERR_INVALID_DATA;
+    }
+    DO( amf3_write_marker( dest, size, AMF3_TYPE_ARRAY ) );
+    DO( amf3_write_track( t, val, AMF3_TYPE_ARRAY ) );
+    DO( amf3_write_u29( dest, size, (dense << 1) | 1 ) );
+    if( t ){
+        t->depth++;
+    }
+    for( size_t i = 0; i < VEC_SIZE(val->array.assoc); ++i ){
+        if( val->array.assoc[i].length == 0 ){
+            continue;
+        }
+        DO( amf3_write_string( t, val->array.assoc[i].name, val->array.assoc[i].length, dest, size ) );
+        DO( amf3_write_value( t, &val->array.assoc[i].value, dest, size ) );
+    }
+    for( size_t i = 0; dense == 0 && i < VEC_SIZE(val->array.ordinal); ++i ){
+        if( val->array.ordinal[i].length == 0 ){
+            continue;
+        }
+        DO( amf3_write_string( t, val->array.ordinal[i].name, val->array.ordinal[i].length, dest, size ) );
+        DO( amf3_write_value( t, &val->array.ordinal[i].value, dest, size ) );
+    }
+    DO( amf3_write_bytes( dest, size, "", 0 ) );
+    for( size_t i = 0; i < dense; ++i ){
+        DO( amf3_write_value( t, &val->array.ordinal[i].value, dest, size ) );
+    }
+    if( t ){
+        t->depth--;
+    }
+    return AMF_SIZE(wrote);
+}
+
+static amf_err_t amf3_write_value_blob( amf3_tables_t *t, amf_value_t val, amf3_type_t type, byte *dest, size_t size ){
+    int wrote = 0;
+    DO( amf3_write_marker( dest, size, type ) );
+    DO( amf3_write_track( t, val, type ) );
+    if( type == AMF3_TYPE_DATE ){
+        DO( amf3_write_date_value( dest, size, val->date.timestamp ) );
+    }
+    else{
+        DO( amf3_write_bytes( dest, size, val->string.data, val->string.length ) );
+    }
+    return AMF_SIZE(wrote);
+}
+
+static amf_err_t amf3_write_value_ref( amf3_tables_t *t, amf_value_t val, byte *dest, size_t size ){
+    int wrote = 0;
+    amf_value_t target = amf_dereference( val, true );
+    if( !target || amf_value_is( target, AMF_TYPE_REFERENCE ) ){
+        return amf3_write_undefined( dest, size );
+    }
+    for( size_t i = 0; t && i < VEC_SIZE(t->objects); ++i ){
+        if( t->objects[i].value == target ){
+            DO( amf3_write_marker( dest, size, t->objects[i].type ) );
+            DO( amf3_write_ref( dest, size, i ) );
+            return AMF_SIZE(wrote);
+        }
+    }
+    //Not sent yet, so the referenced value is written in its place
+    return amf3_write_value( t, target, dest, size );
+}
+
+static amf_err_t amf3_write_value( amf3_tables_t *t, amf_value_t value, byte *dest, size_t size ){
+    int wrote = 0;
+    switch( value->type ){
+        case AMF_TYPE_UNDEFINED:
+        case AMF_TYPE_UNSUPPORTED:
+            return amf3_write_undefined( dest, size );
+        case AMF_TYPE_NULL:
+            return amf3_write_null( dest, size );
+        case AMF_TYPE_BOOLEAN:
+            return amf3_write_boolean( dest, size, value->boolean.boolean );
+        case AMF_TYPE_INTEGER:
+            return amf3_write_integer( dest, size, value->integer.number );
+        case AMF_TYPE_DOUBLE:
+            return amf3_write_double( dest, size, value->dbl.number );
+        case AMF_TYPE_STRING:
+            DO( amf3_write_marker( dest, size, AMF3_TYPE_STRING ) );
+            DO( amf3_write_string( t, value->string.data, value->string.length, dest, size ) );
+            return AMF_SIZE(wrote);
+        case AMF_TYPE_DATE:
+            return amf3_write_value_blob( t, value, AMF3_TYPE_DATE, dest, size );
+        case AMF_TYPE_XML_DOCUMENT:
+            return amf3_write_value_blob( t, value, AMF3_TYPE_XML_DOCUMENT, dest, size );
+        case AMF_TYPE_BYTE_ARRAY:
+            return amf3_write_value_blob( t, value, AMF3_TYPE_BYTE_ARRAY, dest, size );
+        case AMF_TYPE_OBJECT:
+            return amf3_write_value_obj( t, value, dest, size );
+        case AMF_TYPE_ARRAY:
+            return amf3_write_value_arr( t, value, dest, size );
+        case AMF_TYPE_REFERENCE:
+            return amf3_write_value_ref( t, value, dest, size );
+        default:
+            break;
+    }
+    return AMF_ERR_INVALID_DATA;
+}
+
+//Writes an AVM+ marker followed by the AMF3 encoding of the value.
+//Without reference tables, nothing will be sent by reference.
+static amf_err_t amf_write_avmplus( amf3_tables_t *t, amf_value_t value, byte *dest, size_t size ){
+    int wrote = 0;
+    DO( amf3_write_marker( dest, size, (amf3_type_t) AMF0_TYPE_AVMPLUS ) );
+    DO( amf3_write_value( t, value, dest, size ) );
+    return AMF_SIZE(wrote);
+}
+
+#undef DO
+
+
 amf_err_t amf_write_value( amf_value_t value, byte *dest, size_t size );
 
 #define DO(a) do{                       \
@@ -305,6 +1157,9 @@ amf_err_t amf_write_value( amf_value_t value, byte *dest, size_t size ){
             return amf_write_value_ecma( value, dest, size );
         case AMF_TYPE_OBJECT:
             return amf_write_value_obj( value, dest, size );
+        case AMF_TYPE_BYTE_ARRAY:
+            //No AMF0 equivalent, so switch to AMF3 for this value
+            return amf_write_avmplus( nullptr, value, dest, size );
         default:
             break;
     }
@@ -319,11 +1174,32 @@ amf_err_t amf_write( amf_t amf, byte *dest, size_t size, size_t *written ){
     if( written ){
         i = *written;
     }
+    if( amf->version == 3 ){
+        //AMF3 messages lead with an encoding selector; the values themselves start out as AMF0
+        if( dest ){
+            if( size < 1 ){
+                return AMF_ERR_INCOMPLETE;
+            }
+            dest[0] = 0;
+            offset = 1;
+        }
+        total_len = 1;
+    }
     for( i = 0; i < VEC_SIZE(amf->items); ++i ){
         if( dest && offset > size ){
             break;
         }
-        int result = amf_write_value( &amf->items[i], dest + offset, size - offset );
+        int result;
+        if( amf->version == 3 && amf_value_is( &amf->items[i], AMF_TYPE_COMPLEX ) ){
+            amf3_tables_t *t = amf3_tables( amf );
+            if( !t ){
+                return AMF_ERR_OOM;
+            }
+            result = amf_write_avmplus( t, &amf->items[i], dest + offset, size - offset );
+        }
+        else{
+            result = amf_write_value( &amf->items[i], dest + offset, size - offset );
+        }
         if( result < 0 ){
             goto end;
         }
@@ -347,8 +1223,23 @@ amf_err_t amf_read( amf_t amf, const byte *src, size_t size, size_t *read ){
     uint32_t temp_d32;
     double temp_f;
     size_t temp_size;
+    if( amf->version == 3 && size > 0 && src[0] == 0 && VEC_SIZE(amf->items) == 0 && amf->depth == 0 ){
+        //Skip the encoding selector in front of AMF3 messages
+        offset = 1;
+    }
     while( offset < size ){
-        if( amf->depth > 0 ){
+        if( amf->depth > 0 && amf->borrow ){
+            result = amf0_get_prop_length( src + offset, size - offset, &temp_size );
+            if( result >= 0 && size - offset - 2 < temp_size ){
+                result = AMF_ERR_INCOMPLETE;
+            }
+            result = result < 0 ? result : amf_push_member_borrowed( amf, src + offset + 2, temp_size );
+            if( result < 0 ){
+                goto aborted;
+            }
+            offset += 2 + temp_size;
+        }
+        else if( amf->depth > 0 ){
             result = result < 0 ? result : amf0_get_prop_length( src + offset, size - offset, &temp_size );
             result = result < 0 ? result : amf_push_string_alloc( amf, &buffer, temp_size );
             result = result < 0 ? result : amf0_get_prop_name(src + offset, size - offset, buffer, temp_size );
@@ -359,9 +1250,18 @@ amf_err_t amf_read( amf_t amf, const byte *src, size_t size, size_t *read ){
             }
         }
         amf0_type_t type = amf0_next_type(src + offset, size - offset);
+        if( type == AMF0_TYPE_AVMPLUS ){
+            result = amf_read_avmplus( amf, src + offset + 1, size - offset - 1 );
+            if( result < 0 ){
+                goto aborted;
+            }
+            offset += result + 1;
+            continue;
+        }
         result = AMF_ERR_NONE;
+        //The length lookups below leave this untouched on truncated input
+        temp_size = 0;
         switch( type ){
-            case AMF0_TYPE_AVMPLUS:                                                                                             break;
             case AMF0_TYPE_BOOLEAN:         result =    amf0_get_boolean( src + offset, size - offset, &temp_d );               break;
             case AMF0_TYPE_DATE:            result =    amf0_get_date( src + offset, size - offset, &temp_d, &temp_f );         break;
             case AMF0_TYPE_ECMA_ARRAY:      result =    amf0_get_ecma_array( src + offset, size - offset, &temp_d32 );          break;
@@ -385,6 +1285,20 @@ amf_err_t amf_read( amf_t amf, const byte *src, size_t size, size_t *read ){
             goto aborted;
         }
         offset += result;
+        if( amf->borrow && ( type == AMF0_TYPE_STRING || type == AMF0_TYPE_LONG_STRING || type == AMF0_TYPE_XML_DOCUMENT ) ){
+            //Point at the string in the source buffer; the header is the marker and a 16 or 32 bit length
+            size_t header = type == AMF0_TYPE_STRING ? 3 : 5;
+            if( size - offset < header || size - offset - header < temp_size ){
+                result = AMF_ERR_INCOMPLETE;
+                goto aborted;
+            }
+            result = amf_push_borrowed( amf, type == AMF0_TYPE_XML_DOCUMENT ? AMF_TYPE_XML_DOCUMENT : AMF_TYPE_STRING, src + offset + header, temp_size );
+            if( result < 0 ){
+                goto aborted;
+            }
+            offset += header + temp_size;
+            continue;
+        }
         switch( type ){
             case AMF0_TYPE_LONG_STRING:
             case AMF0_TYPE_STRING:
@@ -480,13 +1394,13 @@ static amf_value_t amf_v_get_object( amf_t amf ){
 static amf_v_member_t * amf_v_push_member( amf_t amf ){
     amf_value_t obj = amf_v_get_object( amf );
     if( amf_value_is( obj, AMF_TYPE_OBJECT ) ){
-        return VEC_PUSH( obj->object.members );
+        return AMF_VEC_PUSH( amf, obj->object.members );
     }
     if( amf_value_is( obj, AMF_TYPE_ARRAY ) ){
         if( VEC_SIZE( obj->array.assoc ) < obj->array.assoc_len ){
-            return VEC_PUSH( obj->array.assoc );
+            return AMF_VEC_PUSH( amf, obj->array.assoc );
         }
-        return VEC_PUSH( obj->array.ordinal );
+        return AMF_VEC_PUSH( amf, obj->array.ordinal );
     }
     return nullptr;
 }
@@ -494,7 +1408,7 @@ static amf_v_member_t * amf_v_push_member( amf_t amf ){
 static amf_value_t amf_push_item( amf_t amf ){
     if( amf->depth == 0 ){
         VEC_DECLARE( union amf_value ) old = amf->items;
-        amf_value_t ret = VEC_PUSH(amf->items);
+        amf_value_t ret = AMF_VEC_PUSH(amf, amf->items);
         if( amf->items != old ){
             //Move the reference table entries.
             for( size_t i = 0; i < VEC_SIZE(amf->ref_table); ++i ){
@@ -534,7 +1448,7 @@ static amf_value_t amf_push_item( amf_t amf ){
 static amf_err_t push_str( amf_t a, const void * str, amf_type_t t) {
     if( str != a->allocation ){
         size_t len = strlen( (const char *)str );
-        void * ptr = malloc( len + 1 );
+        void * ptr = amf_alloc( a, len + 1 );
         if( !ptr ){
             return AMF_ERR_OOM;
         }
@@ -556,6 +1470,15 @@ static amf_err_t push_str( amf_t a, const void * str, amf_type_t t) {
     }
 }
 
+//Pushes a string-like value without copying it; the caller guarantees the buffer outlives the object.
+static amf_err_t amf_push_borrowed( amf_t amf, amf_type_t type, const void *data, size_t length ){
+    PUSH_PREP(amf,target);
+    target->string.data = (char*) data;
+    target->string.length = length;
+    target->string.type = type;
+    return AMF_ERR_NONE;
+}
+
 amf_err_t amf_push_double( amf_t amf, double number ){
     PUSH_PREP( amf, target );
     target->dbl.number = number;
@@ -578,9 +1501,14 @@ amf_err_t amf_push_boolean( amf_t amf, char boolean ){
 }
 amf_err_t amf_push_string_alloc( amf_t amf, void** destination, size_t length ){
     if( amf->allocation ){
-        free( amf->allocation );
+        amf_release( amf, amf->allocation );
+        amf->allocation = nullptr;
+    }
+    //Sign extended lengths from corrupt data would otherwise wrap around the terminator
+    if( length >= SIZE_MAX / 2 ){
+        return AMF_ERR_OOM;
     }
-    amf->allocation = malloc( length * sizeof( char ) + 1 );
+    amf->allocation = amf_alloc( amf, length * sizeof( char ) + 1 );
     if( amf->allocation == nullptr ){
         return AMF_ERR_OOM;
     }
@@ -596,9 +1524,9 @@ amf_err_t amf_push_object_start( amf_t amf ){
     PUSH_PREP( amf, target );
     amf->depth ++;
     target->object.type = AMF_TYPE_OBJECT;
-    VEC_INIT(target->object.members);
+    AMF_VEC_INIT(amf, target->object.members);
 
-    amf_value_t* temp = VEC_PUSH(amf->ref_table);
+    amf_value_t* temp = AMF_VEC_PUSH(amf, amf->ref_table);
     if( !temp ){
         return AMF_ERR_OOM;
     }
@@ -621,7 +1549,7 @@ amf_err_t amf_push_member( amf_t amf, const void *str ){
             return AMF_ERR_NONE;
         }
         size_t len = strlen( str );
-        mem->name = malloc( len );
+        mem->name = amf_alloc( amf, len );
         if( mem->name == nullptr ){
             return AMF_ERR_OOM;
         }
@@ -633,15 +1561,29 @@ amf_err_t amf_push_member( amf_t amf, const void *str ){
     }
     return AMF_ERR_OOM;
 }
+static amf_err_t amf_push_member_borrowed( amf_t amf, const void *name, size_t length ){
+    if( amf->member_ready ){
+        return AMF_ERR_INCOMPLETE;
+    }
+    amf_v_member_t* mem = amf_v_push_member( amf );
+    if( !mem ){
+        return AMF_ERR_OOM;
+    }
+    mem->length = length;
+    mem->name = (char*) name;
+    mem->value.type = AMF_TYPE_UNDEFINED;
+    amf->member_ready = true;
+    return AMF_ERR_NONE;
+}
 amf_err_t amf_push_ecma_start( amf_t amf, uint32_t assoc_members ){
     PUSH_PREP( amf, target );
     amf->depth ++;
     target->array.type = AMF_TYPE_ARRAY;
     target->array.assoc_len = assoc_members;
-    VEC_INIT(target->array.assoc);
-    VEC_INIT(target->array.ordinal);
+    AMF_VEC_INIT(amf, target->array.assoc);
+    AMF_VEC_INIT(amf, target->array.ordinal);
 
-    amf_value_t* temp = VEC_PUSH(amf->ref_table);
+    amf_value_t* temp = AMF_VEC_PUSH(amf, amf->ref_table);
     if( !temp ){
         return AMF_ERR_OOM;
     }
@@ -681,16 +1623,16 @@ amf_err_t amf_push_object_end( amf_t amf ){
         amf_value_t obj = amf_v_get_object( amf );
         if( obj ){
             if( amf_value_is( obj, AMF_TYPE_OBJECT ) && VEC_SIZE(obj->object.members) > 0 ){
-                free( VEC_BACK(obj->object.members).name );
+                amf_release( amf, VEC_BACK(obj->object.members).name );
                 VEC_POP( obj->object.members );
             }
             else if( amf_value_is( obj, AMF_TYPE_ARRAY ) ){
                 if( VEC_SIZE(obj->array.ordinal) > 0 ){
-                    free( VEC_BACK(obj->array.ordinal).name );
+                    amf_release( amf, VEC_BACK(obj->array.ordinal).name );
                     VEC_POP( obj->array.ordinal );
                 }
                 else if( VEC_SIZE(obj->array.assoc) > 0 ){
-                    free( VEC_BACK(obj->array.assoc).name );
+                    amf_release( amf, VEC_BACK(obj->array.assoc).name );
                     VEC_POP( obj->array.assoc );
                 }
             }
@@ -709,7 +1651,7 @@ amf_err_t amf_push_assoc_end( amf_t amf ){
             amf->member_ready = false;
 
             if( VEC_SIZE(obj->array.assoc) > 0 ){
-                free( VEC_BACK(obj->array.assoc).name );
+                amf_release( amf, VEC_BACK(obj->array.assoc).name );
                 VEC_POP( obj->array.assoc );
             }
 
@@ -726,6 +1668,29 @@ amf_err_t amf_push_date( amf_t amf, double timestamp, int16_t timezone ){
     target->string.type = AMF_TYPE_DATE;
     return AMF_ERR_NONE;
 }
+amf_err_t amf_push_byte_array( amf_t amf, const void *data, size_t length ){
+    if( data != amf->allocation ){
+        void * ptr = amf_alloc( amf, length + 1 );
+        if( !ptr ){
+            return AMF_ERR_OOM;
+        }
+        memcpy( ptr, data, length );
+        PUSH_PREP(amf,target);
+        target->string.data = (char*) ptr;
+        target->string.length = length;
+        target->string.type = AMF_TYPE_BYTE_ARRAY;
+        return AMF_ERR_NONE;
+    }
+    else{
+        PUSH_PREP(amf,target);
+        target->string.data = (char*) amf->allocation;
+        target->string.length = length;
+        target->string.type = AMF_TYPE_BYTE_ARRAY;
+        amf->allocation = nullptr;
+        amf->allocation_len = 0;
+        return AMF_ERR_NONE;
+    }
+}
 amf_err_t amf_push_long_string( amf_t amf, const void *str ){
     return push_str( amf, str, AMF_TYPE_STRING );
 }
@@ -900,6 +1865,13 @@ const char* amf_value_get_xml( amf_value_t target, size_t *length ){
     return target->string.data;
 }
 
+const byte* amf_value_get_byte_array( amf_value_t target, size_t *length ){
+    if( length ){
+        *length = target->string.length;
+    }
+    return (const byte*) target->string.data;
+}
+
 
 static amf_value_t amf_assoc_get_value_arr( VEC_DECLARE(amf_v_member_t) arr, const char *key ){
     size_t key_len = strlen(key);
@@ -1001,8 +1973,6 @@ size_t amf_arr_get_ord_count( const amf_value_t target ){
 }
 
 
-#include <stdio.h>
-
 void amf_print_value_internal( amf_value_t val, size_t depth ){
 
     switch( val->type ){
@@ -1044,10 +2014,13 @@ void amf_print_value_internal( amf_value_t val, size_t depth ){
             break;
 
         case AMF_TYPE_STRING:
-            printf( "String: %s", val->string.data );
+            printf( "String: %.*s", (int) val->string.length, val->string.data );
             break;
         case AMF_TYPE_XML_DOCUMENT:
-            printf( "XML document: %s", val->string.data );
+            printf( "XML document: %.*s", (int) val->string.length, val->string.data );
+            break;
+        case AMF_TYPE_BYTE_ARRAY:
+            printf( "Byte array: %lu bytes", val->string.length );
             break;
 
         case AMF_TYPE_ARRAY:
@@ -68,33 +68,47 @@ uint32_t rtmp_params_get_d( rtmp_params_t params, rtmp_param_name_t name ){
 void rtmp_set_app_list( rtmp_t mgr, rtmp_app_list_t list ){
     mgr->applist = list;
 }
-#include <stdio.h>
 
+void rtmp_set_memory_budget( rtmp_t mgr, size_t limit ){
+    mgr->io_budget.limit = limit;
+}
+
+void rtmp_set_edge_triggered( rtmp_t mgr, bool enabled ){
+    mgr->edge_triggered = enabled;
+}
+
+void rtmp_set_timeouts( rtmp_t mgr, rtmp_time_t handshake, rtmp_time_t ping, rtmp_time_t idle ){
+    mgr->handshake_timeout = handshake;
+    mgr->ping_interval = ping;
+    mgr->idle_timeout = idle;
+}
+
+size_t rtmp_get_memory_usage( rtmp_t mgr ){
+    return mgr->io_budget.used;
+}
+
+void rtmp_get_conn_stats( rtmp_t mgr, slab_stats_t *stats ){
+    slab_pool_stats( mgr->server_pool, stats );
+}
 rtmp_err_t rtmp_gen_error(rtmp_err_t err, size_t line, const char *file, const char *msg){
-    #if RTMP_LOG_LEVEL >= 1
+    rtmp_log_level_t level;
     if( err >= RTMP_ERR_FATAL ){
-        printf( "%s:%zd Fatal error %s (%s)\n", file, line, rtmp_get_err_name(err), msg );
+        level = RTMP_LOG_FATAL;
     }
-    #if RTMP_LOG_LEVEL >= 2
     else if( err >= RTMP_ERR_ERROR && err != RTMP_ERR_AGAIN ){
-        printf( "%s:%zd Error %s (%s)\n", file, line, rtmp_get_err_name(err), msg );
+        level = RTMP_LOG_ERROR;
+    }
+    else if( err == RTMP_ERR_AGAIN || err == RTMP_ERR_NOT_READY ){
+        level = RTMP_LOG_NOTICE;
     }
-    #endif
-    #if RTMP_LOG_LEVEL >= 3
-    else if (err != RTMP_ERR_NONE && err != RTMP_ERR_NOT_READY ){
-        printf( "%s:%zd Warning %s (%s)\n", file, line, rtmp_get_err_name(err), msg );
+    else if( err != RTMP_ERR_NONE ){
+        level = RTMP_LOG_WARNING;
     }
-    #endif
-    #if RTMP_LOG_LEVEL >= 4
-    else if (err != RTMP_ERR_NONE ){
-        printf( "%s:%zd Notice %s (%s)\n", file, line, rtmp_get_err_name(err), msg );
+    else{
+        level = RTMP_LOG_TRACE;
     }
-    #endif
-    #if RTMP_LOG_LEVEL >= 10
-    else {
-        printf( "%s:%zd Notice %s (%s)\n", file, line, rtmp_get_err_name(err), msg );
+    if( rtmp_log_enabled( level ) ){
+        rtmp_log_write( level, err, line, file, "%s", msg );
     }
-    #endif
-    #endif
     return err;
 }
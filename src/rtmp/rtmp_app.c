@@ -25,6 +25,7 @@
 #include <openrtmp/rtmp/rtmp_types.h>
 #include <openrtmp/rtmp/rtmp_stream.h>
 #include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/rtmp/rtmp_relay.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <openrtmp/util/memutil.h>
@@ -46,6 +47,9 @@ struct rtmp_app {
     rtmp_app_on_pub_proc on_publish;
     void * on_publish_data;
 
+    rtmp_app_on_play_proc on_play;
+    void * on_play_data;
+
     rtmp_app_on_amf_proc on_metadata;
     void * on_metadata_data;
 
@@ -54,6 +58,8 @@ struct rtmp_app {
 
     rtmp_app_on_av_proc on_audio;
     void * on_audio_data;
+
+    rtmp_relay_list_t relays;
 };
 
 struct rtmp_app_list{
@@ -69,6 +75,7 @@ rtmp_app_list_t rtmp_app_list_create( void ){
 
 void rtmp_app_list_destroy( rtmp_app_list_t list ){
     for( size_t i = 0; i < VEC_SIZE(list->apps); ++i ){
+        rtmp_relay_list_destroy( list->apps[i]->relays );
         free( list->apps[i]->name );
         free( list->apps[i] );
     }
@@ -88,15 +95,12 @@ rtmp_app_t rtmp_app_list_register( rtmp_app_list_t list, const char *appname ){
     }
 
     app->name = str_dup( appname );
-    if( !app->name ){
-        free( app );
-        return nullptr;
-    }
-
-    rtmp_app_t * app_pos = VEC_PUSH( list->apps );
+    app->relays = rtmp_relay_list_create();
+    rtmp_app_t * app_pos = app->name && app->relays ? VEC_PUSH( list->apps ) : nullptr;
     if( !app_pos ){
-        free( app );
+        rtmp_relay_list_destroy( app->relays );
         free( app->name );
+        free( app );
         return nullptr;
     }
     *app_pos = app;
@@ -104,6 +108,18 @@ rtmp_app_t rtmp_app_list_register( rtmp_app_list_t list, const char *appname ){
     return app;
 }
 
+rtmp_relay_list_t rtmp_app_relays( rtmp_app_t app ){
+    return app->relays;
+}
+
+void rtmp_app_set_gop_cache_size( rtmp_app_t app, size_t size ){
+    rtmp_relay_list_set_gop_limit( app->relays, size );
+}
+
+bool rtmp_app_get_gop_stats( rtmp_app_t app, const char *name, rtmp_gop_stats_t *stats ){
+    return rtmp_relay_list_get_stats( app->relays, name, stats );
+}
+
 rtmp_app_t rtmp_app_list_get( rtmp_app_list_t list, const char *appname ){
     for( size_t i = 0; i < VEC_SIZE( list->apps ); ++i ){
         if( strcmp( appname, list->apps[i]->name ) == 0 ){
@@ -133,6 +149,11 @@ void rtmp_app_set_publish( rtmp_app_t app, rtmp_app_on_pub_proc proc, void *user
     app->on_publish_data = user;
 }
 
+void rtmp_app_set_play( rtmp_app_t app, rtmp_app_on_play_proc proc, void *user ){
+    app->on_play = proc;
+    app->on_play_data = user;
+}
+
 void rtmp_app_set_fcpublish( rtmp_app_t app, rtmp_app_on_fcpub_proc proc, void *user ){
     app->on_fcpublish = proc;
     app->on_fcpublish_data = user;
@@ -170,6 +191,10 @@ rtmp_cb_status_t rtmp_app_publish( rtmp_stream_t stream, rtmp_app_t app, const c
     return app->on_publish ? app->on_publish( stream, app, name, type, app->on_publish_data ) : RTMP_CB_CONTINUE;
 }
 
+rtmp_cb_status_t rtmp_app_play( rtmp_stream_t stream, rtmp_app_t app, const char * name ){
+    return app->on_play ? app->on_play( stream, app, name, app->on_play_data ) : RTMP_CB_CONTINUE;
+}
+
 rtmp_cb_status_t rtmp_app_fcpublish( rtmp_stream_t stream, rtmp_app_t app, const char * name ){
     return app->on_fcpublish ? app->on_fcpublish( stream, app, name, app->on_fcpublish_data ) : RTMP_CB_CONTINUE;
 }
@@ -95,16 +95,16 @@ void rtmp_chunk_assembler_log_cb(
 
 
 static rtmp_asm_buf_t * rtmp_chunk_assembler_get_buffer( rtmp_chunk_assembler_t self, size_t chunk_id, size_t msg_id ){
-    size_t free_idx = 0;
+    size_t free_idx = (size_t)-1;
     for( size_t i = 0; i < VEC_SIZE(self->buffers); ++i ){
         if( self->buffers[i].chunk_id == chunk_id && self->buffers[i].msg_id == msg_id ){
             return self->buffers + i;
         }
-        if( free_idx == 0 && self->buffers[i].chunk_id == 0 ){
+        if( free_idx == (size_t)-1 && self->buffers[i].chunk_id == 0 ){
             free_idx = i;
         }
     }
-    if( free_idx != 0 ){
+    if( free_idx != (size_t)-1 ){
         ringbuffer_clear( self->buffers[free_idx].buffer );
         self->buffers[free_idx].chunk_id = chunk_id;
         self->buffers[free_idx].msg_id = msg_id;
@@ -212,6 +212,19 @@ void rtmp_chunk_assembler_destroy( rtmp_chunk_assembler_t assembler ){
     free( assembler );
 }
 
+void rtmp_chunk_assembler_reset( rtmp_chunk_assembler_t assembler ){
+    //The buffers that would have been kept anyway are emptied for the next connection
+    while( VEC_SIZE( assembler->buffers ) > RTMP_MAX_ASM_SOFT_BUFFER ){
+        ringbuffer_destroy( VEC_BACK( assembler->buffers ).buffer );
+        VEC_POP( assembler->buffers );
+    }
+    for( size_t i = 0; i < VEC_SIZE( assembler->buffers ); ++i ){
+        ringbuffer_clear( assembler->buffers[i].buffer );
+        assembler->buffers[i].chunk_id = 0;
+        assembler->buffers[i].msg_id = 0;
+    }
+}
+
 void rtmp_chunk_assembler_assign( rtmp_chunk_assembler_t assembler, rtmp_chunk_conn_t connection ){
     rtmp_chunk_conn_register_callbacks( connection, rtmp_chunk_assembler_cb, rtmp_chunk_assembler_event_cb, rtmp_chunk_assembler_log_cb, assembler );
 }
@@ -50,6 +50,8 @@ void rtmp_cache_reset( rtmp_chunk_stream_cache_t cache ){
         memset( &cache->dynamic_cache[i], 0, sizeof( cache->dynamic_cache[i] ) );
         cache->dynamic_cache[i].msg.chunk_stream_id = id;
     }
+    memset( cache->affinity, 0, sizeof( cache->affinity ) );
+    cache->affinity_clock = 0;
 }
 
 //Compare the chunk stream IDs for ordering
@@ -64,18 +66,18 @@ static rtmp_chunk_stream_message_internal_t * rtmp_cache_insert( rtmp_chunk_stre
         return ret;
     }
     size_t remainder = cache->dynamic_cache_size - index;
-    cache->dynamic_cache_size ++;
     //Make room for the new element
-    void* newptr = realloc( cache->dynamic_cache, sizeof(rtmp_chunk_stream_message_internal_t) * cache->dynamic_cache_size );
+    void* newptr = realloc( cache->dynamic_cache, sizeof(rtmp_chunk_stream_message_internal_t) * ( cache->dynamic_cache_size + 1 ) );
     if( newptr == nullptr ){
         //Out of memory
         return ret;
     }
     cache->dynamic_cache = (rtmp_chunk_stream_message_internal_t*)newptr;
+    cache->dynamic_cache_size ++;
     ret = cache->dynamic_cache + index;
     if( remainder > 0 ){
         //If there's data after our index, move it down by one element
-        memmove( ret + 1, ret, remainder );
+        memmove( ret + 1, ret, remainder * sizeof(rtmp_chunk_stream_message_internal_t) );
     }
     //Clear the memory for our new element and set its ID
     memset( ret, 0, sizeof( rtmp_chunk_stream_message_internal_t ) );
@@ -113,48 +115,30 @@ rtmp_chunk_stream_message_internal_t * rtmp_cache_get( rtmp_chunk_stream_cache_t
     }
 }
 
-static int rtmp_cache_match( rtmp_chunk_stream_message_internal_t * cached, size_t stream_id, size_t msg_size, byte msg_type, rtmp_time_t timestamp ){
-    int current_type = 0;
-    if( cached->initialized ) {
-        if( cached->msg.message_stream_id == stream_id ){
-            current_type = 1;
-            if( cached->msg.message_length == msg_size && cached->msg.message_type == msg_type ){
-                current_type = 2;
-                if( cached->time_delta == (rtmp_time_t)timestamp_get_delta( cached->msg.timestamp, timestamp ) ){
-                    current_type = 3;
-                }
-            }
+rtmp_chunk_stream_message_internal_t * rtmp_cache_find( rtmp_chunk_stream_cache_t cache, size_t stream_id, byte msg_type ){
+    //Each message stream and type pair sticks to one chunk stream, so its length and timestamp delta
+    //carry over from one message to the next and most headers compress down to type 2 or 3
+    size_t pick = 0;
+    for( size_t i = 0; i < RTMP_STREAM_AUTO_COUNT; ++i ){
+        rtmp_chunk_stream_affinity_t *entry = &cache->affinity[i];
+        if( entry->used && entry->message_stream_id == stream_id && entry->message_type == msg_type ){
+            pick = i;
+            break;
         }
-    }
-    return current_type;
-}
-
-rtmp_chunk_stream_message_internal_t * rtmp_cache_find( rtmp_chunk_stream_cache_t cache, size_t stream_id, size_t msg_size, byte msg_type, rtmp_time_t timestamp ){
-    rtmp_chunk_stream_message_internal_t * best = &cache->static_cache[4];
-    memset( best, 0, sizeof (rtmp_chunk_stream_message_internal_t) );
-    best->msg.chunk_stream_id = 4;
-    return best;
-    int best_type = 0;
-    int current_type = 0;
-    for( size_t i = 4; i < RTMP_STREAM_STATIC_CACHE_SIZE; ++i ){
-        current_type = rtmp_cache_match( &cache->static_cache[i], stream_id, msg_size, msg_type, timestamp );
-        if( current_type > best_type && cache->static_cache[i].initialized ){
-            best = &cache->static_cache[i];
-            best_type = current_type;
-        }
-        if( best_type == 3 ){
-            return best;
-        }
-    }
-    for( size_t i = 0; i < cache->dynamic_cache_size; ++i ){
-        current_type = rtmp_cache_match( &cache->dynamic_cache[i], stream_id, msg_size, msg_type, timestamp );
-        if( current_type > best_type && cache->dynamic_cache[i].initialized ){
-            best = &cache->dynamic_cache[i];
-            best_type = current_type;
+        //Otherwise prefer a chunk stream nobody has used yet, then the least recently used one
+        if( !entry->used ){
+            if( cache->affinity[pick].used ){
+                pick = i;
+            }
         }
-        if( best_type == 3 ){
-            return best;
+        else if( cache->affinity[pick].used && entry->last_use < cache->affinity[pick].last_use ){
+            pick = i;
         }
     }
-    return best;
+    rtmp_chunk_stream_affinity_t *entry = &cache->affinity[pick];
+    entry->message_stream_id = stream_id;
+    entry->message_type = msg_type;
+    entry->used = true;
+    entry->last_use = ++cache->affinity_clock;
+    return rtmp_cache_get( cache, RTMP_STREAM_AUTO_FIRST + pick );
 }
@@ -32,29 +32,117 @@
 //This is wrapped around all error return values in order to handle logging.
 rtmp_err_t rtmp_chunk_conn_gen_error(rtmp_chunk_conn_t conn, rtmp_err_t err, size_t line, const char *file, const char *msg);
 
+//Counts towards both the connection and the manager servicing it
+#define RTMP_CONN_STAT(conn, counter, amount) do{                       \
+    (conn)->stats.counter += (amount);                                  \
+    if( (conn)->shared_stats ){                                         \
+        RTMP_STAT_ADD( (conn)->shared_stats->counter, (amount) );       \
+    }                                                                   \
+}while(0)
+
+static inline size_t rtmp_chunk_conn_msg_index( byte message_type ){
+    return message_type < RTMP_STATS_MSG_TYPES ? message_type : 0;
+}
+
+//Accounts for bytes added to the outgoing queue
+static void rtmp_chunk_conn_queued( rtmp_chunk_conn_t conn, size_t amount ){
+    conn->bytes_out += amount;
+    RTMP_CONN_STAT( conn, bytes_out, amount );
+    RTMP_CONN_STAT( conn, queue_depth, amount );
+}
+
+//Media is held back while too much of it is unacknowledged. Everything else always goes out, so
+//commands and our own acknowledgements can't end up waiting on the peer's.
+static bool rtmp_chunk_conn_throttled( rtmp_chunk_conn_t conn, byte message_type ){
+    switch( message_type ){
+        case RTMP_MSG_AUDIO:
+        case RTMP_MSG_VIDEO:
+        case RTMP_MSG_AGGREGATE:
+        case RTMP_MSG_AMF0_DAT:
+        case RTMP_MSG_AMF3_DAT:
+            break;
+        default:
+            return false;
+    }
+    if( !conn->peer_acknowledged ){
+        return false;
+    }
+    if( rtmp_chunk_conn_in_flight( conn ) < (size_t)conn->self_window_size * RTMP_MAX_IN_FLIGHT_WINDOWS ){
+        return false;
+    }
+    RTMP_CONN_STAT( conn, throttled, 1 );
+    return true;
+}
+
+static void rtmp_chunk_conn_set_paused( rtmp_chunk_conn_t conn, bool status ){
+    if( status && !conn->paused ){
+        conn->paused_since = rtmp_get_time_ns();
+    }
+    else if( !status && conn->paused ){
+        RTMP_CONN_STAT( conn, paused_time, rtmp_get_time_ns() - conn->paused_since );
+    }
+    conn->paused = status;
+}
+
+
+//The settings a connection starts out with
+static void rtmp_chunk_conn_defaults( rtmp_chunk_conn_t conn, bool is_client ){
+    conn->status = RTMP_STATUS_UNINIT | (is_client ? RTMP_STATUS_IS_CLIENT : 0 );
+
+    conn->self_chunk_size = RTMP_DEFAULT_CHUNK_SIZE;
+    conn->peer_chunk_size = RTMP_DEFAULT_CHUNK_SIZE;
+
+    conn->self_window_size = RTMP_DEFAULT_WINDOW_SIZE;
+    conn->peer_window_size = RTMP_DEFAULT_PEER_WINDOW_SIZE;
+
+    conn->peer_bandwidth_type = RTMP_DEFAULT_BANDWIDTH_TYPE;
+}
 
 rtmp_chunk_conn_t rtmp_chunk_conn_create( bool is_client ){
     rtmp_chunk_conn_t ret = calloc( 1, sizeof( struct rtmp_chunk_conn ) );
 
     ret->in = ringbuffer_create( RTMP_DEFAULT_IO_BUFFER_SIZE );
     ret->out = ringbuffer_create( RTMP_DEFAULT_IO_BUFFER_SIZE );
+    if( !ret->in || !ret->out ){
+        if( ret->in ){
+            ringbuffer_destroy( ret->in );
+        }
+        if( ret->out ){
+            ringbuffer_destroy( ret->out );
+        }
+        free( ret );
+        return nullptr;
+    }
+    ringbuffer_set_limit( ret->in, RTMP_MAX_IO_BUFFER_SIZE );
+    ringbuffer_set_limit( ret->out, RTMP_MAX_IO_BUFFER_SIZE );
+    VEC_INIT( ret->out_segs );
 
     ret->stream_cache_in = rtmp_cache_create();
     ret->stream_cache_out = rtmp_cache_create();
 
-    ret->status = RTMP_STATUS_UNINIT | (is_client ? RTMP_STATUS_IS_CLIENT : 0 );
-
-    ret->self_chunk_size = RTMP_DEFAULT_CHUNK_SIZE;
-    ret->peer_chunk_size = RTMP_DEFAULT_CHUNK_SIZE;
-
-    ret->self_window_size = RTMP_DEFAULT_WINDOW_SIZE;
-    ret->peer_window_size = RTMP_DEFAULT_PEER_WINDOW_SIZE;
-
-    ret->peer_bandwidth_type = RTMP_DEFAULT_BANDWIDTH_TYPE;
+    rtmp_chunk_conn_defaults( ret, is_client );
     return ret;
 }
 
+//Drops one chunk's hold on a referenced payload, releasing it once no chunk needs it
+static void rtmp_chunk_conn_release_seg( rtmp_chunk_seg_t *seg ){
+    rtmp_chunk_ref_t *ref = seg->ref;
+    if( ref && --ref->refs == 0 ){
+        if( ref->release ){
+            ref->release( ref->data, ref->user );
+        }
+        free( ref );
+    }
+    seg->ref = nullptr;
+}
+
 rtmp_err_t rtmp_chunk_conn_close( rtmp_chunk_conn_t conn ){
+    rtmp_chunk_conn_set_stats( conn, nullptr );
+    //Hand back every payload which was still waiting to be sent
+    for( size_t i = conn->out_seg_head; i < VEC_SIZE( conn->out_segs ); ++i ){
+        rtmp_chunk_conn_release_seg( &VEC_AT( conn->out_segs, i ) );
+    }
+    VEC_DESTROY( conn->out_segs );
     ringbuffer_destroy( conn->in );
     ringbuffer_destroy( conn->out );
     rtmp_nonce_del( &conn->nonce_c );
@@ -66,6 +154,40 @@ rtmp_err_t rtmp_chunk_conn_close( rtmp_chunk_conn_t conn ){
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
+rtmp_err_t rtmp_chunk_conn_reset( rtmp_chunk_conn_t conn, bool is_client ){
+    rtmp_chunk_conn_set_stats( conn, nullptr );
+    rtmp_chunk_conn_set_budget( conn, nullptr );
+    for( size_t i = conn->out_seg_head; i < VEC_SIZE( conn->out_segs ); ++i ){
+        rtmp_chunk_conn_release_seg( &VEC_AT( conn->out_segs, i ) );
+    }
+    rtmp_nonce_del( &conn->nonce_c );
+    rtmp_nonce_del( &conn->nonce_s );
+
+    //Everything starts over except the memory, which the next connection gets as it is
+    ringbuffer_t in = conn->in, out = conn->out;
+    rtmp_chunk_stream_cache_t cache_in = conn->stream_cache_in, cache_out = conn->stream_cache_out;
+    rtmp_chunk_seg_t *out_segs = conn->out_segs;
+    memset( conn, 0, sizeof( struct rtmp_chunk_conn ) );
+    conn->in = in;
+    conn->out = out;
+    conn->stream_cache_in = cache_in;
+    conn->stream_cache_out = cache_out;
+    conn->out_segs = out_segs;
+
+    VEC_SIZE( conn->out_segs ) = 0;
+    ringbuffer_pin( conn->in, false );
+    ringbuffer_pin( conn->out, false );
+    ringbuffer_clear( conn->in );
+    ringbuffer_clear( conn->out );
+    ringbuffer_compact( conn->in, RTMP_DEFAULT_IO_BUFFER_SIZE );
+    ringbuffer_compact( conn->out, RTMP_DEFAULT_IO_BUFFER_SIZE );
+    rtmp_cache_reset( conn->stream_cache_in );
+    rtmp_cache_reset( conn->stream_cache_out );
+
+    rtmp_chunk_conn_defaults( conn, is_client );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
 bool rtmp_chunk_conn_connected( rtmp_chunk_conn_t conn ){
     return ( conn->status & RTMP_STATUS_SHAKING_DONE ) == RTMP_STATUS_SHAKING_DONE;
 }
@@ -94,7 +216,10 @@ rtmp_err_t rtmp_chunk_conn_call_event( rtmp_chunk_conn_t conn, rtmp_event_t even
 static rtmp_err_t rtmp_chunk_conn_call_chunk( rtmp_chunk_conn_t conn, const void *input, size_t available, size_t remaining, rtmp_chunk_stream_message_t *msg ){
     rtmp_err_t err = RTMP_ERR_NONE;
     if( conn->callback_chunk ){
-        switch( conn->callback_chunk( conn, input, available, remaining, msg, conn->userdata ) ){
+        uint64_t start = rtmp_get_time_ns();
+        rtmp_cb_status_t status = conn->callback_chunk( conn, input, available, remaining, msg, conn->userdata );
+        RTMP_CONN_STAT( conn, callback_time, rtmp_get_time_ns() - start );
+        switch( status ){
             case RTMP_CB_CONTINUE:
                 break;
             case RTMP_CB_DEFER_PAUSE:
@@ -118,6 +243,8 @@ static void rtmp_chunk_conn_service_shake_tryfinalize( rtmp_chunk_conn_t conn ){
         //Free the nonces used in the handshake
         rtmp_nonce_del( &conn->nonce_c );
         rtmp_nonce_del( &conn->nonce_s );
+        RTMP_CONN_STAT( conn, handshakes, 1 );
+        RTMP_CONN_STAT( conn, handshake_time, rtmp_get_time_ns() - conn->shake_start );
         //Fire the connection success event
         rtmp_chunk_conn_call_event( conn, RTMP_EVENT_CONNECT_SUCCESS );
         conn->lag = 0;
@@ -318,8 +445,7 @@ static rtmp_err_t rtmp_chunk_conn_service_recv_abort(rtmp_chunk_conn_t conn){
 
         rtmp_chunk_stream_message_t msg;
         rtmp_chunk_stream_message_internal_t *cached = rtmp_cache_get( conn->stream_cache_in, chunk_stream);
-        rtmp_chunk_stream_message_internal_t *agmsg = rtmp_cache_get( conn->stream_cache_in, RTMP_CACHE_AGGREGATE );
-        if( cached == nullptr || agmsg == nullptr ){
+        if( cached == nullptr ){
             return RTMP_GEN_ERROR(RTMP_ERR_INADEQUATE_CHUNK);
         }
         memcpy( &msg, cached, sizeof( rtmp_chunk_stream_message_t ) );
@@ -327,8 +453,6 @@ static rtmp_err_t rtmp_chunk_conn_service_recv_abort(rtmp_chunk_conn_t conn){
 
         rtmp_chunk_conn_call_chunk( conn, nullptr, 0, 0, &msg );
         cached->processed = 0;
-        agmsg->processed = 0;
-        agmsg->initialized = false;
         return RTMP_GEN_ERROR(RTMP_ERR_NONE);
     }
     return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
@@ -372,14 +496,9 @@ static rtmp_err_t rtmp_chunk_conn_service_recv_set_peer_bwidth(rtmp_chunk_conn_t
 
 static rtmp_err_t rtmp_chunk_conn_service_recv_ack(rtmp_chunk_conn_t conn ){
     if( conn->control_message_len >= 4 ){
-        size_t amount = ntoh_read_ud( conn->control_message_buffer );
-        if( amount > conn->bytes_out ){
-            //Realistically this should never happen.
-            //This implies that the peer has received more bytes than we have sent.
-            //This shouldn't cause any issues though, so emit only a soft error.
-            //return RTMP_GEN_ERROR(RTMP_ERR_DIVERGENCE_METER_ERROR);
-        }
-        conn->last_ack_out = amount;
+        //The sequence number is only 32 bits, so it wraps every 4GB; see rtmp_chunk_conn_in_flight
+        conn->last_ack_out = ntoh_read_ud( conn->control_message_buffer );
+        conn->peer_acknowledged = true;
         return RTMP_GEN_ERROR(RTMP_ERR_NONE);
     }
     return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
@@ -397,46 +516,6 @@ static rtmp_err_t rtmp_chunk_conn_service_recv_win_ack_size(rtmp_chunk_conn_t co
 }
 
 
-//This is the wrong place for this...
-//TODO: Move into RTMP stream handler
-/*static rtmp_err_t rtmp_chunk_conn_service_recv_aggregate( rtmp_chunk_conn_t conn, const void *input, size_t available, size_t remaining, rtmp_chunk_stream_message_t *msg ){
-    //Fetch our aggregate message cache
-    rtmp_chunk_stream_message_internal_t *agmsg = rtmp_cache_get( conn->stream_cache_in, RTMP_CACHE_AGGREGATE );
-    if( agmsg == nullptr ){
-        return RTMP_GEN_ERROR(RTMP_ERR_INADEQUATE_CHUNK);
-    }
-    size_t offset = 0;
-    if( agmsg->processed == 0 ){
-        //This is a new message, try fetching the header.
-        if( available + conn->control_message_len < RTMP_MESSAGE_HEADER_SIZE ){
-            //The number of available bytes isn't enough to fill the buffer
-            memcpy( conn->control_message_buffer + conn->control_message_len, input, available );
-            conn->control_message_len += available;
-            return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
-        }
-        else if( conn->control_message_len < RTMP_MESSAGE_HEADER_SIZE ){
-            //The number of available bytes is enough to fill the buffer.
-            size_t amount = RTMP_MESSAGE_HEADER_SIZE - conn->control_message_len;
-            memcpy( conn->control_message_buffer + conn->control_message_len, input, amount );
-            conn->control_message_len += amount;
-            offset = amount;
-        }
-        //With the filled buffer, parse it into the cache
-        agmsg->msg.message_type = conn->control_message_buffer[0];
-        agmsg->msg.message_length = ntoh_read_ud3( conn->control_message_buffer + 1 );
-        agmsg->msg.timestamp = ntoh_read_ud( conn->control_message_buffer + 4 );
-        agmsg->msg.message_stream_id = ntoh_read_ud3( conn->control_message_buffer + 8 );
-        agmsg->msg.chunk_stream_id = msg->chunk_stream_id;
-        agmsg->initialized = true;
-        agmsg->processed = agmsg->msg.message_length;
-
-    }
-    if( offset < available ){
-
-    }
-}*/
-
-
 static rtmp_err_t rtmp_chunk_conn_service_recv_cmd( rtmp_chunk_conn_t conn, const void *input, size_t available, size_t remaining, rtmp_chunk_stream_message_t *msg ){
     if( available == remaining && remaining == 0 ){
         //The partial command has been aborted.
@@ -487,7 +566,9 @@ static rtmp_err_t rtmp_chunk_conn_service_recv_issue(
     previous->processed -= available;
     remaining = previous->processed;
 
-    if( msg->chunk_stream_id == RTMP_CONTROL_CHUNK_STREAM && msg->message_stream_id == RTMP_CONTROL_MSG_STREAM ){
+    //User control messages travel with the protocol control messages, but they're for the stream to handle
+    if( msg->chunk_stream_id == RTMP_CONTROL_CHUNK_STREAM && msg->message_stream_id == RTMP_CONTROL_MSG_STREAM &&
+        msg->message_type != RTMP_MSG_USER_CTL ){
         //This is a control message; use our internal handler
         ret = rtmp_chunk_conn_service_recv_cmd( conn, input, available, remaining, msg );
     }
@@ -497,6 +578,9 @@ static rtmp_err_t rtmp_chunk_conn_service_recv_issue(
     }
 
     ringbuffer_commit_read( conn->in, available );
+    if( remaining == 0 ){
+        RTMP_CONN_STAT( conn, messages_in[rtmp_chunk_conn_msg_index( msg->message_type )], 1 );
+    }
 
     return RTMP_GEN_ERROR(ret);
 }
@@ -536,6 +620,7 @@ static rtmp_err_t rtmp_chunk_conn_service_recv( rtmp_chunk_conn_t conn, rtmp_io_
 
     rtmp_chunk_stream_message_t *msg;
     FAIL_IF_ERR( rtmp_chunk_read_hdr( conn->in, &msg, conn->stream_cache_in ) );
+    RTMP_CONN_STAT( conn, chunks_in, 1 );
 
     //Get the previous header from the cache, and fail if we can't.
     rtmp_chunk_stream_message_internal_t *previous = rtmp_cache_get( conn->stream_cache_in, msg->chunk_stream_id );
@@ -567,7 +652,8 @@ static rtmp_err_t rtmp_chunk_conn_service_recv( rtmp_chunk_conn_t conn, rtmp_io_
         //Store the message ID
         conn->partial_msg = msg->chunk_stream_id;
     }
-    if( conn->bytes_in - conn->last_ack_in > conn->peer_window_size / 2 ){
+    //Until the peer tells us its window, it isn't expecting acknowledgements
+    if( conn->peer_window_size > 0 && conn->bytes_in - conn->last_ack_in > conn->peer_window_size / 2 ){
         rtmp_chunk_conn_acknowledge( conn );
     }
 
@@ -584,6 +670,9 @@ rtmp_err_t rtmp_chunk_conn_service( rtmp_chunk_conn_t conn ){
     //Repeatedly service the connection until the buffers don't change
     do{
         bool shaking = ( conn->status & RTMP_STATUS_SHAKING_DONE ) != RTMP_STATUS_SHAKING_DONE;
+        if( shaking && conn->shake_start == 0 ){
+            conn->shake_start = rtmp_get_time_ns();
+        }
         //If the in buffer has data, service input
         if( ringbuffer_count( conn->in ) > 0 ){
             io_status = RTMP_IO_IN;
@@ -620,13 +709,14 @@ rtmp_err_t rtmp_chunk_conn_service( rtmp_chunk_conn_t conn ){
         if( io_status == RTMP_IO_IN ){
             committed = ringbuffer_unfreeze_read( conn->in, commit );
             conn->bytes_in += committed;
+            RTMP_CONN_STAT( conn, bytes_in, committed );
             if( commit && committed > 0 ){
                 ret = rtmp_chunk_conn_call_event( conn, RTMP_EVENT_EMPTIED );
             }
         }
         if( io_status == RTMP_IO_OUT ){
             committed = ringbuffer_unfreeze_write( conn->out, commit );
-            conn->bytes_out += committed;
+            rtmp_chunk_conn_queued( conn, committed );
             if( commit && committed > 0 ){
                 ret = rtmp_chunk_conn_call_event( conn, RTMP_EVENT_FILLED );
             }
@@ -635,7 +725,7 @@ rtmp_err_t rtmp_chunk_conn_service( rtmp_chunk_conn_t conn ){
             }
         }
         if( ret == RTMP_ERR_PAUSE ){
-            conn->paused = true;
+            rtmp_chunk_conn_set_paused( conn, true );
         }
 
         //Repeat if we didn't error and we've committed something
@@ -700,9 +790,8 @@ rtmp_err_t rtmp_chunk_conn_abort( rtmp_chunk_conn_t conn, uint32_t chunk_stream
 }
 
 rtmp_err_t rtmp_chunk_conn_acknowledge( rtmp_chunk_conn_t conn ){
-    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
     byte buffer[4];
-    ntoh_write_ud( buffer, conn->bytes_in );
+    ntoh_write_ud( buffer, (uint32_t)conn->bytes_in );
 
     rtmp_err_t ret = rtmp_chunk_conn_send_message(
         conn,
@@ -713,7 +802,9 @@ rtmp_err_t rtmp_chunk_conn_acknowledge( rtmp_chunk_conn_t conn ){
         buffer,
         sizeof( buffer ),
         nullptr );
-    conn->last_ack_in = conn->bytes_in;
+    if( ret < RTMP_ERR_ERROR ){
+        conn->last_ack_in = conn->bytes_in;
+    }
     return RTMP_GEN_ERROR(ret);
 }
 
@@ -761,7 +852,7 @@ rtmp_err_t rtmp_chunk_conn_set_peer_bwidth( rtmp_chunk_conn_t conn, uint32_t siz
 }
 
 rtmp_err_t rtmp_chunk_conn_pause( rtmp_chunk_conn_t conn, bool status ){
-    conn->paused = status;
+    rtmp_chunk_conn_set_paused( conn, status );
     return RTMP_ERR_NONE;
 }
 
@@ -781,6 +872,10 @@ rtmp_chunk_conn_send_message(
     if( !rtmp_chunk_conn_connected( conn ) ){
         return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
     }
+    //A message which has already started has to be finished
+    if( ( !written_out || *written_out == 0 ) && rtmp_chunk_conn_throttled( conn, message_type ) ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
     rtmp_chunk_stream_message_t msg;
     msg.chunk_stream_id = chunk_stream;
     msg.message_stream_id = message_stream;
@@ -789,13 +884,9 @@ rtmp_chunk_conn_send_message(
     msg.message_type = message_type;
     size_t start_size = conn->bytes_out;
 
-    //We absolutely must have enough space in the output buffer for a whole chunk
-    if( conn->self_chunk_size + 20 > ringbuffer_size( conn->out ) ){
-        ringbuffer_resize( conn->out, conn->self_chunk_size + 20 );
-    }
-
     //If written_out should contain a number which indicates how far into a write we are.
     size_t written = 0;
+    size_t chunks = 0;
     if( written_out ){
         written = *written_out;
     }
@@ -809,10 +900,20 @@ rtmp_chunk_conn_send_message(
         if( chunk_len > conn->self_chunk_size ){
             chunk_len = conn->self_chunk_size;
         }
+        //Make room for the whole chunk up front; the buffer only grows as far as its limits allow
+        if( ringbuffer_reserve( conn->out, chunk_len + RTMP_MAX_CHUNK_HEADER_SIZE ) < chunk_len + RTMP_MAX_CHUNK_HEADER_SIZE ){
+            ret = RTMP_ERR_AGAIN;
+            break;
+        }
         if( written_out ){
             ringbuffer_freeze_write( conn->out );
         }
-        ret = rtmp_chunk_emit_hdr( conn->out, &msg, conn->stream_cache_out );
+        if( written == 0 ){
+            ret = rtmp_chunk_emit_hdr( conn->out, &msg, conn->stream_cache_out );
+        }
+        else{
+            ret = rtmp_chunk_emit_hdr_continue( conn->out, &msg, conn->stream_cache_out );
+        }
         if( ret >= RTMP_ERR_ERROR ){
             //Rollback on fail
             break;
@@ -824,20 +925,30 @@ rtmp_chunk_conn_send_message(
         }
         //Commit the write
         if( written_out ){
-            conn->bytes_out += ringbuffer_unfreeze_write( conn->out, true );
+            rtmp_chunk_conn_queued( conn, ringbuffer_unfreeze_write( conn->out, true ) );
         }
         written += chunk_len;
+        ++chunks;
     }
     if( ret >= RTMP_ERR_ERROR ){
         //Don't commit since we failed the write operation.
+        //Headers that were rolled back may have advanced the cache, so force full headers next time.
         ringbuffer_unfreeze_write( conn->out, false );
+        rtmp_cache_reset( conn->stream_cache_out );
     }
     if( written_out ){
         *written_out = written;
     }
     else {
         //If we errored, the previous unfreeze should make this unfreeze return 0
-        conn->bytes_out += ringbuffer_unfreeze_write( conn->out, true );
+        rtmp_chunk_conn_queued( conn, ringbuffer_unfreeze_write( conn->out, true ) );
+    }
+    //Without written_out, a failed write takes every chunk back with it
+    if( written_out || ret < RTMP_ERR_ERROR ){
+        RTMP_CONN_STAT( conn, chunks_out, chunks );
+        if( chunks > 0 && written == length ){
+            RTMP_CONN_STAT( conn, messages_out[rtmp_chunk_conn_msg_index( message_type )], 1 );
+        }
     }
     if( conn->bytes_out != start_size ){
         rtmp_chunk_conn_call_event( conn, RTMP_EVENT_FILLED );
@@ -845,26 +956,344 @@ rtmp_chunk_conn_send_message(
     return RTMP_GEN_ERROR(ret);
 }
 
+rtmp_err_t
+rtmp_chunk_conn_send_message_ref(
+    rtmp_chunk_conn_t conn,
+    byte message_type,
+    uint32_t chunk_stream,
+    uint32_t message_stream,
+    uint32_t timestamp,
+    const byte *data,
+    size_t length,
+    rtmp_release_proc release,
+    void *user
+){
+    rtmp_err_t ret = RTMP_ERR_NONE;
+    if( !rtmp_chunk_conn_connected( conn ) ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    //Not worth tracking; copy it and let go of it right away
+    if( length < RTMP_ZEROCOPY_THRESHOLD ){
+        ret = rtmp_chunk_conn_send_message( conn, message_type, chunk_stream, message_stream, timestamp, data, length, nullptr );
+        if( ret < RTMP_ERR_ERROR && release ){
+            release( data, user );
+        }
+        return ret;
+    }
+    if( rtmp_chunk_conn_throttled( conn, message_type ) ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    //Referenced payloads count against the output limit just like buffered ones
+    if( conn->out_ref_bytes + length > RTMP_MAX_IO_BUFFER_SIZE ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    size_t chunks = (length + conn->self_chunk_size - 1) / conn->self_chunk_size;
+    //Only the headers go into the ringbuffer
+    if( ringbuffer_reserve( conn->out, chunks * RTMP_MAX_CHUNK_HEADER_SIZE ) < chunks * RTMP_MAX_CHUNK_HEADER_SIZE ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    rtmp_chunk_ref_t *ref = malloc( sizeof( rtmp_chunk_ref_t ) );
+    if( !ref ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    ref->data = data;
+    ref->refs = chunks;
+    ref->release = release;
+    ref->user = user;
+
+    rtmp_chunk_stream_message_t msg;
+    msg.chunk_stream_id = chunk_stream;
+    msg.message_stream_id = message_stream;
+    msg.message_length = length;
+    msg.timestamp = timestamp;
+    msg.message_type = message_type;
+
+    //We need to be able to roll back the whole loop
+    size_t seg_count = VEC_SIZE( conn->out_segs );
+    size_t assigned = conn->out_assigned;
+    ringbuffer_freeze_write( conn->out );
+
+    size_t written = 0;
+    while( written < length ){
+        size_t chunk_len = length - written;
+        if( chunk_len > conn->self_chunk_size ){
+            chunk_len = conn->self_chunk_size;
+        }
+        if( written == 0 ){
+            ret = rtmp_chunk_emit_hdr( conn->out, &msg, conn->stream_cache_out );
+        }
+        else{
+            ret = rtmp_chunk_emit_hdr_continue( conn->out, &msg, conn->stream_cache_out );
+        }
+        if( ret >= RTMP_ERR_ERROR ){
+            break;
+        }
+        rtmp_chunk_seg_t *seg = VEC_PUSH( conn->out_segs );
+        if( !seg ){
+            ret = RTMP_ERR_OOM;
+            break;
+        }
+        //Everything in the ringbuffer not yet claimed by a segment goes out ahead of this slice,
+        //including anything copied in by rtmp_chunk_conn_send_message in the meantime
+        seg->ring_len = ringbuffer_count( conn->out ) - conn->out_assigned;
+        seg->data = data + written;
+        seg->len = chunk_len;
+        seg->ref = ref;
+        conn->out_assigned += seg->ring_len;
+        written += chunk_len;
+    }
+    if( ret >= RTMP_ERR_ERROR ){
+        ringbuffer_unfreeze_write( conn->out, false );
+        rtmp_cache_reset( conn->stream_cache_out );
+        VEC_POP_N( conn->out_segs, VEC_SIZE( conn->out_segs ) - seg_count );
+        conn->out_assigned = assigned;
+        free( ref );
+        return RTMP_GEN_ERROR(ret);
+    }
+    rtmp_chunk_conn_queued( conn, ringbuffer_unfreeze_write( conn->out, true ) + length );
+    RTMP_CONN_STAT( conn, chunks_out, chunks );
+    RTMP_CONN_STAT( conn, messages_out[rtmp_chunk_conn_msg_index( message_type )], 1 );
+    conn->out_ref_bytes += length;
+    rtmp_chunk_conn_call_event( conn, RTMP_EVENT_FILLED );
+    return RTMP_GEN_ERROR(ret);
+}
+
+rtmp_err_t
+rtmp_chunk_conn_send_framed_ref(
+    rtmp_chunk_conn_t conn,
+    uint32_t chunk_stream,
+    rtmp_message_type_t message_type,
+    const byte *data,
+    size_t length,
+    rtmp_release_proc release,
+    void *user
+){
+    if( !rtmp_chunk_conn_connected( conn ) ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    rtmp_chunk_stream_message_internal_t *cached = rtmp_cache_get( conn->stream_cache_out, chunk_stream );
+    if( !cached ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INADEQUATE_CHUNK);
+    }
+    if( rtmp_chunk_conn_throttled( conn, message_type ) ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    if( length < RTMP_ZEROCOPY_THRESHOLD ){
+        if( ringbuffer_reserve( conn->out, length ) < length ){
+            return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+        }
+        ringbuffer_copy_write( conn->out, data, length );
+        if( release ){
+            release( data, user );
+        }
+    }
+    else{
+        if( conn->out_ref_bytes + length > RTMP_MAX_IO_BUFFER_SIZE ){
+            return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+        }
+        rtmp_chunk_ref_t *ref = malloc( sizeof( rtmp_chunk_ref_t ) );
+        rtmp_chunk_seg_t *seg = ref ? VEC_PUSH( conn->out_segs ) : nullptr;
+        if( !seg ){
+            free( ref );
+            return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+        }
+        ref->data = data;
+        ref->refs = 1;
+        ref->release = release;
+        ref->user = user;
+        seg->ring_len = ringbuffer_count( conn->out ) - conn->out_assigned;
+        seg->data = data;
+        seg->len = length;
+        seg->ref = ref;
+        conn->out_assigned += seg->ring_len;
+        conn->out_ref_bytes += length;
+    }
+    cached->initialized = false;
+    cached->msg.message_type = message_type;
+    //The chunks were framed by someone else, so only the message is counted
+    rtmp_chunk_conn_queued( conn, length );
+    RTMP_CONN_STAT( conn, messages_out[rtmp_chunk_conn_msg_index( message_type )], 1 );
+    rtmp_chunk_conn_call_event( conn, RTMP_EVENT_FILLED );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+size_t rtmp_chunk_conn_in_flight( rtmp_chunk_conn_t conn ){
+    size_t queued = ringbuffer_count( conn->out ) + conn->out_ref_bytes;
+    if( !conn->peer_acknowledged ){
+        return queued;
+    }
+    //Acknowledgements carry the low 32 bits of the peer's byte count
+    int32_t unacked = (uint32_t)conn->bytes_out - (uint32_t)conn->last_ack_out;
+    //A peer claiming more than we sent would otherwise look 4GB behind
+    if( unacked < 0 || (size_t)unacked < queued ){
+        return queued;
+    }
+    return unacked;
+}
+
 rtmp_err_t rtmp_chunk_conn_get_in_buff( rtmp_chunk_conn_t conn, void **buffer, size_t *size ){
+    //Try to keep room for at least one whole chunk. If the limits are hit, the caller sees a smaller
+    //buffer (possibly empty), which is what stops reads from a peer that is outpacing us.
+    ringbuffer_reserve( conn->in, conn->peer_chunk_size + RTMP_MAX_CHUNK_HEADER_SIZE );
     *buffer = ringbuffer_get_write_buf( conn->in, size );
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
 rtmp_err_t rtmp_chunk_conn_get_out_buff( rtmp_chunk_conn_t conn, const void **buffer, size_t *size ){
+    if( conn->out_seg_head < VEC_SIZE( conn->out_segs ) ){
+        rtmp_chunk_seg_t *seg = &VEC_AT( conn->out_segs, conn->out_seg_head );
+        //Stop at the first referenced payload so that output stays in order
+        if( seg->ring_len > 0 ){
+            *buffer = ringbuffer_get_read_buf( conn->out, size );
+            if( *size > seg->ring_len ){
+                *size = seg->ring_len;
+            }
+        }
+        else{
+            *buffer = seg->data;
+            *size = seg->len;
+        }
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
     *buffer = ringbuffer_get_read_buf( conn->out, size );
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
+static void rtmp_chunk_conn_set_iov( rtmp_iovec_t *iov, const void *data, size_t len ){
+#ifdef _WIN32
+    iov->buf = (char*)data;
+    iov->len = len;
+#else
+    iov->iov_base = (void*)data;
+    iov->iov_len = len;
+#endif
+}
+
+//Appends up to ring_len bytes of the ringbuffer, starting skip bytes into the unread content
+static size_t rtmp_chunk_conn_ring_iov( rtmp_chunk_conn_t conn, rtmp_iovec_t *iov, size_t max, size_t n, size_t *skip, size_t *ring_len ){
+    while( *ring_len > 0 && n < max ){
+        unsigned long len;
+        const void *ptr = ringbuffer_peek_read( conn->out, *skip, &len );
+        if( !ptr ){
+            break;
+        }
+        if( len > *ring_len ){
+            len = *ring_len;
+        }
+        rtmp_chunk_conn_set_iov( &iov[n++], ptr, len );
+        *skip += len;
+        *ring_len -= len;
+    }
+    return n;
+}
+
+rtmp_err_t rtmp_chunk_conn_get_out_iov( rtmp_chunk_conn_t conn, rtmp_iovec_t *iov, size_t max, size_t *count ){
+    size_t n = 0;
+    size_t skip = 0;
+    size_t i;
+    for( i = conn->out_seg_head; i < VEC_SIZE( conn->out_segs ) && n < max; ++i ){
+        rtmp_chunk_seg_t *seg = &VEC_AT( conn->out_segs, i );
+        size_t ring_len = seg->ring_len;
+        n = rtmp_chunk_conn_ring_iov( conn, iov, max, n, &skip, &ring_len );
+        if( ring_len > 0 || n >= max ){
+            break;
+        }
+        rtmp_chunk_conn_set_iov( &iov[n++], seg->data, seg->len );
+    }
+    //Whatever follows the last segment was copied in and lives only in the ringbuffer
+    if( i >= VEC_SIZE( conn->out_segs ) ){
+        size_t ring_len = ringbuffer_count( conn->out ) - skip;
+        n = rtmp_chunk_conn_ring_iov( conn, iov, max, n, &skip, &ring_len );
+    }
+    *count = n;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
 rtmp_err_t rtmp_chunk_conn_commit_in_buff( rtmp_chunk_conn_t conn, size_t size ){
     ringbuffer_commit_write( conn->in, size );
+    //The peer filled every byte we offered, so offer twice as much next time
+    if( ringbuffer_space( conn->in ) == 0 ){
+        ringbuffer_reserve( conn->in, ringbuffer_size( conn->in ) );
+    }
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
 rtmp_err_t rtmp_chunk_conn_commit_out_buff( rtmp_chunk_conn_t conn, size_t size ){
+    RTMP_CONN_STAT( conn, queue_depth, -(uint64_t)size );
+    //Walk the queued chunks in order, consuming each one's header bytes and then its payload slice
+    while( size > 0 && conn->out_seg_head < VEC_SIZE( conn->out_segs ) ){
+        rtmp_chunk_seg_t *seg = &VEC_AT( conn->out_segs, conn->out_seg_head );
+        size_t amount = seg->ring_len < size ? seg->ring_len : size;
+        ringbuffer_commit_read( conn->out, amount );
+        seg->ring_len -= amount;
+        conn->out_assigned -= amount;
+        size -= amount;
+        if( seg->ring_len > 0 ){
+            break;
+        }
+        amount = seg->len < size ? seg->len : size;
+        seg->data += amount;
+        seg->len -= amount;
+        conn->out_ref_bytes -= amount;
+        size -= amount;
+        if( seg->len > 0 ){
+            break;
+        }
+        rtmp_chunk_conn_release_seg( seg );
+        conn->out_seg_head++;
+    }
+    if( conn->out_seg_head >= VEC_SIZE( conn->out_segs ) ){
+        VEC_SIZE( conn->out_segs ) = 0;
+        conn->out_seg_head = 0;
+    }
+    else if( conn->out_seg_head > RTMP_MAX_IOV && conn->out_seg_head * 2 > VEC_SIZE( conn->out_segs ) ){
+        //A connection that never drains completely would otherwise grow the list forever
+        VEC_ERASE_N( conn->out_segs, 0, conn->out_seg_head );
+        conn->out_seg_head = 0;
+    }
     ringbuffer_commit_read( conn->out, size );
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
+rtmp_err_t rtmp_chunk_conn_set_budget( rtmp_chunk_conn_t conn, ringbuffer_budget_t *budget ){
+    ringbuffer_set_budget( conn->in, budget );
+    ringbuffer_set_budget( conn->out, budget );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+void rtmp_chunk_conn_get_stats( rtmp_chunk_conn_t conn, rtmp_stats_t *stats ){
+    *stats = conn->stats;
+    stats->connections = 1;
+    if( conn->paused ){
+        stats->paused_time += rtmp_get_time_ns() - conn->paused_since;
+    }
+}
+
+rtmp_err_t rtmp_chunk_conn_set_stats( rtmp_chunk_conn_t conn, rtmp_stats_t *stats ){
+    //The gauges move along with the connection
+    if( conn->shared_stats ){
+        RTMP_STAT_ADD( conn->shared_stats->connections, -1 );
+        RTMP_STAT_ADD( conn->shared_stats->queue_depth, -conn->stats.queue_depth );
+    }
+    conn->shared_stats = stats;
+    if( stats ){
+        RTMP_STAT_ADD( stats->connections, 1 );
+        RTMP_STAT_ADD( stats->queue_depth, conn->stats.queue_depth );
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_chunk_conn_trim( rtmp_chunk_conn_t conn ){
+    ringbuffer_compact( conn->in, RTMP_DEFAULT_IO_BUFFER_SIZE );
+    ringbuffer_compact( conn->out, RTMP_DEFAULT_IO_BUFFER_SIZE );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_chunk_conn_pin_out_buff( rtmp_chunk_conn_t conn, bool pinned ){
+    ringbuffer_pin( conn->out, pinned );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
 rtmp_err_t dummy_log(rtmp_err_t err, size_t line, const char * file, const char * message, void * user ){
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
@@ -46,6 +46,7 @@ rtmp_err_t rtmp_chunk_emit_shake_1( ringbuffer_t output, rtmp_time_t timestamp,
     byte zero[4] = {0,0,0,0};
     byte timestamp_out[4];
     ntoh_write_ud( timestamp_out, timestamp );
+    ringbuffer_reserve( output, 8 + length );
     if( ringbuffer_copy_write( output, timestamp_out, 4 ) < 4){
         return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
     }
@@ -63,6 +64,7 @@ rtmp_err_t rtmp_chunk_emit_shake_2( ringbuffer_t output, rtmp_time_t timestamp1,
     byte timestamp2_out[4];
     ntoh_write_ud( timestamp1_out, timestamp1 );
     ntoh_write_ud( timestamp2_out, timestamp2 );
+    ringbuffer_reserve( output, 8 + length );
     if( ringbuffer_copy_write( output, timestamp1_out, 4 ) < 4){
         return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
     }
@@ -121,18 +123,56 @@ rtmp_err_t rtmp_chunk_read_shake_2( ringbuffer_t input, rtmp_time_t * restrict t
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
-rtmp_err_t rtmp_chunk_emit_hdr( ringbuffer_t output, rtmp_chunk_stream_message_t *message, rtmp_chunk_stream_cache_t cache ){
-    byte fmt = 0;
-    rtmp_time_t timestamp = message->timestamp;
-    rtmp_chunk_stream_message_internal_t *previous;
+//Writes a basic header into buffer, which must hold 3 bytes. Returns its length, or 0 if id can't be encoded.
+static size_t rtmp_chunk_write_hdr_basic( byte *buffer, byte format, size_t id ){
+    size_t len = 1;
+    //Fill the two least significant bits of buffer[0] with format
+    buffer[0] = (format & 3) << 6;
+    if( id < 2 ){
+        //id 0 and 1 are reserved
+        return 0;
+    }
+    else if( id < 64 ){
+        //Use one byte format. Fill the top 6 bits of buffer[0] with the ID.
+        buffer[0] |= ( id & 63 );
+    }
+    else if( id < 256 + 64 ){
+        //Use two byte format.
+        buffer[1] = id - 64;
+        len = 2;
+    }
+    else if( id < 65535 + 64 ){
+        //Use three byte format.
+        buffer[0] |= 1;
+        buffer[1] = (id - 64) >> 8;
+        buffer[2] = id - 64;
+        len = 3;
+    }
+    else{
+        return 0;
+    }
+    return len;
+}
 
+//Looks up the cached header for the chunk stream a message goes out on, assigning one if the message has none
+static rtmp_chunk_stream_message_internal_t * rtmp_chunk_emit_cached( rtmp_chunk_stream_message_t *message, rtmp_chunk_stream_cache_t cache ){
+    rtmp_chunk_stream_message_internal_t *previous;
     if( message->chunk_stream_id == 0 ){
-        previous = rtmp_cache_find( cache, message->message_stream_id, message->message_length, message->message_type, message->timestamp );
-        message->chunk_stream_id = previous->msg.chunk_stream_id;
+        previous = rtmp_cache_find( cache, message->message_stream_id, message->message_type );
+        if( previous ){
+            message->chunk_stream_id = previous->msg.chunk_stream_id;
+        }
     }
     else{
         previous = rtmp_cache_get(cache, message->chunk_stream_id);
     }
+    return previous;
+}
+
+rtmp_err_t rtmp_chunk_emit_hdr( ringbuffer_t output, rtmp_chunk_stream_message_t *message, rtmp_chunk_stream_cache_t cache ){
+    byte fmt = 0;
+    rtmp_time_t timestamp = message->timestamp;
+    rtmp_chunk_stream_message_internal_t *previous = rtmp_chunk_emit_cached( message, cache );
     if( previous == nullptr ){
         return RTMP_GEN_ERROR(RTMP_ERR_INADEQUATE_CHUNK);
     }
@@ -156,25 +196,24 @@ rtmp_err_t rtmp_chunk_emit_hdr( ringbuffer_t output, rtmp_chunk_stream_message_t
         }
     }
     if( fmt > 0 ){
-        timestamp = timestamp_get_delta( previous->msg.timestamp, timestamp );
+        timestamp = delta;
     }
     memcpy( previous, message, sizeof( rtmp_chunk_stream_message_t) );
-    previous->time_delta = delta;
+    //A type 3 header repeats the previous timestamp field, so the peer adds the same delta again
+    if( fmt < 3 ){
+        previous->time_delta = timestamp;
+        previous->extended = timestamp >= 0xFFFFFF;
+    }
     previous->initialized = true;
 
-    byte buffer[16];
-    size_t position = 0;
-    rtmp_err_t err;
-    if( (err = rtmp_chunk_emit_hdr_basic( output, fmt, message->chunk_stream_id ) ) >= RTMP_ERR_ERROR ){
-        return RTMP_GEN_ERROR(err);
+    //Basic header, message header and extended timestamp are assembled in place and written at once
+    byte buffer[3 + 11 + 4];
+    size_t position = rtmp_chunk_write_hdr_basic( buffer, fmt, message->chunk_stream_id );
+    if( position == 0 ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
     }
     if( fmt <= 2 ){
-        if( timestamp >= 0xFFFFFF ){
-            ntoh_write_ud3( buffer + position, 0xFFFFFF );
-        }
-        else{
-            ntoh_write_ud3( buffer + position, timestamp );
-        }
+        ntoh_write_ud3( buffer + position, previous->extended ? 0xFFFFFF : timestamp );
         position += 3;
     }
     if( fmt <= 1 ){
@@ -186,8 +225,8 @@ rtmp_err_t rtmp_chunk_emit_hdr( ringbuffer_t output, rtmp_chunk_stream_message_t
         htol_write_ud( buffer + position, message->message_stream_id );
         position += 4;
     }
-    if( timestamp >= 0xFFFFFF ){
-        ntoh_write_ud( buffer + position, timestamp );
+    if( previous->extended ){
+        ntoh_write_ud( buffer + position, previous->time_delta );
         position += 4;
     }
     if(ringbuffer_copy_write( output, buffer, position ) < position ){
@@ -196,87 +235,130 @@ rtmp_err_t rtmp_chunk_emit_hdr( ringbuffer_t output, rtmp_chunk_stream_message_t
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
-rtmp_err_t rtmp_chunk_read_hdr( ringbuffer_t input, rtmp_chunk_stream_message_t **message_out, rtmp_chunk_stream_cache_t cache ){
-    size_t id;
-    byte fmt;
-    unsigned int old_time = 0;
-    rtmp_err_t err;
-    if( (err = rtmp_chunk_read_hdr_basic( input, &fmt, &id )) >= RTMP_ERR_ERROR ){
-        return RTMP_GEN_ERROR(err);
-    }
-
-    rtmp_chunk_stream_message_internal_t *previous = rtmp_cache_get(cache, id);
+rtmp_err_t rtmp_chunk_emit_hdr_continue( ringbuffer_t output, rtmp_chunk_stream_message_t *message, rtmp_chunk_stream_cache_t cache ){
+    rtmp_chunk_stream_message_internal_t *previous = rtmp_chunk_emit_cached( message, cache );
     if( previous == nullptr ){
         return RTMP_GEN_ERROR(RTMP_ERR_INADEQUATE_CHUNK);
     }
-    old_time = previous->msg.timestamp;
+    byte buffer[3 + 4];
+    size_t position = rtmp_chunk_write_hdr_basic( buffer, 3, message->chunk_stream_id );
+    if( position == 0 ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
+    }
+    if( previous->extended ){
+        ntoh_write_ud( buffer + position, previous->time_delta );
+        position += 4;
+    }
+    if(ringbuffer_copy_write( output, buffer, position ) < position ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
 
-    rtmp_chunk_stream_message_t *message = &previous->msg;
-    message->chunk_stream_id = id;
-    byte buffer[4];
+//The largest chunk header: a 3 byte basic header, an 11 byte message header and a 4 byte extended timestamp
+#define RTMP_CHUNK_HDR_MAX 18
 
-    rtmp_time_t new_time = 0;
-    if( fmt <= 2 ){
-        if( ringbuffer_copy_read( input, buffer, 3) < 3 ){
-            return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
-        }
-        new_time = ntoh_read_ud3( buffer );
+//Decodes a whole chunk header from a flat buffer. Nothing is changed unless the header is complete,
+//in which case the number of bytes it occupies is returned in used.
+static rtmp_err_t rtmp_chunk_decode_hdr( const byte *buffer, unsigned long length, unsigned long *used, rtmp_chunk_stream_message_t **message_out, rtmp_chunk_stream_cache_t cache ){
+    //Message header length by format
+    static const byte msg_hdr_len[4] = { 11, 7, 3, 0 };
+    if( length < 1 ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
     }
-    if( fmt <= 1 ){
-        if( ringbuffer_copy_read( input, buffer, 4) < 4 ){
+    byte fmt = (buffer[0] >> 6) & 3;
+    size_t id = buffer[0] & 63;
+    size_t position = 1;
+    if( id == 0 ){
+        if( length < 2 ){
             return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
         }
-        message->message_length = ntoh_read_ud3( buffer );
-        message->message_type = buffer[3];
+        id = buffer[1] + 64;
+        position = 2;
     }
-    if( fmt <= 0 ){
-        if( ringbuffer_copy_read( input, buffer, 4) < 4 ){
+    else if( id == 1 ){
+        if( length < 3 ){
             return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
         }
-        message->message_stream_id = ltoh_read_ud( buffer );
+        id = ((size_t)buffer[1] << 8 | buffer[2]) + 64;
+        position = 3;
+    }
+
+    rtmp_chunk_stream_message_internal_t *previous = rtmp_cache_get(cache, id);
+    if( previous == nullptr ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INADEQUATE_CHUNK);
     }
-    if( ( fmt == 3 && old_time == 0xFFFFFF ) || new_time == 0xFFFFFF ){
-        if( ringbuffer_copy_read( input, buffer, 4) < 4 ){
+    if( length < position + msg_hdr_len[fmt] ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    const byte *header = buffer + position;
+    //A type 3 header reuses the previous timestamp field, including whether it was extended
+    rtmp_time_t new_time = fmt <= 2 ? ntoh_read_ud3( header ) : previous->time_delta;
+    bool extended = fmt == 3 ? previous->extended : new_time == 0xFFFFFF;
+    position += msg_hdr_len[fmt];
+    if( extended ){
+        if( length < position + 4 ){
             return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
         }
-        new_time = ntoh_read_ud( buffer );
+        new_time = ntoh_read_ud( buffer + position );
+        position += 4;
+    }
+
+    rtmp_chunk_stream_message_t *message = &previous->msg;
+    message->chunk_stream_id = id;
+    if( fmt <= 1 ){
+        message->message_length = ntoh_read_ud3( header + 3 );
+        message->message_type = header[6];
+    }
+    if( fmt <= 0 ){
+        message->message_stream_id = ltoh_read_ud( header + 7 );
+    }
+    if( fmt <= 2 ){
+        previous->time_delta = new_time;
+        previous->extended = extended;
     }
     if( fmt == 0 ){
         message->timestamp = new_time;
     }
-    else{
+    else if( fmt <= 2 || previous->processed == 0 ){
+        //A type 3 header only moves the timestamp when it starts a new message, not on its continuation chunks
         message->timestamp += new_time;
     }
+    *used = position;
     *message_out = message;
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
-rtmp_err_t rtmp_chunk_emit_hdr_basic( ringbuffer_t output, byte format, size_t id ){
-    byte buffer[3];
-    size_t len = 1;
-    //Fill the two least significant bits of buffer[0] with format
-    buffer[0] = (format & 3) << 6;
-    if( id < 2 ){
-        //id 0 and 1 are reserved
-        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
-    }
-    else if( id < 64 ){
-        //Use one byte format. Fill the top 6 bits of buffer[0] with the ID.
-        buffer[0] |= ( id & 63 );
-    }
-    else if( id < 256 + 64 ){
-        //Use two byte format.
-        buffer[1] = id - 64;
-        len = 2;
+rtmp_err_t rtmp_chunk_read_hdr( ringbuffer_t input, rtmp_chunk_stream_message_t **message_out, rtmp_chunk_stream_cache_t cache ){
+    unsigned long length, used;
+    const byte *view = ringbuffer_peek_read( input, 0, &length );
+    byte flat[RTMP_CHUNK_HDR_MAX];
+    if( view && length < RTMP_CHUNK_HDR_MAX ){
+        //The header may straddle the end of the ring, so gather both sides of the wrap
+        unsigned long rest;
+        const byte *wrapped = ringbuffer_peek_read( input, length, &rest );
+        if( wrapped ){
+            if( rest > RTMP_CHUNK_HDR_MAX - length ){
+                rest = RTMP_CHUNK_HDR_MAX - length;
+            }
+            memcpy( flat, view, length );
+            memcpy( flat + length, wrapped, rest );
+            view = flat;
+            length += rest;
+        }
     }
-    else if( id < 65535 + 64 ){
-        //Use three byte format.
-        buffer[0] |= 1;
-        buffer[1] = (id - 64) >> 8;
-        buffer[2] = id - 64;
-        len = 3;
+    rtmp_err_t err = rtmp_chunk_decode_hdr( view, length, &used, message_out, cache );
+    if( err >= RTMP_ERR_ERROR ){
+        return err;
     }
-    else{
+    ringbuffer_commit_read( input, used );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_chunk_emit_hdr_basic( ringbuffer_t output, byte format, size_t id ){
+    byte buffer[3];
+    size_t len = rtmp_chunk_write_hdr_basic( buffer, format, id );
+    if( len == 0 ){
         return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
     }
     if( ringbuffer_copy_write( output, buffer, len ) < len ){
@@ -285,6 +367,50 @@ rtmp_err_t rtmp_chunk_emit_hdr_basic( ringbuffer_t output, byte format, size_t i
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
+size_t rtmp_chunk_frame_size( const rtmp_chunk_stream_message_t *message, uint32_t chunk_size ){
+    byte basic[3];
+    size_t basic_len = rtmp_chunk_write_hdr_basic( basic, 0, message->chunk_stream_id );
+    if( basic_len == 0 || chunk_size == 0 ){
+        return 0;
+    }
+    size_t chunks = (message->message_length + chunk_size - 1) / chunk_size;
+    if( chunks == 0 ){
+        chunks = 1;
+    }
+    //Continuation chunks repeat the extended timestamp, so it costs 4 bytes on every chunk
+    size_t per_chunk = basic_len + ( message->timestamp >= 0xFFFFFF ? 4 : 0 );
+    return message->message_length + chunks * per_chunk + 11;
+}
+
+size_t rtmp_chunk_frame_message( byte *output, const rtmp_chunk_stream_message_t *message, const byte *data, uint32_t chunk_size ){
+    size_t position = 0;
+    size_t written = 0;
+    bool extended = message->timestamp >= 0xFFFFFF;
+    do{
+        size_t chunk_len = message->message_length - written;
+        if( chunk_len > chunk_size ){
+            chunk_len = chunk_size;
+        }
+        //Type 0 header on the first chunk, type 3 on the rest
+        position += rtmp_chunk_write_hdr_basic( output + position, written == 0 ? 0 : 3, message->chunk_stream_id );
+        if( written == 0 ){
+            ntoh_write_ud3( output + position, extended ? 0xFFFFFF : message->timestamp );
+            ntoh_write_ud3( output + position + 3, message->message_length );
+            output[position + 6] = message->message_type;
+            htol_write_ud( output + position + 7, message->message_stream_id );
+            position += 11;
+        }
+        if( extended ){
+            ntoh_write_ud( output + position, message->timestamp );
+            position += 4;
+        }
+        memcpy( output + position, data + written, chunk_len );
+        position += chunk_len;
+        written += chunk_len;
+    } while( written < message->message_length );
+    return position;
+}
+
 rtmp_err_t rtmp_chunk_read_hdr_basic( ringbuffer_t input, byte *format, size_t *id ){
     byte buffer[3];
     if( ringbuffer_copy_read( input, buffer, 1) < 1 ){
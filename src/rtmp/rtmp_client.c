@@ -322,10 +322,10 @@ rtmp_err_t rtmp_client_setdataframe(
                 AMF_STR("encoder", encoder )
             )
     ));
-    amf_print( amf );
 
     rtmp_err_t ret =    err ? rtmp_amferr( err ) :
                         rtmp_stream_send_dat2( rtmp_client_stream( client ), 3, streamid, 0, amf, nullptr );
+    RTMP_LOG( RTMP_LOG_DEBUG, ret, "Sent metadata for stream %zu", streamid );
 
     amf_destroy( amf );
     return ret;
@@ -346,7 +346,21 @@ rtmp_err_t rtmp_client_play( rtmp_client_t client,
     const char *stream_name,
     double start,
     double duration,
-    bool reset );
+    bool reset ){
+    if( stream_name == nullptr ){
+        stream_name = client->playpath;
+    }
+    //Sent on the message stream selected with rtmp_stream_set_msg_stream
+    return rtmp_stream_call2(
+        rtmp_client_stream( client ), 8, client->stream.message_id,
+        "play", nullptr, nullptr, AMF(
+            AMF_NULL(),
+            AMF_STR( stream_name ),
+            AMF_DBL( start ),
+            AMF_DBL( duration ),
+            AMF_BOOL( reset )
+    ));
+}
 
 rtmp_err_t rtmp_client_play2( rtmp_client_t client,
     const char * old_stream_name,
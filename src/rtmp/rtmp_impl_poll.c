@@ -21,10 +21,172 @@
 
 */
 
+
+#include <errno.h>
 #include <openrtmp/rtmp/rtmp_config.h>
+#include <openrtmp/rtmp.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef RTMP_POLLTECH_POLL
-#error "Poll technique is not yet implemented. Implementation shouldn't be too hard."
 
+#include <poll.h>
+
+typedef struct rtmp_pollset{
+    //The sockets handed to poll(), and the pointer registered with each
+    struct pollfd *fds;
+    void **ptrs;
+    size_t count, cap;
+    //Position of each socket in fds plus one, indexed by socket number; 0 if it isn't registered
+    size_t *slots;
+    size_t slots_cap;
+    //Where the next wait starts reporting from, so that sockets late in the set aren't starved when many are ready
+    size_t next;
+} rtmp_pollset_t;
+
+static short poll_flags( int flags ){
+    return ( flags & RTMP_POLL_IN ? POLLIN : 0 ) | ( flags & RTMP_POLL_OUT ? POLLOUT : 0 );
+}
+
+static size_t *pollset_slot( rtmp_pollset_t *set, rtmp_sock_t sock, bool grow ){
+    if( sock < 0 ){
+        return nullptr;
+    }
+    if( (size_t)sock >= set->slots_cap ){
+        if( !grow ){
+            return nullptr;
+        }
+        size_t cap = set->slots_cap ? set->slots_cap : 64;
+        while( cap <= (size_t)sock ){
+            cap *= 2;
+        }
+        size_t *slots = realloc( set->slots, cap * sizeof( size_t ) );
+        if( !slots ){
+            return nullptr;
+        }
+        memset( slots + set->slots_cap, 0, ( cap - set->slots_cap ) * sizeof( size_t ) );
+        set->slots = slots;
+        set->slots_cap = cap;
+    }
+    return &set->slots[sock];
+}
+
+static rtmp_err_t rtmp_poll_create( rtmp_t mgr ){
+    rtmp_pollset_t *set = calloc( 1, sizeof( rtmp_pollset_t ) );
+    if( !set ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    mgr->poller_data = set;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static void rtmp_poll_destroy( rtmp_t mgr ){
+    rtmp_pollset_t *set = mgr->poller_data;
+    free( set->fds );
+    free( set->ptrs );
+    free( set->slots );
+    free( set );
+    mgr->poller_data = nullptr;
+}
+
+static rtmp_err_t rtmp_poll_add( rtmp_t mgr, rtmp_sock_t sock, int flags, void *ptr ){
+    rtmp_pollset_t *set = mgr->poller_data;
+    size_t *slot = pollset_slot( set, sock, true );
+    if( !slot ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    if( *slot ){
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+    if( set->count == set->cap ){
+        size_t cap = set->cap ? set->cap * 2 : 64;
+        struct pollfd *fds = realloc( set->fds, cap * sizeof( struct pollfd ) );
+        if( !fds ){
+            return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+        }
+        set->fds = fds;
+        void **ptrs = realloc( set->ptrs, cap * sizeof( void* ) );
+        if( !ptrs ){
+            return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+        }
+        set->ptrs = ptrs;
+        set->cap = cap;
+    }
+    set->fds[set->count].fd = sock;
+    set->fds[set->count].events = poll_flags( flags );
+    set->fds[set->count].revents = 0;
+    set->ptrs[set->count] = ptr;
+    *slot = ++set->count;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static rtmp_err_t rtmp_poll_modify( rtmp_t mgr, rtmp_sock_t sock, int flags, void *ptr ){
+    rtmp_pollset_t *set = mgr->poller_data;
+    size_t *slot = pollset_slot( set, sock, false );
+    if( !slot || !*slot ){
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+    set->fds[*slot - 1].events = poll_flags( flags );
+    set->ptrs[*slot - 1] = ptr;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static void rtmp_poll_remove( rtmp_t mgr, rtmp_sock_t sock ){
+    rtmp_pollset_t *set = mgr->poller_data;
+    size_t *slot = pollset_slot( set, sock, false );
+    if( !slot || !*slot ){
+        return;
+    }
+    //The last socket takes the removed one's place
+    size_t i = *slot - 1;
+    *slot = 0;
+    if( --set->count != i ){
+        set->fds[i] = set->fds[set->count];
+        set->ptrs[i] = set->ptrs[set->count];
+        set->slots[set->fds[i].fd] = i + 1;
+    }
+}
+
+static int rtmp_poll_wait( rtmp_t mgr, rtmp_poll_event_t *events, size_t max, int timeout ){
+    rtmp_pollset_t *set = mgr->poller_data;
+    RTMP_STAT_ADD( mgr->stats.syscalls, 1 );
+    int ready = poll( set->fds, set->count, timeout );
+    if( ready < 0 ){
+        return errno == EINTR ? 0 : -1;
+    }
+    size_t stored = 0;
+    size_t start = set->next < set->count ? set->next : 0;
+    for( size_t k = 0; k < set->count && ready > 0; ++k ){
+        size_t i = ( start + k ) % set->count;
+        short revents = set->fds[i].revents;
+        if( !revents ){
+            continue;
+        }
+        if( stored == max ){
+            //Level-triggered, so whatever is left over is reported again next time, starting here
+            set->next = i;
+            break;
+        }
+        --ready;
+        events[stored].ptr = set->ptrs[i];
+        events[stored].events = ( revents & POLLIN ? RTMP_POLL_IN : 0 ) |
+                                ( revents & POLLOUT ? RTMP_POLL_OUT : 0 ) |
+                                ( revents & ( POLLERR | POLLHUP | POLLNVAL ) ? RTMP_POLL_ERR : 0 );
+        ++stored;
+    }
+    return stored;
+}
+
+const rtmp_poller_t rtmp_poller_poll = {
+    .backend = RTMP_BACKEND_POLL,
+    .edge = false,
+    .create = rtmp_poll_create,
+    .destroy = rtmp_poll_destroy,
+    .add = rtmp_poll_add,
+    .modify = rtmp_poll_modify,
+    .remove = rtmp_poll_remove,
+    .wait = rtmp_poll_wait
+};
 
 #endif
@@ -21,10 +21,134 @@
 
 */
 
+
+#include <errno.h>
 #include <openrtmp/rtmp/rtmp_config.h>
+#include <openrtmp/rtmp.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <stdlib.h>
 
 #ifdef RTMP_POLLTECH_SELECT
-#error "Select technique is not yet implemented. Implementation shouldn't be too hard."
 
+#include <sys/select.h>
+
+typedef struct rtmp_select{
+    fd_set rfds, wfds;
+    //The pointer registered for each socket, or nullptr if it isn't registered
+    void *ptrs[FD_SETSIZE];
+    //One more than the highest socket registered
+    int nfds;
+    //Where the next wait starts reporting from, so that high sockets aren't starved when many are ready
+    int next;
+} rtmp_select_t;
+
+static void select_set( rtmp_select_t *state, rtmp_sock_t sock, int flags ){
+    if( flags & RTMP_POLL_IN ){
+        FD_SET( sock, &state->rfds );
+    }
+    else{
+        FD_CLR( sock, &state->rfds );
+    }
+    if( flags & RTMP_POLL_OUT ){
+        FD_SET( sock, &state->wfds );
+    }
+    else{
+        FD_CLR( sock, &state->wfds );
+    }
+}
+
+static rtmp_err_t rtmp_select_create( rtmp_t mgr ){
+    rtmp_select_t *state = calloc( 1, sizeof( rtmp_select_t ) );
+    if( !state ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    FD_ZERO( &state->rfds );
+    FD_ZERO( &state->wfds );
+    mgr->poller_data = state;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static void rtmp_select_destroy( rtmp_t mgr ){
+    free( mgr->poller_data );
+    mgr->poller_data = nullptr;
+}
+
+static rtmp_err_t rtmp_select_add( rtmp_t mgr, rtmp_sock_t sock, int flags, void *ptr ){
+    rtmp_select_t *state = mgr->poller_data;
+    if( sock < 0 || sock >= FD_SETSIZE || state->ptrs[sock] ){
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+    state->ptrs[sock] = ptr;
+    select_set( state, sock, flags );
+    if( sock >= state->nfds ){
+        state->nfds = sock + 1;
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static rtmp_err_t rtmp_select_modify( rtmp_t mgr, rtmp_sock_t sock, int flags, void *ptr ){
+    rtmp_select_t *state = mgr->poller_data;
+    if( sock < 0 || sock >= FD_SETSIZE || !state->ptrs[sock] ){
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+    state->ptrs[sock] = ptr;
+    select_set( state, sock, flags );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static void rtmp_select_remove( rtmp_t mgr, rtmp_sock_t sock ){
+    rtmp_select_t *state = mgr->poller_data;
+    if( sock < 0 || sock >= FD_SETSIZE || !state->ptrs[sock] ){
+        return;
+    }
+    state->ptrs[sock] = nullptr;
+    select_set( state, sock, 0 );
+    while( state->nfds > 0 && !state->ptrs[state->nfds - 1] ){
+        --state->nfds;
+    }
+}
+
+static int rtmp_select_wait( rtmp_t mgr, rtmp_poll_event_t *events, size_t max, int timeout ){
+    rtmp_select_t *state = mgr->poller_data;
+    fd_set rfds = state->rfds, wfds = state->wfds;
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = ( timeout % 1000 ) * 1000;
+    RTMP_STAT_ADD( mgr->stats.syscalls, 1 );
+    //select() reports errors and hangups as readiness, so they surface when the socket is read or written
+    int ready = select( state->nfds, &rfds, &wfds, nullptr, timeout < 0 ? nullptr : &tv );
+    if( ready < 0 ){
+        return errno == EINTR ? 0 : -1;
+    }
+    size_t stored = 0;
+    int start = state->next < state->nfds ? state->next : 0;
+    for( int k = 0; k < state->nfds && ready > 0; ++k ){
+        int sock = ( start + k ) % state->nfds;
+        int flags = ( FD_ISSET( sock, &rfds ) ? RTMP_POLL_IN : 0 ) | ( FD_ISSET( sock, &wfds ) ? RTMP_POLL_OUT : 0 );
+        if( !flags ){
+            continue;
+        }
+        if( stored == max ){
+            state->next = sock;
+            break;
+        }
+        ready -= ( flags & RTMP_POLL_IN ? 1 : 0 ) + ( flags & RTMP_POLL_OUT ? 1 : 0 );
+        events[stored].ptr = state->ptrs[sock];
+        events[stored].events = flags;
+        ++stored;
+    }
+    return stored;
+}
+
+const rtmp_poller_t rtmp_poller_select = {
+    .backend = RTMP_BACKEND_SELECT,
+    .edge = false,
+    .create = rtmp_select_create,
+    .destroy = rtmp_select_destroy,
+    .add = rtmp_select_add,
+    .modify = rtmp_select_modify,
+    .remove = rtmp_select_remove,
+    .wait = rtmp_select_wait
+};
 
 #endif
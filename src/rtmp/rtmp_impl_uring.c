@@ -0,0 +1,675 @@
+/*
+    rtmp_impl_uring.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+//The io_uring backend. A manager which uses it has everything rtmp_mgr.c sets up except a readiness backend;
+//rtmp_mgr.c calls in here wherever the two differ. The rings are mapped and driven with
+//the raw system calls, so there is no dependency on liburing.
+//
+//Submissions are only handed to the kernel from rtmp_service, together with the wait for completions. Besides
+//saving system calls, this keeps a pool worker's requests tied to the worker's own thread, which is where the kernel
+//finishes them.
+
+#include <errno.h>
+#include <openrtmp/rtmp/rtmp_config.h>
+#include <openrtmp/rtmp.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/util/ringbuffer.h>
+#include <unistd.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#ifdef RTMP_POLLTECH_IO_URING
+
+#include <linux/io_uring.h>
+
+_Static_assert( ( RTMP_URING_BUFFERS & ( RTMP_URING_BUFFERS - 1 ) ) == 0 && RTMP_URING_BUFFERS <= 32768,
+    "RTMP_URING_BUFFERS must be a power of two no larger than 32768" );
+
+//What a completion is for is kept in the low bits of its user data, under the connection it belongs to, if any
+#define URING_OP_IGNORE     0
+#define URING_OP_RECV       1
+#define URING_OP_SEND       2
+#define URING_OP_ACCEPT     3
+#define URING_OP_INBOX      4
+#define URING_OP_MASK       7
+
+//The group of provided buffers every receive picks from
+#define URING_BUFFER_GROUP  0
+
+struct rtmp_uring{
+    int fd;
+    //Submission queue. Entries are claimed locally, and only published to the kernel when submitting.
+    unsigned *sq_head, *sq_tail, *sq_flags;
+    unsigned sq_mask, sq_entries;
+    unsigned sq_local;
+    struct io_uring_sqe *sqes;
+    //Completion queue
+    unsigned *cq_head, *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *ring;
+    size_t ring_len;
+    size_t sqes_len;
+
+    //Receive buffers, which the kernel picks from as data arrives
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_len;
+    char *buffers;
+    unsigned short buf_tail;
+
+    //Closed connections which still have operations in flight
+    VEC_DECLARE(rtmp_mgr_svr_t) dying;
+};
+
+struct rtmp_uring_conn{
+    //Operations submitted or queued which refer to the connection. Once it is closed, it is freed when this reaches zero.
+    unsigned ops;
+    bool receiving;     //A multishot receive is armed
+    bool cancelling;    //A request to cancel the receive has been queued
+    bool sending;       //A send is in flight, and the output buffer is pinned
+    bool dead;
+    bool leaving;       //Being handed off to another manager, so nothing new is started
+    size_t dying_idx;
+    //Data which arrived while the input buffer was full. It goes into the input ahead of anything received later.
+    ringbuffer_t overflow;
+    struct msghdr msg;
+    rtmp_iovec_t iov[RTMP_MAX_IOV];
+};
+
+
+static int uring_setup( unsigned entries, struct io_uring_params *p ){
+    return (int)syscall( __NR_io_uring_setup, entries, p );
+}
+
+static int uring_enter( int fd, unsigned submit, unsigned wait, unsigned flags, const void *arg, size_t argsz ){
+    return (int)syscall( __NR_io_uring_enter, fd, submit, wait, flags, arg, argsz );
+}
+
+static int uring_register( int fd, unsigned opcode, const void *arg, unsigned count ){
+    return (int)syscall( __NR_io_uring_register, fd, opcode, arg, count );
+}
+
+//Publishes the claimed entries, and enters the kernel to submit them and collect completions
+static int uring_submit( rtmp_t mgr, unsigned wait, unsigned flags, const void *arg, size_t argsz ){
+    struct rtmp_uring *r = mgr->uring;
+    __atomic_store_n( r->sq_tail, r->sq_local, __ATOMIC_RELEASE );
+    unsigned submit = r->sq_local - __atomic_load_n( r->sq_head, __ATOMIC_ACQUIRE );
+    RTMP_STAT_ADD( mgr->stats.syscalls, 1 );
+    return uring_enter( r->fd, submit, wait, flags | IORING_ENTER_GETEVENTS, arg, argsz );
+}
+
+//Claims a cleared submission entry, or returns nullptr if the queue is full even after submitting what is in it
+static struct io_uring_sqe * uring_sqe( rtmp_t mgr, int fd, uint8_t opcode, uint64_t user_data ){
+    struct rtmp_uring *r = mgr->uring;
+    if( r->sq_local - __atomic_load_n( r->sq_head, __ATOMIC_ACQUIRE ) >= r->sq_entries ){
+        uring_submit( mgr, 0, 0, nullptr, 0 );
+        if( r->sq_local - __atomic_load_n( r->sq_head, __ATOMIC_ACQUIRE ) >= r->sq_entries ){
+            return nullptr;
+        }
+    }
+    struct io_uring_sqe *sqe = &r->sqes[r->sq_local & r->sq_mask];
+    memset( sqe, 0, sizeof( *sqe ) );
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+    ++r->sq_local;
+    return sqe;
+}
+
+//Hands a receive buffer back to the kernel
+static void uring_recycle( struct rtmp_uring *r, unsigned short bid ){
+    //The tail shares its memory with the reserved field of the first entry, so that field is never written
+    struct io_uring_buf *buf = &r->buf_ring->bufs[r->buf_tail & ( RTMP_URING_BUFFERS - 1 )];
+    buf->addr = (uintptr_t)( r->buffers + (size_t)bid * RTMP_URING_BUFFER_SIZE );
+    buf->len = RTMP_URING_BUFFER_SIZE;
+    buf->bid = bid;
+    ++r->buf_tail;
+    __atomic_store_n( &r->buf_ring->tail, r->buf_tail, __ATOMIC_RELEASE );
+}
+
+//Multishot receive arrived in the same release as zero-copy send, which unlike it can be probed for
+static bool uring_supported( int fd ){
+    const size_t ops = 256;
+    struct io_uring_probe *probe = calloc( 1, sizeof( struct io_uring_probe ) + ops * sizeof( struct io_uring_probe_op ) );
+    bool supported = probe && uring_register( fd, IORING_REGISTER_PROBE, probe, ops ) >= 0 &&
+        probe->last_op >= IORING_OP_SEND_ZC &&
+        ( probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED ) != 0;
+    free( probe );
+    return supported;
+}
+
+static rtmp_chunk_conn_t uring_conn( rtmp_mgr_svr_t item ){
+    rtmp_stream_t s = rtmp_mgr_item_stream( item );
+    return s ? rtmp_stream_get_conn( s ) : nullptr;
+}
+
+static void uring_arm_accept( rtmp_t mgr ){
+    struct io_uring_sqe *sqe = uring_sqe( mgr, mgr->listen_socket, IORING_OP_ACCEPT, URING_OP_ACCEPT );
+    if( sqe ){
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    }
+}
+
+static void uring_arm_inbox( rtmp_t mgr ){
+    struct io_uring_sqe *sqe = uring_sqe( mgr, mgr->inbox.fd, IORING_OP_POLL_ADD, URING_OP_INBOX );
+    if( sqe ){
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+}
+
+static bool uring_arm_recv( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    struct io_uring_sqe *sqe = uring_sqe( mgr, item->socket, IORING_OP_RECV, (uintptr_t)item | URING_OP_RECV );
+    if( !sqe ){
+        return false;
+    }
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    item->uring->receiving = true;
+    ++item->uring->ops;
+    return true;
+}
+
+static void uring_cancel_recv( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    struct rtmp_uring_conn *u = item->uring;
+    if( !u->receiving || u->cancelling ){
+        return;
+    }
+    struct io_uring_sqe *sqe = uring_sqe( mgr, -1, IORING_OP_ASYNC_CANCEL, URING_OP_IGNORE );
+    if( sqe ){
+        sqe->addr = (uintptr_t)item | URING_OP_RECV;
+        u->cancelling = true;
+    }
+}
+
+//Sends the first count descriptors in the connection's iov. The output stays pinned until the send completes.
+static bool uring_send( rtmp_t mgr, rtmp_mgr_svr_t item, rtmp_chunk_conn_t conn, size_t count ){
+    struct rtmp_uring_conn *u = item->uring;
+    struct io_uring_sqe *sqe = uring_sqe( mgr, item->socket, IORING_OP_SENDMSG, (uintptr_t)item | URING_OP_SEND );
+    if( !sqe ){
+        return false;
+    }
+    memset( &u->msg, 0, sizeof( u->msg ) );
+    u->msg.msg_iov = u->iov;
+    u->msg.msg_iovlen = count;
+    sqe->addr = (uintptr_t)&u->msg;
+    sqe->len = 1;
+    //The kernel keeps sending until everything is out, so a short send never has to be resubmitted
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    rtmp_chunk_conn_pin_out_buff( conn, true );
+    u->sending = true;
+    ++u->ops;
+    return true;
+}
+
+//Moves as much of the overflow into the input as fits. Returns the number of bytes moved.
+static size_t uring_flush_overflow( struct rtmp_uring_conn *u, rtmp_chunk_conn_t conn ){
+    size_t moved = 0;
+    while( u->overflow && ringbuffer_count( u->overflow ) > 0 ){
+        void *buffer;
+        size_t size;
+        unsigned long avail;
+        const void *src = ringbuffer_get_read_buf( u->overflow, &avail );
+        if( rtmp_chunk_conn_get_in_buff( conn, &buffer, &size ) != RTMP_ERR_NONE || size == 0 ){
+            break;
+        }
+        if( size > avail ){
+            size = avail;
+        }
+        memcpy( buffer, src, size );
+        rtmp_chunk_conn_commit_in_buff( conn, size );
+        ringbuffer_commit_read( u->overflow, size );
+        moved += size;
+    }
+    return moved;
+}
+
+static bool uring_has_overflow( struct rtmp_uring_conn *u ){
+    return u->overflow && ringbuffer_count( u->overflow ) > 0;
+}
+
+//Copies received data into the input, keeping whatever doesn't fit for later and stopping the receive until it does
+static void uring_deliver( rtmp_t mgr, rtmp_mgr_svr_t item, const char *data, size_t len ){
+    struct rtmp_uring_conn *u = item->uring;
+    rtmp_chunk_conn_t conn = uring_conn( item );
+    if( !conn ){
+        return;
+    }
+    while( len > 0 && !uring_has_overflow( u ) ){
+        void *buffer;
+        size_t size;
+        if( rtmp_chunk_conn_get_in_buff( conn, &buffer, &size ) != RTMP_ERR_NONE || size == 0 ){
+            break;
+        }
+        if( size > len ){
+            size = len;
+        }
+        memcpy( buffer, data, size );
+        rtmp_chunk_conn_commit_in_buff( conn, size );
+        data += size;
+        len -= size;
+    }
+    if( len == 0 ){
+        return;
+    }
+    if( !u->overflow ){
+        u->overflow = ringbuffer_create( RTMP_URING_BUFFER_SIZE );
+    }
+    if( u->overflow && ringbuffer_reserve( u->overflow, len ) >= len ){
+        ringbuffer_copy_write( u->overflow, data, len );
+    }
+    else{
+        RTMP_LOG( RTMP_LOG_ERROR, RTMP_ERR_OOM, "Dropped %zu received bytes on socket %d", len, item->socket );
+    }
+    uring_cancel_recv( mgr, item );
+}
+
+static void uring_free( rtmp_mgr_svr_t item ){
+    close( item->socket );
+    if( item->uring->overflow ){
+        ringbuffer_destroy( item->uring->overflow );
+    }
+    free( item->uring );
+    slab_free( item );
+}
+
+//Frees a closed connection once nothing in flight refers to it anymore
+static void uring_reap( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    struct rtmp_uring_conn *u = item->uring;
+    if( !u->dead || u->ops > 0 ){
+        return;
+    }
+    struct rtmp_uring *r = mgr->uring;
+    if( u->dying_idx < VEC_SIZE( r->dying ) && r->dying[u->dying_idx] == item ){
+        rtmp_mgr_svr_t last = VEC_BACK( r->dying );
+        r->dying[u->dying_idx] = last;
+        last->uring->dying_idx = u->dying_idx;
+        VEC_POP( r->dying );
+    }
+    uring_free( item );
+}
+
+static rtmp_err_t uring_on_recv( rtmp_t mgr, rtmp_mgr_svr_t item, const struct io_uring_cqe *cqe ){
+    struct rtmp_uring *r = mgr->uring;
+    struct rtmp_uring_conn *u = item->uring;
+    rtmp_err_t err = RTMP_ERR_NONE;
+    if( !( cqe->flags & IORING_CQE_F_MORE ) ){
+        u->receiving = u->cancelling = false;
+        --u->ops;
+    }
+    const char *data = nullptr;
+    unsigned short bid = 0;
+    if( cqe->flags & IORING_CQE_F_BUFFER ){
+        bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        data = r->buffers + (size_t)bid * RTMP_URING_BUFFER_SIZE;
+    }
+    if( u->dead ){
+        uring_reap( mgr, item );
+    }
+    else if( cqe->res > 0 && data ){
+        uring_deliver( mgr, item, data, cqe->res );
+        rtmp_mgr_queue( mgr, item );
+    }
+    else if( cqe->res == -ENOBUFS || cqe->res == -ECANCELED ){
+        //Every buffer was in use, or the input filled up; the receive is armed again once the connection is drained
+        rtmp_mgr_queue( mgr, item );
+    }
+    else{
+        err = rtmp_mgr_close( mgr, item, cqe->res == 0 ? "peer closed" : "receive failed" );
+    }
+    if( data ){
+        uring_recycle( r, bid );
+    }
+    return err;
+}
+
+static rtmp_err_t uring_on_send( rtmp_t mgr, rtmp_mgr_svr_t item, const struct io_uring_cqe *cqe ){
+    struct rtmp_uring_conn *u = item->uring;
+    --u->ops;
+    u->sending = false;
+    if( u->dead ){
+        uring_reap( mgr, item );
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    rtmp_chunk_conn_t conn = uring_conn( item );
+    if( conn ){
+        rtmp_chunk_conn_pin_out_buff( conn, false );
+    }
+    if( cqe->res <= 0 || !conn ){
+        return rtmp_mgr_close( mgr, item, "send failed" );
+    }
+    rtmp_chunk_conn_commit_out_buff( conn, cqe->res );
+    rtmp_mgr_queue( mgr, item );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static rtmp_err_t uring_on_accept( rtmp_t mgr, const struct io_uring_cqe *cqe ){
+    rtmp_err_t err = RTMP_ERR_NONE;
+    if( cqe->res >= 0 ){
+        err = rtmp_mgr_accept( mgr, cqe->res );
+    }
+    if( cqe->flags & IORING_CQE_F_MORE ){
+        return err;
+    }
+    //A multishot accept also stops on errors like running out of descriptors; only give up if the socket itself failed
+    if( cqe->res == -EBADF || cqe->res == -EINVAL || cqe->res == -ENOTSOCK ){
+        shutdown( mgr->listen_socket, SHUT_RDWR );
+        close( mgr->listen_socket );
+        mgr->listen_socket = 0;
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+    uring_arm_accept( mgr );
+    return err;
+}
+
+static rtmp_err_t uring_on_inbox( rtmp_t mgr, const struct io_uring_cqe *cqe ){
+    if( !( cqe->flags & IORING_CQE_F_MORE ) ){
+        uring_arm_inbox( mgr );
+    }
+    return rtmp_mgr_handle_inbox( mgr );
+}
+
+
+rtmp_err_t rtmp_uring_create( rtmp_t mgr ){
+    struct rtmp_uring *r = calloc( 1, sizeof( struct rtmp_uring ) );
+    if( !r ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    r->ring = MAP_FAILED;
+    r->sqes = MAP_FAILED;
+    r->buf_ring = MAP_FAILED;
+    struct io_uring_params p;
+    memset( &p, 0, sizeof( p ) );
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+    p.cq_entries = RTMP_URING_ENTRIES * 4;
+    r->fd = uring_setup( RTMP_URING_ENTRIES, &p );
+    const uint32_t features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if( r->fd < 0 || ( p.features & features ) != features || !uring_supported( r->fd ) ){
+        goto fail;
+    }
+
+    size_t sq_len = p.sq_off.array + p.sq_entries * sizeof( unsigned );
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof( struct io_uring_cqe );
+    r->ring_len = sq_len > cq_len ? sq_len : cq_len;
+    r->ring = mmap( nullptr, r->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING );
+    r->sqes_len = p.sq_entries * sizeof( struct io_uring_sqe );
+    r->sqes = mmap( nullptr, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES );
+    if( r->ring == MAP_FAILED || r->sqes == MAP_FAILED ){
+        goto fail;
+    }
+    char *ring = r->ring;
+    r->sq_head = (unsigned*)( ring + p.sq_off.head );
+    r->sq_tail = (unsigned*)( ring + p.sq_off.tail );
+    r->sq_flags = (unsigned*)( ring + p.sq_off.flags );
+    r->sq_mask = *(unsigned*)( ring + p.sq_off.ring_mask );
+    r->sq_entries = p.sq_entries;
+    r->sq_local = *r->sq_tail;
+    r->cq_head = (unsigned*)( ring + p.cq_off.head );
+    r->cq_tail = (unsigned*)( ring + p.cq_off.tail );
+    r->cq_mask = *(unsigned*)( ring + p.cq_off.ring_mask );
+    r->cqes = (struct io_uring_cqe*)( ring + p.cq_off.cqes );
+    //Each submission slot always holds the entry of the same index
+    unsigned *array = (unsigned*)( ring + p.sq_off.array );
+    for( unsigned i = 0; i < p.sq_entries; ++i ){
+        array[i] = i;
+    }
+
+    r->buf_ring_len = RTMP_URING_BUFFERS * sizeof( struct io_uring_buf );
+    r->buf_ring = mmap( nullptr, r->buf_ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    r->buffers = malloc( (size_t)RTMP_URING_BUFFERS * RTMP_URING_BUFFER_SIZE );
+    VEC_INIT( r->dying );
+    if( r->buf_ring == MAP_FAILED || !r->buffers || !r->dying ){
+        goto fail;
+    }
+    struct io_uring_buf_reg reg;
+    memset( &reg, 0, sizeof( reg ) );
+    reg.ring_addr = (uintptr_t)r->buf_ring;
+    reg.ring_entries = RTMP_URING_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if( uring_register( r->fd, IORING_REGISTER_PBUF_RING, &reg, 1 ) < 0 ){
+        goto fail;
+    }
+    for( unsigned i = 0; i < RTMP_URING_BUFFERS; ++i ){
+        uring_recycle( r, i );
+    }
+
+    mgr->uring = r;
+    uring_arm_inbox( mgr );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+
+    fail:
+    mgr->uring = r;
+    rtmp_uring_destroy( mgr );
+    return RTMP_ERR_POLL_FAIL;
+}
+
+void rtmp_uring_destroy( rtmp_t mgr ){
+    struct rtmp_uring *r = mgr->uring;
+    if( !r ){
+        return;
+    }
+    //Closing the ring cancels whatever is still in flight
+    if( r->fd >= 0 ){
+        close( r->fd );
+    }
+    if( r->dying ){
+        VEC_DESTROY_DTOR( r->dying, uring_free );
+    }
+    //The connections themselves are destroyed by the manager
+    for( size_t i = 0; mgr->servers && i < handle_table_count( mgr->servers ); ++i ){
+        rtmp_mgr_svr_t item = handle_table_at( mgr->servers, i );
+        if( item->uring ){
+            if( item->uring->overflow ){
+                ringbuffer_destroy( item->uring->overflow );
+            }
+            free( item->uring );
+            item->uring = nullptr;
+        }
+    }
+    if( r->ring != MAP_FAILED ){
+        munmap( r->ring, r->ring_len );
+    }
+    if( r->sqes != MAP_FAILED ){
+        munmap( r->sqes, r->sqes_len );
+    }
+    if( r->buf_ring != MAP_FAILED ){
+        munmap( r->buf_ring, r->buf_ring_len );
+    }
+    free( r->buffers );
+    free( r );
+    mgr->uring = nullptr;
+}
+
+rtmp_err_t rtmp_uring_listen( rtmp_t mgr ){
+    uring_arm_accept( mgr );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_uring_add( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    item->uring = calloc( 1, sizeof( struct rtmp_uring_conn ) );
+    if( !item->uring ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    //The receive is armed when the connection is first drained, once it's known there is room for input.
+    //A client has its handshake to send before the server says anything.
+    rtmp_mgr_queue( mgr, item );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+void rtmp_uring_remove( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    struct rtmp_uring_conn *u = item->uring;
+    rtmp_chunk_conn_t conn = uring_conn( item );
+    if( u->sending && conn ){
+        rtmp_chunk_conn_pin_out_buff( conn, false );
+    }
+    //Operations in flight finish quickly once the socket is shut down. It is only closed once they have, so that its
+    //descriptor can't be reused by a new connection while a queued submission still names it.
+    shutdown( item->socket, SHUT_RDWR );
+    uring_cancel_recv( mgr, item );
+    u->dead = true;
+}
+
+void rtmp_uring_release( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    if( item->uring->ops == 0 ){
+        uring_free( item );
+        return;
+    }
+    struct rtmp_uring *r = mgr->uring;
+    rtmp_mgr_svr_t *loc = VEC_PUSH( r->dying );
+    if( loc ){
+        *loc = item;
+        item->uring->dying_idx = VEC_SIZE( r->dying ) - 1;
+    }
+}
+
+bool rtmp_uring_detach( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    struct rtmp_uring_conn *u = item->uring;
+    u->leaving = true;
+    uring_cancel_recv( mgr, item );
+    if( u->ops > 0 ){
+        return false;
+    }
+    rtmp_chunk_conn_t conn = uring_conn( item );
+    if( conn && uring_has_overflow( u ) ){
+        rtmp_chunk_conn_service( conn );
+        uring_flush_overflow( u, conn );
+    }
+    if( uring_has_overflow( u ) ){
+        return false;
+    }
+    if( u->overflow ){
+        ringbuffer_destroy( u->overflow );
+    }
+    free( u );
+    item->uring = nullptr;
+    return true;
+}
+
+int rtmp_uring_wait( rtmp_t mgr, int timeout ){
+    struct rtmp_uring *r = mgr->uring;
+    unsigned ready = __atomic_load_n( r->cq_tail, __ATOMIC_ACQUIRE ) - *r->cq_head;
+    bool queued = r->sq_local != __atomic_load_n( r->sq_head, __ATOMIC_ACQUIRE );
+    unsigned flags = __atomic_load_n( r->sq_flags, __ATOMIC_RELAXED );
+    bool wait = ready == 0 && timeout != 0;
+    //Completions which are waiting on the kernel to finish them, or which didn't fit in the queue, need a system call too
+    if( !queued && !wait && !( flags & ( IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW ) ) ){
+        return ready;
+    }
+    int ret;
+    if( wait && timeout > 0 ){
+        struct __kernel_timespec ts;
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = ( timeout % 1000 ) * 1000000L;
+        struct io_uring_getevents_arg arg;
+        memset( &arg, 0, sizeof( arg ) );
+        arg.ts = (uintptr_t)&ts;
+        ret = uring_submit( mgr, 1, IORING_ENTER_EXT_ARG, &arg, sizeof( arg ) );
+    }
+    else{
+        ret = uring_submit( mgr, wait ? 1 : 0, 0, nullptr, 0 );
+    }
+    if( ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN ){
+        return -1;
+    }
+    return __atomic_load_n( r->cq_tail, __ATOMIC_ACQUIRE ) - *r->cq_head;
+}
+
+rtmp_err_t rtmp_uring_dispatch( rtmp_t mgr ){
+    struct rtmp_uring *r = mgr->uring;
+    rtmp_err_t err = RTMP_ERR_NONE;
+    unsigned head = *r->cq_head;
+    while( head != __atomic_load_n( r->cq_tail, __ATOMIC_ACQUIRE ) ){
+        //Release the entry before handling it, since handling it may need to enter the kernel
+        struct io_uring_cqe cqe = r->cqes[head & r->cq_mask];
+        __atomic_store_n( r->cq_head, ++head, __ATOMIC_RELEASE );
+        rtmp_mgr_svr_t item = (rtmp_mgr_svr_t)(uintptr_t)( cqe.user_data & ~(uint64_t)URING_OP_MASK );
+        rtmp_err_t ret = RTMP_ERR_NONE;
+        switch( cqe.user_data & URING_OP_MASK ){
+        case URING_OP_RECV:
+            ret = uring_on_recv( mgr, item, &cqe );
+            break;
+        case URING_OP_SEND:
+            ret = uring_on_send( mgr, item, &cqe );
+            break;
+        case URING_OP_ACCEPT:
+            ret = uring_on_accept( mgr, &cqe );
+            break;
+        case URING_OP_INBOX:
+            ret = uring_on_inbox( mgr, &cqe );
+            break;
+        default:
+            break;
+        }
+        if( err == RTMP_ERR_NONE ){
+            err = ret;
+        }
+    }
+    return err;
+}
+
+rtmp_err_t rtmp_uring_drain( rtmp_t mgr, rtmp_mgr_svr_t item, bool *more ){
+    struct rtmp_uring_conn *u = item->uring;
+    rtmp_chunk_conn_t conn = uring_conn( item );
+    *more = false;
+    if( !conn ){
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    //Anything the connection queues for itself meanwhile is handled here
+    item->pending = true;
+    do{
+        if( rtmp_chunk_conn_service( conn ) >= RTMP_ERR_FATAL ){
+            item->closing = true;
+        }
+    }while( uring_flush_overflow( u, conn ) > 0 );
+
+    if( !u->sending && !u->leaving ){
+        size_t count = 0;
+        rtmp_chunk_conn_get_out_iov( conn, u->iov, RTMP_MAX_IOV, &count );
+        if( count > 0 ){
+            if( !uring_send( mgr, item, conn, count ) ){
+                *more = true;
+            }
+        }
+        else if( item->closing ){
+            return rtmp_mgr_close( mgr, item, "finished closing" );
+        }
+    }
+    //Only receive while there is room for the data. The emptied event queues the connection again once there is.
+    if( !u->receiving && !u->leaving && !item->closing && !uring_has_overflow( u ) ){
+        void *buffer;
+        size_t size;
+        if( rtmp_chunk_conn_get_in_buff( conn, &buffer, &size ) == RTMP_ERR_NONE && size > 0 && !uring_arm_recv( mgr, item ) ){
+            *more = true;
+        }
+    }
+    item->pending = false;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+#endif
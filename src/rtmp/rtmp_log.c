@@ -0,0 +1,227 @@
+/*
+    rtmp_log.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <openrtmp/rtmp/rtmp_log.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/rtmp/rtmp_debug.h>
+
+#define RTMP_LOG_MASK (RTMP_LOG_QUEUE_SIZE - 1)
+
+//A slot is free for the producer at position pos when its sequence is pos, and holds a record for
+//the consumer at position pos once its sequence is pos + 1. The sequence is stored relative to
+//the slot index, so that the zero initialized queue starts out with every slot free.
+typedef struct rtmp_log_record{
+    size_t sequence;
+    rtmp_err_t err;
+    size_t line;
+    const char *file;
+    char message[RTMP_LOG_MESSAGE_MAX];
+} rtmp_log_record_t;
+
+typedef struct rtmp_log_sink{
+    rtmp_log_proc proc;
+    void *user;
+} rtmp_log_sink_t;
+
+static struct{
+    rtmp_log_record_t records[RTMP_LOG_QUEUE_SIZE];
+    //Next position claimed by a producer
+    size_t head;
+    //Next position delivered; only touched while holding drain_lock
+    size_t tail;
+    size_t dropped;
+
+    rtmp_log_sink_t sinks[RTMP_LOG_SINKS_MAX];
+    size_t sink_count;
+    pthread_mutex_t sink_lock;
+
+    pthread_mutex_t drain_lock;
+    pthread_t thread;
+    bool running;
+} rtmp_log = {
+    .sink_lock = PTHREAD_MUTEX_INITIALIZER,
+    .drain_lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+rtmp_log_level_t rtmp_log_threshold = RTMP_LOG_WARNING;
+
+
+void rtmp_log_set_level( rtmp_log_level_t level ){
+    __atomic_store_n( &rtmp_log_threshold, level, __ATOMIC_RELAXED );
+}
+
+rtmp_log_level_t rtmp_log_get_level( void ){
+    return __atomic_load_n( &rtmp_log_threshold, __ATOMIC_RELAXED );
+}
+
+size_t rtmp_log_dropped( void ){
+    return __atomic_load_n( &rtmp_log.dropped, __ATOMIC_RELAXED );
+}
+
+rtmp_err_t rtmp_log_add_sink( rtmp_log_proc proc, void *user ){
+    if( !proc ){
+        return RTMP_ERR_INVALID;
+    }
+    rtmp_err_t ret = RTMP_ERR_NONE;
+    pthread_mutex_lock( &rtmp_log.sink_lock );
+    size_t count = rtmp_log.sink_count;
+    if( count >= RTMP_LOG_SINKS_MAX ){
+        ret = RTMP_ERR_OOM;
+    }
+    else{
+        rtmp_log.sinks[count].proc = proc;
+        rtmp_log.sinks[count].user = user;
+        __atomic_store_n( &rtmp_log.sink_count, count + 1, __ATOMIC_RELEASE );
+    }
+    pthread_mutex_unlock( &rtmp_log.sink_lock );
+    return ret;
+}
+
+void rtmp_log_print( rtmp_err_t err, size_t line, const char* restrict file, const char* restrict message, void * restrict user ){
+    const char *kind;
+    if( err >= RTMP_ERR_FATAL ){
+        kind = "Fatal error";
+    }
+    else if( err >= RTMP_ERR_ERROR && err != RTMP_ERR_AGAIN ){
+        kind = "Error";
+    }
+    else if( err != RTMP_ERR_NONE && err != RTMP_ERR_AGAIN && err != RTMP_ERR_NOT_READY ){
+        kind = "Warning";
+    }
+    else{
+        kind = "Notice";
+    }
+    printf( "%s:%zd %s %s (%s)\n", file, line, kind, rtmp_get_err_name( err ), message );
+}
+
+void rtmp_log_write( rtmp_log_level_t level, rtmp_err_t err, size_t line, const char *file, const char *format, ... ){
+    rtmp_log_record_t *record;
+    size_t pos = __atomic_load_n( &rtmp_log.head, __ATOMIC_RELAXED );
+    while( true ){
+        record = &rtmp_log.records[pos & RTMP_LOG_MASK];
+        size_t sequence = __atomic_load_n( &record->sequence, __ATOMIC_ACQUIRE ) + ( pos & RTMP_LOG_MASK );
+        intptr_t diff = (intptr_t)( sequence - pos );
+        if( diff == 0 ){
+            if( __atomic_compare_exchange_n( &rtmp_log.head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ){
+                break;
+            }
+        }
+        else if( diff < 0 ){
+            //The consumer hasn't caught up; never block the caller
+            __atomic_add_fetch( &rtmp_log.dropped, 1, __ATOMIC_RELAXED );
+            return;
+        }
+        else{
+            pos = __atomic_load_n( &rtmp_log.head, __ATOMIC_RELAXED );
+        }
+    }
+
+    record->err = err;
+    record->line = line;
+    record->file = file;
+    va_list list;
+    va_start( list, format );
+    vsnprintf( record->message, sizeof( record->message ), format, list );
+    va_end( list );
+
+    __atomic_store_n( &record->sequence, pos + 1 - ( pos & RTMP_LOG_MASK ), __ATOMIC_RELEASE );
+}
+
+//Must hold drain_lock
+static size_t rtmp_log_drain_locked( void ){
+    size_t delivered = 0;
+    size_t sink_count = __atomic_load_n( &rtmp_log.sink_count, __ATOMIC_ACQUIRE );
+    while( true ){
+        size_t pos = rtmp_log.tail;
+        rtmp_log_record_t *record = &rtmp_log.records[pos & RTMP_LOG_MASK];
+        size_t sequence = __atomic_load_n( &record->sequence, __ATOMIC_ACQUIRE ) + ( pos & RTMP_LOG_MASK );
+        if( sequence != pos + 1 ){
+            //Empty, or the next record is still being written
+            break;
+        }
+        if( sink_count == 0 ){
+            rtmp_log_print( record->err, record->line, record->file, record->message, nullptr );
+        }
+        for( size_t i = 0; i < sink_count; ++i ){
+            rtmp_log.sinks[i].proc( record->err, record->line, record->file, record->message, rtmp_log.sinks[i].user );
+        }
+        __atomic_store_n( &record->sequence, pos + RTMP_LOG_QUEUE_SIZE - ( pos & RTMP_LOG_MASK ), __ATOMIC_RELEASE );
+        rtmp_log.tail = pos + 1;
+        ++delivered;
+    }
+    return delivered;
+}
+
+size_t rtmp_log_drain( void ){
+    if( pthread_mutex_trylock( &rtmp_log.drain_lock ) != 0 ){
+        return 0;
+    }
+    size_t delivered = rtmp_log_drain_locked();
+    pthread_mutex_unlock( &rtmp_log.drain_lock );
+    return delivered;
+}
+
+//Called by each manager as it services its connections
+void rtmp_log_service( void ){
+    if( !__atomic_load_n( &rtmp_log.running, __ATOMIC_RELAXED ) ){
+        rtmp_log_drain();
+    }
+}
+
+static void * rtmp_log_thread_proc( void *user ){
+    struct timespec interval = { 0, RTMP_LOG_DRAIN_INTERVAL * 1000000L };
+    while( __atomic_load_n( &rtmp_log.running, __ATOMIC_ACQUIRE ) ){
+        if( rtmp_log_drain() == 0 ){
+            nanosleep( &interval, nullptr );
+        }
+    }
+    return nullptr;
+}
+
+rtmp_err_t rtmp_log_start( void ){
+    if( __atomic_load_n( &rtmp_log.running, __ATOMIC_ACQUIRE ) ){
+        return RTMP_ERR_NONE;
+    }
+    __atomic_store_n( &rtmp_log.running, true, __ATOMIC_RELEASE );
+    if( pthread_create( &rtmp_log.thread, nullptr, rtmp_log_thread_proc, nullptr ) != 0 ){
+        __atomic_store_n( &rtmp_log.running, false, __ATOMIC_RELEASE );
+        return RTMP_ERR_ERROR;
+    }
+    return RTMP_ERR_NONE;
+}
+
+void rtmp_log_stop( void ){
+    if( !__atomic_load_n( &rtmp_log.running, __ATOMIC_ACQUIRE ) ){
+        return;
+    }
+    __atomic_store_n( &rtmp_log.running, false, __ATOMIC_RELEASE );
+    pthread_join( rtmp_log.thread, nullptr );
+    pthread_mutex_lock( &rtmp_log.drain_lock );
+    rtmp_log_drain_locked();
+    pthread_mutex_unlock( &rtmp_log.drain_lock );
+}
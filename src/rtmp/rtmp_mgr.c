@@ -0,0 +1,1181 @@
+/*
+    rtmp_mgr.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <errno.h>
+#include <openrtmp/rtmp/rtmp_config.h>
+#include <openrtmp/rtmp.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/util/memutil.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+
+
+//Readiness backends in the order RTMP_BACKEND_AUTO prefers them, after io_uring
+static const rtmp_poller_t *mgr_pollers[] = {
+    #ifdef RTMP_POLLTECH_EPOLL
+    &rtmp_poller_epoll,
+    #endif
+    #ifdef RTMP_POLLTECH_POLL
+    &rtmp_poller_poll,
+    #endif
+    #ifdef RTMP_POLLTECH_SELECT
+    &rtmp_poller_select,
+    #endif
+    nullptr
+};
+
+rtmp_t rtmp_create( void ){
+    rtmp_t mgr = calloc( 1, sizeof( struct rtmp_mgr ) );
+    if( !mgr ){
+        return nullptr;
+    }
+    mgr->type = RTMP_T_RTMP_T;
+    mgr->servers = handle_table_create();
+    VEC_INIT(mgr->handoffs);
+    VEC_INIT(mgr->pending);
+    mgr->edge_triggered = RTMP_EPOLL_EDGE_TRIGGERED;
+    mgr->timers = timer_wheel_create( rtmp_get_time() );
+    mgr->handshake_timeout = RTMP_HANDSHAKE_TIMEOUT;
+    mgr->ping_interval = RTMP_PING_INTERVAL;
+    mgr->idle_timeout = RTMP_IDLE_TIMEOUT;
+    mgr->io_budget.limit = RTMP_DEFAULT_MEMORY_BUDGET;
+    mgr->server_pool = rtmp_server_pool_create( RTMP_CONN_SLAB_SIZE );
+    mgr->item_pool = slab_pool_create( sizeof( struct rtmp_mgr_svr ), RTMP_CONN_SLAB_SIZE );
+    VEC_INIT(mgr->spare_servers);
+
+    //The inbox wakes up the backend's wait whenever another thread posts a task
+    mgr->inbox.type = RTMP_T_INBOX_T;
+    mgr->inbox.fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    pthread_mutex_init( &mgr->inbox.lock, nullptr );
+    VEC_INIT(mgr->inbox.tasks);
+
+    if( mgr->inbox.fd < 0 || !mgr->servers || !mgr->server_pool || !mgr->item_pool || !mgr->spare_servers || !mgr->pending || !mgr->timers ||
+        rtmp_set_backend( mgr, RTMP_DEFAULT_BACKEND ) >= RTMP_ERR_ERROR ||
+        rtmp_stats_register( mgr ) >= RTMP_ERR_ERROR ){
+        rtmp_destroy( mgr );
+        return nullptr;
+    }
+    return mgr;
+}
+
+static void destroy_server(rtmp_mgr_svr_t stream){
+    if( !stream ){
+        return;
+    }
+    if( stream->type == RTMP_T_SERVER_T ){
+        rtmp_server_destroy( stream->server );
+    }
+    else if( stream->type == RTMP_T_CLIENT_T ){
+        rtmp_client_destroy( stream->client );
+    }
+    close( stream->socket );
+    slab_free( stream );
+}
+
+void rtmp_destroy( rtmp_t mgr ){
+    #ifdef RTMP_POLLTECH_IO_URING
+    rtmp_uring_destroy( mgr );
+    #endif
+    if( mgr->servers ){
+        for( size_t i = 0; i < handle_table_count( mgr->servers ); ++i ){
+            destroy_server( handle_table_at( mgr->servers, i ) );
+        }
+        handle_table_destroy( mgr->servers );
+        mgr->servers = nullptr;
+    }
+    VEC_DESTROY_DTOR( mgr->handoffs, free );
+    if( mgr->spare_servers ){
+        VEC_DESTROY_DTOR( mgr->spare_servers, rtmp_server_destroy );
+    }
+    VEC_DESTROY( mgr->pending );
+    //Tasks which were never run are dropped
+    VEC_DESTROY( mgr->inbox.tasks );
+    pthread_mutex_destroy( &mgr->inbox.lock );
+    if( mgr->listen_socket > 0 ){
+        close( mgr->listen_socket );
+    }
+    if( mgr->poller ){
+        mgr->poller->destroy( mgr );
+    }
+    if( mgr->inbox.fd >= 0 ){
+        close( mgr->inbox.fd );
+    }
+    rtmp_stats_unregister( mgr );
+    //Servers that were handed off to other managers may still be using the pool; it goes away with the last of them
+    slab_pool_destroy( mgr->server_pool );
+    slab_pool_destroy( mgr->item_pool );
+    //Streams take their timers off the wheel when they are destroyed, so it has to go last
+    timer_wheel_destroy( mgr->timers );
+    free( mgr );
+}
+
+static void mgr_poller_close( rtmp_t mgr ){
+    if( mgr->poller ){
+        mgr->poller->destroy( mgr );
+        mgr->poller = nullptr;
+    }
+}
+
+//Switches to a readiness backend and registers the inbox with it. The current backend is kept if the new one fails.
+static rtmp_err_t mgr_poller_open( rtmp_t mgr, const rtmp_poller_t *poller ){
+    if( mgr->poller == poller ){
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    const rtmp_poller_t *old = mgr->poller;
+    void *old_data = mgr->poller_data;
+    mgr->poller = poller;
+    mgr->poller_data = nullptr;
+    rtmp_err_t err = poller->create( mgr );
+    if( err < RTMP_ERR_ERROR ){
+        err = poller->add( mgr, mgr->inbox.fd, RTMP_POLL_IN, &mgr->inbox );
+        if( err >= RTMP_ERR_ERROR ){
+            poller->destroy( mgr );
+        }
+    }
+    if( err >= RTMP_ERR_ERROR ){
+        mgr->poller = old;
+        mgr->poller_data = old_data;
+        return err;
+    }
+    if( old ){
+        void *data = mgr->poller_data;
+        mgr->poller_data = old_data;
+        old->destroy( mgr );
+        mgr->poller_data = data;
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_set_backend( rtmp_t mgr, rtmp_backend_t backend ){
+    if( handle_table_count( mgr->servers ) > 0 || mgr->listen_socket > 0 ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
+    }
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( backend == RTMP_BACKEND_AUTO || backend == RTMP_BACKEND_IO_URING ){
+        if( mgr->uring || rtmp_uring_create( mgr ) == RTMP_ERR_NONE ){
+            //io_uring watches the inbox itself
+            mgr_poller_close( mgr );
+            return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+        }
+    }
+    #endif
+    for( size_t i = 0; mgr_pollers[i]; ++i ){
+        if( backend != RTMP_BACKEND_AUTO && backend != mgr_pollers[i]->backend ){
+            continue;
+        }
+        rtmp_err_t err = mgr_poller_open( mgr, mgr_pollers[i] );
+        if( err >= RTMP_ERR_ERROR ){
+            return err;
+        }
+        #ifdef RTMP_POLLTECH_IO_URING
+        rtmp_uring_destroy( mgr );
+        #endif
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+}
+
+rtmp_backend_t rtmp_get_backend( rtmp_t mgr ){
+    return mgr->uring ? RTMP_BACKEND_IO_URING : mgr->poller->backend;
+}
+
+rtmp_stream_t rtmp_mgr_item_stream( rtmp_mgr_svr_t item ){
+    if( item->type == RTMP_T_SERVER_T ){
+        return rtmp_server_stream( item->server );
+    }
+    return rtmp_client_stream( item->client );
+}
+
+static inline void count_syscall( rtmp_t mgr ){
+    RTMP_STAT_ADD( mgr->stats.syscalls, 1 );
+}
+
+//Whether new connections should be edge-triggered
+static bool mgr_edge( rtmp_t mgr ){
+    return mgr->edge_triggered && !mgr->uring && mgr->poller->edge;
+}
+
+//Queues an edge-triggered connection to be drained before the manager next waits for events
+void rtmp_mgr_queue( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    if( item->pending ){
+        return;
+    }
+    rtmp_mgr_svr_t *loc = VEC_PUSH( mgr->pending );
+    if( loc ){
+        *loc = item;
+        item->pending = true;
+    }
+}
+
+static void stream_unqueue( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    for( size_t i = 0; i < VEC_SIZE(mgr->pending); ++i ){
+        if( mgr->pending[i] == item ){
+            mgr->pending[i] = nullptr;
+        }
+    }
+    item->pending = false;
+}
+
+//Returns a closed connection's memory to the pool. io_uring may still be finishing operations which refer to it.
+static void stream_free( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( item->uring ){
+        rtmp_uring_release( mgr, item );
+        return;
+    }
+    #endif
+    slab_free( item );
+}
+
+//Fires the refresh event, and services the connection in case the callbacks left it something to do
+static void stream_refresh( timer_entry_t *timer, void *user ){
+    rtmp_mgr_svr_t item = user;
+    rtmp_stream_t stream = rtmp_mgr_item_stream( item );
+    rtmp_chunk_conn_t conn = rtmp_stream_get_conn( stream );
+    rtmp_chunk_conn_call_event( conn, RTMP_EVENT_REFRESH );
+    if( rtmp_chunk_conn_service( conn ) >= RTMP_ERR_FATAL ){
+        rtmp_mgr_close( item->mgr, item, "chunk stream failed" );
+        return;
+    }
+    if( rtmp_stream_wants_refresh( stream ) ){
+        timer_wheel_schedule( item->mgr->timers, timer, rtmp_get_time() + RTMP_REFRESH_TIME );
+    }
+}
+
+void rtmp_mgr_refresh( rtmp_t mgr, rtmp_stream_t stream ){
+    rtmp_mgr_svr_t item = handle_table_get( mgr->servers, stream->handle );
+    if( item && rtmp_mgr_item_stream( item ) == stream && !timer_scheduled( &item->refresh ) ){
+        timer_wheel_schedule( mgr->timers, &item->refresh, rtmp_get_time() + RTMP_REFRESH_TIME );
+    }
+}
+
+//Checks on a connection again after the ping interval, or when it would go idle if that is sooner
+static void stream_keepalive( rtmp_t mgr, rtmp_mgr_svr_t item, rtmp_time_t now ){
+    rtmp_time_t next = 0;
+    if( mgr->ping_interval ){
+        next = now + mgr->ping_interval;
+    }
+    if( mgr->idle_timeout && ( !next || item->active_since + mgr->idle_timeout < next ) ){
+        next = item->active_since + mgr->idle_timeout;
+    }
+    if( next ){
+        timer_wheel_schedule( mgr->timers, &item->deadline, next );
+    }
+    else{
+        timer_wheel_cancel( mgr->timers, &item->deadline );
+    }
+}
+
+//Closes connections which never finish their handshake or stop receiving, and pings quiet ones to see which they are.
+//Also trims each connection's buffers, so that doing so costs nothing beyond the keepalive checks.
+static void stream_deadline( timer_entry_t *timer, void *user ){
+    rtmp_mgr_svr_t item = user;
+    rtmp_t mgr = item->mgr;
+    rtmp_stream_t stream = rtmp_mgr_item_stream( item );
+    rtmp_time_t now = rtmp_get_time();
+    if( !item->connected ){
+        rtmp_mgr_close( mgr, item, "the handshake timed out" );
+        return;
+    }
+    //Buffers grown for a burst are given back here rather than on a timer of their own
+    rtmp_chunk_conn_trim( rtmp_stream_get_conn( stream ) );
+    size_t bytes_in = rtmp_stream_get_conn( stream )->bytes_in;
+    if( bytes_in != item->seen_in ){
+        item->seen_in = bytes_in;
+        item->active_since = now;
+    }
+    else if( mgr->idle_timeout && now - item->active_since >= mgr->idle_timeout ){
+        rtmp_mgr_close( mgr, item, "the peer stopped responding" );
+        return;
+    }
+    else if( mgr->ping_interval ){
+        rtmp_stream_send_ping_req( stream, (uint32_t)now );
+    }
+    stream_keepalive( mgr, item, now );
+}
+
+//Starts a connection's timers on the manager it now belongs to
+static void stream_arm( rtmp_t mgr, rtmp_mgr_svr_t item ){
+    rtmp_time_t now = rtmp_get_time();
+    if( rtmp_stream_wants_refresh( rtmp_mgr_item_stream( item ) ) ){
+        timer_wheel_schedule( mgr->timers, &item->refresh, now + RTMP_REFRESH_TIME );
+    }
+    if( item->connected ){
+        //Time spent changing hands isn't the peer's fault
+        item->active_since = now;
+        stream_keepalive( mgr, item, now );
+    }
+    else if( mgr->handshake_timeout ){
+        timer_wheel_schedule( mgr->timers, &item->deadline, now + mgr->handshake_timeout );
+    }
+    rtmp_stream_attach( rtmp_mgr_item_stream( item ), mgr );
+}
+
+static void stream_disarm( rtmp_t mgr, rtmp_mgr_svr_t item, rtmp_stream_t stream ){
+    timer_wheel_cancel( mgr->timers, &item->refresh );
+    timer_wheel_cancel( mgr->timers, &item->deadline );
+    if( stream ){
+        rtmp_stream_attach( stream, nullptr );
+    }
+}
+
+static rtmp_cb_status_t stream_connected(
+    rtmp_stream_t conn,
+    rtmp_event_t event,
+    void * restrict user
+){
+    rtmp_mgr_svr_t self = (rtmp_mgr_svr_t) user;
+    self->connected = true;
+    self->seen_in = rtmp_stream_get_conn( conn )->bytes_in;
+    self->active_since = rtmp_get_time();
+    stream_keepalive( self->mgr, self, self->active_since );
+    return RTMP_CB_CONTINUE;
+}
+
+static rtmp_cb_status_t stream_event(
+    rtmp_stream_t conn,
+    rtmp_event_t event,
+    void * restrict user
+){
+    rtmp_mgr_svr_t self = (rtmp_mgr_svr_t) user;
+    if( self->uring ){
+        rtmp_mgr_queue( self->mgr, self );
+        return RTMP_CB_CONTINUE;
+    }
+    if( self->edge ){
+        //No new edge is coming for data which is already waiting, so drain it ourselves
+        if( ( event == RTMP_EVENT_FILLED && self->writable ) || ( event == RTMP_EVENT_EMPTIED && self->readable ) ){
+            rtmp_mgr_queue( self->mgr, self );
+        }
+        return RTMP_CB_CONTINUE;
+    }
+    int flags = self->flags;
+    if( event == RTMP_EVENT_FILLED ){
+        flags |= RTMP_POLL_OUT;
+    }
+    if( event == RTMP_EVENT_EMPTIED ){
+        flags |= RTMP_POLL_IN;
+    }
+    if( flags != self->flags ){
+        self->flags = flags;
+        self->mgr->poller->modify( self->mgr, self->socket, flags, self );
+    }
+    return RTMP_CB_CONTINUE;
+}
+
+//A server closed on this manager is reused whole, so that an accept doesn't have to allocate its connection again
+static rtmp_server_t server_take( rtmp_t mgr ){
+    if( VEC_SIZE( mgr->spare_servers ) == 0 ){
+        return rtmp_server_create_pooled( mgr->server_pool );
+    }
+    rtmp_server_t server = VEC_BACK( mgr->spare_servers );
+    VEC_POP( mgr->spare_servers );
+    return server;
+}
+
+static void server_put( rtmp_t mgr, rtmp_server_t server ){
+    rtmp_server_t *loc = VEC_SIZE( mgr->spare_servers ) < RTMP_SPARE_SERVERS ? VEC_PUSH( mgr->spare_servers ) : nullptr;
+    if( !loc ){
+        rtmp_server_destroy( server );
+        return;
+    }
+    rtmp_server_recycle( server );
+    *loc = server;
+}
+
+static rtmp_err_t create_stream( rtmp_t mgr, void * client_or_server, rtmp_sock_t sock, rtmp_t_t type ){
+    rtmp_mgr_svr_t item = slab_alloc( mgr->item_pool );
+    if( !item ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    item->handle = handle_table_add( mgr->servers, item );
+    if( item->handle == HANDLE_NONE ){
+        slab_free( item );
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+
+    item->type = type;
+    item->socket = sock;
+    item->uring = nullptr;
+    rtmp_stream_t stream = nullptr;
+    if( type == RTMP_T_SERVER_T){
+        ALIAS( client_or_server, rtmp_server_t *, server );
+        item->server = server_take( mgr );
+        if( !item->server ){
+            handle_table_remove( mgr->servers, item->handle );
+            slab_free( item );
+            return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+        }
+        *server = item->server;
+        stream = rtmp_server_stream(*server );
+    }
+    else if( type == RTMP_T_CLIENT_T ){
+        ALIAS( client_or_server, rtmp_client_t *, client );
+        item->client = *client;
+        stream = rtmp_client_stream( *client );
+    }
+    stream->handle = item->handle;
+    item->flags = RTMP_POLL_IN | RTMP_POLL_OUT;
+    item->mgr = mgr;
+    item->closing = false;
+    item->edge = mgr_edge( mgr );
+    item->readable = false;
+    item->writable = true;
+    item->pending = false;
+    item->connected = false;
+    if( item->edge ){
+        item->flags |= RTMP_POLL_EDGE;
+    }
+    timer_init( &item->refresh, stream_refresh, item );
+    timer_init( &item->deadline, stream_deadline, item );
+    rtmp_chunk_conn_set_budget( rtmp_stream_get_conn( stream ), &mgr->io_budget );
+    rtmp_chunk_conn_set_stats( rtmp_stream_get_conn( stream ), &mgr->stats );
+
+    rtmp_err_t err = rtmp_stream_reg_event( stream, RTMP_EVENT_FILLED, stream_event, item );
+    err = err ? err : rtmp_stream_reg_event( stream, RTMP_EVENT_EMPTIED, stream_event, item );
+    err = err ? err : rtmp_stream_reg_event( stream, RTMP_EVENT_CONNECT_SUCCESS, stream_connected, item );
+    if( err ){
+        return err;
+    }
+    stream_arm( mgr, item );
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( mgr->uring ){
+        return rtmp_uring_add( mgr, item );
+    }
+    #endif
+    err = mgr->poller->add( mgr, sock, item->flags, item );
+    if( err >= RTMP_ERR_ERROR ){
+        rtmp_mgr_close( mgr, item, "the backend refused the socket" );
+        return err;
+    }
+    if( item->edge ){
+        //A client has its handshake to send before the server says anything
+        rtmp_mgr_queue( mgr, item );
+    }
+    return err;
+}
+
+static rtmp_err_t destroy_stream( rtmp_t mgr, rtmp_stream_t stream ){
+    //A stale handle may name a connection which has since taken the slot, so the stream is checked too
+    rtmp_mgr_svr_t item = handle_table_get( mgr->servers, stream->handle );
+    if( !item || rtmp_mgr_item_stream( item ) != stream ){
+        return RTMP_ERR_NONE;
+    }
+    handle_table_remove( mgr->servers, item->handle );
+    stream_unqueue( mgr, item );
+    stream_disarm( mgr, item, stream );
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( item->uring ){
+        rtmp_uring_remove( mgr, item );
+    }
+    else
+    #endif
+    {
+        mgr->poller->remove( mgr, item->socket );
+        shutdown( item->socket, SHUT_RDWR );
+        close( item->socket );
+    }
+    if( item->type == RTMP_T_SERVER_T ){
+        server_put( mgr, item->server );
+    }
+    stream_free( mgr, item );
+    return RTMP_ERR_NONE;
+}
+
+
+rtmp_err_t rtmp_mgr_accept( rtmp_t mgr, rtmp_sock_t sock ){
+    rtmp_server_t server;
+    rtmp_err_t ret = create_stream( mgr, &server, sock, RTMP_T_SERVER_T );
+    if( ret >= RTMP_ERR_ERROR ){
+        return ret;
+    }
+
+    rtmp_server_set_app_list( server, mgr->applist );
+    if( mgr->callback ){
+        return mgr->callback( server, mgr->callback_data ) == RTMP_CB_CONTINUE ? RTMP_ERR_NONE : RTMP_ERR_ABORT ;
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static rtmp_err_t handle_server( rtmp_t mgr, int flags ){
+    if( flags & RTMP_POLL_ERR ){
+        mgr->poller->remove( mgr, mgr->listen_socket );
+        shutdown( mgr->listen_socket, SHUT_RDWR );
+        close( mgr->listen_socket );
+        mgr->listen_socket = 0;
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+    if( flags & RTMP_POLL_IN ){
+        rtmp_sock_t sock = accept( mgr->listen_socket, nullptr, 0 );
+        if( sock <= 0 ){
+            perror( "accept" );
+            return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+        }
+        return rtmp_mgr_accept( mgr, sock );
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+
+rtmp_err_t rtmp_mgr_close( rtmp_t mgr, rtmp_mgr_svr_t stream, const char *reason ){
+    RTMP_LOG( RTMP_LOG_NOTICE, RTMP_ERR_CONNECTION_CLOSED, "Closing connection on socket %d: %s", stream->socket, reason );
+    stream_unqueue( mgr, stream );
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( stream->uring ){
+        rtmp_uring_remove( mgr, stream );
+    }
+    else
+    #endif
+    {
+        mgr->poller->remove( mgr, stream->socket );
+        shutdown( stream->socket, SHUT_RDWR );
+        close( stream->socket );
+    }
+    //The stream may outlive the manager, so stop charging its buffers to our budget
+    rtmp_stream_t s = stream->type == RTMP_T_SERVER_T ?
+        rtmp_server_stream( stream->server ) :
+        rtmp_client_stream( stream->client ) ;
+    stream_disarm( mgr, stream, s );
+    if( s ){
+        //Let the owner know before the server is recycled; a client must not be destroyed from this callback
+        rtmp_chunk_conn_call_event( rtmp_stream_get_conn( s ), RTMP_EVENT_CLOSED );
+        rtmp_chunk_conn_set_budget( rtmp_stream_get_conn( s ), nullptr );
+        rtmp_chunk_conn_set_stats( rtmp_stream_get_conn( s ), nullptr );
+    }
+    //Recycle the server's memory now that the connection is gone
+    if( stream->type == RTMP_T_SERVER_T ){
+        server_put( mgr, stream->server );
+    }
+    else if( stream->type == RTMP_T_CLIENT_T ){
+        //rtmp_client_destroy( stream->client );
+    }
+    handle_table_remove( mgr->servers, stream->handle );
+    stream_free( mgr, stream );
+    return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_CLOSED);
+}
+
+//Flushes an edge-triggered connection until the output is empty or the kernel's buffer is full, and reads until the
+//socket is empty or the input buffer is full. more is set if it stopped reading early, and should be drained again soon.
+static rtmp_err_t stream_drain( rtmp_t mgr, rtmp_mgr_svr_t stream, bool *more ){
+    rtmp_stream_t s = stream->type == RTMP_T_SERVER_T ?
+        rtmp_server_stream( stream->server ) :
+        rtmp_client_stream( stream->client ) ;
+    rtmp_chunk_conn_t conn = s ? rtmp_stream_get_conn( s ) : nullptr;
+    *more = false;
+    if( !conn ){
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    const char *reason;
+    size_t budget = RTMP_EPOLL_READ_MAX;
+    //Anything the connection queues for itself meanwhile is handled by this loop
+    stream->pending = true;
+    bool progress = true;
+    while( progress ){
+        progress = false;
+        if( rtmp_chunk_conn_service( conn ) >= RTMP_ERR_FATAL ){
+            stream->closing = true;
+        }
+        rtmp_iovec_t iov[RTMP_MAX_IOV];
+        size_t count = 0;
+        while( stream->writable ){
+            if( rtmp_chunk_conn_get_out_iov( conn, iov, RTMP_MAX_IOV, &count ) != RTMP_ERR_NONE || count == 0 ){
+                break;
+            }
+            size_t total = 0;
+            for( size_t i = 0; i < count; ++i ){
+                total += iov[i].iov_len;
+            }
+            struct msghdr msg;
+            memset( &msg, 0, sizeof( msg ) );
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            count_syscall( mgr );
+            ssize_t size = sendmsg( stream->socket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT );
+            if( size < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ){
+                stream->writable = false;
+                break;
+            }
+            if( size < 0 && errno == EINTR ){
+                continue;
+            }
+            if( size <= 0 ){
+                reason = "send failed";
+                goto confail;
+            }
+            rtmp_chunk_conn_commit_out_buff( conn, size );
+            //The kernel took less than offered, so its buffer is full until the next edge
+            if( (size_t)size < total ){
+                stream->writable = false;
+            }
+        }
+        if( stream->closing ){
+            if( stream->writable ){
+                reason = "finished closing";
+                goto confail;
+            }
+            break;
+        }
+        if( !stream->readable ){
+            continue;
+        }
+        if( budget == 0 ){
+            *more = true;
+            break;
+        }
+        void *buffer;
+        size_t size;
+        if( rtmp_chunk_conn_get_in_buff( conn, &buffer, &size ) != RTMP_ERR_NONE || size == 0 ){
+            //The input is full. Once it is processed, the emptied event queues us again.
+            break;
+        }
+        if( size > budget ){
+            size = budget;
+        }
+        count_syscall( mgr );
+        ssize_t got = recv( stream->socket, buffer, size, MSG_NOSIGNAL | MSG_DONTWAIT );
+        if( got < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ){
+            stream->readable = false;
+            continue;
+        }
+        if( got < 0 && errno == EINTR ){
+            progress = true;
+            continue;
+        }
+        if( got <= 0 ){
+            reason = "receive failed or peer closed";
+            goto confail;
+        }
+        rtmp_chunk_conn_commit_in_buff( conn, got );
+        budget -= got;
+        //A short read means the socket is empty; more data will come with another edge
+        if( (size_t)got < size ){
+            stream->readable = false;
+        }
+        progress = true;
+    }
+    stream->pending = false;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    confail:
+    return rtmp_mgr_close( mgr, stream, reason );
+}
+
+//Drains the queued edge-triggered connections, including any queued along the way. Those which stopped reading early
+//stay queued for the next iteration.
+static rtmp_err_t stream_flush_pending( rtmp_t mgr ){
+    rtmp_err_t err = RTMP_ERR_NONE;
+    size_t deferred = 0;
+    for( size_t i = 0; i < VEC_SIZE(mgr->pending); ++i ){
+        rtmp_mgr_svr_t item = mgr->pending[i];
+        if( !item ){
+            continue;
+        }
+        mgr->pending[i] = nullptr;
+        item->pending = false;
+        bool more;
+        rtmp_err_t ret;
+        #ifdef RTMP_POLLTECH_IO_URING
+        if( item->uring ){
+            ret = rtmp_uring_drain( mgr, item, &more );
+        }
+        else
+        #endif
+        {
+            ret = stream_drain( mgr, item, &more );
+        }
+        if( ret == RTMP_ERR_NONE && more ){
+            //Slots before i have already been visited, so they can be reused
+            mgr->pending[deferred++] = item;
+            item->pending = true;
+        }
+        if( err == RTMP_ERR_NONE ){
+            err = ret;
+        }
+    }
+    VEC_SIZE(mgr->pending) = deferred;
+    return err;
+}
+
+static rtmp_err_t handle_stream( rtmp_t mgr, rtmp_mgr_svr_t stream, int flags ){
+    rtmp_stream_t s;
+    const char *reason;
+    if( flags & RTMP_POLL_ERR ){
+        reason = "socket error or hangup";
+        goto confail;
+    }
+    if( stream->edge ){
+        //Edges are only reported once, so note them now and drain once every event has been seen
+        stream->readable |= (flags & RTMP_POLL_IN) != 0;
+        stream->writable |= (flags & RTMP_POLL_OUT) != 0;
+        rtmp_mgr_queue( mgr, stream );
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    s = stream->type == RTMP_T_SERVER_T ?
+        rtmp_server_stream( stream->server ) :
+        rtmp_client_stream( stream->client ) ;
+    if( flags & RTMP_POLL_OUT ){
+        rtmp_iovec_t iov[RTMP_MAX_IOV];
+        size_t count;
+        rtmp_chunk_conn_t conn = s ? rtmp_stream_get_conn( s ) : nullptr;
+        if( conn && rtmp_chunk_conn_get_out_iov( conn, iov, RTMP_MAX_IOV, &count ) == RTMP_ERR_NONE ){
+            if( count == 0 ){
+                if( stream->closing ){
+                    reason = "finished closing";
+                    goto confail;
+                }
+                stream->flags &= ~RTMP_POLL_OUT;
+                mgr->poller->modify( mgr, stream->socket, stream->flags, stream );
+            }
+            else{
+                //Chunk headers and referenced payloads go out together in one call
+                struct msghdr msg;
+                memset( &msg, 0, sizeof( msg ) );
+                msg.msg_iov = iov;
+                msg.msg_iovlen = count;
+                count_syscall( mgr );
+                ssize_t size = sendmsg( stream->socket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT );
+                if( size < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) ){
+                    //Poll and select may report readiness which is gone by now; try again on the next one
+                    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+                }
+                if( size <= 0 ){
+                    reason = "send failed";
+                    goto confail;
+                }
+                rtmp_chunk_conn_commit_out_buff( conn, size );
+            }
+            if( rtmp_chunk_conn_service( conn ) >= RTMP_ERR_FATAL ){
+                reason = "chunk stream failed";
+                goto confail;
+            }
+        }
+    }
+    if( flags & RTMP_POLL_IN ){
+        void * buffer;
+        size_t size;
+        rtmp_chunk_conn_t conn = s ? rtmp_stream_get_conn( s ) : nullptr;
+        if( conn && rtmp_chunk_conn_get_in_buff( conn, &buffer, &size ) == RTMP_ERR_NONE ){
+            if( size == 0 ){
+                stream->flags &= ~RTMP_POLL_IN;
+                mgr->poller->modify( mgr, stream->socket, stream->flags, stream );
+                if( rtmp_chunk_conn_service( conn ) >= RTMP_ERR_FATAL ){
+                    stream->closing = true;
+                    stream->flags = RTMP_POLL_OUT;
+                    mgr->poller->modify( mgr, stream->socket, stream->flags, stream );
+                }
+            }
+            else{
+                count_syscall( mgr );
+                ssize_t newsize = recv( stream->socket, buffer, size, MSG_NOSIGNAL | MSG_DONTWAIT );
+                if( newsize < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) ){
+                    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+                }
+                if( newsize <= 0 ){
+                    reason = "receive failed or peer closed";
+                    goto confail;
+                }
+                rtmp_chunk_conn_commit_in_buff( conn, newsize );
+            }
+            if( rtmp_chunk_conn_service( conn ) >= RTMP_ERR_FATAL ){
+                stream->closing = true;
+                stream->flags = RTMP_POLL_OUT;
+                mgr->poller->modify( mgr, stream->socket, stream->flags, stream );
+            }
+        }
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    confail:
+    return rtmp_mgr_close( mgr, stream, reason );
+}
+
+
+rtmp_err_t rtmp_post( rtmp_t mgr, rtmp_task_proc proc, void *user ){
+    pthread_mutex_lock( &mgr->inbox.lock );
+    rtmp_task_t *task = VEC_PUSH( mgr->inbox.tasks );
+    if( task ){
+        task->proc = proc;
+        task->user = user;
+    }
+    pthread_mutex_unlock( &mgr->inbox.lock );
+    if( !task ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    uint64_t one = 1;
+    if( write( mgr->inbox.fd, &one, sizeof( one ) ) < 0 && errno != EAGAIN ){
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_mgr_handle_inbox( rtmp_t mgr ){
+    uint64_t count;
+    if( read( mgr->inbox.fd, &count, sizeof( count ) ) < 0 && errno != EAGAIN ){
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+    //Take the whole queue so that tasks may post more tasks without deadlocking
+    VEC_DECLARE(rtmp_task_t) tasks;
+    VEC_INIT( tasks );
+    if( !tasks ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    pthread_mutex_lock( &mgr->inbox.lock );
+    rtmp_task_t *pending = mgr->inbox.tasks;
+    mgr->inbox.tasks = tasks;
+    pthread_mutex_unlock( &mgr->inbox.lock );
+
+    for( size_t i = 0; i < VEC_SIZE(pending); ++i ){
+        pending[i].proc( mgr, pending[i].user );
+    }
+    VEC_DESTROY( pending );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+//Runs on the receiving manager's thread
+static void handoff_adopt( rtmp_t mgr, void *user ){
+    rtmp_handoff_t *handoff = user;
+    rtmp_mgr_svr_t item = handoff->item;
+    rtmp_err_t err = RTMP_ERR_NONE;
+    item->handle = handle_table_add( mgr->servers, item );
+    if( item->handle == HANDLE_NONE ){
+        err = RTMP_ERR_OOM;
+        shutdown( item->socket, SHUT_RDWR );
+        close( item->socket );
+        slab_free( item );
+    }
+    else{
+        handoff->stream->handle = item->handle;
+        item->mgr = mgr;
+        stream_arm( mgr, item );
+        //Start with both directions armed, since the stream may already have buffered data
+        item->flags |= RTMP_POLL_IN | RTMP_POLL_OUT;
+        item->edge = mgr_edge( mgr );
+        item->readable = item->writable = true;
+        item->pending = false;
+        if( item->edge ){
+            item->flags |= RTMP_POLL_EDGE;
+        }
+        else{
+            item->flags &= ~RTMP_POLL_EDGE;
+        }
+        rtmp_chunk_conn_set_budget( rtmp_stream_get_conn( handoff->stream ), &mgr->io_budget );
+        rtmp_chunk_conn_set_stats( rtmp_stream_get_conn( handoff->stream ), &mgr->stats );
+        #ifdef RTMP_POLLTECH_IO_URING
+        if( mgr->uring ){
+            err = rtmp_uring_add( mgr, item );
+        }
+        else
+        #endif
+        if( mgr->poller->add( mgr, item->socket, item->flags, item ) >= RTMP_ERR_ERROR ){
+            err = RTMP_ERR_POLL_FAIL;
+        }
+        else if( item->edge ){
+            rtmp_mgr_queue( mgr, item );
+        }
+    }
+    if( handoff->callback ){
+        handoff->callback( mgr, handoff->stream, RTMP_GEN_ERROR(err), handoff->user );
+    }
+    free( handoff );
+}
+
+//Takes a connection off the original manager, and posts it to the target
+static rtmp_err_t handoff_release( rtmp_t mgr, rtmp_handoff_t *handoff, rtmp_mgr_svr_t item ){
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( item->uring && !rtmp_uring_detach( mgr, item ) ){
+        return RTMP_ERR_AGAIN;
+    }
+    #endif
+    if( !mgr->uring ){
+        mgr->poller->remove( mgr, item->socket );
+    }
+    stream_unqueue( mgr, item );
+    stream_disarm( mgr, item, handoff->stream );
+    rtmp_chunk_conn_set_budget( rtmp_stream_get_conn( handoff->stream ), nullptr );
+    rtmp_chunk_conn_set_stats( rtmp_stream_get_conn( handoff->stream ), nullptr );
+    handle_table_remove( mgr->servers, item->handle );
+    handoff->item = item;
+    rtmp_err_t err = rtmp_post( handoff->target, handoff_adopt, handoff );
+    if( err < RTMP_ERR_ERROR ){
+        return err;
+    }
+    //Nobody will adopt it, so take it back. The slot that was just freed is reused, so this can't run out of memory.
+    item->handle = handle_table_add( mgr->servers, item );
+    handoff->stream->handle = item->handle;
+    stream_arm( mgr, item );
+    rtmp_chunk_conn_set_budget( rtmp_stream_get_conn( handoff->stream ), &mgr->io_budget );
+    rtmp_chunk_conn_set_stats( rtmp_stream_get_conn( handoff->stream ), &mgr->stats );
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( mgr->uring ){
+        rtmp_uring_add( mgr, item );
+        return err;
+    }
+    #endif
+    mgr->poller->add( mgr, item->socket, item->flags, item );
+    if( item->edge ){
+        item->readable = item->writable = true;
+        rtmp_mgr_queue( mgr, item );
+    }
+    return err;
+}
+
+//Runs on the original manager's thread once it is no longer iterating over events.
+//A handoff waiting on io_uring operations which still refer to the connection stays queued for the next iteration.
+static void handoff_flush( rtmp_t mgr ){
+    size_t waiting = 0;
+    for( size_t h = 0; h < VEC_SIZE(mgr->handoffs); ++h ){
+        rtmp_handoff_t *handoff = mgr->handoffs[h];
+        rtmp_err_t err = RTMP_ERR_CONNECTION_CLOSED;
+        rtmp_mgr_svr_t item = handle_table_get( mgr->servers, handoff->stream->handle );
+        if( item && rtmp_mgr_item_stream( item ) == handoff->stream ){
+            err = handoff_release( mgr, handoff, item );
+        }
+        if( err == RTMP_ERR_AGAIN ){
+            //Slots before h have already been visited, so they can be reused
+            mgr->handoffs[waiting++] = handoff;
+        }
+        else if( err != RTMP_ERR_NONE ){
+            if( handoff->callback ){
+                handoff->callback( mgr, handoff->stream, err, handoff->user );
+            }
+            free( handoff );
+        }
+    }
+    VEC_SIZE(mgr->handoffs) = waiting;
+}
+
+rtmp_err_t rtmp_handoff( rtmp_t from, rtmp_t to, rtmp_stream_t stream, rtmp_handoff_proc cb, void *user ){
+    if( from == to ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
+    }
+    rtmp_handoff_t *handoff = calloc( 1, sizeof( rtmp_handoff_t ) );
+    rtmp_handoff_t **loc = handoff ? VEC_PUSH( from->handoffs ) : nullptr;
+    if( !loc ){
+        free( handoff );
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    handoff->stream = stream;
+    handoff->target = to;
+    handoff->callback = cb;
+    handoff->user = user;
+    *loc = handoff;
+    if( !from->servicing ){
+        handoff_flush( from );
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_service( rtmp_t mgr, int timeout ){
+    rtmp_poll_event_t events[RTMP_POLL_MAX];
+    rtmp_err_t err = RTMP_ERR_NONE;
+    int64_t next = timer_wheel_next( mgr->timers, rtmp_get_time() );
+    if( next >= 0 && ( timeout < 0 || next < timeout ) ){
+        timeout = next < INT_MAX ? next : INT_MAX;
+    }
+    //Connections queued since the last iteration, or left with more to read, shouldn't wait for an event
+    if( VEC_SIZE(mgr->pending) > 0 ){
+        timeout = 0;
+    }
+    int fd_count;
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( mgr->uring ){
+        fd_count = rtmp_uring_wait( mgr, timeout );
+    }
+    else
+    #endif
+    {
+        fd_count = mgr->poller->wait( mgr, events, RTMP_POLL_MAX, timeout );
+    }
+    if( fd_count < 0 ){
+        return RTMP_ERR_POLL_FAIL;
+    }
+    rtmp_log_service();
+    uint64_t start = rtmp_get_time_ns();
+    bool idle = fd_count == 0 && VEC_SIZE(mgr->pending) == 0;
+    mgr->servicing = true;
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( mgr->uring ){
+        err = rtmp_uring_dispatch( mgr );
+        fd_count = 0;
+    }
+    #endif
+    //Every event is handled even if one fails, since an edge-triggered connection won't be told about its edge again
+    for( size_t i = 0; i < (size_t)fd_count; ++i ){
+        rtmp_t_t * type = events[i].ptr;
+        rtmp_err_t ret;
+        switch( *type ){
+        case RTMP_T_RTMP_T:
+            ret = handle_server( events[i].ptr, events[i].events );
+            break;
+        case RTMP_T_CLIENT_T:
+        case RTMP_T_SERVER_T:
+            ret = handle_stream( mgr, events[i].ptr, events[i].events );
+            break;
+        case RTMP_T_INBOX_T:
+            ret = rtmp_mgr_handle_inbox( mgr );
+            break;
+        default:
+            ret = RTMP_ERR_POLL_FAIL;
+            break;
+        }
+        if( err == RTMP_ERR_NONE ){
+            err = ret;
+        }
+    }
+    rtmp_err_t flushed = stream_flush_pending( mgr );
+    if( err == RTMP_ERR_NONE ){
+        err = flushed;
+    }
+    mgr->servicing = false;
+    handoff_flush( mgr );
+    //Only the timers which are due are touched, however many connections there are
+    timer_wheel_advance( mgr->timers, rtmp_get_time() );
+    //Timeouts with nothing to do would only drown out the iterations that did work
+    if( !idle ){
+        rtmp_histogram_record( &mgr->service_time, rtmp_get_time_ns() - start );
+    }
+    if( fd_count < 0 ){
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+    return RTMP_GEN_ERROR(err);
+}
+
+rtmp_err_t rtmp_connect( rtmp_t mgr, rtmp_client_t client ){
+    rtmp_sock_t sock;
+    union{
+        struct sockaddr_in sin;
+        struct sockaddr s;
+    } svr;
+    struct hostent *host;
+    const char * hostname;
+    uint16_t port;
+    if( rtmp_client_get_conninfo( client, &hostname, &port ) != RTMP_ERR_NONE){
+        rtmp_client_destroy( client );
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+
+    host = gethostbyname( hostname );
+    if( !host || !host->h_addr_list || !host->h_addr_list[0] ){
+        //rtmp_client_destroy( client );
+        return RTMP_GEN_ERROR(RTMP_ERR_DNS_FAIL);
+    }
+
+    sock = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    if( sock <= 0 ){
+        perror("socket");
+        rtmp_client_destroy( client );
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+    //Allow socket reuse
+    static int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+
+    memset( &svr, 0, sizeof( svr ) );
+    svr.sin.sin_addr.s_addr = *((in_addr_t**)host->h_addr_list)[0];
+    svr.sin.sin_family = AF_INET;
+    svr.sin.sin_port = htons(port);
+    if( connect( sock, &svr.s, sizeof( svr ) ) < 0 ){
+        perror("connect");
+        rtmp_client_destroy( client );
+        close( sock );
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+
+    return create_stream( mgr, &client, sock, RTMP_T_CLIENT_T );
+
+    //mgr->callback = cb;
+    //mgr->callback_data = user;
+    //mgr->listen_socket = sock;
+
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_disconnect( rtmp_t mgr, rtmp_client_t client ){
+    return destroy_stream( mgr, rtmp_client_stream( client ) );
+}
+
+rtmp_err_t rtmp_close_stream( rtmp_t mgr, rtmp_stream_t stream ){
+    return destroy_stream( mgr, stream );
+}
+
+rtmp_err_t rtmp_listen( rtmp_t mgr, const char * iface, short port, rtmp_connect_proc cb, void *user ){
+    rtmp_sock_t sock;
+    union{
+        struct sockaddr_in sin;
+        struct sockaddr s;
+    } svr;
+    struct hostent *host;
+
+    host = gethostbyname( iface );
+    if( !host || !host->h_addr_list || !host->h_addr_list[0] ){
+        return RTMP_GEN_ERROR(RTMP_ERR_DNS_FAIL);
+    }
+
+    sock = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    if( sock <= 0 ){
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+    //Allow socket reuse
+    static int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+    //Pooled managers each bind their own socket and let the kernel balance connections between them
+    if( mgr->reuse_port && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof( one ) ) < 0 ){
+        close( sock );
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+
+    memset( &svr, 0, sizeof( svr ) );
+    svr.sin.sin_addr.s_addr = *((in_addr_t**)host->h_addr_list)[0];
+    svr.sin.sin_family = AF_INET;
+    svr.sin.sin_port = htons(port);
+    if( bind( sock, &svr.s, sizeof( svr ) ) < 0 ){
+        perror("bind");
+        close( sock );
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+
+    if( listen( sock, RTMP_LISTEN_SIZE ) < 0 ){
+        close( sock );
+        return RTMP_GEN_ERROR(RTMP_ERR_CONNECTION_FAIL);
+    }
+
+    mgr->callback = cb;
+    mgr->callback_data = user;
+    mgr->listen_socket = sock;
+
+    #ifdef RTMP_POLLTECH_IO_URING
+    if( mgr->uring ){
+        return rtmp_uring_listen( mgr );
+    }
+    #endif
+    if( mgr->poller->add( mgr, sock, RTMP_POLL_IN, mgr ) >= RTMP_ERR_ERROR ){
+        close( sock );
+        mgr->listen_socket = 0;
+        return RTMP_GEN_ERROR(RTMP_ERR_POLL_FAIL);
+    }
+
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
@@ -0,0 +1,161 @@
+/*
+    rtmp_pool.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <openrtmp/rtmp/rtmp_pool.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+typedef struct rtmp_pool_worker{
+    rtmp_t mgr;
+    pthread_t thread;
+    bool started;
+    rtmp_pool_t pool;
+} rtmp_pool_worker_t;
+
+struct rtmp_pool{
+    rtmp_pool_worker_t *workers;
+    size_t count;
+    bool running;
+};
+
+
+rtmp_pool_t rtmp_pool_create( size_t workers ){
+    if( workers == 0 ){
+        long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+        workers = cpus > 0 ? (size_t)cpus : 1;
+    }
+    rtmp_pool_t pool = calloc( 1, sizeof( struct rtmp_pool ) );
+    if( !pool ){
+        return nullptr;
+    }
+    pool->workers = calloc( workers, sizeof( rtmp_pool_worker_t ) );
+    if( !pool->workers ){
+        free( pool );
+        return nullptr;
+    }
+    pool->count = workers;
+    for( size_t i = 0; i < workers; ++i ){
+        pool->workers[i].pool = pool;
+        pool->workers[i].mgr = rtmp_create();
+        if( !pool->workers[i].mgr ){
+            rtmp_pool_destroy( pool );
+            return nullptr;
+        }
+        pool->workers[i].mgr->reuse_port = true;
+    }
+    return pool;
+}
+
+void rtmp_pool_destroy( rtmp_pool_t pool ){
+    rtmp_pool_stop( pool );
+    for( size_t i = 0; i < pool->count; ++i ){
+        if( pool->workers[i].mgr ){
+            rtmp_destroy( pool->workers[i].mgr );
+        }
+    }
+    free( pool->workers );
+    free( pool );
+}
+
+size_t rtmp_pool_size( rtmp_pool_t pool ){
+    return pool->count;
+}
+
+rtmp_t rtmp_pool_worker( rtmp_pool_t pool, size_t idx ){
+    if( idx >= pool->count ){
+        return nullptr;
+    }
+    return pool->workers[idx].mgr;
+}
+
+void rtmp_pool_set_app_list( rtmp_pool_t pool, rtmp_app_list_t list ){
+    for( size_t i = 0; i < pool->count; ++i ){
+        rtmp_set_app_list( pool->workers[i].mgr, list );
+    }
+}
+
+void rtmp_pool_set_memory_budget( rtmp_pool_t pool, size_t limit ){
+    size_t share = limit / pool->count;
+    //Don't let rounding turn a tiny budget into an unlimited one
+    if( limit > 0 && share == 0 ){
+        share = 1;
+    }
+    for( size_t i = 0; i < pool->count; ++i ){
+        rtmp_set_memory_budget( pool->workers[i].mgr, share );
+    }
+}
+
+rtmp_err_t rtmp_pool_listen( rtmp_pool_t pool, const char * iface, short port, rtmp_connect_proc cb, void *user ){
+    for( size_t i = 0; i < pool->count; ++i ){
+        rtmp_err_t err = rtmp_listen( pool->workers[i].mgr, iface, port, cb, user );
+        if( err >= RTMP_ERR_ERROR ){
+            return err;
+        }
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+static void * rtmp_pool_worker_run( void *arg ){
+    rtmp_pool_worker_t *worker = arg;
+    while( __atomic_load_n( &worker->pool->running, __ATOMIC_ACQUIRE ) ){
+        //Errors here are per-connection, so they don't stop the worker
+        rtmp_service( worker->mgr, -1 );
+    }
+    return nullptr;
+}
+
+//Posted to wake a worker up so that it notices the pool is stopping
+static void rtmp_pool_wake( rtmp_t mgr, void *user ){
+}
+
+rtmp_err_t rtmp_pool_start( rtmp_pool_t pool ){
+    if( __atomic_load_n( &pool->running, __ATOMIC_ACQUIRE ) ){
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    __atomic_store_n( &pool->running, true, __ATOMIC_RELEASE );
+    for( size_t i = 0; i < pool->count; ++i ){
+        if( pthread_create( &pool->workers[i].thread, nullptr, rtmp_pool_worker_run, &pool->workers[i] ) != 0 ){
+            rtmp_pool_stop( pool );
+            return RTMP_GEN_ERROR(RTMP_ERR_FATAL);
+        }
+        pool->workers[i].started = true;
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+void rtmp_pool_stop( rtmp_pool_t pool ){
+    __atomic_store_n( &pool->running, false, __ATOMIC_RELEASE );
+    for( size_t i = 0; i < pool->count; ++i ){
+        if( pool->workers[i].started ){
+            rtmp_post( pool->workers[i].mgr, rtmp_pool_wake, nullptr );
+        }
+    }
+    for( size_t i = 0; i < pool->count; ++i ){
+        if( pool->workers[i].started ){
+            pthread_join( pool->workers[i].thread, nullptr );
+            pool->workers[i].started = false;
+        }
+    }
+}
@@ -0,0 +1,556 @@
+/*
+    rtmp_relay.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <openrtmp/rtmp/rtmp_relay.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/rtmp/rtmp_stream.h>
+#include <openrtmp/rtmp/rtmp_chunk_conn.h>
+#include <openrtmp/rtmp/rtmp_chunk_flow.h>
+#include <openrtmp/util/memutil.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Chunk streams used for relayed messages. They sit below RTMP_STREAM_AUTO_FIRST, so automatically assigned ones never collide with them.
+#define RTMP_RELAY_VIDEO_CHUNK_STREAM 4
+#define RTMP_RELAY_AUDIO_CHUNK_STREAM 5
+#define RTMP_RELAY_DATA_CHUNK_STREAM 6
+
+//One message framed for one (chunk size, message stream) pair. Every subscriber it was sent to holds a reference.
+//References are only ever touched from the relay's manager, so they don't need to be atomic.
+typedef struct rtmp_relay_frame{
+    size_t refs;
+    uint32_t chunk_size;
+    uint32_t msg_stream;
+    size_t len;
+    byte data[];
+} rtmp_relay_frame_t;
+
+typedef struct rtmp_relay_sub{
+    rtmp_stream_t stream;
+    uint32_t msg_stream;
+    //Set while video is being skipped until the next keyframe
+    bool need_key;
+} rtmp_relay_sub_t;
+
+//A block of the GOP cache's arena. The cache holds one reference, and every send still reading from the block holds another.
+typedef struct rtmp_relay_block{
+    size_t refs;
+    size_t len;
+    size_t cap;
+    byte data[];
+} rtmp_relay_block_t;
+
+typedef struct rtmp_relay_cached{
+    rtmp_message_type_t type;
+    rtmp_time_t timestamp;
+    rtmp_relay_block_t *block;
+    size_t offset;
+    size_t len;
+} rtmp_relay_cached_t;
+
+//A codec configuration message, which every decoder needs before the first frame
+typedef struct rtmp_relay_seqhdr{
+    byte *data;
+    size_t len;
+    rtmp_time_t timestamp;
+} rtmp_relay_seqhdr_t;
+
+typedef struct rtmp_relay_gop{
+    VEC_DECLARE(rtmp_relay_block_t*) blocks;
+    VEC_DECLARE(rtmp_relay_cached_t) frames;
+    rtmp_relay_seqhdr_t video_hdr, audio_hdr;
+    //Cleared when the cache is dropped, until the next keyframe starts a new GOP
+    bool active;
+} rtmp_relay_gop_t;
+
+//Fragments of a message which is still being received
+typedef struct rtmp_relay_partial{
+    byte *data;
+    size_t len;
+    size_t cap;
+} rtmp_relay_partial_t;
+
+struct rtmp_relay{
+    rtmp_relay_list_t list;
+    char *name;
+    size_t refs;
+    rtmp_t mgr;
+    bool claimed;
+
+    rtmp_stream_t publisher;
+    VEC_DECLARE(rtmp_relay_sub_t) subscribers;
+    //Frames built for the message currently being sent
+    VEC_DECLARE(rtmp_relay_frame_t*) frames;
+    rtmp_relay_partial_t audio, video;
+    byte *metadata;
+    size_t metadata_len;
+
+    rtmp_relay_gop_t gop;
+    //Written on the relay's manager and read from anywhere, so only touched atomically
+    rtmp_gop_stats_t stats;
+};
+
+struct rtmp_relay_list{
+    pthread_mutex_t lock;
+    VEC_DECLARE(rtmp_relay_t) relays;
+    size_t gop_limit;
+};
+
+#define STAT_SET(relay,field,value) __atomic_store_n( &(relay)->stats.field, (value), __ATOMIC_RELAXED )
+#define STAT_GET(relay,field) __atomic_load_n( &(relay)->stats.field, __ATOMIC_RELAXED )
+
+
+rtmp_relay_list_t rtmp_relay_list_create( void ){
+    rtmp_relay_list_t list = ezalloc( list );
+    if( !list ){
+        return nullptr;
+    }
+    pthread_mutex_init( &list->lock, nullptr );
+    VEC_INIT( list->relays );
+    list->gop_limit = RTMP_DEFAULT_GOP_CACHE_SIZE;
+    return list;
+}
+
+void rtmp_relay_list_set_gop_limit( rtmp_relay_list_t list, size_t limit ){
+    __atomic_store_n( &list->gop_limit, limit, __ATOMIC_RELAXED );
+}
+
+bool rtmp_relay_list_get_stats( rtmp_relay_list_t list, const char *name, rtmp_gop_stats_t *stats ){
+    bool found = false;
+    pthread_mutex_lock( &list->lock );
+    for( size_t i = 0; i < VEC_SIZE( list->relays ); ++i ){
+        rtmp_relay_t relay = list->relays[i];
+        if( strcmp( relay->name, name ) == 0 ){
+            stats->bytes_held = STAT_GET( relay, bytes_held );
+            stats->frames_held = STAT_GET( relay, frames_held );
+            stats->gops_cached = STAT_GET( relay, gops_cached );
+            stats->gops_dropped = STAT_GET( relay, gops_dropped );
+            stats->subscribers = STAT_GET( relay, subscribers );
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock( &list->lock );
+    return found;
+}
+
+static void rtmp_relay_block_release( const byte *data, void *user ){
+    rtmp_relay_block_t *block = user;
+    if( --block->refs == 0 ){
+        free( block );
+    }
+}
+
+//Empties the GOP cache. Blocks still being sent are freed once their sends finish.
+static void rtmp_relay_gop_clear( rtmp_relay_t relay ){
+    for( size_t i = 0; i < VEC_SIZE( relay->gop.blocks ); ++i ){
+        rtmp_relay_block_release( nullptr, relay->gop.blocks[i] );
+    }
+    VEC_SIZE( relay->gop.blocks ) = 0;
+    VEC_SIZE( relay->gop.frames ) = 0;
+    STAT_SET( relay, bytes_held, 0 );
+    STAT_SET( relay, frames_held, 0 );
+}
+
+static void rtmp_relay_seqhdr_set( rtmp_relay_seqhdr_t *hdr, rtmp_time_t timestamp, const byte *data, size_t length ){
+    //Clearing passes no data at all
+    byte *copy = length ? malloc( length ) : nullptr;
+    if( copy ){
+        memcpy( copy, data, length );
+    }
+    free( hdr->data );
+    hdr->data = copy;
+    hdr->len = copy ? length : 0;
+    hdr->timestamp = timestamp;
+}
+
+//Appends a frame to the arena, starting a new block when the current one is full
+static bool rtmp_relay_gop_append( rtmp_relay_t relay, rtmp_message_type_t type, rtmp_time_t timestamp, const byte *data, size_t length ){
+    rtmp_relay_gop_t *gop = &relay->gop;
+    rtmp_relay_block_t *block = VEC_SIZE( gop->blocks ) > 0 ? VEC_BACK( gop->blocks ) : nullptr;
+    if( !block || block->cap - block->len < length ){
+        size_t cap = length > RTMP_GOP_BLOCK_SIZE ? length : RTMP_GOP_BLOCK_SIZE;
+        block = malloc( sizeof( rtmp_relay_block_t ) + cap );
+        rtmp_relay_block_t **loc = block ? VEC_PUSH( gop->blocks ) : nullptr;
+        if( !loc ){
+            free( block );
+            return false;
+        }
+        block->refs = 1;
+        block->len = 0;
+        block->cap = cap;
+        *loc = block;
+    }
+    rtmp_relay_cached_t *cached = VEC_PUSH( gop->frames );
+    if( !cached ){
+        return false;
+    }
+    cached->type = type;
+    cached->timestamp = timestamp;
+    cached->block = block;
+    cached->offset = block->len;
+    cached->len = length;
+    memcpy( block->data + block->len, data, length );
+    block->len += length;
+    STAT_SET( relay, bytes_held, STAT_GET( relay, bytes_held ) + length );
+    STAT_SET( relay, frames_held, VEC_SIZE( gop->frames ) );
+    return true;
+}
+
+static bool rtmp_relay_is_keyframe( rtmp_message_type_t type, const byte *data, size_t length ){
+    //The upper nibble of an FLV video tag is the frame type, where 1 is a keyframe
+    if( type != RTMP_MSG_VIDEO || length == 0 || ( data[0] >> 4 ) != 1 ){
+        return false;
+    }
+    //An AVC sequence header carries the keyframe bit too, but only NALUs (packet type 1) hold a picture
+    return ( data[0] & 0x0F ) != 7 || ( length >= 2 && data[1] == 1 );
+}
+
+//Keeps the sequence headers, and everything from the latest keyframe onwards while it fits
+static void rtmp_relay_gop_push( rtmp_relay_t relay, rtmp_message_type_t type, rtmp_time_t timestamp, const byte *data, size_t length ){
+    rtmp_relay_gop_t *gop = &relay->gop;
+    size_t limit = __atomic_load_n( &relay->list->gop_limit, __ATOMIC_RELAXED );
+    //An AVC or AAC packet type of 0 marks the sequence header
+    if( type == RTMP_MSG_VIDEO && length > 1 && ( data[0] & 0x0F ) == 7 && data[1] == 0 ){
+        rtmp_relay_seqhdr_set( &gop->video_hdr, timestamp, data, length );
+        return;
+    }
+    if( type == RTMP_MSG_AUDIO && length > 1 && ( data[0] >> 4 ) == 10 && data[1] == 0 ){
+        rtmp_relay_seqhdr_set( &gop->audio_hdr, timestamp, data, length );
+        return;
+    }
+    if( rtmp_relay_is_keyframe( type, data, length ) ){
+        rtmp_relay_gop_clear( relay );
+        gop->active = limit > 0;
+        if( gop->active ){
+            STAT_SET( relay, gops_cached, STAT_GET( relay, gops_cached ) + 1 );
+        }
+    }
+    if( !gop->active ){
+        return;
+    }
+    if( STAT_GET( relay, bytes_held ) + length > limit || !rtmp_relay_gop_append( relay, type, timestamp, data, length ) ){
+        rtmp_relay_gop_clear( relay );
+        gop->active = false;
+        STAT_SET( relay, gops_dropped, STAT_GET( relay, gops_dropped ) + 1 );
+    }
+}
+
+void rtmp_relay_list_destroy( rtmp_relay_list_t list ){
+    if( !list ){
+        return;
+    }
+    //Every relay is gone by the time its app is, since each of them is held by a live stream
+    VEC_DESTROY( list->relays );
+    pthread_mutex_destroy( &list->lock );
+    free( list );
+}
+
+static void rtmp_relay_free( rtmp_relay_t relay ){
+    rtmp_relay_gop_clear( relay );
+    VEC_DESTROY( relay->gop.blocks );
+    VEC_DESTROY( relay->gop.frames );
+    free( relay->gop.video_hdr.data );
+    free( relay->gop.audio_hdr.data );
+    VEC_DESTROY( relay->subscribers );
+    VEC_DESTROY( relay->frames );
+    free( relay->audio.data );
+    free( relay->video.data );
+    free( relay->metadata );
+    free( relay->name );
+    free( relay );
+}
+
+rtmp_relay_t rtmp_relay_acquire( rtmp_relay_list_t list, const char *name, rtmp_t mgr, bool publisher ){
+    rtmp_relay_t relay = nullptr;
+    pthread_mutex_lock( &list->lock );
+    for( size_t i = 0; i < VEC_SIZE( list->relays ); ++i ){
+        if( strcmp( list->relays[i]->name, name ) == 0 ){
+            relay = list->relays[i];
+            break;
+        }
+    }
+    if( !relay ){
+        relay = ezalloc( relay );
+        char *dup = relay ? str_dup( name ) : nullptr;
+        rtmp_relay_t *loc = dup ? VEC_PUSH( list->relays ) : nullptr;
+        if( !loc ){
+            free( dup );
+            free( relay );
+            pthread_mutex_unlock( &list->lock );
+            return nullptr;
+        }
+        relay->list = list;
+        relay->name = dup;
+        relay->mgr = mgr;
+        VEC_INIT( relay->subscribers );
+        VEC_INIT( relay->frames );
+        VEC_INIT( relay->gop.blocks );
+        VEC_INIT( relay->gop.frames );
+        *loc = relay;
+    }
+    if( publisher ){
+        if( relay->claimed ){
+            relay = nullptr;
+        }
+        else{
+            relay->claimed = true;
+        }
+    }
+    if( relay ){
+        relay->refs++;
+    }
+    pthread_mutex_unlock( &list->lock );
+    return relay;
+}
+
+void rtmp_relay_release( rtmp_relay_t relay, bool publisher ){
+    rtmp_relay_list_t list = relay->list;
+    pthread_mutex_lock( &list->lock );
+    if( publisher ){
+        relay->claimed = false;
+    }
+    if( --relay->refs > 0 ){
+        pthread_mutex_unlock( &list->lock );
+        return;
+    }
+    for( size_t i = 0; i < VEC_SIZE( list->relays ); ++i ){
+        if( list->relays[i] == relay ){
+            VEC_ERASE( list->relays, i );
+            break;
+        }
+    }
+    pthread_mutex_unlock( &list->lock );
+    rtmp_relay_free( relay );
+}
+
+rtmp_t rtmp_relay_mgr( rtmp_relay_t relay ){
+    return relay->mgr;
+}
+
+static void rtmp_relay_frame_release( const byte *data, void *user ){
+    rtmp_relay_frame_t *frame = user;
+    if( --frame->refs == 0 ){
+        free( frame );
+    }
+}
+
+//Finds or builds the framing of msg for one chunk size and message stream
+static rtmp_relay_frame_t * rtmp_relay_frame_get( rtmp_relay_t relay, rtmp_chunk_stream_message_t *msg, const byte *data, uint32_t chunk_size ){
+    for( size_t i = 0; i < VEC_SIZE( relay->frames ); ++i ){
+        rtmp_relay_frame_t *frame = relay->frames[i];
+        if( frame->chunk_size == chunk_size && frame->msg_stream == msg->message_stream_id ){
+            return frame;
+        }
+    }
+    size_t size = rtmp_chunk_frame_size( msg, chunk_size );
+    rtmp_relay_frame_t *frame = size ? malloc( sizeof( rtmp_relay_frame_t ) + size ) : nullptr;
+    rtmp_relay_frame_t **loc = frame ? VEC_PUSH( relay->frames ) : nullptr;
+    if( !loc ){
+        free( frame );
+        return nullptr;
+    }
+    //The relay holds one reference until the message has been offered to everyone
+    frame->refs = 1;
+    frame->chunk_size = chunk_size;
+    frame->msg_stream = msg->message_stream_id;
+    frame->len = rtmp_chunk_frame_message( frame->data, msg, data, chunk_size );
+    *loc = frame;
+    return frame;
+}
+
+static void rtmp_relay_broadcast( rtmp_relay_t relay, rtmp_message_type_t type, uint32_t chunk_stream, rtmp_time_t timestamp, const byte *data, size_t length ){
+    bool video = type == RTMP_MSG_VIDEO;
+    bool keyframe = rtmp_relay_is_keyframe( type, data, length );
+    rtmp_chunk_stream_message_t msg;
+    msg.chunk_stream_id = chunk_stream;
+    msg.timestamp = timestamp;
+    msg.message_length = length;
+    msg.message_type = type;
+
+    for( size_t i = 0; i < VEC_SIZE( relay->subscribers ); ++i ){
+        rtmp_relay_sub_t *sub = &relay->subscribers[i];
+        if( video && sub->need_key && !keyframe ){
+            continue;
+        }
+        rtmp_chunk_conn_t conn = rtmp_stream_get_conn( sub->stream );
+        msg.message_stream_id = sub->msg_stream;
+        rtmp_relay_frame_t *frame = rtmp_relay_frame_get( relay, &msg, data, conn->self_chunk_size );
+        rtmp_err_t err = RTMP_ERR_OOM;
+        if( frame ){
+            frame->refs++;
+            err = rtmp_chunk_conn_send_framed_ref( conn, chunk_stream, type, frame->data, frame->len, rtmp_relay_frame_release, frame );
+            if( err >= RTMP_ERR_ERROR ){
+                frame->refs--;
+            }
+        }
+        //A subscriber that can't keep up, because its buffers are full or it is too far behind on acknowledgements,
+        //loses frames. Once video has been dropped, nothing it receives can be decoded until the next keyframe,
+        //so don't bother sending any.
+        if( video ){
+            sub->need_key = err >= RTMP_ERR_ERROR;
+        }
+    }
+    for( size_t i = 0; i < VEC_SIZE( relay->frames ); ++i ){
+        rtmp_relay_frame_release( nullptr, relay->frames[i] );
+    }
+    VEC_SIZE( relay->frames ) = 0;
+}
+
+rtmp_err_t rtmp_relay_attach_publisher( rtmp_relay_t relay, rtmp_stream_t stream ){
+    if( relay->publisher ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
+    }
+    relay->publisher = stream;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+void rtmp_relay_detach_publisher( rtmp_relay_t relay ){
+    relay->publisher = nullptr;
+    relay->audio.len = 0;
+    relay->video.len = 0;
+    free( relay->metadata );
+    relay->metadata = nullptr;
+    relay->metadata_len = 0;
+    rtmp_relay_gop_clear( relay );
+    relay->gop.active = false;
+    rtmp_relay_seqhdr_set( &relay->gop.video_hdr, 0, nullptr, 0 );
+    rtmp_relay_seqhdr_set( &relay->gop.audio_hdr, 0, nullptr, 0 );
+    //Subscribers stay attached and pick up again at the first keyframe of the next publisher
+    for( size_t i = 0; i < VEC_SIZE( relay->subscribers ); ++i ){
+        rtmp_relay_sub_t *sub = &relay->subscribers[i];
+        sub->need_key = true;
+        rtmp_stream_send_stream_eof( sub->stream, sub->msg_stream );
+    }
+}
+
+rtmp_err_t rtmp_relay_attach( rtmp_relay_t relay, rtmp_stream_t stream, uint32_t msg_stream ){
+    rtmp_relay_sub_t *sub = VEC_PUSH( relay->subscribers );
+    if( !sub ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    sub->stream = stream;
+    sub->msg_stream = msg_stream;
+    sub->need_key = true;
+    STAT_SET( relay, subscribers, VEC_SIZE( relay->subscribers ) );
+
+    rtmp_chunk_conn_t conn = rtmp_stream_get_conn( stream );
+    rtmp_relay_gop_t *gop = &relay->gop;
+    if( relay->metadata ){
+        rtmp_chunk_conn_send_message( conn, RTMP_MSG_AMF0_DAT, RTMP_RELAY_DATA_CHUNK_STREAM,
+                                      msg_stream, 0, relay->metadata, relay->metadata_len, nullptr );
+    }
+    if( gop->video_hdr.data ){
+        rtmp_chunk_conn_send_message( conn, RTMP_MSG_VIDEO, RTMP_RELAY_VIDEO_CHUNK_STREAM,
+                                      msg_stream, gop->video_hdr.timestamp, gop->video_hdr.data, gop->video_hdr.len, nullptr );
+    }
+    if( gop->audio_hdr.data ){
+        rtmp_chunk_conn_send_message( conn, RTMP_MSG_AUDIO, RTMP_RELAY_AUDIO_CHUNK_STREAM,
+                                      msg_stream, gop->audio_hdr.timestamp, gop->audio_hdr.data, gop->audio_hdr.len, nullptr );
+    }
+    //Replay the cached GOP straight out of the arena, so the subscriber can start from its keyframe
+    //instead of waiting for the next one
+    size_t sent = 0;
+    for( ; sent < VEC_SIZE( gop->frames ); ++sent ){
+        rtmp_relay_cached_t *cached = &gop->frames[sent];
+        cached->block->refs++;
+        if( rtmp_chunk_conn_send_message_ref( conn, cached->type,
+                cached->type == RTMP_MSG_VIDEO ? RTMP_RELAY_VIDEO_CHUNK_STREAM : RTMP_RELAY_AUDIO_CHUNK_STREAM,
+                msg_stream, cached->timestamp, cached->block->data + cached->offset, cached->len,
+                rtmp_relay_block_release, cached->block ) >= RTMP_ERR_ERROR ){
+            cached->block->refs--;
+            break;
+        }
+    }
+    if( sent > 0 && sent == VEC_SIZE( gop->frames ) ){
+        sub->need_key = false;
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+void rtmp_relay_detach( rtmp_relay_t relay, rtmp_stream_t stream ){
+    for( size_t i = 0; i < VEC_SIZE( relay->subscribers ); ++i ){
+        if( relay->subscribers[i].stream == stream ){
+            VEC_ERASE( relay->subscribers, i );
+            STAT_SET( relay, subscribers, VEC_SIZE( relay->subscribers ) );
+            return;
+        }
+    }
+}
+
+size_t rtmp_relay_subscriber_count( rtmp_relay_t relay ){
+    return VEC_SIZE( relay->subscribers );
+}
+
+rtmp_err_t rtmp_relay_media( rtmp_relay_t relay, rtmp_message_type_t type, rtmp_time_t timestamp, const byte *data, size_t length, size_t remaining ){
+    rtmp_relay_partial_t *partial = type == RTMP_MSG_VIDEO ? &relay->video : &relay->audio;
+    uint32_t chunk_stream = type == RTMP_MSG_VIDEO ? RTMP_RELAY_VIDEO_CHUNK_STREAM : RTMP_RELAY_AUDIO_CHUNK_STREAM;
+
+    if( length == 0 && remaining == 0 ){
+        //An aborted message; whatever was gathered of it is thrown away
+        partial->len = 0;
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    //Whole messages are passed straight through without being copied
+    if( partial->len == 0 && remaining == 0 ){
+        rtmp_relay_gop_push( relay, type, timestamp, data, length );
+        rtmp_relay_broadcast( relay, type, chunk_stream, timestamp, data, length );
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    size_t needed = partial->len + length + remaining;
+    if( needed > RTMP_MAX_IO_BUFFER_SIZE ){
+        partial->len = 0;
+        return RTMP_GEN_ERROR(RTMP_ERR_INADEQUATE_CHUNK);
+    }
+    if( needed > partial->cap ){
+        byte *grown = realloc( partial->data, needed );
+        if( !grown ){
+            partial->len = 0;
+            return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+        }
+        partial->data = grown;
+        partial->cap = needed;
+    }
+    memcpy( partial->data + partial->len, data, length );
+    partial->len += length;
+    if( remaining == 0 ){
+        rtmp_relay_gop_push( relay, type, timestamp, partial->data, partial->len );
+        rtmp_relay_broadcast( relay, type, chunk_stream, timestamp, partial->data, partial->len );
+        partial->len = 0;
+    }
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+rtmp_err_t rtmp_relay_metadata( rtmp_relay_t relay, const byte *data, size_t length ){
+    byte *copy = malloc( length );
+    if( !copy ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+    memcpy( copy, data, length );
+    free( relay->metadata );
+    relay->metadata = copy;
+    relay->metadata_len = length;
+    rtmp_relay_broadcast( relay, RTMP_MSG_AMF0_DAT, RTMP_RELAY_DATA_CHUNK_STREAM, 0, copy, length );
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
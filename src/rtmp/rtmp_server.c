@@ -25,6 +25,7 @@
 #include <openrtmp/rtmp/rtmp_types.h>
 #include <openrtmp/rtmp/rtmp_stream.h>
 #include <openrtmp/rtmp/rtmp_private.h>
+#include <openrtmp/rtmp/rtmp_relay.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <openrtmp/util/memutil.h>
@@ -40,6 +41,20 @@ struct rtmp_server{
     rtmp_app_t app;
     VEC_DECLARE(rtmp_server_stream_t) streams;
     size_t next_stream;
+
+    //The published stream this connection is playing or publishing, if any
+    rtmp_relay_t relay;
+    uint32_t relay_stream;
+    bool relay_publisher;
+    //Only set once the connection is running on the relay's manager
+    bool relay_attached;
+    //Fragments of the publisher's data message which is still being received
+    byte *data;
+    size_t data_len;
+    size_t data_cap;
+
+    //The pool this server's memory is returned to, if it came from one
+    slab_pool_t pool;
 };
 
 
@@ -111,7 +126,7 @@ rtmp_cb_status_t rtmp_server_onconnect(
     if( !str || self->applist == nullptr || self->app != nullptr ){
         goto fail;
     }
-    printf("Got connection for app %s\n", str );
+    RTMP_LOG( RTMP_LOG_NOTICE, RTMP_ERR_NONE, "Got connection for app %s", str );
 
     self->app = rtmp_app_list_get( self->applist, str );
 
@@ -218,6 +233,70 @@ rtmp_cb_status_t rtmp_server_onFCPublish( rtmp_stream_args_t args, amf_t object,
     return err ? RTMP_CB_ERROR : RTMP_CB_CONTINUE;
 }
 
+//Runs on the relay's manager
+static void rtmp_server_relay_attach( rtmp_server_t self ){
+    rtmp_err_t err;
+    if( self->relay_publisher ){
+        err = rtmp_relay_attach_publisher( self->relay, &self->stream );
+    }
+    else{
+        err = rtmp_relay_attach( self->relay, &self->stream, self->relay_stream );
+    }
+    self->relay_attached = err == RTMP_ERR_NONE;
+}
+
+static void rtmp_server_relay_adopted( rtmp_t mgr, rtmp_stream_t stream, rtmp_err_t err, void *user ){
+    //On failure the connection is either gone or still on its old manager. Either way the
+    //reference is dropped when the connection is destroyed.
+    if( err == RTMP_ERR_NONE ){
+        rtmp_server_relay_attach( (rtmp_server_t)user );
+    }
+}
+
+//Joins the relay for name, first moving this connection to the relay's manager if it lives elsewhere,
+//so that all fan-out for a published stream happens on a single thread.
+static rtmp_err_t rtmp_server_relay_enter( rtmp_server_t self, const char *name, uint32_t msg_stream, bool publisher ){
+    if( self->relay ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
+    }
+    rtmp_t mgr = self->stream.mgr;
+    rtmp_relay_t relay = rtmp_relay_acquire( rtmp_app_relays( self->app ), name, mgr, publisher );
+    if( !relay ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
+    }
+    self->relay = relay;
+    self->relay_stream = msg_stream;
+    self->relay_publisher = publisher;
+    if( rtmp_relay_mgr( relay ) == mgr ){
+        rtmp_server_relay_attach( self );
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    rtmp_err_t err = rtmp_handoff( mgr, rtmp_relay_mgr( relay ), &self->stream, rtmp_server_relay_adopted, self );
+    if( err >= RTMP_ERR_ERROR ){
+        rtmp_relay_release( relay, publisher );
+        self->relay = nullptr;
+    }
+    return err;
+}
+
+static void rtmp_server_relay_leave( rtmp_server_t self ){
+    if( !self->relay ){
+        return;
+    }
+    if( self->relay_attached ){
+        if( self->relay_publisher ){
+            rtmp_relay_detach_publisher( self->relay );
+        }
+        else{
+            rtmp_relay_detach( self->relay, &self->stream );
+        }
+    }
+    rtmp_relay_release( self->relay, self->relay_publisher );
+    self->relay = nullptr;
+    self->relay_attached = false;
+    self->data_len = 0;
+}
+
 rtmp_cb_status_t rtmp_server_onpublish( rtmp_stream_args_t args, amf_t object, void *user ){
     const rtmp_stream_t stream = args->stream;
     ALIAS( user, rtmp_server_t, self );
@@ -243,6 +322,19 @@ rtmp_cb_status_t rtmp_server_onpublish( rtmp_stream_args_t args, amf_t object, v
     }
 
     rtmp_err_t err = RTMP_ERR_NONE;
+    if( rtmp_server_relay_enter( self, target, args->message_stream, true ) != RTMP_ERR_NONE ){
+        rtmp_stream_respond2( stream, 3, args->message_stream, "onStatus", amf_value_get_integer(amf_get_item( object, 1 )),
+            AMF(
+                AMF_NULL(),
+                AMF_OBJ(
+                    AMF_STR("level", "error"),
+                    AMF_STR("code", RTMP_NETSTREAM_BADNAME),
+                    AMF_STR("description", target)
+                )
+            )
+        );
+        return RTMP_CB_ERROR;
+    }
     err = err ? err : rtmp_stream_respond2( stream, 3, 1, "onStatus", amf_value_get_integer(amf_get_item( object, 1 )),
         AMF(
             AMF_NULL(),
@@ -257,6 +349,71 @@ rtmp_cb_status_t rtmp_server_onpublish( rtmp_stream_args_t args, amf_t object, v
     return err ? RTMP_CB_ERROR : RTMP_CB_CONTINUE;
 }
 
+rtmp_cb_status_t rtmp_server_onplay( rtmp_stream_args_t args, amf_t object, void *user ){
+    const rtmp_stream_t stream = args->stream;
+    ALIAS( user, rtmp_server_t, self );
+    if(!self->app){
+        return RTMP_CB_ERROR;
+    }
+    if( amf_get_count( object ) < 4 ||
+       !amf_value_is_like( amf_get_item( object, 1 ), AMF_TYPE_INTEGER) ||
+       !amf_value_is( amf_get_item( object, 3 ), AMF_TYPE_STRING ) ){
+        return RTMP_CB_ERROR;
+    }
+
+    char buffer[RTMP_TEMP_BUFF_SIZE+22] = "Playing ";
+    size_t offset = strlen(buffer);
+    const char * target = amf_value_get_string( amf_get_item( object, 3 ), nullptr );
+    double txn = amf_value_get_integer(amf_get_item( object, 1 ));
+    snprintf( buffer + offset, RTMP_TEMP_BUFF_SIZE, "%s", target );
+
+    rtmp_cb_status_t status = rtmp_app_play( stream, self->app, target );
+    if( status != RTMP_CB_CONTINUE ){
+        return status;
+    }
+
+    rtmp_err_t err = RTMP_ERR_NONE;
+    //The status messages are queued before a possible handoff, and travel with the connection
+    err = err ? err : rtmp_stream_send_stream_begin( stream, args->message_stream );
+    err = err ? err : rtmp_stream_respond2( stream, 3, args->message_stream, "onStatus", txn,
+        AMF(
+            AMF_NULL(),
+            AMF_OBJ(
+                AMF_STR("level", "status"),
+                AMF_STR("code", RTMP_NETSTREAM_PLAY_RESET),
+                AMF_STR("description", buffer)
+            )
+        )
+    );
+    err = err ? err : rtmp_stream_respond2( stream, 3, args->message_stream, "onStatus", txn,
+        AMF(
+            AMF_NULL(),
+            AMF_OBJ(
+                AMF_STR("level", "status"),
+                AMF_STR("code", RTMP_NETSTREAM_PLAY_START),
+                AMF_STR("description", buffer)
+            )
+        )
+    );
+    if( err ){
+        return RTMP_CB_ERROR;
+    }
+    if( rtmp_server_relay_enter( self, target, args->message_stream, false ) != RTMP_ERR_NONE ){
+        rtmp_stream_respond2( stream, 3, args->message_stream, "onStatus", txn,
+            AMF(
+                AMF_NULL(),
+                AMF_OBJ(
+                    AMF_STR("level", "error"),
+                    AMF_STR("code", RTMP_NETSTREAM_PLAY_FAILED),
+                    AMF_STR("description", buffer)
+                )
+            )
+        );
+        return RTMP_CB_ERROR;
+    }
+    return RTMP_CB_CONTINUE;
+}
+
 rtmp_cb_status_t rtmp_server_oncreateStream( rtmp_stream_args_t args, amf_t object, void *user ){
     const rtmp_stream_t stream = args->stream;
     ALIAS( user, rtmp_server_t, self);
@@ -345,6 +502,49 @@ rtmp_cb_status_t rtmp_server_onsetDataFrame( rtmp_stream_args_t args, amf_t obje
     return rtmp_app_metadata( args->stream, self->app, object );
 }
 
+//Passes the publisher's metadata on to subscribers as-is, minus the leading "@setDataFrame"
+static rtmp_cb_status_t rtmp_server_relay_data(rtmp_stream_args_t args, const byte *data, size_t length, size_t remaining, void * user){
+    static const byte marker[] = { AMF0_TYPE_STRING, 0, 13, '@','s','e','t','D','a','t','a','F','r','a','m','e' };
+    ALIAS( user, rtmp_server_t, self);
+    if( !self->relay_attached || !self->relay_publisher ){
+        return RTMP_CB_CONTINUE;
+    }
+    if( length == 0 && remaining == 0 ){
+        //An aborted message
+        self->data_len = 0;
+        return RTMP_CB_CONTINUE;
+    }
+    //Fragmented messages are gathered up first, so that the marker is matched against the whole payload
+    if( self->data_len > 0 || remaining > 0 ){
+        size_t needed = self->data_len + length + remaining;
+        if( needed > RTMP_MAX_IO_BUFFER_SIZE ){
+            self->data_len = 0;
+            return RTMP_CB_CONTINUE;
+        }
+        if( needed > self->data_cap ){
+            byte *grown = realloc( self->data, needed );
+            if( !grown ){
+                self->data_len = 0;
+                return RTMP_CB_CONTINUE;
+            }
+            self->data = grown;
+            self->data_cap = needed;
+        }
+        memcpy( self->data + self->data_len, data, length );
+        self->data_len += length;
+        if( remaining > 0 ){
+            return RTMP_CB_CONTINUE;
+        }
+        data = self->data;
+        length = self->data_len;
+        self->data_len = 0;
+    }
+    if( length > sizeof( marker ) && memcmp( data, marker, sizeof( marker ) ) == 0 ){
+        rtmp_relay_metadata( self->relay, data + sizeof( marker ), length - sizeof( marker ) );
+    }
+    return RTMP_CB_CONTINUE;
+}
+
 rtmp_cb_status_t rtmp_server_write_vid(rtmp_stream_args_t args, const byte *data, size_t length, size_t remaining, void * user){
     const rtmp_time_t timestamp = args->timestamp;
     ALIAS( user, rtmp_server_t, self);
@@ -360,6 +560,9 @@ rtmp_cb_status_t rtmp_server_write_vid(rtmp_stream_args_t args, const byte *data
         flv_write_backptr(output->file, output->last_size);
         output->last_size = 0;
     }*/
+    if( self->relay_attached && self->relay_publisher ){
+        rtmp_relay_media( self->relay, RTMP_MSG_VIDEO, args->timestamp, data, length, remaining );
+    }
     return rtmp_app_video( args->stream, self->app, args->message_stream, args->timestamp, data, length, remaining == 0 );
 }
 rtmp_cb_status_t rtmp_server_write_aud(rtmp_stream_args_t args, const byte *data, size_t length, size_t remaining, void * user){
@@ -377,36 +580,82 @@ rtmp_cb_status_t rtmp_server_write_aud(rtmp_stream_args_t args, const byte *data
         flv_write_backptr(output->file, output->last_size_a);
         output->last_size_a = 0;
     }*/
+    if( self->relay_attached && self->relay_publisher ){
+        rtmp_relay_media( self->relay, RTMP_MSG_AUDIO, args->timestamp, data, length, remaining );
+    }
     return rtmp_app_audio( args->stream, self->app, args->message_stream, args->timestamp, data, length, remaining == 0 );
 }
 
 
-rtmp_server_t rtmp_server_create( void ){
-    rtmp_server_t server = ezalloc( server );
-    rtmp_stream_create_at( &server->stream, false );
-    VEC_INIT( server->streams );
-    server->next_stream = 1;
-
+static void rtmp_server_register( rtmp_server_t server ){
     rtmp_stream_reg_amf( &server->stream, RTMP_MSG_AMF0_CMD, "connect", rtmp_server_onconnect, server );
     rtmp_stream_reg_amf( &server->stream, RTMP_MSG_AMF0_CMD, "releaseStream", rtmp_server_onreleaseStream, server );
     rtmp_stream_reg_amf( &server->stream, RTMP_MSG_AMF0_CMD, "FCPublish", rtmp_server_onFCPublish, server );
     rtmp_stream_reg_amf( &server->stream, RTMP_MSG_AMF0_CMD, "publish", rtmp_server_onpublish, server );
     rtmp_stream_reg_amf( &server->stream, RTMP_MSG_AMF0_CMD, "createStream", rtmp_server_oncreateStream, server );
+    rtmp_stream_reg_amf( &server->stream, RTMP_MSG_AMF0_CMD, "play", rtmp_server_onplay, server );
 
     rtmp_stream_reg_amf( &server->stream, RTMP_MSG_AMF0_DAT, "@setDataFrame", rtmp_server_onsetDataFrame, server );
 
     rtmp_stream_reg_msg( &server->stream, RTMP_MSG_VIDEO, rtmp_server_write_vid, server );
     rtmp_stream_reg_msg( &server->stream, RTMP_MSG_AUDIO, rtmp_server_write_aud, server );
+    rtmp_stream_reg_msg( &server->stream, RTMP_MSG_AMF0_DAT, rtmp_server_relay_data, server );
     rtmp_stream_reg_event( &server->stream, RTMP_EVENT_CONNECT_SUCCESS, rtmp_server_shake_done, server );
     rtmp_stream_reg_event( &server->stream, RTMP_EVENT_CONNECT_FAIL, rtmp_server_shake_fail, server );
+}
 
+static rtmp_server_t rtmp_server_init( rtmp_server_t server ){
+    rtmp_stream_create_at( &server->stream, false );
+    VEC_INIT( server->streams );
+    server->next_stream = 1;
+    rtmp_server_register( server );
     return server;
 }
 
+rtmp_server_t rtmp_server_create( void ){
+    rtmp_server_t server = ezalloc( server );
+    if( !server ){
+        return nullptr;
+    }
+    return rtmp_server_init( server );
+}
+
+slab_pool_t rtmp_server_pool_create( size_t per_slab ){
+    return slab_pool_create( sizeof( struct rtmp_server ), per_slab );
+}
+
+rtmp_server_t rtmp_server_create_pooled( slab_pool_t pool ){
+    rtmp_server_t server = slab_alloc( pool );
+    if( !server ){
+        return nullptr;
+    }
+    server->pool = pool;
+    return rtmp_server_init( server );
+}
+
+void rtmp_server_recycle( rtmp_server_t server ){
+    rtmp_server_relay_leave( server );
+    rtmp_stream_reset_at( &server->stream, false );
+    VEC_SIZE( server->streams ) = 0;
+    server->next_stream = 1;
+    server->applist = nullptr;
+    server->app = nullptr;
+    server->relay_stream = 0;
+    server->relay_publisher = false;
+    rtmp_server_register( server );
+}
+
 void rtmp_server_destroy( rtmp_server_t server ){
+    rtmp_server_relay_leave( server );
+    free( server->data );
     VEC_DESTROY( server->streams );
     rtmp_stream_destroy_at( &server->stream );
-    free( server );
+    if( server->pool ){
+        slab_free( server );
+    }
+    else{
+        free( server );
+    }
 }
 
 bool rtmp_server_connected( rtmp_server_t server ){
@@ -0,0 +1,190 @@
+/*
+    rtmp_stats.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <string.h>
+#include <pthread.h>
+#include <openrtmp/rtmp/rtmp_stats.h>
+#include <openrtmp/rtmp/rtmp_private.h>
+
+#define RTMP_HISTOGRAM_SUB (1ull << RTMP_HISTOGRAM_PRECISION)
+
+//Every manager that currently exists, plus the totals of those which have been destroyed
+static struct{
+    pthread_mutex_t lock;
+    VEC_DECLARE(rtmp_t) managers;
+    rtmp_stats_t retired;
+    rtmp_histogram_t retired_service_time;
+} rtmp_stats_registry = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+
+//Values below RTMP_HISTOGRAM_SUB get a bucket each. Above that, each power of two is split into RTMP_HISTOGRAM_SUB buckets.
+static size_t rtmp_histogram_bucket( uint64_t value ){
+    if( value < RTMP_HISTOGRAM_SUB ){
+        return value;
+    }
+    size_t magnitude = 63 - __builtin_clzll( value );
+    if( magnitude >= RTMP_HISTOGRAM_MAGNITUDE ){
+        return RTMP_HISTOGRAM_BUCKETS - 1;
+    }
+    size_t shift = magnitude - RTMP_HISTOGRAM_PRECISION;
+    return ( ( shift + 1 ) << RTMP_HISTOGRAM_PRECISION ) + ( value >> shift ) - RTMP_HISTOGRAM_SUB;
+}
+
+//The largest value which lands in a bucket
+static uint64_t rtmp_histogram_bucket_max( size_t bucket ){
+    if( bucket < RTMP_HISTOGRAM_SUB ){
+        return bucket;
+    }
+    size_t shift = ( bucket >> RTMP_HISTOGRAM_PRECISION ) - 1;
+    uint64_t base = RTMP_HISTOGRAM_SUB + ( bucket & ( RTMP_HISTOGRAM_SUB - 1 ) );
+    return ( ( base + 1 ) << shift ) - 1;
+}
+
+void rtmp_histogram_record( rtmp_histogram_t *hist, uint64_t value ){
+    RTMP_STAT_ADD( hist->buckets[rtmp_histogram_bucket( value )], 1 );
+    RTMP_STAT_ADD( hist->count, 1 );
+    RTMP_STAT_ADD( hist->sum, value );
+    if( value > hist->max ){
+        __atomic_store_n( &hist->max, value, __ATOMIC_RELAXED );
+    }
+}
+
+void rtmp_histogram_merge( rtmp_histogram_t *dst, const rtmp_histogram_t *src ){
+    for( size_t i = 0; i < RTMP_HISTOGRAM_BUCKETS; ++i ){
+        dst->buckets[i] += RTMP_STAT_GET( src->buckets[i] );
+    }
+    dst->count += RTMP_STAT_GET( src->count );
+    dst->sum += RTMP_STAT_GET( src->sum );
+    uint64_t max = RTMP_STAT_GET( src->max );
+    if( max > dst->max ){
+        dst->max = max;
+    }
+}
+
+uint64_t rtmp_histogram_percentile( const rtmp_histogram_t *hist, double percentile ){
+    uint64_t count = RTMP_STAT_GET( hist->count );
+    uint64_t max = RTMP_STAT_GET( hist->max );
+    if( count == 0 ){
+        return 0;
+    }
+    if( percentile >= 100 ){
+        return max;
+    }
+    uint64_t target = percentile > 0 ? (uint64_t)( count * percentile / 100 ) : 0;
+    uint64_t seen = 0;
+    for( size_t i = 0; i < RTMP_HISTOGRAM_BUCKETS; ++i ){
+        seen += RTMP_STAT_GET( hist->buckets[i] );
+        if( seen > target ){
+            uint64_t value = rtmp_histogram_bucket_max( i );
+            return value < max ? value : max;
+        }
+    }
+    //Buckets were still being written while we read them
+    return max;
+}
+
+void rtmp_stats_merge( rtmp_stats_t *dst, const rtmp_stats_t *src ){
+    dst->connections += RTMP_STAT_GET( src->connections );
+    dst->bytes_in += RTMP_STAT_GET( src->bytes_in );
+    dst->bytes_out += RTMP_STAT_GET( src->bytes_out );
+    dst->queue_depth += RTMP_STAT_GET( src->queue_depth );
+    dst->chunks_in += RTMP_STAT_GET( src->chunks_in );
+    dst->chunks_out += RTMP_STAT_GET( src->chunks_out );
+    for( size_t i = 0; i < RTMP_STATS_MSG_TYPES; ++i ){
+        dst->messages_in[i] += RTMP_STAT_GET( src->messages_in[i] );
+        dst->messages_out[i] += RTMP_STAT_GET( src->messages_out[i] );
+    }
+    dst->handshakes += RTMP_STAT_GET( src->handshakes );
+    dst->handshake_time += RTMP_STAT_GET( src->handshake_time );
+    dst->callback_time += RTMP_STAT_GET( src->callback_time );
+    dst->paused_time += RTMP_STAT_GET( src->paused_time );
+    dst->syscalls += RTMP_STAT_GET( src->syscalls );
+    dst->throttled += RTMP_STAT_GET( src->throttled );
+}
+
+rtmp_err_t rtmp_stats_register( rtmp_t mgr ){
+    rtmp_err_t ret = RTMP_ERR_NONE;
+    pthread_mutex_lock( &rtmp_stats_registry.lock );
+    if( !rtmp_stats_registry.managers ){
+        VEC_INIT( rtmp_stats_registry.managers );
+    }
+    rtmp_t *loc = rtmp_stats_registry.managers ? VEC_PUSH( rtmp_stats_registry.managers ) : nullptr;
+    if( loc ){
+        *loc = mgr;
+    }
+    else{
+        ret = RTMP_ERR_OOM;
+    }
+    pthread_mutex_unlock( &rtmp_stats_registry.lock );
+    return RTMP_GEN_ERROR(ret);
+}
+
+void rtmp_stats_unregister( rtmp_t mgr ){
+    pthread_mutex_lock( &rtmp_stats_registry.lock );
+    size_t count = rtmp_stats_registry.managers ? VEC_SIZE( rtmp_stats_registry.managers ) : 0;
+    for( size_t i = 0; i < count; ++i ){
+        if( rtmp_stats_registry.managers[i] != mgr ){
+            continue;
+        }
+        VEC_ERASE( rtmp_stats_registry.managers, i );
+        rtmp_stats_t stats;
+        memset( &stats, 0, sizeof( stats ) );
+        rtmp_stats_merge( &stats, &mgr->stats );
+        //The connections go with the manager, and so does anything they had queued
+        stats.connections = 0;
+        stats.queue_depth = 0;
+        rtmp_stats_merge( &rtmp_stats_registry.retired, &stats );
+        rtmp_histogram_merge( &rtmp_stats_registry.retired_service_time, &mgr->service_time );
+        break;
+    }
+    pthread_mutex_unlock( &rtmp_stats_registry.lock );
+}
+
+void rtmp_get_stats( rtmp_t mgr, rtmp_stats_t *stats, rtmp_histogram_t *service_time ){
+    memset( stats, 0, sizeof( rtmp_stats_t ) );
+    if( service_time ){
+        memset( service_time, 0, sizeof( rtmp_histogram_t ) );
+    }
+    if( mgr ){
+        rtmp_stats_merge( stats, &mgr->stats );
+        if( service_time ){
+            rtmp_histogram_merge( service_time, &mgr->service_time );
+        }
+        return;
+    }
+    pthread_mutex_lock( &rtmp_stats_registry.lock );
+    rtmp_stats_merge( stats, &rtmp_stats_registry.retired );
+    if( service_time ){
+        rtmp_histogram_merge( service_time, &rtmp_stats_registry.retired_service_time );
+    }
+    size_t count = rtmp_stats_registry.managers ? VEC_SIZE( rtmp_stats_registry.managers ) : 0;
+    for( size_t i = 0; i < count; ++i ){
+        rtmp_stats_merge( stats, &rtmp_stats_registry.managers[i]->stats );
+        if( service_time ){
+            rtmp_histogram_merge( service_time, &rtmp_stats_registry.managers[i]->service_time );
+        }
+    }
+    pthread_mutex_unlock( &rtmp_stats_registry.lock );
+}
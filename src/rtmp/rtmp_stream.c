@@ -27,6 +27,7 @@
 #include <openrtmp/rtmp.h>
 #include <openrtmp/rtmp/rtmp_private.h>
 #include <openrtmp/util/memutil.h>
+#include <openrtmp/util/algorithm.h>
 #include <stdio.h>
 
 
@@ -50,68 +51,300 @@ static rtmp_cb_status_t rtmp_stream_call_msg(
     return ret;
 }
 
+#define RTMP_NO_CB ((size_t)-1)
+
+static uint32_t rtmp_stream_amf_hash( rtmp_message_type_t type, const char *name, size_t len ){
+    uint32_t hash = alg_hash( &type, sizeof( type ), ALG_HASH_SEED );
+    return name ? alg_hash( name, len, hash ) : hash;
+}
+
+//Returns the slot holding the key, or the empty slot where it would go
+static rtmp_amf_slot_t * rtmp_stream_amf_slot( rtmp_stream_t stream, rtmp_message_type_t type, const char *name, size_t len, uint32_t hash ){
+    size_t mask = stream->amf_index_cap - 1;
+    for( size_t i = hash & mask; ; i = ( i + 1 ) & mask ){
+        rtmp_amf_slot_t *slot = &stream->amf_index[i];
+        if( slot->head == RTMP_NO_CB ){
+            return slot;
+        }
+        if( slot->hash != hash ){
+            continue;
+        }
+        rtmp_amf_cb_t *cb = &stream->amf_callback[slot->head];
+        if( cb->type != type ){
+            continue;
+        }
+        if( name == nullptr ? cb->name == nullptr : ( cb->name && cb->name_len == len && memcmp( cb->name, name, len ) == 0 ) ){
+            return slot;
+        }
+    }
+}
+
+//Returns the first callback registered for the key
+static size_t rtmp_stream_amf_find( rtmp_stream_t stream, rtmp_message_type_t type, const char *name, size_t len ){
+    if( !stream->amf_index ){
+        return RTMP_NO_CB;
+    }
+    return rtmp_stream_amf_slot( stream, type, name, len, rtmp_stream_amf_hash( type, name, len ) )->head;
+}
+
+static bool rtmp_stream_amf_grow( rtmp_stream_t stream ){
+    size_t cap = stream->amf_index_cap ? stream->amf_index_cap * 2 : 16;
+    rtmp_amf_slot_t *old = stream->amf_index;
+    size_t old_cap = stream->amf_index_cap;
+    rtmp_amf_slot_t *index = malloc( sizeof( rtmp_amf_slot_t ) * cap );
+    if( !index ){
+        return false;
+    }
+    for( size_t i = 0; i < cap; ++i ){
+        index[i].head = RTMP_NO_CB;
+    }
+    for( size_t i = 0; i < old_cap; ++i ){
+        if( old[i].head != RTMP_NO_CB ){
+            size_t j = old[i].hash & ( cap - 1 );
+            while( index[j].head != RTMP_NO_CB ){
+                j = ( j + 1 ) & ( cap - 1 );
+            }
+            index[j] = old[i];
+        }
+    }
+    free( old );
+    stream->amf_index = index;
+    stream->amf_index_cap = cap;
+    return true;
+}
+
+//Pending calls are keyed by transaction ID. IDs are handed out sequentially, so they spread evenly without hashing.
+static rtmp_call_cb_t * rtmp_stream_call_find( rtmp_stream_t stream, uint32_t seq_num ){
+    if( stream->calls_used == 0 || seq_num == 0 ){
+        return nullptr;
+    }
+    size_t mask = stream->calls_cap - 1;
+    for( size_t i = seq_num & mask; stream->calls[i].seq_num != 0; i = ( i + 1 ) & mask ){
+        if( stream->calls[i].seq_num == seq_num ){
+            return &stream->calls[i];
+        }
+    }
+    return nullptr;
+}
+
+static void rtmp_stream_call_place( rtmp_call_cb_t *calls, size_t cap, const rtmp_call_cb_t *call ){
+    size_t i = call->seq_num & ( cap - 1 );
+    while( calls[i].seq_num != 0 ){
+        i = ( i + 1 ) & ( cap - 1 );
+    }
+    calls[i] = *call;
+}
+
+static bool rtmp_stream_call_insert( rtmp_stream_t stream, const rtmp_call_cb_t *call ){
+    if( ( stream->calls_used + 1 ) * 2 > stream->calls_cap ){
+        size_t cap = stream->calls_cap ? stream->calls_cap * 2 : 16;
+        rtmp_call_cb_t *calls = calloc( cap, sizeof( rtmp_call_cb_t ) );
+        if( !calls ){
+            return false;
+        }
+        for( size_t i = 0; i < stream->calls_cap; ++i ){
+            if( stream->calls[i].seq_num != 0 ){
+                rtmp_stream_call_place( calls, cap, &stream->calls[i] );
+            }
+        }
+        free( stream->calls );
+        stream->calls = calls;
+        stream->calls_cap = cap;
+    }
+    if( stream->calls_used == 0 ){
+        stream->calls_oldest = call->seq_num;
+    }
+    rtmp_stream_call_place( stream->calls, stream->calls_cap, call );
+    stream->calls_used++;
+    return true;
+}
+
+//Removes a call, shifting back any entries in its probe run so that no tombstones are needed
+static void rtmp_stream_call_remove( rtmp_stream_t stream, rtmp_call_cb_t *call ){
+    size_t mask = stream->calls_cap - 1;
+    size_t hole = call - stream->calls;
+    for( size_t i = ( hole + 1 ) & mask; stream->calls[i].seq_num != 0; i = ( i + 1 ) & mask ){
+        size_t home = stream->calls[i].seq_num & mask;
+        //Entries whose home lies cyclically in (hole, i] have to stay put
+        bool stays = hole <= i ? ( home > hole && home <= i ) : ( home > hole || home <= i );
+        if( !stays ){
+            stream->calls[hole] = stream->calls[i];
+            hole = i;
+        }
+    }
+    stream->calls[hole].seq_num = 0;
+    stream->calls_used--;
+}
+
+//Drops calls which have gone unanswered for too long. Calls are issued in order, so only the oldest ones need checking,
+//and each transaction ID is stepped over at most once.
+static void rtmp_stream_call_expire( rtmp_stream_t stream, rtmp_time_t now ){
+    while( stream->calls_used > 0 && stream->calls_oldest != stream->seq_num ){
+        rtmp_call_cb_t *call = rtmp_stream_call_find( stream, stream->calls_oldest );
+        if( call ){
+            if( now - call->issued < RTMP_CALL_TIMEOUT ){
+                return;
+            }
+            rtmp_stream_call_remove( stream, call );
+        }
+        if( ++stream->calls_oldest == 0 ){
+            stream->calls_oldest = 1;
+        }
+    }
+}
+
+//Expires calls without waiting for a result to arrive, then waits for the next oldest
+static void rtmp_stream_call_timeout( timer_entry_t *timer, void *user ){
+    rtmp_stream_t stream = user;
+    rtmp_stream_call_expire( stream, rtmp_get_time() );
+    rtmp_call_cb_t *call = stream->calls_used > 0 ? rtmp_stream_call_find( stream, stream->calls_oldest ) : nullptr;
+    if( call ){
+        timer_wheel_schedule( stream->mgr->timers, timer, call->issued + RTMP_CALL_TIMEOUT );
+    }
+}
+
+void rtmp_stream_attach( rtmp_stream_t stream, rtmp_t mgr ){
+    if( stream->mgr ){
+        timer_wheel_cancel( stream->mgr->timers, &stream->call_timer );
+    }
+    stream->mgr = mgr;
+    //Calls may have expired while the stream was between managers, so check right away
+    if( mgr && stream->calls_used > 0 ){
+        timer_wheel_schedule( mgr->timers, &stream->call_timer, 0 );
+    }
+}
+
+//Decodes the whole message, for when a handler actually wants it
+static amf_t rtmp_stream_decode_amf( char amf_ver, const byte *contents, size_t available ){
+    size_t amount = 0;
+    //Handlers expect NUL terminated strings, so copy them into the arena rather than borrowing
+    amf_t amf = amf_create_arena( amf_ver, available, false );
+    if( !amf ){
+        return nullptr;
+    }
+    if( amf_read( amf, contents, available, &amount ) < 0 ){
+        amf_destroy( amf );
+        return nullptr;
+    }
+    return amf;
+}
+
+//The command name and transaction id are read straight from the message bytes,
+//and the message is only decoded once a callback is found which wants it.
 rtmp_cb_status_t rtmp_stream_call_amf(
     rtmp_stream_args_t args,
-    amf_t object
+    char amf_ver,
+    const byte *contents,
+    size_t available
 ){
-    amf_print( object );
     rtmp_cb_status_t ret = RTMP_CB_CONTINUE;
+    amf_t object = nullptr;
+    amf0_index_t index;
+    amf0_view_t item;
 
     const char* name = nullptr;
-    size_t len;
-
+    size_t len = 0;
+    bool has_seq = false;
+    uint32_t seq_num = 0;
+
+    //AMF3 messages lead with an encoding selector, and then carry AMF0 until an AVM+ marker
+    const byte *body = contents;
+    size_t body_len = available;
+    if( amf_ver == 3 && body_len > 0 && body[0] == 0 ){
+        ++body;
+        --body_len;
+    }
 
-    if( amf_get_count( object ) > 0 ){
-        amf_value_t item = amf_get_item( object, 0 );
-        if( amf_value_is_like( item, AMF_TYPE_STRING ) ){
-            name = amf_value_get_string( item, &len );
+    if( amf0_index_create( &index, body, body_len ) >= 0 ){
+        if( amf0_index_get( &index, 0, &item ) >= 0 ){
+            amf0_view_get_string( &item, &name, &len );
+        }
+        double number;
+        if( amf0_index_get( &index, 1, &item ) >= 0 && amf0_view_get_number( &item, &number ) >= 0 && number >= 0 && number <= UINT32_MAX ){
+            seq_num = number;
+            has_seq = true;
+        }
+    }
+    else{
+        //Values the index can't step over (mostly AVM+ values) have to be decoded up front
+        object = rtmp_stream_decode_amf( amf_ver, contents, available );
+        if( !object ){
+            return RTMP_CB_ERROR;
+        }
+        if( amf_get_count( object ) > 0 ){
+            amf_value_t value = amf_get_item( object, 0 );
+            if( amf_value_is_like( value, AMF_TYPE_STRING ) ){
+                name = amf_value_get_string( value, &len );
+            }
+        }
+        if( amf_get_count( object ) > 1 ){
+            amf_value_t value = amf_get_item( object, 1 );
+            if( amf_value_is_like( value, AMF_TYPE_INTEGER ) ){
+                seq_num = amf_value_get_integer( value );
+                has_seq = true;
+            }
         }
     }
 
-    rtmp_time_t now = rtmp_get_time();
+    RTMP_LOG( RTMP_LOG_DEBUG, RTMP_ERR_NONE, "Received command %.*s (transaction %u)", (int)len, name ? name : "", seq_num );
+
+    rtmp_stream_t stream = args->stream;
     //Handle callbacks for call results
-    if( amf_get_count( object ) > 1 ){
-        amf_value_t item = amf_get_item( object, 1 );
-        if( amf_value_is_like( item, AMF_TYPE_INTEGER ) ){
-            uint32_t seq_num = amf_value_get_integer( item );
-            VEC_DECLARE(rtmp_call_cb_t)* cbs = &args->stream->call_callback;
-            printf("%zd\n", VEC_SIZE(*cbs));
-            printf("%zd\n", VEC_SIZE(args->stream->call_callback));
-            bool erased = false;
-            for( size_t i = 0; i < VEC_SIZE(*cbs); ++i ){
-                printf("%zd\n", VEC_SIZE(*cbs));
-                printf("%zd\n", VEC_SIZE(args->stream->call_callback));
-                i -= erased ? 1 : 0;
-                erased = false;
-                if( (*cbs)[i].seq_num == seq_num && (*cbs)[i].callback ){
-                    ret = (*cbs)[i].callback( args, object, (*cbs)[i].user );
-                    if( ret != RTMP_CB_CONTINUE ){
-                        return ret;
-                    }
-                    if( (*cbs)[i].issued + RTMP_CALL_TIMEOUT > now ){
-                        VEC_ERASE((*cbs), i);
-                        erased = true;
-                    }
-                }
+    if( has_seq ){
+        rtmp_stream_call_expire( stream, rtmp_get_time() );
+        rtmp_call_cb_t *slot = rtmp_stream_call_find( stream, seq_num );
+        if( slot ){
+            //Take the call out first, since the callback is free to issue new ones
+            rtmp_call_cb_t call = *slot;
+            rtmp_stream_call_remove( stream, slot );
+            if( !object && !( object = rtmp_stream_decode_amf( amf_ver, contents, available ) ) ){
+                return RTMP_CB_ERROR;
+            }
+            ret = call.callback( args, object, call.user );
+            if( ret != RTMP_CB_CONTINUE ){
+                amf_destroy( object );
+                return ret;
             }
         }
     }
 
-    for( size_t i = 0; i < VEC_SIZE(args->stream->amf_callback); ++i ){
-        rtmp_amf_cb_t *cb = &args->stream->amf_callback[i];
-        if( cb->callback && ( cb->type == RTMP_ANY || cb->type == args->message ) ){
-            if( cb->name == nullptr || strncmp( cb->name, name, len ) == 0 ){
-                ret = cb->callback( args, object, cb->user );
-                if( ret != RTMP_CB_CONTINUE ){
-                    break;
-                }
+    //Callbacks can be registered for a specific message type or any type, and for a specific name or any name.
+    //Each combination has its own chain, and they're merged back into registration order.
+    size_t next[4];
+    size_t chains = 0;
+    if( name ){
+        next[chains++] = rtmp_stream_amf_find( stream, args->message, name, len );
+        next[chains++] = rtmp_stream_amf_find( stream, RTMP_ANY, name, len );
+    }
+    next[chains++] = rtmp_stream_amf_find( stream, args->message, nullptr, 0 );
+    next[chains++] = rtmp_stream_amf_find( stream, RTMP_ANY, nullptr, 0 );
+
+    while( true ){
+        size_t chain = 0;
+        for( size_t i = 1; i < chains; ++i ){
+            if( next[i] < next[chain] ){
+                chain = i;
             }
         }
+        if( next[chain] == RTMP_NO_CB ){
+            break;
+        }
+        rtmp_amf_cb_t *cb = &stream->amf_callback[next[chain]];
+        next[chain] = cb->next;
+        if( !object && !( object = rtmp_stream_decode_amf( amf_ver, contents, available ) ) ){
+            return RTMP_CB_ERROR;
+        }
+        ret = cb->callback( args, object, cb->user );
+        if( ret != RTMP_CB_CONTINUE ){
+            break;
+        }
     }
+    amf_destroy( object );
     return ret;
 }
 
 
+
 rtmp_cb_status_t rtmp_stream_call_usr(
     rtmp_stream_args_t args,
     rtmp_usr_evt_t event,
@@ -133,6 +366,87 @@ rtmp_cb_status_t rtmp_stream_call_usr(
 }
 
 
+//Splits an aggregate message into the FLV tags it carries, and passes each one through rtmp_stream_chunk_proc
+//as a message of its own. Tag bodies are handed on in place; only tag headers which straddle two pieces are copied.
+static rtmp_cb_status_t rtmp_stream_split_aggregate(
+    rtmp_stream_t self,
+    rtmp_chunk_conn_t conn,
+    const byte *contents,
+    size_t available,
+    size_t remaining,
+    const rtmp_chunk_stream_message_t *msg
+){
+    rtmp_aggregate_in_t *agg = &self->aggregate_in;
+    if( agg->chunk_stream_id == 0 ){
+        agg->chunk_stream_id = msg->chunk_stream_id;
+    }
+    else if( agg->chunk_stream_id != msg->chunk_stream_id ){
+        //Two aggregates too large to assemble are interleaved; there's only room to follow one
+        return RTMP_CB_ABORT;
+    }
+    if( available == 0 && remaining == 0 ){
+        //The aggregate was aborted, and with it any tag still open inside it
+        if( agg->body_left > 0 ){
+            rtmp_stream_chunk_proc( conn, nullptr, 0, 0, &agg->sub, self );
+        }
+        memset( agg, 0, sizeof( rtmp_aggregate_in_t ) );
+        return RTMP_CB_CONTINUE;
+    }
+
+    rtmp_cb_status_t ret = RTMP_CB_CONTINUE;
+    while( available > 0 && ret == RTMP_CB_CONTINUE ){
+        size_t amount;
+        if( agg->body_left > 0 ){
+            amount = agg->body_left < available ? agg->body_left : available;
+            agg->body_left -= amount;
+            ret = rtmp_stream_chunk_proc( conn, contents, amount, agg->body_left, &agg->sub, self );
+        }
+        else if( agg->trailer_left > 0 ){
+            //Skip the back pointer
+            amount = agg->trailer_left < available ? agg->trailer_left : available;
+            agg->trailer_left -= amount;
+        }
+        else{
+            amount = RTMP_MESSAGE_HEADER_SIZE - agg->header_len;
+            if( amount > available ){
+                amount = available;
+            }
+            memcpy( agg->header + agg->header_len, contents, amount );
+            agg->header_len += amount;
+            if( agg->header_len == RTMP_MESSAGE_HEADER_SIZE ){
+                //Type, length, timestamp with its high byte last, and a stream ID which is always 0
+                rtmp_time_t timestamp = ntoh_read_ud3( agg->header + 4 ) | (rtmp_time_t)agg->header[7] << 24;
+                if( !agg->started ){
+                    agg->first = timestamp;
+                    agg->started = true;
+                }
+                agg->sub.chunk_stream_id = msg->chunk_stream_id;
+                agg->sub.message_stream_id = msg->message_stream_id;
+                agg->sub.message_type = agg->header[0];
+                agg->sub.message_length = ntoh_read_ud3( agg->header + 1 );
+                agg->sub.timestamp = msg->timestamp + ( timestamp - agg->first );
+                agg->header_len = 0;
+                agg->body_left = agg->sub.message_length;
+                agg->trailer_left = 4;
+                if( agg->sub.message_type == RTMP_MSG_AGGREGATE ){
+                    ret = RTMP_CB_ABORT;
+                }
+            }
+        }
+        contents += amount;
+        available -= amount;
+    }
+    if( remaining == 0 || ret != RTMP_CB_CONTINUE ){
+        //Anything left over is a truncated tag, which is dropped. If its body was partly delivered, the callbacks
+        //are told it was aborted in the same way the chunk layer does, rather than being left waiting for the rest.
+        if( agg->body_left > 0 && ret == RTMP_CB_CONTINUE ){
+            ret = rtmp_stream_chunk_proc( conn, nullptr, 0, 0, &agg->sub, self );
+        }
+        memset( agg, 0, sizeof( rtmp_aggregate_in_t ) );
+    }
+    return ret;
+}
+
 rtmp_cb_status_t rtmp_stream_chunk_proc(
     rtmp_chunk_conn_t conn,
     const byte * restrict contents,
@@ -142,14 +456,16 @@ rtmp_cb_status_t rtmp_stream_chunk_proc(
     void * restrict user
 ){
     rtmp_stream_t self = (rtmp_stream_t) user;
-    amf_t amf;
     rtmp_cb_status_t ret = RTMP_CB_CONTINUE;
-    size_t amount = 0;
     uint32_t param1 = 0;
     uint32_t param2 = 0;
     int amf_ver = -1;
     rtmp_usr_evt_t usr_evt;
 
+    if( msg->message_type == RTMP_MSG_AGGREGATE ){
+        return rtmp_stream_split_aggregate( self, conn, contents, available, remaining, msg );
+    }
+
     struct rtmp_stream_args args;
     args.message = msg->message_type;
     args.message_stream = msg->message_stream_id;
@@ -177,16 +493,7 @@ rtmp_cb_status_t rtmp_stream_chunk_proc(
                 //Don't even try to deal with it; kill the connection.
                 return RTMP_CB_ABORT;
             }
-            amf = amf_create( amf_ver );
-            if( !amf ){
-                return RTMP_CB_ERROR;
-            }
-            if( amf_read( amf, contents, available, &amount ) < 0 ){
-                amf_destroy( amf );
-                return RTMP_CB_ERROR;
-            }
-            ret = rtmp_stream_call_amf( &args, amf );
-            amf_destroy( amf );
+            ret = rtmp_stream_call_amf( &args, amf_ver, contents, available );
             break;
         case RTMP_MSG_USER_CTL:
             if( remaining != 0 ){
@@ -207,6 +514,9 @@ rtmp_cb_status_t rtmp_stream_chunk_proc(
                 param2 = ntoh_read_ud( contents + 6 );
             }
             ret = rtmp_stream_call_usr( &args, usr_evt, param1, param2 );
+            if( ret == RTMP_CB_CONTINUE && usr_evt == RTMP_USR_EVT_PING_REQ ){
+                rtmp_stream_send_ping_res( self, param1 );
+            }
             break;
     }
 
@@ -264,7 +574,8 @@ void rtmp_stream_create_at( rtmp_stream_t location, bool client ){
     VEC_INIT( location->log_callback );
     VEC_INIT( location->msg_callback );
     VEC_INIT( location->usr_callback );
-    VEC_INIT( location->call_callback );
+    location->calls_oldest = location->seq_num;
+    timer_init( &location->call_timer, rtmp_stream_call_timeout, location );
 }
 
 void rtmp_stream_destroy( rtmp_stream_t stream ){
@@ -273,6 +584,7 @@ void rtmp_stream_destroy( rtmp_stream_t stream ){
 }
 
 void rtmp_stream_destroy_at( rtmp_stream_t stream ){
+    rtmp_stream_attach( stream, nullptr );
     rtmp_chunk_conn_close( stream->connection );
     rtmp_chunk_assembler_destroy( stream->assembler );
     for( size_t i = 0; i < VEC_SIZE(stream->amf_callback); ++i ){
@@ -286,8 +598,57 @@ void rtmp_stream_destroy_at( rtmp_stream_t stream ){
     VEC_DESTROY( stream->log_callback );
     VEC_DESTROY( stream->msg_callback );
     VEC_DESTROY( stream->usr_callback );
-    VEC_DESTROY( stream->call_callback );
+    free( stream->amf_index );
+    free( stream->calls );
     free( stream->scratch );
+    free( stream->aggregate_out );
+}
+
+void rtmp_stream_reset_at( rtmp_stream_t stream, bool client ){
+    rtmp_stream_attach( stream, nullptr );
+    for( size_t i = 0; i < VEC_SIZE(stream->amf_callback); ++i ){
+        free( stream->amf_callback[i].name );
+    }
+    if( stream->ondestroy ){
+        stream->ondestroy( stream->userdata );
+    }
+    rtmp_chunk_conn_reset( stream->connection, client );
+    rtmp_chunk_assembler_reset( stream->assembler );
+    rtmp_chunk_assembler_assign( stream->assembler, stream->connection );
+
+    //Keep everything that was allocated, and clear the rest
+    struct rtmp_stream kept = *stream;
+    memset( stream, 0, sizeof( struct rtmp_stream ) );
+    stream->connection = kept.connection;
+    stream->assembler = kept.assembler;
+    stream->scratch = kept.scratch;
+    stream->scratch_len = kept.scratch_len;
+    stream->aggregate_out = kept.aggregate_out;
+    stream->aggregate_cap = kept.aggregate_cap;
+    stream->event_callback = kept.event_callback;
+    stream->amf_callback = kept.amf_callback;
+    stream->log_callback = kept.log_callback;
+    stream->msg_callback = kept.msg_callback;
+    stream->usr_callback = kept.usr_callback;
+    stream->amf_index = kept.amf_index;
+    stream->amf_index_cap = kept.amf_index_cap;
+    stream->calls = kept.calls;
+    stream->calls_cap = kept.calls_cap;
+
+    VEC_SIZE( stream->event_callback ) = 0;
+    VEC_SIZE( stream->amf_callback ) = 0;
+    VEC_SIZE( stream->log_callback ) = 0;
+    VEC_SIZE( stream->msg_callback ) = 0;
+    VEC_SIZE( stream->usr_callback ) = 0;
+    for( size_t i = 0; i < stream->amf_index_cap; ++i ){
+        stream->amf_index[i].head = RTMP_NO_CB;
+    }
+    if( stream->calls ){
+        memset( stream->calls, 0, sizeof( rtmp_call_cb_t ) * stream->calls_cap );
+    }
+    stream->seq_num = 1;
+    stream->calls_oldest = stream->seq_num;
+    timer_init( &stream->call_timer, rtmp_stream_call_timeout, stream );
 }
 
 void rtmp_stream_set_data( rtmp_stream_t stream, void * data, rtmp_destroy_proc proc ){
@@ -304,6 +665,11 @@ rtmp_err_t rtmp_stream_reg_amf( rtmp_stream_t stream, rtmp_message_type_t type,
         return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
     }
 
+    //Keep the index at most half full
+    if( ( stream->amf_index_used + 1 ) * 2 > stream->amf_index_cap && !rtmp_stream_amf_grow( stream ) ){
+        return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+    }
+
     rtmp_amf_cb_t *value = VEC_PUSH( stream->amf_callback );
     if(!value){
         return RTMP_GEN_ERROR(RTMP_ERR_OOM);
@@ -311,18 +677,34 @@ rtmp_err_t rtmp_stream_reg_amf( rtmp_stream_t stream, rtmp_message_type_t type,
 
     value->callback = proc;
     value->name = nullptr;
+    value->name_len = 0;
     value->type = type;
     value->user = user;
+    value->next = RTMP_NO_CB;
 
     if( name != nullptr ){
         size_t len = strlen( name );
         value->name = (char*) malloc( sizeof( char ) * len + 1 );
         if( !value->name ){
-            //Since the length hasn't been incremented, we can safely abort without completing initialization.
+            VEC_POP( stream->amf_callback );
             return RTMP_GEN_ERROR(RTMP_ERR_OOM);
         }
         strcpy( value->name, name );
+        value->name_len = len;
+    }
+
+    size_t index = VEC_SIZE( stream->amf_callback ) - 1;
+    uint32_t hash = rtmp_stream_amf_hash( type, name, value->name_len );
+    rtmp_amf_slot_t *slot = rtmp_stream_amf_slot( stream, type, name, value->name_len, hash );
+    if( slot->head == RTMP_NO_CB ){
+        slot->head = index;
+        slot->hash = hash;
+        stream->amf_index_used++;
+    }
+    else{
+        stream->amf_callback[slot->tail].next = index;
     }
+    slot->tail = index;
 
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
@@ -374,9 +756,22 @@ rtmp_err_t rtmp_stream_reg_event( rtmp_stream_t stream, rtmp_event_t type, rtmp_
     value->type = type;
     value->user = user;
 
+    //Refresh events are only timed for streams which listen for them
+    if( stream->mgr && ( type == RTMP_EVENT_REFRESH || type == RTMP_ANY ) ){
+        rtmp_mgr_refresh( stream->mgr, stream );
+    }
     return RTMP_GEN_ERROR(RTMP_ERR_NONE);
 }
 
+bool rtmp_stream_wants_refresh( rtmp_stream_t stream ){
+    for( size_t i = 0; i < VEC_SIZE( stream->event_callback ); ++i ){
+        if( stream->event_callback[i].type == RTMP_EVENT_REFRESH || stream->event_callback[i].type == RTMP_ANY ){
+            return true;
+        }
+    }
+    return false;
+}
+
 rtmp_err_t rtmp_stream_reg_log( rtmp_stream_t stream, rtmp_log_proc proc, void *user ){
     if( !proc ){
         return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
@@ -397,6 +792,10 @@ rtmp_chunk_conn_t rtmp_stream_get_conn( rtmp_stream_t stream ){
     return stream->connection;
 }
 
+void rtmp_stream_get_stats( rtmp_stream_t stream, rtmp_stats_t *stats ){
+    rtmp_chunk_conn_get_stats( stream->connection, stats );
+}
+
 
 void rtmp_stream_set_chunk_stream( rtmp_stream_t stream, size_t chunk_id ){
     stream->chunk_id = chunk_id;
@@ -414,6 +813,14 @@ rtmp_err_t rtmp_stream_send_video( rtmp_stream_t stream, rtmp_time_t timestamp,
     return rtmp_stream_send_video2( stream, stream->chunk_id, stream->message_id, timestamp, data, len, written );
 }
 
+rtmp_err_t rtmp_stream_send_audio_ref( rtmp_stream_t stream, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user ){
+    return rtmp_stream_send_audio_ref2( stream, stream->chunk_id, stream->message_id, timestamp, data, len, release, user );
+}
+
+rtmp_err_t rtmp_stream_send_video_ref( rtmp_stream_t stream, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user ){
+    return rtmp_stream_send_video_ref2( stream, stream->chunk_id, stream->message_id, timestamp, data, len, release, user );
+}
+
 rtmp_err_t rtmp_stream_send_cmd( rtmp_stream_t stream, rtmp_time_t timestamp, amf_t amf, size_t *written  ){
     return rtmp_stream_send_cmd2( stream, stream->chunk_id, stream->message_id, timestamp, amf, written );
 }
@@ -467,7 +874,7 @@ rtmp_err_t rtmp_stream_send_audio2( rtmp_stream_t stream, size_t chunk_id, size_
     return rtmp_chunk_conn_send_message(
             stream->connection,
             RTMP_MSG_AUDIO,
-            5,
+            chunk_id,
             msg_id,
             timestamp,
             data,
@@ -478,13 +885,110 @@ rtmp_err_t rtmp_stream_send_video2( rtmp_stream_t stream, size_t chunk_id, size_
     return rtmp_chunk_conn_send_message(
             stream->connection,
             RTMP_MSG_VIDEO,
-            4,
+            chunk_id,
+            msg_id,
+            timestamp,
+            data,
+            len,
+            written );
+}
+rtmp_err_t rtmp_stream_send_audio_ref2( rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user ){
+    return rtmp_chunk_conn_send_message_ref(
+            stream->connection,
+            RTMP_MSG_AUDIO,
+            chunk_id,
             msg_id,
             timestamp,
             data,
             len,
+            release,
+            user );
+}
+rtmp_err_t rtmp_stream_send_video_ref2( rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, const byte *data, size_t len, rtmp_release_proc release, void *user ){
+    return rtmp_chunk_conn_send_message_ref(
+            stream->connection,
+            RTMP_MSG_VIDEO,
+            chunk_id,
+            msg_id,
+            timestamp,
+            data,
+            len,
+            release,
+            user );
+}
+rtmp_err_t rtmp_stream_queue_aggregate( rtmp_stream_t stream, rtmp_message_type_t type, rtmp_time_t timestamp, const byte * restrict data, size_t len ){
+    if( len > 0xFFFFFF || type == RTMP_MSG_AGGREGATE ){
+        return RTMP_GEN_ERROR(RTMP_ERR_INVALID);
+    }
+    if( stream->aggregate_busy ){
+        //The queued messages are still going out
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    size_t needed = stream->aggregate_len + RTMP_MESSAGE_HEADER_SIZE + len + 4;
+    if( needed > 0xFFFFFF ){
+        return RTMP_GEN_ERROR(RTMP_ERR_AGAIN);
+    }
+    if( needed > stream->aggregate_cap ){
+        size_t cap = stream->aggregate_cap ? stream->aggregate_cap * 2 : 1024;
+        while( cap < needed ){
+            cap *= 2;
+        }
+        byte *grown = realloc( stream->aggregate_out, cap );
+        if( !grown ){
+            return RTMP_GEN_ERROR(RTMP_ERR_OOM);
+        }
+        stream->aggregate_out = grown;
+        stream->aggregate_cap = cap;
+    }
+    if( stream->aggregate_len == 0 ){
+        stream->aggregate_time = timestamp;
+    }
+    //An FLV tag: the header, the payload and the size of both
+    byte *tag = stream->aggregate_out + stream->aggregate_len;
+    tag[0] = type;
+    ntoh_write_ud3( tag + 1, len );
+    ntoh_write_ud3( tag + 4, timestamp & 0xFFFFFF );
+    tag[7] = timestamp >> 24;
+    ntoh_write_ud3( tag + 8, 0 );
+    memcpy( tag + RTMP_MESSAGE_HEADER_SIZE, data, len );
+    ntoh_write_ud( tag + RTMP_MESSAGE_HEADER_SIZE + len, RTMP_MESSAGE_HEADER_SIZE + len );
+    stream->aggregate_len = needed;
+    return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+}
+
+size_t rtmp_stream_aggregate_size( rtmp_stream_t stream ){
+    return stream->aggregate_len;
+}
+
+rtmp_err_t rtmp_stream_send_aggregate( rtmp_stream_t stream, size_t *written ){
+    return rtmp_stream_send_aggregate2( stream, stream->chunk_id, stream->message_id, written );
+}
+
+rtmp_err_t rtmp_stream_send_aggregate2( rtmp_stream_t stream, size_t chunk_id, size_t msg_id, size_t *written ){
+    if( stream->aggregate_len == 0 ){
+        return RTMP_GEN_ERROR(RTMP_ERR_NONE);
+    }
+    rtmp_err_t ret = rtmp_chunk_conn_send_message(
+            stream->connection,
+            RTMP_MSG_AGGREGATE,
+            chunk_id,
+            msg_id,
+            stream->aggregate_time,
+            stream->aggregate_out,
+            stream->aggregate_len,
             written );
+    if( written ){
+        stream->aggregate_busy = *written > 0 && *written < stream->aggregate_len;
+        if( *written == stream->aggregate_len ){
+            stream->aggregate_len = 0;
+        }
+    }
+    else if( ret < RTMP_ERR_ERROR ){
+        stream->aggregate_len = 0;
+    }
+    return RTMP_GEN_ERROR(ret);
 }
+
 rtmp_err_t rtmp_stream_send_cmd2( rtmp_stream_t stream, size_t chunk_id, size_t msg_id, rtmp_time_t timestamp, amf_t amf, size_t *written ){
     return rtmp_stream_send_amf(
             stream,
@@ -634,7 +1138,7 @@ static rtmp_err_t rtmp_stream_issue_va( rtmp_stream_t stream, size_t chunk_id, s
     err = err ? err : amf_push_simple_list( amf, list );
     rtmp_err_t ret = rtmp_amferr( err );
     ret = ret ? ret : rtmp_stream_send_amf( stream, RTMP_MSG_AMF0_CMD, chunk_id, msg_id, 0, amf, nullptr );
-    amf_print(amf);
+    RTMP_LOG( RTMP_LOG_DEBUG, ret, "Sent command %s (transaction %.0f)", name, id );
     amf_destroy( amf );
     return ret;
 }
@@ -673,19 +1177,27 @@ rtmp_err_t rtmp_stream_respond2( rtmp_stream_t stream, size_t chunk_id, size_t m
 }
 
 rtmp_err_t rtmp_stream_call2_va( rtmp_stream_t stream, size_t chunk_id, size_t msg_id, const char *name, rtmp_stream_amf_proc callback, void * userdata, va_list list ){
+    uint32_t seq_num = stream->seq_num;
     if( callback ){
-        printf("a %zd\n", VEC_SIZE(stream->call_callback));
-        rtmp_call_cb_t * space = VEC_PUSH( stream->call_callback );
-        if( !space ){
+        rtmp_call_cb_t call;
+        call.callback = callback;
+        call.user = userdata;
+        call.seq_num = seq_num;
+        call.issued = rtmp_get_time();
+        rtmp_stream_call_expire( stream, call.issued );
+        if( !rtmp_stream_call_insert( stream, &call ) ){
             return RTMP_GEN_ERROR(RTMP_ERR_OOM);
         }
-        printf("b %zd\n", VEC_SIZE(stream->call_callback));
-        space->callback = callback;
-        space->user = userdata;
-        space->seq_num = stream->seq_num;
-        space->issued = rtmp_get_time();
+        //A scheduled timer is already due no later than this call
+        if( stream->mgr && !timer_scheduled( &stream->call_timer ) ){
+            timer_wheel_schedule( stream->mgr->timers, &stream->call_timer, call.issued + RTMP_CALL_TIMEOUT );
+        }
+    }
+    //Zero marks an empty call slot, so it's never handed out
+    if( ++stream->seq_num == 0 ){
+        stream->seq_num = 1;
     }
 
-    rtmp_err_t ret = rtmp_stream_issue_va( stream, chunk_id, msg_id, name, stream->seq_num ++, list );
+    rtmp_err_t ret = rtmp_stream_issue_va( stream, chunk_id, msg_id, name, seq_num, list );
     return ret;
 }
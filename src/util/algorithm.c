@@ -79,5 +79,10 @@ size_t alg_search_lin( const void * restrict needle, const void * restrict hayst
     return count;
 }
 
-
-
+uint32_t alg_hash( const void * restrict data, size_t len, uint32_t seed ){
+    const unsigned char *d = data;
+    for( size_t i = 0; i < len; ++i ){
+        seed = ( seed ^ d[i] ) * 16777619u;
+    }
+    return seed;
+}
@@ -0,0 +1,161 @@
+/*
+    handletable.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdlib.h>
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/util/handletable.h>
+
+#define HANDLE_FREE_END UINT32_MAX
+
+typedef struct handle_slot{
+    //Bumped whenever the slot's value is removed
+    uint32_t generation;
+    //The value's index in the packed arrays, or the next free slot
+    uint32_t link;
+} handle_slot_t;
+
+struct handle_table{
+    handle_slot_t *slots;
+    uint32_t slot_count;
+    uint32_t free_head;
+    //Packed values, and the slot each one belongs to
+    void **values;
+    uint32_t *owners;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+static inline uint32_t handle_index( handle_t handle ){
+    return (uint32_t)handle;
+}
+
+static inline uint32_t handle_generation( handle_t handle ){
+    return (uint32_t)( handle >> 32 );
+}
+
+handle_table_t handle_table_create( void ){
+    handle_table_t table = calloc( 1, sizeof( struct handle_table ) );
+    if( !table ){
+        return nullptr;
+    }
+    table->free_head = HANDLE_FREE_END;
+    return table;
+}
+
+void handle_table_destroy( handle_table_t table ){
+    if( !table ){
+        return;
+    }
+    free( table->slots );
+    free( table->values );
+    free( table->owners );
+    free( table );
+}
+
+//Slots and packed entries are always added together, so both grow to the same capacity
+static bool handle_table_grow( handle_table_t table ){
+    if( table->capacity >= HANDLE_FREE_END / 2 ){
+        return false;
+    }
+    uint32_t capacity = table->capacity ? table->capacity * 2 : 16;
+    handle_slot_t *slots = realloc( table->slots, capacity * sizeof( handle_slot_t ) );
+    if( !slots ){
+        return false;
+    }
+    table->slots = slots;
+    void **values = realloc( table->values, capacity * sizeof( void* ) );
+    if( !values ){
+        return false;
+    }
+    table->values = values;
+    uint32_t *owners = realloc( table->owners, capacity * sizeof( uint32_t ) );
+    if( !owners ){
+        return false;
+    }
+    table->owners = owners;
+    table->capacity = capacity;
+    return true;
+}
+
+handle_t handle_table_add( handle_table_t table, void *value ){
+    uint32_t index = table->free_head;
+    if( index == HANDLE_FREE_END ){
+        if( table->slot_count == table->capacity && !handle_table_grow( table ) ){
+            return HANDLE_NONE;
+        }
+        index = table->slot_count++;
+        //Generation 0 is skipped so that no handle is ever HANDLE_NONE
+        table->slots[index].generation = 1;
+    }
+    else{
+        table->free_head = table->slots[index].link;
+    }
+    handle_slot_t *slot = &table->slots[index];
+    slot->link = table->count;
+    table->values[table->count] = value;
+    table->owners[table->count] = index;
+    table->count++;
+    return (handle_t)slot->generation << 32 | index;
+}
+
+static handle_slot_t * handle_table_slot( handle_table_t table, handle_t handle ){
+    uint32_t index = handle_index( handle );
+    if( index >= table->slot_count ){
+        return nullptr;
+    }
+    handle_slot_t *slot = &table->slots[index];
+    return slot->generation == handle_generation( handle ) ? slot : nullptr;
+}
+
+void * handle_table_get( handle_table_t table, handle_t handle ){
+    handle_slot_t *slot = handle_table_slot( table, handle );
+    return slot ? table->values[slot->link] : nullptr;
+}
+
+bool handle_table_remove( handle_table_t table, handle_t handle ){
+    handle_slot_t *slot = handle_table_slot( table, handle );
+    if( !slot ){
+        return false;
+    }
+    uint32_t hole = slot->link;
+    uint32_t last = --table->count;
+    if( hole != last ){
+        table->values[hole] = table->values[last];
+        table->owners[hole] = table->owners[last];
+        table->slots[table->owners[hole]].link = hole;
+    }
+    if( ++slot->generation == 0 ){
+        slot->generation = 1;
+    }
+    slot->link = table->free_head;
+    table->free_head = handle_index( handle );
+    return true;
+}
+
+size_t handle_table_count( handle_table_t table ){
+    return table->count;
+}
+
+void * handle_table_at( handle_table_t table, size_t index ){
+    return table->values[index];
+}
@@ -32,100 +32,8 @@
 #include <openrtmp/util/memutil.h>
 #include <openrtmp/rtmp.h>
 
-//memcpy that will reverse byte order if the machine is little endian
-void ntoh_memcpy(void * restrict dst, const void * restrict src, size_t len){
-    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-        byte *output = dst;
-        const byte *input = src;
-        while( len --> 0 ){
-            *(output++) = input[len];
-        }
-    #elif __BYTE_ORDER__ == __ORDER_PDP_ENDIAN__
-        #error "Intentionally unsupported"
-    #else
-        memcpy( dst, src, len );
-    #endif
-}
-
-//Read a short from a buffer based on endianess
-short ntoh_read_s(const void *src){
-    short value;
-    ntoh_memcpy( &value, src, 2 );
-    return value;
-}
-
-//Read an int from a buffer based on endianess
-int ntoh_read_d(const void *src){
-    int value;
-    ntoh_memcpy( &value, src, 4 );
-    return value;
-}
-
-//Read a short from a buffer based on endianess
-uint16_t ntoh_read_us(const void *src){
-    uint16_t value;
-    ntoh_memcpy( &value, src, 2 );
-    return value;
-}
-
-//Read an int from a buffer based on endianess
-uint32_t ntoh_read_ud(const void *src){
-    uint32_t value;
-    ntoh_memcpy( &value, src, sizeof( uint32_t ) );
-    return value;
-}
-
-//Write a short to a buffer based on endianess
-void ntoh_write_s(void *src, short value){
-    ntoh_memcpy( src, &value, sizeof( value ) );
-}
-
-//Write an int to a buffer based on endianess
-void ntoh_write_d(void *src, int value){
-    ntoh_memcpy( src, &value, sizeof( value ) );
-}
-
-//Write a short to a buffer based on endianess
-void ntoh_write_us(void *src, uint16_t value){
-    ntoh_memcpy( src, &value, sizeof( value ) );
-}
-
-//Write an int to a buffer based on endianess
-void ntoh_write_ud(void *src, uint32_t value){
-    ntoh_memcpy( src, &value, sizeof( value ) );
-}
-
-void htol_write_ud(void *dst, uint32_t value){
-    memcpy( dst, &value, sizeof( value ));
-}
-uint32_t ltoh_read_ud(void *src){
-    uint32_t value;
-    memcpy( &value, src, sizeof( uint32_t ));
-    return value;
-}
-
-//Write an int to a buffer based on endianess
-void ntoh_write_ud3(void *dst, uint32_t value){
-    byte *dstb = dst;
-    dstb[0] = (value >> 16 ) & 255;
-    dstb[1] = (value >> 8 ) & 255;
-    dstb[2] = (value ) & 255;
-}
-//Read a 3 byte int from a buffer based on endianess
-uint32_t ntoh_read_ud3(void *src){
-    uint32_t ret;
-    byte *srcb = src;
-    ret = srcb[0];
-    ret <<= 8;
-    ret |= srcb[1];
-    ret <<= 8;
-    ret |= srcb[2];
-    return ret;
-}
-
-
 void emit_err(const char* err){
-    printf("%s\n", err);
+    RTMP_LOG( RTMP_LOG_ERROR, RTMP_ERR_ERROR, "%s", err );
 }
 
 //Get the difference between timestamps. This is dependent on wrapping behavior of ints
@@ -188,6 +96,13 @@ rtmp_time_t rtmp_get_time( void ){
     return s;
 }
 
+//Return a nanosecond timestamp
+uint64_t rtmp_get_time_ns( void ){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
 //Static array of powers of ten for use in si_convert
 static const unsigned long long si_pow10_table[] = {
     1ull,
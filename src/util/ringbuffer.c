@@ -20,9 +20,16 @@
     along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
 
 */
+#ifdef RTMP_HAS_MEMFD
+#   define _GNU_SOURCE
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/rtmp/rtmp_config.h>
 #include <openrtmp/util/ringbuffer.h>
 
 #define READ_FROZEN(a) (a&1)
@@ -41,21 +48,114 @@ struct ringbuffer{
     unsigned long start;
     unsigned long len;
     unsigned long size;
+    unsigned long limit;
+    ringbuffer_budget_t *budget;
+    //Whether data is followed by a second mapping of the same pages
+    bool mirrored;
+    //Whether data must stay where it is; kept apart from frozen, which clearing resets
+    bool pinned;
 };
 
+#ifdef RTMP_HAS_MEMFD
+static unsigned long ringbuffer_page_size( void ){
+    static unsigned long page = 0;
+    if( page == 0 ){
+        page = sysconf( _SC_PAGESIZE );
+    }
+    return page;
+}
+
+//Maps size bytes of memory twice in a row, so that data[i] and data[i + size] are the same byte
+static char * ringbuffer_map_mirror( unsigned long size ){
+    int fd = memfd_create( "ringbuffer", MFD_CLOEXEC );
+    if( fd < 0 ){
+        return nullptr;
+    }
+    char *data = nullptr;
+    if( ftruncate( fd, size ) == 0 ){
+        //Reserve the address range for both halves first so nothing else can land in between
+        void *base = mmap( nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( base != MAP_FAILED ){
+            if( mmap( base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) != MAP_FAILED &&
+                mmap( (char*)base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) != MAP_FAILED ){
+                data = base;
+            }
+            else{
+                munmap( base, size * 2 );
+            }
+        }
+    }
+    //The mappings keep the memory alive on their own
+    close( fd );
+    return data;
+}
+#endif
+
+//Returns the capacity a buffer asking for size bytes will get. Mirrored storage is rounded up to whole pages.
+static unsigned long ringbuffer_round( unsigned long size ){
+    #ifdef RTMP_HAS_MEMFD
+    if( RTMP_RINGBUFFER_MIRROR_MIN > 0 && size >= RTMP_RINGBUFFER_MIRROR_MIN ){
+        unsigned long page = ringbuffer_page_size();
+        return (size + page - 1) / page * page;
+    }
+    #endif
+    return size;
+}
+
+//Allocates storage for a buffer of size bytes, mirrored if it is large enough, in which case size may grow.
+static char * ringbuffer_alloc( unsigned long *size, bool *mirrored ){
+    *mirrored = false;
+    #ifdef RTMP_HAS_MEMFD
+    if( RTMP_RINGBUFFER_MIRROR_MIN > 0 && *size >= RTMP_RINGBUFFER_MIRROR_MIN ){
+        unsigned long rounded = ringbuffer_round( *size );
+        char *data = ringbuffer_map_mirror( rounded );
+        if( data ){
+            *size = rounded;
+            *mirrored = true;
+            return data;
+        }
+        //Out of mappings or unsupported at runtime; the heap still works
+    }
+    #endif
+    return malloc( *size );
+}
+
+static void ringbuffer_free_data( char *data, unsigned long size, bool mirrored ){
+    #ifdef RTMP_HAS_MEMFD
+    if( mirrored ){
+        munmap( data, size * 2 );
+        return;
+    }
+    #endif
+    free( data );
+}
+
 ringbuffer_t ringbuffer_create( unsigned long size){
     ringbuffer_t buf = malloc( sizeof( struct ringbuffer ) );
-    buf->data = malloc( size );
+    if( !buf ){
+        return nullptr;
+    }
+    buf->data = ringbuffer_alloc( &size, &buf->mirrored );
+    if( !buf->data ){
+        free( buf );
+        return nullptr;
+    }
     buf->start = buf->len = 0;
     buf->size = size;
     buf->read_offset = 0;
     buf->write_offset = 0;
     buf->frozen = 0;
+    buf->limit = 0;
+    buf->budget = nullptr;
+    buf->pinned = false;
     return buf;
 }
 
 void ringbuffer_destroy( ringbuffer_t buffer ){
-    free( buffer->data );
+    if( buffer->budget ){
+        buffer->budget->used -= buffer->size;
+    }
+    ringbuffer_free_data( buffer->data, buffer->size, buffer->mirrored );
     free( buffer );
 }
 
@@ -71,8 +171,8 @@ void* ringbuffer_get_write_buf( ringbuffer_t buffer, unsigned long *size ){
     unsigned long length = buffer->size - buffer->len - buffer->write_offset;
     void *buff = buffer->data + offset;
     if( size ){
-        //If the length of the buffer doesn't fall off the end, return the length as-is
-        if( offset + length < buffer->size ){
+        //If the length of the buffer doesn't fall off the end, or the end is mirrored, return the length as-is
+        if( buffer->mirrored || offset + length < buffer->size ){
             *size = length;
         }
         //Otherwise return the length from the write offset to the end of the allocated buffer
@@ -87,8 +187,8 @@ const void* ringbuffer_get_read_buf( ringbuffer_t buffer, unsigned long *size ){
     unsigned long length = buffer->len + buffer->write_offset - buffer->read_offset;
     void *buff = buffer->data + offset;
     if( size ){
-        //If the length of the read buffer doesn't fall off of the end, return the length as-is
-        if( offset + length < buffer->size ){
+        //If the length of the read buffer doesn't fall off of the end, or the end is mirrored, return the length as-is
+        if( buffer->mirrored || offset + length < buffer->size ){
             *size = length;
         }
         //Otherwise, return the distance from the read offset to the end of the allocated buffer
@@ -98,6 +198,21 @@ const void* ringbuffer_get_read_buf( ringbuffer_t buffer, unsigned long *size ){
     }
     return buff;
 }
+const void* ringbuffer_peek_read( ringbuffer_t buffer, unsigned long skip, unsigned long *size ){
+    unsigned long length = buffer->len + buffer->write_offset - buffer->read_offset;
+    if( skip >= length ){
+        *size = 0;
+        return nullptr;
+    }
+    unsigned long offset = (buffer->start + buffer->read_offset + skip) % buffer->size;
+    length -= skip;
+    //Stop at the end of the allocated buffer, just like ringbuffer_get_read_buf
+    if( !buffer->mirrored && offset + length > buffer->size ){
+        length = buffer->size - offset;
+    }
+    *size = length;
+    return buffer->data + offset;
+}
 unsigned long ringbuffer_commit_write( ringbuffer_t buffer, unsigned long len ){
     if( WRITE_FROZEN(buffer->frozen) ){
         unsigned long ret = buffer->write_offset;
@@ -148,6 +263,10 @@ unsigned long ringbuffer_count( ringbuffer_t buffer ){
     return buffer->len + buffer->write_offset - buffer->read_offset;
 }
 
+unsigned long ringbuffer_space( ringbuffer_t buffer ){
+    return buffer->size - buffer->len - buffer->write_offset;
+}
+
 void ringbuffer_expand( ringbuffer_t buffer, unsigned long amount ){
     ringbuffer_resize( buffer, buffer->size + amount );
 }
@@ -160,49 +279,111 @@ void ringbuffer_shrink( ringbuffer_t buffer, unsigned long amount ){
 }
 
 void ringbuffer_resize( ringbuffer_t buffer, unsigned long amount ){
-    if( amount > buffer->size ){
-        //Expand memory then move data
-        buffer->data = realloc( buffer->data, amount );
-        //Get number of bytes hanging off the end
-        unsigned long offset = buffer->len + buffer->start + buffer->write_offset;
-        unsigned long overlap = offset % buffer->size;
-        //If there are some hanging off, determine how many bytes to move from the start of the buffer
-        //to the new space added to the end.
-        if( offset > buffer->size ){
-            unsigned long new_space = amount - buffer->size;
-            if( new_space > overlap ){
-                new_space = overlap;
-            }
-            //Move the first bytes of the buffer to the new area
-            memmove( buffer->data + buffer->size, buffer->data, new_space );
-            //If there's any data left at the beginning, move it down to the start of the array
-            memmove( buffer->data, buffer->data + new_space, overlap - new_space);
-        }
+    if( amount == 0 || buffer->pinned || ringbuffer_round( amount ) == buffer->size ){
+        return;
+    }
+    //Allocate first, so that a failure leaves the content where it was
+    bool mirrored;
+    char *data = ringbuffer_alloc( &amount, &mirrored );
+    if( !data ){
+        //Leave the buffer untouched; callers check the capacity afterwards
+        return;
     }
-    else if( amount < buffer->size ){
-        //Move data then shrink memory
-        unsigned long commit = 0;
-        //Determine number of bytes to trim off the start
-        if( amount < buffer->len + buffer->write_offset ){
-            commit = buffer->len + buffer->write_offset - amount;
+    //Trim bytes off the start if the content won't fit in the new capacity
+    unsigned long used = buffer->len + buffer->write_offset;
+    if( used > amount ){
+        unsigned long trim = used - amount;
+        buffer->start = (buffer->start + trim) % buffer->size;
+        if( trim > buffer->len ){
+            buffer->write_offset -= trim - buffer->len;
+            buffer->len = 0;
         }
-        //Trim them
-        ringbuffer_commit_read( buffer, commit );
-        //Get number of bytes hanging off the end
-        unsigned long offset = buffer->len + buffer->start + buffer->write_offset;
-        unsigned long overlap = offset % buffer->size;
-        if( offset > buffer->size ){
-            //If any, move them to where they would be if start was zero
-            memmove( buffer->data + buffer->len + buffer->write_offset - overlap, buffer->data, overlap );
+        else{
+            buffer->len -= trim;
         }
-        //Move everything between start and size to the front of the buffer
-        //Since the previous move is only done if the data overlaps the end, this will not clobber anything.
-        memmove( buffer->data, buffer->data + buffer->start, buffer->size - buffer->start );
-        buffer->data = realloc( buffer->data, amount );
+        buffer->read_offset = buffer->read_offset > trim ? buffer->read_offset - trim : 0;
+        used = amount;
+    }
+    //Linearize the content so that it begins at the start of the new allocation.
+    //Mirrored content never wraps, so it moves in one piece.
+    unsigned long head = buffer->size - buffer->start;
+    if( buffer->mirrored || head > used ){
+        head = used;
     }
+    memcpy( data, buffer->data + buffer->start, head );
+    memcpy( data + head, buffer->data, used - head );
+    ringbuffer_free_data( buffer->data, buffer->size, buffer->mirrored );
+    buffer->mirrored = mirrored;
+    if( buffer->budget ){
+        buffer->budget->used += amount;
+        buffer->budget->used -= buffer->size;
+    }
+    buffer->data = data;
+    buffer->start = 0;
     buffer->size = amount;
 }
 
+unsigned long ringbuffer_reserve( ringbuffer_t buffer, unsigned long amount ){
+    unsigned long space = ringbuffer_space( buffer );
+    if( space >= amount ){
+        return space;
+    }
+    //Grow geometrically so that repeated reservations stay cheap
+    unsigned long target = buffer->size ? buffer->size : 1;
+    while( target - (buffer->size - space) < amount ){
+        target *= 2;
+    }
+    if( buffer->limit && target > buffer->limit ){
+        target = buffer->limit;
+    }
+    if( buffer->budget && buffer->budget->limit ){
+        unsigned long available = 0;
+        if( buffer->budget->limit > buffer->budget->used ){
+            available = buffer->budget->limit - buffer->budget->used;
+        }
+        if( target > buffer->size + available ){
+            target = buffer->size + available;
+        }
+    }
+    if( target > buffer->size ){
+        ringbuffer_resize( buffer, target );
+    }
+    return ringbuffer_space( buffer );
+}
+
+void ringbuffer_compact( ringbuffer_t buffer, unsigned long floor ){
+    if( buffer->frozen ){
+        return;
+    }
+    unsigned long target = buffer->size;
+    unsigned long used = buffer->len;
+    //Halve the capacity while the buffer would still be no more than half full
+    while( target / 2 >= floor && used <= target / 4 ){
+        target /= 2;
+    }
+    if( target < buffer->size ){
+        ringbuffer_resize( buffer, target );
+    }
+}
+
+void ringbuffer_pin( ringbuffer_t buffer, bool pinned ){
+    buffer->pinned = pinned;
+}
+
+void ringbuffer_set_limit( ringbuffer_t buffer, unsigned long limit ){
+    buffer->limit = limit;
+}
+
+void ringbuffer_set_budget( ringbuffer_t buffer, ringbuffer_budget_t *budget ){
+    if( buffer->budget ){
+        buffer->budget->used -= buffer->size;
+    }
+    buffer->budget = budget;
+    if( buffer->budget ){
+        buffer->budget->used += buffer->size;
+    }
+}
+
 unsigned long ringbuffer_size( ringbuffer_t buffer ){
     return buffer->size;
 }
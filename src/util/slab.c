@@ -0,0 +1,162 @@
+/*
+    slab.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/util/slab.h>
+#include <openrtmp/util/vec.h>
+
+//Precedes every object, and links it into the free list while it is not in use
+typedef struct slab_hdr{
+    slab_pool_t pool;
+    struct slab_hdr *next;
+} slab_hdr_t;
+
+//Keeps objects aligned for anything the connection structures may hold
+#define SLAB_ALIGN 16
+#define SLAB_HDR_SIZE ((sizeof( slab_hdr_t ) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+
+struct slab_pool{
+    pthread_mutex_t lock;
+    size_t stride;
+    size_t per_slab;
+    VEC_DECLARE(void*) slabs;
+    //Freed objects are pushed on top of the ones a new slab was carved into, so the
+    //bottom fresh entries of the free list have never been handed out
+    slab_hdr_t *free_list;
+    size_t fresh;
+    slab_stats_t stats;
+    bool destroyed;
+};
+
+slab_pool_t slab_pool_create( size_t object_size, size_t per_slab ){
+    slab_pool_t pool = calloc( 1, sizeof( struct slab_pool ) );
+    if( !pool ){
+        return nullptr;
+    }
+    VEC_INIT( pool->slabs );
+    if( !pool->slabs ){
+        free( pool );
+        return nullptr;
+    }
+    pthread_mutex_init( &pool->lock, nullptr );
+    pool->stride = SLAB_HDR_SIZE + ((object_size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1));
+    pool->per_slab = per_slab > 0 ? per_slab : 1;
+    pool->stats.object_size = object_size;
+    return pool;
+}
+
+static void slab_pool_free( slab_pool_t pool ){
+    VEC_DESTROY_DTOR( pool->slabs, free );
+    pthread_mutex_destroy( &pool->lock );
+    free( pool );
+}
+
+void slab_pool_destroy( slab_pool_t pool ){
+    if( !pool ){
+        return;
+    }
+    pthread_mutex_lock( &pool->lock );
+    pool->destroyed = true;
+    bool idle = pool->stats.live == 0;
+    pthread_mutex_unlock( &pool->lock );
+    //Otherwise the last slab_free releases the pool
+    if( idle ){
+        slab_pool_free( pool );
+    }
+}
+
+//Carves a new slab into objects and puts them on the free list. The caller must hold the lock.
+static bool slab_grow( slab_pool_t pool ){
+    void **loc = VEC_PUSH( pool->slabs );
+    byte *slab = loc ? malloc( pool->stride * pool->per_slab ) : nullptr;
+    if( !slab ){
+        if( loc ){
+            VEC_POP( pool->slabs );
+        }
+        return false;
+    }
+    *loc = slab;
+    for( size_t i = pool->per_slab; i > 0; --i ){
+        slab_hdr_t *hdr = (slab_hdr_t*)(slab + (i - 1) * pool->stride);
+        hdr->pool = pool;
+        hdr->next = pool->free_list;
+        pool->free_list = hdr;
+    }
+    pool->stats.slabs++;
+    pool->stats.cached += pool->per_slab;
+    pool->fresh = pool->per_slab;
+    return true;
+}
+
+void * slab_alloc( slab_pool_t pool ){
+    pthread_mutex_lock( &pool->lock );
+    if( !pool->free_list && !slab_grow( pool ) ){
+        pthread_mutex_unlock( &pool->lock );
+        return nullptr;
+    }
+    slab_hdr_t *hdr = pool->free_list;
+    pool->free_list = hdr->next;
+    if( pool->stats.cached > pool->fresh ){
+        pool->stats.reuses++;
+    }
+    else{
+        pool->fresh--;
+    }
+    pool->stats.cached--;
+    pool->stats.live++;
+    pool->stats.allocs++;
+    if( pool->stats.live > pool->stats.peak ){
+        pool->stats.peak = pool->stats.live;
+    }
+    pthread_mutex_unlock( &pool->lock );
+
+    void *object = (byte*)hdr + SLAB_HDR_SIZE;
+    memset( object, 0, pool->stride - SLAB_HDR_SIZE );
+    return object;
+}
+
+void slab_free( void * object ){
+    if( !object ){
+        return;
+    }
+    slab_hdr_t *hdr = (slab_hdr_t*)((byte*)object - SLAB_HDR_SIZE);
+    slab_pool_t pool = hdr->pool;
+    pthread_mutex_lock( &pool->lock );
+    hdr->next = pool->free_list;
+    pool->free_list = hdr;
+    pool->stats.cached++;
+    pool->stats.live--;
+    bool release = pool->destroyed && pool->stats.live == 0;
+    pthread_mutex_unlock( &pool->lock );
+    if( release ){
+        slab_pool_free( pool );
+    }
+}
+
+void slab_pool_stats( slab_pool_t pool, slab_stats_t *stats ){
+    pthread_mutex_lock( &pool->lock );
+    *stats = pool->stats;
+    pthread_mutex_unlock( &pool->lock );
+}
@@ -0,0 +1,249 @@
+/*
+    timerwheel.c
+
+    Copyright (C) 2016 Hubtag LLC.
+
+    ----------------------------------------
+
+    This file is part of libOpenRTMP.
+
+    libOpenRTMP is free software: you can redistribute it and/or modify
+    it under the terms of version 3 of the GNU Affero General Public License
+    as published by the Free Software Foundation.
+
+    libOpenRTMP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with libOpenRTMP. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <stdlib.h>
+#include <openrtmp/rtmp/rtmp_types.h>
+#include <openrtmp/util/timerwheel.h>
+
+//Each level has 64 slots, each covering 64 times as long as a slot on the level below.
+//Six levels reach 2^36 milliseconds, a bit over two years; timers further out wait on the last level.
+#define TIMER_LEVELS    6
+#define TIMER_BITS      6
+#define TIMER_SLOTS     ( 1 << TIMER_BITS )
+#define TIMER_MASK      ( TIMER_SLOTS - 1 )
+#define TIMER_RANGE     ( (uint64_t)1 << ( TIMER_LEVELS * TIMER_BITS ) )
+
+//Values of level for timers which aren't in a slot
+#define TIMER_IDLE      0xFF
+#define TIMER_EXPIRED   0xFE
+#define TIMER_RUNNING   0xFD
+
+typedef struct timer_level{
+    //Bit n is set when slot n has timers
+    uint64_t occupied;
+    timer_link_t slots[TIMER_SLOTS];
+} timer_level_t;
+
+struct timer_wheel{
+    //The time the wheel has been advanced to
+    uint64_t elapsed;
+    //Timers scheduled for a time which had already passed
+    timer_link_t expired;
+    timer_level_t levels[TIMER_LEVELS];
+};
+
+static inline void link_init( timer_link_t *list ){
+    list->next = list->prev = list;
+}
+
+static inline bool link_empty( const timer_link_t *list ){
+    return list->next == list;
+}
+
+static inline void link_push( timer_link_t *list, timer_link_t *link ){
+    link->prev = list->prev;
+    link->next = list;
+    list->prev->next = link;
+    list->prev = link;
+}
+
+static inline void link_remove( timer_link_t *link ){
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = link->prev = nullptr;
+}
+
+//Moves every timer in from onto an empty to
+static inline void link_take( timer_link_t *to, timer_link_t *from ){
+    if( link_empty( from ) ){
+        link_init( to );
+        return;
+    }
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    link_init( from );
+}
+
+timer_wheel_t timer_wheel_create( uint64_t now ){
+    timer_wheel_t wheel = malloc( sizeof( struct timer_wheel ) );
+    if( !wheel ){
+        return nullptr;
+    }
+    wheel->elapsed = now;
+    link_init( &wheel->expired );
+    for( size_t l = 0; l < TIMER_LEVELS; ++l ){
+        wheel->levels[l].occupied = 0;
+        for( size_t s = 0; s < TIMER_SLOTS; ++s ){
+            link_init( &wheel->levels[l].slots[s] );
+        }
+    }
+    return wheel;
+}
+
+void timer_wheel_destroy( timer_wheel_t wheel ){
+    free( wheel );
+}
+
+void timer_init( timer_entry_t *timer, timer_proc proc, void *user ){
+    timer->link.next = timer->link.prev = nullptr;
+    timer->deadline = 0;
+    timer->proc = proc;
+    timer->user = user;
+    timer->level = TIMER_IDLE;
+    timer->slot = 0;
+}
+
+bool timer_scheduled( const timer_entry_t *timer ){
+    return timer->level != TIMER_IDLE;
+}
+
+//Files a timer on the level where its deadline first differs from the wheel's time, so that it moves down a level
+//each time the wheel reaches its slot, until it is due
+static void wheel_file( timer_wheel_t wheel, timer_entry_t *timer ){
+    if( timer->deadline <= wheel->elapsed ){
+        timer->level = TIMER_EXPIRED;
+        link_push( &wheel->expired, &timer->link );
+        return;
+    }
+    uint64_t deadline = timer->deadline;
+    if( deadline - wheel->elapsed >= TIMER_RANGE ){
+        deadline = wheel->elapsed + TIMER_RANGE - 1;
+    }
+    uint64_t differs = ( deadline ^ wheel->elapsed ) | TIMER_MASK;
+    if( differs >= TIMER_RANGE ){
+        differs = TIMER_RANGE - 1;
+    }
+    size_t level = ( 63 - __builtin_clzll( differs ) ) / TIMER_BITS;
+    size_t slot = ( deadline >> ( level * TIMER_BITS ) ) & TIMER_MASK;
+    timer->level = level;
+    timer->slot = slot;
+    link_push( &wheel->levels[level].slots[slot], &timer->link );
+    wheel->levels[level].occupied |= (uint64_t)1 << slot;
+}
+
+void timer_wheel_cancel( timer_wheel_t wheel, timer_entry_t *timer ){
+    if( timer->level == TIMER_IDLE ){
+        return;
+    }
+    link_remove( &timer->link );
+    if( timer->level < TIMER_LEVELS ){
+        timer_level_t *level = &wheel->levels[timer->level];
+        if( link_empty( &level->slots[timer->slot] ) ){
+            level->occupied &= ~( (uint64_t)1 << timer->slot );
+        }
+    }
+    timer->level = TIMER_IDLE;
+}
+
+void timer_wheel_schedule( timer_wheel_t wheel, timer_entry_t *timer, uint64_t deadline ){
+    timer_wheel_cancel( wheel, timer );
+    timer->deadline = deadline;
+    wheel_file( wheel, timer );
+}
+
+//Finds the slot the wheel reaches next, and when it does. Lower levels are always reached first.
+static bool wheel_next_slot( timer_wheel_t wheel, size_t *level, size_t *slot, uint64_t *when ){
+    for( size_t l = 0; l < TIMER_LEVELS; ++l ){
+        uint64_t occupied = wheel->levels[l].occupied;
+        if( !occupied ){
+            continue;
+        }
+        size_t shift = l * TIMER_BITS;
+        //Timers in or behind the current slot are due on the next turn of the level, so the search starts after it
+        size_t first = ( ( wheel->elapsed >> shift ) + 1 ) & TIMER_MASK;
+        uint64_t rotated = first ? ( occupied >> first ) | ( occupied << ( TIMER_SLOTS - first ) ) : occupied;
+        size_t s = ( __builtin_ctzll( rotated ) + first ) & TIMER_MASK;
+        uint64_t range = (uint64_t)1 << ( shift + TIMER_BITS );
+        uint64_t start = ( wheel->elapsed & ~( range - 1 ) ) + ( (uint64_t)s << shift );
+        if( start <= wheel->elapsed ){
+            start += range;
+        }
+        *level = l;
+        *slot = s;
+        *when = start;
+        return true;
+    }
+    return false;
+}
+
+//Runs the callbacks of the timers in list which are due, and files the rest further down
+static size_t wheel_run( timer_wheel_t wheel, timer_link_t *list ){
+    size_t ran = 0;
+    //Callbacks may cancel or schedule timers still on the list, so it is taken apart one timer at a time
+    for( timer_link_t *link = list->next; link != list; link = link->next ){
+        ( (timer_entry_t*)link )->level = TIMER_RUNNING;
+    }
+    while( !link_empty( list ) ){
+        timer_entry_t *timer = (timer_entry_t*)list->next;
+        link_remove( &timer->link );
+        if( timer->deadline <= wheel->elapsed ){
+            timer->level = TIMER_IDLE;
+            timer->proc( timer, timer->user );
+            ++ran;
+        }
+        else{
+            wheel_file( wheel, timer );
+        }
+    }
+    return ran;
+}
+
+size_t timer_wheel_advance( timer_wheel_t wheel, uint64_t now ){
+    size_t ran = 0;
+    while( true ){
+        timer_link_t due;
+        if( !link_empty( &wheel->expired ) ){
+            link_take( &due, &wheel->expired );
+            ran += wheel_run( wheel, &due );
+            continue;
+        }
+        size_t level, slot;
+        uint64_t when;
+        if( !wheel_next_slot( wheel, &level, &slot, &when ) || when > now ){
+            break;
+        }
+        wheel->elapsed = when;
+        wheel->levels[level].occupied &= ~( (uint64_t)1 << slot );
+        link_take( &due, &wheel->levels[level].slots[slot] );
+        ran += wheel_run( wheel, &due );
+    }
+    if( now > wheel->elapsed ){
+        wheel->elapsed = now;
+    }
+    return ran;
+}
+
+int64_t timer_wheel_next( timer_wheel_t wheel, uint64_t now ){
+    if( !link_empty( &wheel->expired ) ){
+        return 0;
+    }
+    size_t level, slot;
+    uint64_t when;
+    if( !wheel_next_slot( wheel, &level, &slot, &when ) ){
+        return -1;
+    }
+    return when > now ? (int64_t)( when - now ) : 0;
+}